@@ -133,6 +133,7 @@ ADDRESS *mutt_expand_aliases(ADDRESS *a)
 
 void mutt_expand_aliases_env(ENVELOPE *env)
 {
+  mutt_env_restore_lazy(env);
   env->from = mutt_expand_aliases(env->from);
   env->to = mutt_expand_aliases(env->to);
   env->cc = mutt_expand_aliases(env->cc);
@@ -0,0 +1,66 @@
+/**
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define MAIN_C 1
+
+#include "config.h"
+#include <stdlib.h>
+#include <time.h>
+#include "mutt.h"
+#include "bench.h"
+#include "keymap.h"
+#include "mailbox.h"
+#include "mbyte.h"
+#include "mutt_crypt.h"
+#include "mutt_curses.h"
+#include "mutt_regex.h"
+#include "mx.h"
+#include "sort.h"
+
+char **envlist;
+
+void mutt_exit(int code)
+{
+  exit(code);
+}
+
+/**
+ * bench_init - Set up what the benchmarks need from mutt's configuration
+ *
+ * Messages and errors are printed to stderr, the charset is UTF-8 and
+ * $reply_regexp has its default value.
+ */
+void bench_init(void)
+{
+  mutt_error = mutt_message = mutt_nocurses_error;
+  set_option(OPTNOCURSES);
+  Charset = safe_strdup("utf-8");
+  mutt_set_charset(Charset);
+  ReplyRegexp.pattern = safe_strdup("^(re([\\[0-9\\]+])*|aw):[ \t]*");
+  ReplyRegexp.rx = safe_malloc(sizeof(regex_t));
+  REGCOMP(ReplyRegexp.rx, ReplyRegexp.pattern, REG_EXTENDED | REG_ICASE);
+}
+
+/**
+ * bench_now - Read a monotonic clock
+ * @retval num Seconds since an arbitrary point in time
+ */
+double bench_now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
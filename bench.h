@@ -0,0 +1,27 @@
+/**
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MUTT_BENCH_H
+#define _MUTT_BENCH_H 1
+
+/* Support for the micro-benchmark programs (hcache_bench, mx_bench and
+ * header_bench), which are linked with everything mutt is made of but
+ * main().  bench.c stands in for main.c: it defines the globals and the
+ * few symbols main.c provides. */
+
+void bench_init(void);
+double bench_now(void);
+
+#endif /* _MUTT_BENCH_H */
@@ -302,19 +302,21 @@ int mutt_chscmp(const char *s, const char *chs)
   return (ascii_strncasecmp(a > b ? buffer : chs, a > b ? chs : buffer, MIN(a, b)) == 0);
 }
 
-char *mutt_get_default_charset(void)
+/* The first of $assumed_charset, copied to buf as headers may be parsed by
+ * several threads at once */
+char *mutt_get_default_charset(char *buf, size_t buflen)
 {
-  static char fcharset[SHORT_STRING];
   const char *c = AssumedCharset;
   const char *c1 = NULL;
 
   if (c && *c)
   {
     c1 = strchr(c, ':');
-    strfcpy(fcharset, c, c1 ? (c1 - c + 1) : sizeof(fcharset));
-    return fcharset;
+    strfcpy(buf, c, c1 ? MIN(buflen, (size_t)(c1 - c + 1)) : buflen);
+    return buf;
   }
-  return strcpy(fcharset, "us-ascii"); /* __STRCPY_CHECKED__ */
+  strfcpy(buf, "us-ascii", buflen);
+  return buf;
 }
 
 /*
@@ -37,7 +37,7 @@ char *fgetconvs(char *buf, size_t l, FGETCONV *_fc);
 void fgetconv_close(FGETCONV **_fc);
 
 void mutt_set_langinfo_charset(void);
-char *mutt_get_default_charset(void);
+char *mutt_get_default_charset(char *buf, size_t buflen);
 
 /* flags for charset.c:mutt_convert_string(), fgetconv_open(), and
  * mutt_iconv_open(). Note that applying charset-hooks to tocode is
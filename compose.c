@@ -303,7 +303,7 @@ static void draw_envelope(HEADER *msg, char *fcc)
     redraw_crypt_lines(msg);
 
 #ifdef MIXMASTER
-  redraw_mix_line(msg->chain);
+  redraw_mix_line(msg->cold->chain);
 #endif
 
   SETCOLOR(MT_COLOR_STATUS);
@@ -1140,7 +1140,7 @@ int mutt_compose_menu(HEADER *msg, /* structure for new message */
 
 
 #ifdef MIXMASTER
-        if (msg->chain && mix_check_message(msg) != 0)
+        if (msg->cold->chain && mix_check_message(msg) != 0)
           break;
 #endif
 
@@ -1497,7 +1497,7 @@ int mutt_compose_menu(HEADER *msg, /* structure for new message */
 #ifdef MIXMASTER
       case OP_COMPOSE_MIX:
 
-        mix_make_chain(&msg->chain);
+        mix_make_chain(&msg->cold->chain);
         mutt_message_hook(NULL, msg, MUTT_SEND2HOOK);
         break;
 #endif
@@ -319,6 +319,41 @@ int mutt_copy_hdr(FILE *in, FILE *out, LOFF_T off_start, LOFF_T off_end,
   return 0;
 }
 
+/**
+ * mutt_status_fields - Make the values of the status fields of a message
+ * @h:       Message
+ * @status:  Buffer for the Status: value (MUTT_STATUS_WIDTH + 1 bytes)
+ * @xstatus: Buffer for the X-Status: value (MUTT_STATUS_WIDTH + 1 bytes)
+ * @pad:     If true, pad the values with spaces to MUTT_STATUS_WIDTH
+ *
+ * Padded fields always have the same size, so that the flags of a message in
+ * a mbox folder can be changed without moving the rest of the folder.
+ */
+void mutt_status_fields(HEADER *h, char *status, char *xstatus, bool pad)
+{
+  char *p = status;
+
+  if (h->read)
+  {
+    *p++ = 'R';
+    *p++ = 'O';
+  }
+  else if (h->old)
+    *p++ = 'O';
+  while (pad && (p < status + MUTT_STATUS_WIDTH))
+    *p++ = ' ';
+  *p = 0;
+
+  p = xstatus;
+  if (h->replied)
+    *p++ = 'A';
+  if (h->flagged)
+    *p++ = 'F';
+  while (pad && (p < xstatus + MUTT_STATUS_WIDTH))
+    *p++ = ' ';
+  *p = 0;
+}
+
 /* flags
         CH_DECODE       RFC2047 header decoding
         CH_FROM         retain the "From " message separator
@@ -338,6 +373,8 @@ int mutt_copy_hdr(FILE *in, FILE *out, LOFF_T off_start, LOFF_T off_end,
         CH_UPDATE_IRT   update the In-Reply-To: header
         CH_UPDATE_REFS  update the References: header
         CH_VIRTUAL      write virtual header lines too
+        CH_PAD_STATUS   always write Status: and X-Status:, padded to
+                        MUTT_STATUS_WIDTH
 
    prefix
         string to use if CH_PREFIX is set
@@ -387,25 +424,13 @@ int mutt_copy_header(FILE *in, HEADER *h, FILE *out, int flags, const char *pref
 
   if ((flags & CH_UPDATE) && (flags & CH_NOSTATUS) == 0)
   {
-    if (h->old || h->read)
-    {
-      fputs("Status: ", out);
-      if (h->read)
-        fputs("RO", out);
-      else if (h->old)
-        fputc('O', out);
-      fputc('\n', out);
-    }
+    char status[MUTT_STATUS_WIDTH + 1], xstatus[MUTT_STATUS_WIDTH + 1];
 
-    if (h->flagged || h->replied)
-    {
-      fputs("X-Status: ", out);
-      if (h->replied)
-        fputc('A', out);
-      if (h->flagged)
-        fputc('F', out);
-      fputc('\n', out);
-    }
+    mutt_status_fields(h, status, xstatus, flags & CH_PAD_STATUS);
+    if (*status)
+      fprintf(out, "Status: %s\n", status);
+    if (*xstatus)
+      fprintf(out, "X-Status: %s\n", xstatus);
   }
 
   if (flags & CH_UPDATE_LEN && (flags & CH_NOLEN) == 0)
@@ -755,7 +780,11 @@ static int _mutt_append_message(CONTEXT *dest, FILE *fpin, CONTEXT *src,
   if ((msg = mx_open_new_message(dest, hdr, is_from(buf, NULL, 0, NULL) ? 0 : MUTT_ADD_FROM)) == NULL)
     return -1;
   if (dest->magic == MUTT_MBOX || dest->magic == MUTT_MMDF)
+  {
     chflags |= CH_FROM | CH_FORCE_FROM;
+    if (option(OPTMBOXPADSTATUS))
+      chflags |= CH_PAD_STATUS;
+  }
   chflags |= (dest->magic == MUTT_MAILDIR ? CH_NOSTATUS : CH_UPDATE);
   r = _mutt_copy_message(msg->fp, fpin, hdr, body, flags, chflags);
   if (mx_commit_message(msg, dest) != 0)
@@ -57,6 +57,12 @@
 #define CH_DISPLAY        (1 << 18) /* display result to user */
 #define CH_UPDATE_LABEL   (1 << 19) /* update X-Label: from hdr->env->x_label? */
 #define CH_VIRTUAL        (1 << 20) /* write virtual header lines too */
+#define CH_PAD_STATUS     (1 << 21) /* write fixed-width status fields */
+
+/* width of the values of the status fields written with CH_PAD_STATUS */
+#define MUTT_STATUS_WIDTH 4
+
+void mutt_status_fields(HEADER *h, char *status, char *xstatus, bool pad);
 
 int mutt_copy_hdr(FILE *in, FILE *out, LOFF_T off_start, LOFF_T off_end,
                   int flags, const char *prefix);
@@ -989,6 +989,29 @@ void mutt_flush_unget_to_endcond(void)
   }
 }
 
+/**
+ * mutt_key_pending - Check whether input is waiting, without blocking
+ * @retval true A key was typed, or an event is queued
+ *
+ * A typed key is put back, so the next mutt_getch() returns it.
+ */
+bool mutt_key_pending(void)
+{
+  event_t ch;
+
+  if (UngetCount || (!option(OPTIGNOREMACROEVENTS) && MacroBufferCount))
+    return true;
+
+  timeout(0);
+  ch = mutt_getch();
+  timeout(-1);
+  if (ch.ch == -2)
+    return false;
+
+  mutt_unget_event(ch.ch, ch.op);
+  return true;
+}
+
 void mutt_flushinp(void)
 {
   UngetCount = 0;
@@ -339,6 +339,7 @@ void update_index(MUTTMENU *menu, CONTEXT *ctx, int check, int oldcount, int ind
 
   /* save the list of new messages */
   if (option(OPTUNCOLLAPSENEW) && oldcount && check != MUTT_REOPENED &&
+      check != MUTT_NEW_MAIL && check != MUTT_LOADED &&
       ((Sort & SORT_MASK) == SORT_THREADS))
   {
     save_new = safe_malloc(sizeof(HEADER *) * (ctx->msgcount - oldcount));
@@ -346,8 +347,13 @@ void update_index(MUTTMENU *menu, CONTEXT *ctx, int check, int oldcount, int ind
       save_new[j - oldcount] = ctx->hdrs[j];
   }
 
-  /* if the mailbox was reopened, need to rethread from scratch */
-  mutt_sort_headers(ctx, (check == MUTT_REOPENED));
+  /* if the mailbox was reopened, need to rethread from scratch, else only
+   * the new messages need to be sorted */
+  if (check == MUTT_NEW_MAIL || check == MUTT_LOADED)
+    mutt_sort_new_headers(ctx, oldcount,
+                          option(OPTUNCOLLAPSENEW) && (check == MUTT_NEW_MAIL));
+  else
+    mutt_sort_headers(ctx, (check == MUTT_REOPENED));
 
   /* uncollapse threads with new mail */
   if (option(OPTUNCOLLAPSENEW) && ((Sort & SORT_MASK) == SORT_THREADS))
@@ -366,19 +372,11 @@ void update_index(MUTTMENU *menu, CONTEXT *ctx, int check, int oldcount, int ind
       }
       mutt_set_virtual(ctx);
     }
-    else if (oldcount)
+    else if (save_new)
     {
       for (j = 0; j < ctx->msgcount - oldcount; j++)
-      {
-        int k;
-
-        for (k = 0; k < ctx->msgcount; k++)
-        {
-          HEADER *h = ctx->hdrs[k];
-          if (h == save_new[j] && (!ctx->pattern || h->limited))
-            mutt_uncollapse_thread(ctx, h);
-        }
-      }
+        if (!ctx->pattern || save_new[j]->limited)
+          mutt_uncollapse_thread(ctx, save_new[j]);
       FREE(&save_new);
       mutt_set_virtual(ctx);
     }
@@ -462,7 +460,8 @@ static int main_change_folder(MUTTMENU *menu, int op, char *buf, size_t bufsz,
   mutt_folder_hook(buf);
 
   if ((Context = mx_open_mailbox(
-           buf, (option(OPTREADONLY) || op == OP_MAIN_CHANGE_FOLDER_READONLY) ? MUTT_READONLY : 0,
+           buf, ((option(OPTREADONLY) || op == OP_MAIN_CHANGE_FOLDER_READONLY) ? MUTT_READONLY : 0) |
+                    MUTT_PROGRESSIVE,
            NULL)) != NULL)
   {
     menu->current = ci_first_message();
@@ -564,7 +563,7 @@ void index_make_entry(char *s, size_t l, MUTTMENU *menu, int num)
   int edgemsgno, reverse = Sort & SORT_REVERSE;
   THREAD *tmp = NULL;
 
-  if ((Sort & SORT_MASK) == SORT_THREADS && h->tree)
+  if ((Sort & SORT_MASK) == SORT_THREADS && h->cold->tree)
   {
     flag |= MUTT_FORMAT_TREE; /* display the thread tree */
     if (h->display_subject)
@@ -981,6 +980,26 @@ int mutt_index_menu(void)
 
         set_option(OPTSEARCHINVALID);
       }
+
+      /* read more headers of a mailbox opened progressively, but only while
+       * the user isn't typing */
+      if (Context && Context->loading && op == -1)
+      {
+        oldcount = Context->msgcount;
+        mx_load_mailbox(Context);
+        if (Context->msgcount > oldcount)
+        {
+          bool q = Context->quiet;
+          Context->quiet = true;
+          update_index(menu, Context, MUTT_LOADED, oldcount, index_hint);
+          Context->quiet = q;
+
+          menu->redraw |= REDRAW_INDEX | REDRAW_STATUS;
+          menu->max = Context->vcount;
+
+          set_option(OPTSEARCHINVALID);
+        }
+      }
     }
 
     if (!attach_msg)
@@ -1045,13 +1064,18 @@ int mutt_index_menu(void)
       }
 #endif
 
-      op = km_dokey(MENU_MAIN);
+      /* don't wait for a key while the mailbox is loading */
+      if (Context && Context->loading && !mutt_key_pending())
+        op = -1;
+      else
+        op = km_dokey(MENU_MAIN);
 
       mutt_debug(4, "mutt_index_menu[%d]: Got op %d\n", __LINE__, op);
 
       if (op == -1)
       {
-        mutt_timeout_hook();
+        if (!Context || !Context->loading)
+          mutt_timeout_hook();
         continue; /* either user abort or timeout */
       }
 
@@ -22,11 +22,8 @@
 #include "mx.h"
 #include "sort.h"
 
-void _mutt_set_flag(CONTEXT *ctx, HEADER *h, int flag, int bf, int upd_ctx)
+static void set_flag(CONTEXT *ctx, HEADER *h, int flag, int bf, int upd_ctx)
 {
-  if (!ctx || !h)
-    return;
-
   bool changed = h->changed;
   int deleted = ctx->deleted;
   int tagged = ctx->tagged;
@@ -315,6 +312,17 @@ void _mutt_set_flag(CONTEXT *ctx, HEADER *h, int flag, int bf, int upd_ctx)
     h->searched = false;
 }
 
+void _mutt_set_flag(CONTEXT *ctx, HEADER *h, int flag, int bf, int upd_ctx)
+{
+  if (!ctx || !h)
+    return;
+
+  /* the thread counts the unread messages */
+  mutt_count_thread_message(ctx, h, -1);
+  set_flag(ctx, h, flag, bf, upd_ctx);
+  mutt_count_thread_message(ctx, h, 1);
+}
+
 void mutt_tag_set_flag(int flag, int bf)
 {
   int j;
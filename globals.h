@@ -153,6 +153,8 @@ WHERE char *SmtpUrl INITVAL(NULL);
 #endif /* USE_SMTP */
 WHERE char *Spoolfile;
 WHERE char *SpamSep;
+WHERE char *StatsFile;
+WHERE char *StatsTraceFile;
 #ifdef USE_SSL
 WHERE char *SslCertFile INITVAL(NULL);
 WHERE char *SslClientCert INITVAL(NULL);
@@ -207,6 +209,7 @@ WHERE RX_LIST *MailLists INITVAL(0);
 WHERE RX_LIST *UnMailLists INITVAL(0);
 WHERE RX_LIST *SubscribedLists INITVAL(0);
 WHERE RX_LIST *UnSubscribedLists INITVAL(0);
+WHERE unsigned int MailListsSerial INITVAL(1); /* changed with the lists above */
 WHERE REPLACE_LIST *SpamList INITVAL(0);
 WHERE RX_LIST *NoSpamList INITVAL(0);
 WHERE REPLACE_LIST *SubjectRxList INITVAL(0);
@@ -235,6 +238,9 @@ WHERE short NntpContext;
 
 WHERE short ConnectTimeout;
 WHERE short HistSize;
+WHERE short IndexSortThreads;
+WHERE short MaildirParseThreads;
+WHERE short MboxParseThreads;
 WHERE short MenuContext;
 WHERE short PagerContext;
 WHERE short PagerIndexLines;
@@ -259,9 +265,17 @@ WHERE short SidebarWidth INITVAL(0);
 WHERE LIST *SidebarWhitelist INITVAL(0);
 #endif
 
+#ifdef USE_HCACHE
+WHERE short HeaderCacheMemory;
+#endif
+#ifdef HAVE_ZLIB
+WHERE short HeaderCacheCompressLevel;
+#endif
+
 #ifdef USE_IMAP
 WHERE short ImapKeepalive;
 WHERE short ImapPipelineDepth;
+WHERE short ImapProgressiveOpen;
 #endif
 
 /* flags for received signals */
@@ -1593,12 +1593,13 @@ void mutt_decode_attachment(BODY *b, STATE *s)
 {
   int istext = mutt_is_text_part(b);
   iconv_t cd = (iconv_t)(-1);
+  char assumed[SHORT_STRING];
 
   if (istext && s->flags & MUTT_CHARCONV)
   {
     char *charset = mutt_get_parameter("charset", b->parameter);
     if (!charset && AssumedCharset && *AssumedCharset)
-      charset = mutt_get_default_charset();
+      charset = mutt_get_default_charset(assumed, sizeof(assumed));
     if (charset && Charset)
       cd = mutt_iconv_open(Charset, charset, MUTT_ICONV_HOOK_FROM);
   }
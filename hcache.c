@@ -30,12 +30,20 @@
 #include "hcache_backend.h"
 #include "hcversion.h"
 #include "md5.h"
+#include "stats.h"
 #ifdef HAVE_SYS_TIME_H
 #include <sys/time.h>
 #endif
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
 
 static unsigned int hcachever = 0x0;
 
+/* Number of stores and deletes grouped in a single backend transaction while
+ * a batch is active, see mutt_hcache_begin() */
+#define HCACHE_BATCH_SIZE 1000
+
 /**
  * header_cache_t - header cache structure.
  *
@@ -47,8 +55,18 @@ static unsigned int hcachever = 0x0;
 struct header_cache
 {
   char *folder;
+  char *path;           /* database file */
+  bool shared;          /* the database holds the records of other folders */
   unsigned int crc;
   void *ctx;
+  bool batch;           /* a batch of writes is in progress */
+  unsigned int pending; /* writes issued in the current backend transaction */
+  LIST *decoded;        /* records decompressed by mutt_hcache_fetch() */
+#ifdef HAVE_ZLIB
+  z_stream *deflate;    /* reused by hcache_encode(), see hcache_deflater() */
+  int deflate_level;
+  z_stream *inflate;    /* reused by hcache_decode() */
+#endif
 };
 
 typedef union {
@@ -56,6 +74,40 @@ typedef union {
   unsigned int uidvalidity;
 } validate;
 
+/* A record starts with validate, the crc and an hcache_flags_t, which are
+ * never compressed so that callers can check them on the raw data. They are
+ * followed by a codec header (codec, size of the plain payload, size of the
+ * stored payload) and the payload itself. */
+enum
+{
+  HCACHE_CODEC_NONE = 0,
+  HCACHE_CODEC_ZLIB, /* deflate, primed with ZlibDict */
+};
+
+#define HCACHE_FLAGS_OFF (sizeof(validate) + sizeof(unsigned int))
+#define HCACHE_CODEC_OFF (HCACHE_FLAGS_OFF + sizeof(hcache_flags_t))
+#define HCACHE_PAYLOAD_OFF (HCACHE_CODEC_OFF + 3 * sizeof(unsigned int))
+
+#ifdef HAVE_ZLIB
+/* Cached headers are too small for deflate to learn much from each one on its
+ * own, so the stream is primed with strings common to most of them. deflate
+ * works best with the most frequent strings at the end. Changing this breaks
+ * existing records: add a new codec instead. */
+static const char ZlibDict[] =
+    "List-Post: List-Id: In-Reply-To: References: X-Label: Supersedes: "
+    "Mail-Followup-To: Return-Path: X-Spam-Status: Followup-To: "
+    "quoted-printable base64 7bit 8bit attachment inline "
+    "signed encrypted alternative mixed related html plain "
+    "format=flowed delsp=yes boundary charset iso-8859-1 us-ascii UTF-8 utf-8 "
+    ".org .net .com mail gmail.com lists list noreply "
+    "multipart application message text Re: Fwd: ";
+
+/* A record is a few KB at most: a small window and hash keep the per-record
+ * setup of the streams cheap. */
+#define ZLIB_WINDOW_BITS 12
+#define ZLIB_MEM_LEVEL 4
+#endif
+
 #define HCACHE_BACKEND(name) extern const hcache_ops_t hcache_##name##_ops;
 HCACHE_BACKEND_LIST
 #undef HCACHE_BACKEND
@@ -384,6 +436,7 @@ static unsigned char *dump_body(BODY *c, unsigned char *d, int *off, int convert
   nb.parts = NULL;
   nb.hdr = NULL;
   nb.aptr = NULL;
+  nb.pooled = false;
 
   lazy_realloc(&d, *off + sizeof(BODY));
   memcpy(d + *off, &nb, sizeof(BODY));
@@ -420,33 +473,30 @@ static void restore_body(BODY *c, const unsigned char *d, int *off, int convert)
 
 static unsigned char *dump_envelope(ENVELOPE *e, unsigned char *d, int *off, int convert)
 {
-  d = dump_address(e->return_path, d, off, convert);
   d = dump_address(e->from, d, off, convert);
   d = dump_address(e->to, d, off, convert);
   d = dump_address(e->cc, d, off, convert);
   d = dump_address(e->bcc, d, off, convert);
   d = dump_address(e->sender, d, off, convert);
   d = dump_address(e->reply_to, d, off, convert);
-  d = dump_address(e->mail_followup_to, d, off, convert);
 
   d = dump_char(e->list_post, d, off, convert);
   d = dump_char(e->subject, d, off, convert);
 
+  /* real_subj is a suffix of subject, though not necessarily inside it */
   if (e->real_subj)
-    d = dump_int(e->real_subj - e->subject, d, off);
+    d = dump_int(mutt_strlen(e->subject) - mutt_strlen(e->real_subj), d, off);
   else
     d = dump_int(-1, d, off);
 
   d = dump_char(e->message_id, d, off, 0);
   d = dump_char(e->supersedes, d, off, 0);
-  d = dump_char(e->date, d, off, 0);
   d = dump_char(e->x_label, d, off, convert);
 
   d = dump_buffer(e->spam, d, off, convert);
 
   d = dump_list(e->references, d, off, 0);
   d = dump_list(e->in_reply_to, d, off, 0);
-  d = dump_list(e->userhdrs, d, off, convert);
 
 #ifdef USE_NNTP
   d = dump_char(e->xref, d, off, 0);
@@ -461,14 +511,12 @@ static void restore_envelope(ENVELOPE *e, const unsigned char *d, int *off, int
 {
   int real_subj_off;
 
-  restore_address(&e->return_path, d, off, convert);
   restore_address(&e->from, d, off, convert);
   restore_address(&e->to, d, off, convert);
   restore_address(&e->cc, d, off, convert);
   restore_address(&e->bcc, d, off, convert);
   restore_address(&e->sender, d, off, convert);
   restore_address(&e->reply_to, d, off, convert);
-  restore_address(&e->mail_followup_to, d, off, convert);
 
   restore_char(&e->list_post, d, off, convert);
   restore_char(&e->subject, d, off, convert);
@@ -481,14 +529,12 @@ static void restore_envelope(ENVELOPE *e, const unsigned char *d, int *off, int
 
   restore_char(&e->message_id, d, off, 0);
   restore_char(&e->supersedes, d, off, 0);
-  restore_char(&e->date, d, off, 0);
   restore_char(&e->x_label, d, off, convert);
 
   restore_buffer(&e->spam, d, off, convert);
 
   restore_list(&e->references, d, off, 0);
   restore_list(&e->in_reply_to, d, off, 0);
-  restore_list(&e->userhdrs, d, off, convert);
 
 #ifdef USE_NNTP
   restore_char(&e->xref, d, off, 0);
@@ -497,6 +543,482 @@ static void restore_envelope(ENVELOPE *e, const unsigned char *d, int *off, int
 #endif
 }
 
+/* The cold part of the envelope holds the fields which are not needed to
+ * display, sort, limit or thread the index. It is stored at the end of the
+ * record, prefixed by its size, so that it can be restored on demand. */
+static unsigned char *dump_envelope_cold(ENVELOPE *e, unsigned char *d, int *off, int convert)
+{
+  unsigned int start_off = *off;
+  unsigned int size;
+
+  d = dump_int(0xdeadbeef, d, off);
+
+  d = dump_address(e->return_path, d, off, convert);
+  d = dump_address(e->mail_followup_to, d, off, convert);
+  d = dump_char(e->date, d, off, 0);
+  d = dump_list(e->userhdrs, d, off, convert);
+
+  size = *off - start_off - sizeof(int);
+  memcpy(d + start_off, &size, sizeof(int));
+
+  return d;
+}
+
+static void restore_envelope_cold(ENVELOPE *e, const unsigned char *d, int *off, int convert)
+{
+  restore_address(&e->return_path, d, off, convert);
+  restore_address(&e->mail_followup_to, d, off, convert);
+  restore_char(&e->date, d, off, 0);
+  restore_list(&e->userhdrs, d, off, convert);
+}
+
+static unsigned char *dump_flags(HEADER *h, unsigned char *d, int *off)
+{
+  hcache_flags_t f;
+
+  memset(&f, 0, sizeof(f));
+  if (h->read)
+    f.flags |= HCACHE_FLAG_READ;
+  if (h->old)
+    f.flags |= HCACHE_FLAG_OLD;
+  if (h->flagged)
+    f.flags |= HCACHE_FLAG_FLAGGED;
+  if (h->replied)
+    f.flags |= HCACHE_FLAG_REPLIED;
+  if (h->deleted)
+    f.flags |= HCACHE_FLAG_DELETED;
+  if (h->content)
+    f.size = h->content->length;
+  f.received = h->received;
+
+  lazy_realloc(&d, *off + sizeof(f));
+  memcpy(d + *off, &f, sizeof(f));
+  *off += sizeof(f);
+
+  return d;
+}
+
+static unsigned int hcache_codec(const unsigned char *d)
+{
+  unsigned int codec;
+  int off = HCACHE_CODEC_OFF;
+
+  restore_int(&codec, d, &off);
+  return codec;
+}
+
+static void hcache_set_codec(unsigned char *d, unsigned int codec,
+                             unsigned int size, unsigned int stored)
+{
+  int off = HCACHE_CODEC_OFF;
+
+  memcpy(d + off, &codec, sizeof(int));
+  off += sizeof(int);
+  memcpy(d + off, &size, sizeof(int));
+  off += sizeof(int);
+  memcpy(d + off, &stored, sizeof(int));
+}
+
+#ifdef HAVE_ZLIB
+/* Whether a backend compresses the whole database itself, so that the records
+ * needn't be */
+static bool hcache_compresses(const hcache_ops_t *ops)
+{
+#if defined(HAVE_QDBM) || defined(HAVE_TC) || defined(HAVE_KC)
+  static const char *const natives[] = { "tokyocabinet", "kyotocabinet", "qdbm", NULL };
+  int i;
+
+  if (!option(OPTHCACHECOMPRESS))
+    return false;
+  for (i = 0; ops && natives[i]; i++)
+    if (strcmp(ops->name, natives[i]) == 0)
+      return true;
+#endif
+  return false;
+}
+
+/**
+ * hcache_deflater - Get the deflate stream of a header cache, ready for a record
+ * @h:     Header cache
+ * @level: Compression level
+ * @retval ptr  Stream, primed with ZlibDict
+ * @retval NULL zlib failed
+ *
+ * Setting up a stream costs far more than compressing a record, so each
+ * header cache keeps one, which is reset between records.
+ */
+static z_stream *hcache_deflater(header_cache_t *h, int level)
+{
+  if (h->deflate && (h->deflate_level != level))
+  {
+    deflateEnd(h->deflate);
+    FREE(&h->deflate);
+  }
+
+  if (!h->deflate)
+  {
+    h->deflate = safe_calloc(1, sizeof(z_stream));
+    if (deflateInit2(h->deflate, level, Z_DEFLATED, ZLIB_WINDOW_BITS,
+                     ZLIB_MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+      FREE(&h->deflate);
+      return NULL;
+    }
+    h->deflate_level = level;
+  }
+  else if (deflateReset(h->deflate) != Z_OK)
+    return NULL;
+
+  if (deflateSetDictionary(h->deflate, (const Bytef *) ZlibDict, sizeof(ZlibDict) - 1) != Z_OK)
+    return NULL;
+  return h->deflate;
+}
+
+/* Free the zlib streams of a header cache */
+static void hcache_zfree(header_cache_t *h)
+{
+  if (h->deflate)
+  {
+    deflateEnd(h->deflate);
+    FREE(&h->deflate);
+  }
+  if (h->inflate)
+  {
+    inflateEnd(h->inflate);
+    FREE(&h->inflate);
+  }
+}
+#endif
+
+/**
+ * hcache_encode - Compress the payload of a freshly dumped record
+ * @h:   Header cache
+ * @d:   Record, as built by mutt_hcache_dump()
+ * @off: Size of the record, updated on return
+ * @retval ptr The record to store, which may have been reallocated
+ *
+ * The payload is stored as it is if compression is disabled, left to the
+ * backend, or does not make it smaller.
+ */
+static unsigned char *hcache_encode(header_cache_t *h, unsigned char *d, int *off)
+{
+  unsigned int size = *off - HCACHE_PAYLOAD_OFF;
+
+  hcache_set_codec(d, HCACHE_CODEC_NONE, size, size);
+
+#ifdef HAVE_ZLIB
+  if (option(OPTHCACHEZLIB) && !hcache_compresses(hcache_get_ops()))
+  {
+    z_stream *zs = NULL;
+    unsigned char *c = NULL;
+    uLong bound;
+    int level = HeaderCacheCompressLevel;
+
+    if (level < Z_BEST_SPEED)
+      level = Z_BEST_SPEED;
+    else if (level > Z_BEST_COMPRESSION)
+      level = Z_BEST_COMPRESSION;
+
+    zs = hcache_deflater(h, level);
+    if (!zs)
+      return d;
+
+    bound = deflateBound(zs, size);
+    c = safe_malloc(HCACHE_PAYLOAD_OFF + bound);
+    zs->next_in = d + HCACHE_PAYLOAD_OFF;
+    zs->avail_in = size;
+    zs->next_out = c + HCACHE_PAYLOAD_OFF;
+    zs->avail_out = bound;
+
+    if (deflate(zs, Z_FINISH) == Z_STREAM_END && zs->total_out < size)
+    {
+      memcpy(c, d, HCACHE_CODEC_OFF);
+      hcache_set_codec(c, HCACHE_CODEC_ZLIB, size, zs->total_out);
+      *off = HCACHE_PAYLOAD_OFF + zs->total_out;
+      FREE(&d);
+      d = c;
+    }
+    else
+      FREE(&c);
+  }
+#endif
+
+  return d;
+}
+
+/**
+ * hcache_decode - Decompress the payload of a record
+ * @h: Header cache, or NULL to use a stream of its own
+ * @d: Record, as returned by the backend
+ * @retval ptr  Newly allocated copy of the record with a plain payload
+ * @retval NULL The codec is unknown to this build or the data is corrupt
+ */
+static unsigned char *hcache_decode(header_cache_t *h, const unsigned char *d)
+{
+  unsigned int codec, size, stored;
+  int off = HCACHE_CODEC_OFF;
+
+  restore_int(&codec, d, &off);
+  restore_int(&size, d, &off);
+  restore_int(&stored, d, &off);
+
+#ifdef HAVE_ZLIB
+  if (codec == HCACHE_CODEC_ZLIB)
+  {
+    z_stream own;
+    z_stream *zs = &own;
+    unsigned char *c = NULL;
+    int rc;
+
+    if (h && h->inflate)
+    {
+      zs = h->inflate;
+      rc = inflateReset(zs);
+    }
+    else
+    {
+      if (h)
+        zs = h->inflate = safe_calloc(1, sizeof(z_stream));
+      else
+        memset(&own, 0, sizeof(own));
+      rc = inflateInit2(zs, ZLIB_WINDOW_BITS);
+      if ((rc != Z_OK) && h)
+        FREE(&h->inflate);
+    }
+    if (rc != Z_OK)
+      return NULL;
+
+    c = safe_malloc(HCACHE_PAYLOAD_OFF + size);
+    zs->next_in = (Bytef *) d + HCACHE_PAYLOAD_OFF;
+    zs->avail_in = stored;
+    zs->next_out = c + HCACHE_PAYLOAD_OFF;
+    zs->avail_out = size;
+
+    rc = inflate(zs, Z_FINISH);
+    if (rc == Z_NEED_DICT &&
+        inflateSetDictionary(zs, (const Bytef *) ZlibDict, sizeof(ZlibDict) - 1) == Z_OK)
+      rc = inflate(zs, Z_FINISH);
+    if (rc != Z_STREAM_END || zs->total_out != size)
+      FREE(&c);
+    if (zs == &own)
+      inflateEnd(zs);
+    if (!c)
+      return NULL;
+
+    memcpy(c, d, HCACHE_CODEC_OFF);
+    hcache_set_codec(c, HCACHE_CODEC_NONE, size, size);
+    return c;
+  }
+#endif
+
+  mutt_debug(1, "hcache_decode: unsupported codec %u\n", codec);
+  return NULL;
+}
+
+/* The memory tier keeps copies of the plain records most recently fetched,
+ * so that going back to a folder visited a moment ago neither hits the
+ * backend nor decompresses anything. Entries are keyed by database and full
+ * key, and kept in LRU order, the most recently used first. Stores and
+ * deletes drop the entries they make stale. */
+struct hcache_mem
+{
+  char *key;
+  unsigned char *data;
+  size_t charge; /* bytes accounted against $header_cache_memory */
+  struct hcache_mem *prev;
+  struct hcache_mem *next;
+};
+
+/* Last known state of a database file, to notice writes by other processes */
+struct hcache_mem_db
+{
+  char *path;
+  time_t mtime;
+  off_t size;
+  struct hcache_mem_db *next;
+};
+
+static HASH *MemHash = NULL;
+static struct hcache_mem *MemHead = NULL;
+static struct hcache_mem *MemTail = NULL;
+static size_t MemUsed = 0;
+static struct hcache_mem_db *MemDbs = NULL;
+
+static size_t hcache_mem_limit(void)
+{
+  return (HeaderCacheMemory > 0) ? ((size_t) HeaderCacheMemory << 20) : 0;
+}
+
+static bool hcache_mem_key(header_cache_t *h, const char *key, char *buf, size_t buflen)
+{
+  size_t len = snprintf(buf, buflen, "%s:%s%s", h->path, h->folder, key);
+
+  return len < buflen;
+}
+
+static void hcache_mem_unlink(struct hcache_mem *m)
+{
+  if (m->prev)
+    m->prev->next = m->next;
+  else
+    MemHead = m->next;
+  if (m->next)
+    m->next->prev = m->prev;
+  else
+    MemTail = m->prev;
+  m->prev = m->next = NULL;
+}
+
+static void hcache_mem_push(struct hcache_mem *m)
+{
+  m->next = MemHead;
+  if (MemHead)
+    MemHead->prev = m;
+  else
+    MemTail = m;
+  MemHead = m;
+}
+
+static void hcache_mem_drop(struct hcache_mem *m)
+{
+  hcache_mem_unlink(m);
+  hash_delete(MemHash, m->key, m, NULL);
+  MemUsed -= m->charge;
+  FREE(&m->key);
+  FREE(&m->data);
+  FREE(&m);
+}
+
+static void hcache_mem_trim(size_t limit)
+{
+  while (MemTail && MemUsed > limit)
+    hcache_mem_drop(MemTail);
+}
+
+/**
+ * hcache_mem_find - Look up a record in the memory tier
+ * @h:   Header cache
+ * @key: Key, without the folder
+ * @retval ptr  Plain record, owned by the memory tier
+ * @retval NULL Not cached
+ */
+static const unsigned char *hcache_mem_find(header_cache_t *h, const char *key)
+{
+  char buf[2 * _POSIX_PATH_MAX];
+  struct hcache_mem *m = NULL;
+
+  if (!MemHash || !hcache_mem_key(h, key, buf, sizeof(buf)))
+    return NULL;
+
+  m = hash_find(MemHash, buf);
+  if (!m)
+    return NULL;
+
+  if (m != MemHead)
+  {
+    hcache_mem_unlink(m);
+    hcache_mem_push(m);
+  }
+  return m->data;
+}
+
+static void hcache_mem_forget(header_cache_t *h, const char *key)
+{
+  char buf[2 * _POSIX_PATH_MAX];
+  struct hcache_mem *m = NULL;
+
+  if (MemHash && hcache_mem_key(h, key, buf, sizeof(buf)) &&
+      (m = hash_find(MemHash, buf)))
+    hcache_mem_drop(m);
+}
+
+/**
+ * hcache_mem_insert - Add a copy of a plain record to the memory tier
+ * @h:   Header cache
+ * @key: Key, without the folder
+ * @d:   Plain record
+ */
+static void hcache_mem_insert(header_cache_t *h, const char *key, const unsigned char *d)
+{
+  char buf[2 * _POSIX_PATH_MAX];
+  struct hcache_mem *m = NULL;
+  size_t limit = hcache_mem_limit();
+  unsigned int size;
+  int off = HCACHE_CODEC_OFF + sizeof(unsigned int);
+
+  if (!limit || !hcache_mem_key(h, key, buf, sizeof(buf)))
+    return;
+
+  restore_int(&size, d, &off);
+  size += HCACHE_PAYLOAD_OFF;
+
+  hcache_mem_forget(h, key);
+
+  m = safe_calloc(1, sizeof(struct hcache_mem));
+  m->key = safe_strdup(buf);
+  m->data = safe_malloc(size);
+  memcpy(m->data, d, size);
+  m->charge = size + strlen(buf) + 1 + sizeof(struct hcache_mem) + sizeof(struct hash_elem);
+
+  if (!MemHash)
+  {
+    /* assume records of about 1K to size the table */
+    MemHash = hash_create(MAX(1024, (int) MIN(limit >> 10, 1 << 20)), 0);
+  }
+  hash_insert(MemHash, m->key, m);
+  hcache_mem_push(m);
+  MemUsed += m->charge;
+
+  hcache_mem_trim(limit);
+}
+
+/**
+ * hcache_mem_check_db - Keep the memory tier consistent with a database file
+ * @path:    Database file
+ * @opening: The database is being opened, rather than closed
+ *
+ * On close, the state of the file is recorded. On open, a change since then
+ * means that another process wrote to the database, so the entries of the
+ * database are dropped.
+ */
+static void hcache_mem_check_db(const char *path, bool opening)
+{
+  struct hcache_mem_db *db = NULL;
+  struct hcache_mem *m = NULL, *next = NULL;
+  struct stat sb;
+  size_t len = mutt_strlen(path);
+
+  if (stat(path, &sb) != 0)
+    memset(&sb, 0, sizeof(sb));
+
+  for (db = MemDbs; db; db = db->next)
+    if (mutt_strcmp(db->path, path) == 0)
+      break;
+
+  if (!db)
+  {
+    if (!MemHead)
+      return;
+    db = safe_calloc(1, sizeof(struct hcache_mem_db));
+    db->path = safe_strdup(path);
+    db->next = MemDbs;
+    MemDbs = db;
+  }
+  else if (opening && (db->mtime != sb.st_mtime || db->size != sb.st_size))
+  {
+    mutt_debug(2, "hcache_mem_check_db: %s changed, dropping its records\n", path);
+    for (m = MemHead; m; m = next)
+    {
+      next = m->next;
+      if (mutt_strncmp(m->key, path, len) == 0 && m->key[len] == ':')
+        hcache_mem_drop(m);
+    }
+  }
+
+  db->mtime = sb.st_mtime;
+  db->size = sb.st_size;
+}
+
 static int crc_matches(const char *d, unsigned int crc)
 {
   int off = sizeof(validate);
@@ -614,7 +1136,7 @@ static const char *hcache_per_folder(const char *path, const char *folder, hcach
 /* This function transforms a header into a char so that it is useable by
  * db_store.
  */
-static void *hcache_dump(header_cache_t *h, HEADER *header, int *off, unsigned int uidvalidity)
+void *mutt_hcache_dump(header_cache_t *h, HEADER *header, int *off, unsigned int uidvalidity)
 {
   unsigned char *d = NULL;
   HEADER nh;
@@ -634,6 +1156,14 @@ static void *hcache_dump(header_cache_t *h, HEADER *header, int *off, unsigned i
   *off += sizeof(validate);
 
   d = dump_int(h->crc, d, off);
+  d = dump_flags(header, d, off);
+
+  /* codec header, filled in by hcache_encode() */
+  d = dump_int(HCACHE_CODEC_NONE, d, off);
+  d = dump_int(0, d, off);
+  d = dump_int(0, d, off);
+
+  mutt_env_restore_lazy(header->env);
 
   lazy_realloc(&d, *off + sizeof(HEADER));
   memcpy(&nh, header, sizeof(HEADER));
@@ -651,39 +1181,49 @@ static void *hcache_dump(header_cache_t *h, HEADER *header, int *off, unsigned i
   nh.recipient = 0;
   nh.pair = 0;
   nh.attach_valid = false;
-  nh.path = NULL;
-  nh.tree = NULL;
+  nh.pooled = false;
   nh.thread = NULL;
-#ifdef MIXMASTER
-  nh.chain = NULL;
-#endif
-#if defined(USE_POP) || defined(USE_IMAP)
-  nh.data = NULL;
-#endif
+  nh.cold = NULL; /* only maildir_flags is cached, below */
 
   memcpy(d + *off, &nh, sizeof(HEADER));
   *off += sizeof(HEADER);
 
   d = dump_envelope(nh.env, d, off, convert);
   d = dump_body(nh.content, d, off, convert);
-  d = dump_char(nh.maildir_flags, d, off, convert);
+  d = dump_char(header->cold->maildir_flags, d, off, convert);
+  d = dump_envelope_cold(nh.env, d, off, convert);
 
-  return d;
+  return hcache_encode(h, d, off);
 }
 
 HEADER *mutt_hcache_restore(const unsigned char *d)
 {
   int off = 0;
   HEADER *h = mutt_new_header();
+  struct header_cold *cold = NULL;
   int convert = !Charset_is_utf8;
+  unsigned char *plain = NULL;
 
-  /* skip validate */
-  off += sizeof(validate);
+  /* mutt_hcache_fetch() hands out plain records, but this may also be a
+   * record straight from mutt_hcache_dump() */
+  if (hcache_codec(d) != HCACHE_CODEC_NONE)
+  {
+    plain = hcache_decode(NULL, d);
+    if (!plain)
+    {
+      h->env = mutt_new_envelope();
+      h->content = mutt_new_body();
+      return h;
+    }
+    d = plain;
+  }
 
-  /* skip crc */
-  off += sizeof(unsigned int);
+  /* skip validate, crc, flags and codec header */
+  off += HCACHE_PAYLOAD_OFF;
 
+  cold = h->cold;
   memcpy(h, d + off, sizeof(HEADER));
+  h->cold = cold;
   off += sizeof(HEADER);
 
   h->env = mutt_new_envelope();
@@ -692,11 +1232,39 @@ HEADER *mutt_hcache_restore(const unsigned char *d)
   h->content = mutt_new_body();
   restore_body(h->content, d, &off, convert);
 
-  restore_char(&h->maildir_flags, d, &off, convert);
+  restore_char(&h->cold->maildir_flags, d, &off, convert);
+
+  if (option(OPTHCACHELAZY))
+  {
+    /* Keep a private copy of the cold fields: the data returned by the
+     * backend (possibly a pointer into a memory map) is only valid until
+     * mutt_hcache_free() or the next write. */
+    unsigned int size;
+    restore_int(&size, d, &off);
+    h->env->lazy = safe_malloc(size);
+    memcpy(h->env->lazy, d + off, size);
+  }
+  else
+  {
+    off += sizeof(unsigned int);
+    restore_envelope_cold(h->env, d, &off, convert);
+  }
 
+  FREE(&plain);
   return h;
 }
 
+void mutt_hcache_restore_lazy(ENVELOPE *e)
+{
+  int off = 0;
+
+  if (!e || !e->lazy)
+    return;
+
+  restore_envelope_cold(e, e->lazy, &off, !Charset_is_utf8);
+  FREE(&e->lazy);
+}
+
 static char *get_foldername(const char *folder)
 {
   char *p = NULL;
@@ -716,6 +1284,7 @@ static char *get_foldername(const char *folder)
 header_cache_t *mutt_hcache_open(const char *path, const char *folder, hcache_namer_t namer)
 {
   const hcache_ops_t *ops = hcache_get_ops();
+  const char *hcpath = NULL;
   if (!ops)
     return NULL;
 
@@ -767,20 +1336,27 @@ header_cache_t *mutt_hcache_open(const char *path, const char *folder, hcache_na
     return NULL;
   }
 
-  path = hcache_per_folder(path, h->folder, namer);
+  hcpath = hcache_per_folder(path, h->folder, namer);
+  /* $header_cache naming a file: a single database for all the folders */
+  h->shared = (mutt_strcmp(hcpath, path) == 0);
+  h->path = safe_strdup(hcpath);
+
+  hcache_mem_trim(hcache_mem_limit());
+  hcache_mem_check_db(h->path, true);
 
-  h->ctx = ops->open(path);
+  h->ctx = ops->open(h->path);
   if (h->ctx)
     return h;
   else
   {
     /* remove a possibly incompatible version */
-    if (unlink(path) == 0)
+    if (unlink(h->path) == 0)
     {
-      h->ctx = ops->open(path);
+      h->ctx = ops->open(h->path);
       if (h->ctx)
         return h;
     }
+    FREE(&h->path);
     FREE(&h->folder);
     FREE(&h);
 
@@ -794,31 +1370,130 @@ void mutt_hcache_close(header_cache_t *h)
   if (!h || !ops)
     return;
 
+  mutt_hcache_commit(h);
   ops->close(&h->ctx);
+  hcache_mem_check_db(h->path, false);
+  mutt_free_list(&h->decoded);
+#ifdef HAVE_ZLIB
+  hcache_zfree(h);
+#endif
+  FREE(&h->path);
   FREE(&h->folder);
   FREE(&h);
 }
 
+/* Remember a copy made by mutt_hcache_fetch() so that mutt_hcache_free() can
+ * tell it apart from the data owned by the backend */
+static void *hcache_track(header_cache_t *h, unsigned char *plain)
+{
+  LIST *l = safe_calloc(1, sizeof(LIST));
+  l->data = (char *) plain;
+  l->next = h->decoded;
+  h->decoded = l;
+  return plain;
+}
+
 void *mutt_hcache_fetch(header_cache_t *h, const char *key, size_t keylen)
 {
   void *data = NULL;
+  const unsigned char *cached = NULL;
+
+  if (!h)
+    return NULL;
+
+  cached = hcache_mem_find(h, key);
+  if (cached)
+  {
+    unsigned int size;
+    int off = HCACHE_CODEC_OFF + sizeof(unsigned int);
+    unsigned char *copy = NULL;
+
+    restore_int(&size, cached, &off);
+    size += HCACHE_PAYLOAD_OFF;
+    copy = safe_malloc(size);
+    memcpy(copy, cached, size);
+    mutt_stats_count(STATS_HCACHE_HIT);
+    return hcache_track(h, copy);
+  }
 
   data = mutt_hcache_fetch_raw(h, key, keylen);
   if (!data)
   {
+    mutt_stats_count(STATS_HCACHE_MISS);
     return NULL;
   }
 
   if (!crc_matches(data, h->crc))
   {
     mutt_hcache_free(h, &data);
+    mutt_stats_count(STATS_HCACHE_MISS);
     return NULL;
   }
 
+  if (hcache_codec(data) != HCACHE_CODEC_NONE)
+  {
+    unsigned char *plain = hcache_decode(h, data);
+    mutt_hcache_free(h, &data);
+    if (!plain)
+    {
+      mutt_stats_count(STATS_HCACHE_MISS);
+      return NULL;
+    }
+
+    data = hcache_track(h, plain);
+  }
+
+  hcache_mem_insert(h, key, data);
+  mutt_stats_count(STATS_HCACHE_HIT);
+
   return data;
 }
 
+int mutt_hcache_fetch_flags(header_cache_t *h, const char *key, size_t keylen,
+                            hcache_flags_t *flags)
+{
+  void *data = NULL;
+  const unsigned char *cached = NULL;
+
+  if (!h)
+    return -1;
+
+  cached = hcache_mem_find(h, key);
+  if (cached)
+  {
+    memcpy(flags, cached + HCACHE_FLAGS_OFF, sizeof(hcache_flags_t));
+    mutt_stats_count(STATS_HCACHE_HIT);
+    return 0;
+  }
+
+  data = mutt_hcache_fetch_raw(h, key, keylen);
+  if (!data)
+  {
+    mutt_stats_count(STATS_HCACHE_MISS);
+    return -1;
+  }
+
+  if (!crc_matches(data, h->crc))
+  {
+    mutt_hcache_free(h, &data);
+    mutt_stats_count(STATS_HCACHE_MISS);
+    return -1;
+  }
+
+  memcpy(flags, (unsigned char *) data + HCACHE_FLAGS_OFF, sizeof(hcache_flags_t));
+  mutt_hcache_free(h, &data);
+  mutt_stats_count(STATS_HCACHE_HIT);
+
+  return 0;
+}
+
 void *mutt_hcache_fetch_raw(header_cache_t *h, const char *key, size_t keylen)
+{
+  return mutt_hcache_fetch_raw_size(h, key, keylen, NULL);
+}
+
+void *mutt_hcache_fetch_raw_size(header_cache_t *h, const char *key,
+                                 size_t keylen, size_t *dlen)
 {
   char path[_POSIX_PATH_MAX];
   const hcache_ops_t *ops = hcache_get_ops();
@@ -828,7 +1503,7 @@ void *mutt_hcache_fetch_raw(header_cache_t *h, const char *key, size_t keylen)
 
   keylen = snprintf(path, sizeof(path), "%s%s", h->folder, key);
 
-  return ops->fetch(h->ctx, path, keylen);
+  return ops->fetch(h->ctx, path, keylen, dlen);
 }
 
 void mutt_hcache_free(header_cache_t *h, void **data)
@@ -838,6 +1513,18 @@ void mutt_hcache_free(header_cache_t *h, void **data)
   if (!h || !ops)
     return;
 
+  for (LIST **l = &h->decoded; data && *data && *l; l = &(*l)->next)
+  {
+    if ((*l)->data == *data)
+    {
+      LIST *dead = *l;
+      *l = dead->next;
+      FREE(&dead);
+      FREE(data); /* __MEM_CHECKED__ */
+      return;
+    }
+  }
+
   ops->free(h->ctx, data); /* __MEM_CHECKED__ */
 }
 
@@ -851,7 +1538,7 @@ int mutt_hcache_store(header_cache_t *h, const char *key, size_t keylen,
   if (!h)
     return -1;
 
-  data = hcache_dump(h, header, &dlen, uidvalidity);
+  data = mutt_hcache_dump(h, header, &dlen, uidvalidity);
   ret = mutt_hcache_store_raw(h, key, keylen, data, dlen);
 
   FREE(&data);
@@ -859,31 +1546,195 @@ int mutt_hcache_store(header_cache_t *h, const char *key, size_t keylen,
   return ret;
 }
 
+/**
+ * hcache_batch_step - Account for a write in the current batch
+ * @param h  Header cache
+ * @param ops Backend operations
+ *
+ * Once HCACHE_BATCH_SIZE writes have been issued, the backend transaction is
+ * committed and a new one is started, to bound its size.
+ */
+static void hcache_batch_step(header_cache_t *h, const hcache_ops_t *ops)
+{
+  if (!h->batch || (++h->pending < HCACHE_BATCH_SIZE))
+    return;
+
+  ops->commit(h->ctx);
+  h->pending = 0;
+  if (ops->begin(h->ctx) != 0)
+    h->batch = false;
+}
+
 int mutt_hcache_store_raw(header_cache_t *h, const char *key, size_t keylen,
                           void *data, size_t dlen)
 {
   char path[_POSIX_PATH_MAX];
   const hcache_ops_t *ops = hcache_get_ops();
+  int ret;
 
   if (!h || !ops)
     return -1;
 
+  hcache_mem_forget(h, key);
+
   keylen = snprintf(path, sizeof(path), "%s%s", h->folder, key);
 
-  return ops->store(h->ctx, path, keylen, data, dlen);
+  ret = ops->store(h->ctx, path, keylen, data, dlen);
+  hcache_batch_step(h, ops);
+
+  return ret;
 }
 
 int mutt_hcache_delete(header_cache_t *h, const char *key, size_t keylen)
 {
   char path[_POSIX_PATH_MAX];
   const hcache_ops_t *ops = hcache_get_ops();
+  int ret;
 
-  if (!h)
+  if (!h || !ops)
     return -1;
 
+  hcache_mem_forget(h, key);
+
   keylen = snprintf(path, sizeof(path), "%s%s", h->folder, key);
 
-  return ops->delete (h->ctx, path, keylen);
+  ret = ops->delete (h->ctx, path, keylen);
+  hcache_batch_step(h, ops);
+
+  return ret;
+}
+
+int mutt_hcache_begin(header_cache_t *h)
+{
+  const hcache_ops_t *ops = hcache_get_ops();
+
+  if (!h || !ops)
+    return -1;
+
+  if (h->batch)
+    return 0;
+
+  if (ops->begin(h->ctx) != 0)
+    return -1;
+
+  h->batch = true;
+  h->pending = 0;
+  return 0;
+}
+
+int mutt_hcache_commit(header_cache_t *h)
+{
+  const hcache_ops_t *ops = hcache_get_ops();
+
+  if (!h || !ops || !h->batch)
+    return -1;
+
+  h->batch = false;
+  h->pending = 0;
+  return ops->commit(h->ctx) == 0 ? 0 : -1;
+}
+
+struct hcache_gc
+{
+  header_cache_t *h;
+  hcache_keep_t keep;
+  void *data;
+  LIST *stale;
+  int count;
+};
+
+static int hcache_gc_key(const char *key, size_t keylen, void *data)
+{
+  struct hcache_gc *gc = data;
+  char buf[_POSIX_PATH_MAX];
+  size_t flen = mutt_strlen(gc->h->folder);
+
+  /* only look at the records of this folder */
+  if (keylen < flen || keylen - flen >= sizeof(buf) ||
+      mutt_strncmp(key, gc->h->folder, flen) != 0)
+    return 0;
+
+  memcpy(buf, key + flen, keylen - flen);
+  buf[keylen - flen] = '\0';
+
+  if (!gc->keep(buf, gc->data))
+  {
+    LIST *l = safe_calloc(1, sizeof(LIST));
+    l->data = safe_strdup(buf);
+    l->next = gc->stale;
+    gc->stale = l;
+    gc->count++;
+  }
+
+  return 0;
+}
+
+static off_t hcache_file_size(const char *path)
+{
+  struct stat sb;
+
+  return (stat(path, &sb) == 0) ? sb.st_size : 0;
+}
+
+int mutt_hcache_keep_hash(const char *key, void *data)
+{
+  return hash_find(data, key) != NULL;
+}
+
+int mutt_hcache_compact(header_cache_t *h, hcache_keep_t keep, void *data,
+                        bool force, long *reclaimed)
+{
+  const hcache_ops_t *ops = hcache_get_ops();
+  struct hcache_gc gc;
+  off_t before;
+  LIST *l = NULL;
+
+  if (reclaimed)
+    *reclaimed = 0;
+
+  if (!h || !ops || !h->ctx)
+    return -1;
+
+  memset(&gc, 0, sizeof(gc));
+  gc.h = h;
+  gc.keep = keep;
+  gc.data = data;
+
+  mutt_hcache_commit(h);
+  before = hcache_file_size(h->path);
+
+  /* Folder names may be prefixes of each other, so the keys of a database
+   * shared by all the folders cannot be attributed safely. */
+  if (!h->shared && ops->walk(h->ctx, hcache_gc_key, &gc) != 0)
+  {
+    mutt_free_list(&gc.stale);
+    return -1;
+  }
+
+  if (gc.stale)
+  {
+    mutt_hcache_begin(h);
+    for (l = gc.stale; l; l = l->next)
+    {
+      mutt_debug(3, "mutt_hcache_compact: dropping %s\n", l->data);
+      mutt_hcache_delete(h, l->data, strlen(l->data));
+    }
+    mutt_hcache_commit(h);
+    mutt_free_list(&gc.stale);
+  }
+
+  if (force || gc.count)
+  {
+    if (ops->compact(&h->ctx) != 0)
+      mutt_debug(1, "mutt_hcache_compact: %s: compaction failed\n", h->path);
+    if (!h->ctx)
+      h->ctx = ops->open(h->path);
+  }
+
+  if (reclaimed)
+    *reclaimed = before - hcache_file_size(h->path);
+
+  return gc.count;
 }
 
 const char *mutt_hcache_backend_list(void)
@@ -28,6 +28,32 @@ typedef struct header_cache header_cache_t;
 
 typedef int (*hcache_namer_t)(const char *path, char *dest, size_t dlen);
 
+/* tells mutt_hcache_compact whether the record stored under key is still
+ * needed */
+typedef int (*hcache_keep_t)(const char *key, void *data);
+
+/* key of the thread tree of a folder, see mutt_sort_threads().  It can't be
+ * the key of a message. */
+#define HCACHE_THREADS_KEY "//THREADS"
+
+/* hcache_flags_t.flags */
+#define HCACHE_FLAG_READ    (1 << 0)
+#define HCACHE_FLAG_OLD     (1 << 1)
+#define HCACHE_FLAG_FLAGGED (1 << 2)
+#define HCACHE_FLAG_REPLIED (1 << 3)
+#define HCACHE_FLAG_DELETED (1 << 4)
+
+/**
+ * hcache_flags_t - the state of a cached message, kept at a fixed offset in
+ * its record so that it can be read without restoring the whole HEADER.
+ */
+typedef struct hcache_flags
+{
+  unsigned int flags; /* HCACHE_FLAG_* */
+  LOFF_T size;        /* length of the message body */
+  time_t received;    /* time when the message was placed in the mailbox */
+} hcache_flags_t;
+
 /**
  * mutt_hcache_open - open the connection to the header cache.
  *
@@ -60,6 +86,21 @@ void mutt_hcache_close(header_cache_t *h);
  */
 void *mutt_hcache_fetch(header_cache_t *h, const char *key, size_t keylen);
 
+/**
+ * mutt_hcache_fetch_flags - fetch and validate the flags of a message.
+ *
+ * @param h Pointer to the header_cache_t structure got by mutt_hcache_open.
+ * @param key Message identification string.
+ * @param keylen Length of the string pointed to by key.
+ * @param flags Filled in with the state of the message if found and valid.
+ * @return 0 on success, -1 otherwise.
+ * @note Unlike mutt_hcache_fetch followed by mutt_hcache_restore, this neither
+ * decompresses the record nor restores the envelope and body, which makes it
+ * much cheaper for callers that only check whether a message changed.
+ */
+int mutt_hcache_fetch_flags(header_cache_t *h, const char *key, size_t keylen,
+                            hcache_flags_t *flags);
+
 /**
  * mutt_hcache_fetch_raw - fetch a message's header from the cache.
  *
@@ -74,6 +115,20 @@ void *mutt_hcache_fetch(header_cache_t *h, const char *key, size_t keylen);
  */
 void *mutt_hcache_fetch_raw(header_cache_t *h, const char *key, size_t keylen);
 
+/**
+ * mutt_hcache_fetch_raw_size - fetch raw data and its length from the cache.
+ *
+ * @param h Pointer to the header_cache_t structure got by mutt_hcache_open.
+ * @param key Message identification string.
+ * @param keylen Length of the string pointed to by key.
+ * @param dlen If not NULL, receives the length of the data found.
+ * @return Pointer to the data if found, NULL otherwise.
+ * @note Like mutt_hcache_fetch_raw, the data is not checked and must be freed
+ * with mutt_hcache_free.
+ */
+void *mutt_hcache_fetch_raw_size(header_cache_t *h, const char *key,
+                                 size_t keylen, size_t *dlen);
+
 /**
  * mutt_hcache_free - free previously fetched data.
  *
@@ -82,6 +137,20 @@ void *mutt_hcache_fetch_raw(header_cache_t *h, const char *key, size_t keylen);
  */
 void mutt_hcache_free(header_cache_t *h, void **data);
 
+/**
+ * mutt_hcache_dump - serialise a HEADER along with a validity datum.
+ *
+ * @param h Pointer to the header_cache_t structure got by mutt_hcache_open.
+ * @param header Message header to serialise.
+ * @param off Set to the length of the returned buffer.
+ * @param uidvalidity IMAP-specific UIDVALIDITY value, or 0 to use the current
+ * time.
+ * @return Pointer to the serialised data, suitable for mutt_hcache_restore.
+ * @note The returned buffer must be free'd by the caller. Most callers want
+ * mutt_hcache_store instead.
+ */
+void *mutt_hcache_dump(header_cache_t *h, HEADER *header, int *off, unsigned int uidvalidity);
+
 /**
  * mutt_hcache_restore - restore a HEADER from data retrieved from the cache.
  *
@@ -89,9 +158,24 @@ void mutt_hcache_free(header_cache_t *h, void **data);
  * @return Pointer to the restored header (cannot be NULL).
  * @note The returned HEADER must be free'd by caller code with
  * mutt_free_header.
+ * @note See mutt_hcache_restore_lazy for the fields which might not be
+ * restored yet.
  */
 HEADER *mutt_hcache_restore(const unsigned char *d);
 
+/**
+ * mutt_hcache_restore_lazy - restore the envelope fields left out by
+ * mutt_hcache_restore.
+ *
+ * @param e Envelope of a HEADER returned by mutt_hcache_restore.
+ * @note When $header_cache_lazy is set, mutt_hcache_restore only decodes the
+ * fields needed by the index (display, sorting, limiting and threading). The
+ * rest (Return-Path, Mail-Followup-To, Date and the user headers) is kept in
+ * serialised form until this function is called, usually by
+ * mutt_env_restore_lazy.
+ */
+void mutt_hcache_restore_lazy(ENVELOPE *e);
+
 /**
  * mutt_hcache_store - store a HEADER along with a validity datum.
  *
@@ -129,6 +213,55 @@ int mutt_hcache_store_raw(header_cache_t *h, const char *key, size_t keylen,
  */
 int mutt_hcache_delete(header_cache_t *h, const char *key, size_t keylen);
 
+/**
+ * mutt_hcache_begin - start a batch of writes.
+ *
+ * @param h Pointer to the header_cache_t structure got by mutt_hcache_open.
+ * @return 0 on success, -1 otherwise.
+ * @note Until mutt_hcache_commit is called, stores and deletes are grouped in
+ * backend transactions of a bounded number of writes each. Data previously
+ * returned by mutt_hcache_fetch might be invalidated by those commits, so it
+ * must not be accessed after issuing further writes. mutt_hcache_close commits
+ * any batch still in progress.
+ */
+int mutt_hcache_begin(header_cache_t *h);
+
+/**
+ * mutt_hcache_commit - complete a batch of writes.
+ *
+ * @param h Pointer to the header_cache_t structure got by mutt_hcache_open.
+ * @return 0 on success, -1 otherwise (including when no batch is active).
+ */
+int mutt_hcache_commit(header_cache_t *h);
+
+/**
+ * mutt_hcache_compact - drop stale records and shrink the database.
+ *
+ * @param h Pointer to the header_cache_t structure got by mutt_hcache_open.
+ * @param keep Called with the key of each record of the folder (as passed to
+ * mutt_hcache_store); records for which it returns 0 are deleted.
+ * @param data Data passed to keep.
+ * @param force If false, the database is only rewritten when records were
+ * deleted.
+ * @param reclaimed If not NULL, set to the number of bytes by which the
+ * database file shrank.
+ * @return Number of records deleted, -1 on error.
+ * @note Records are only deleted from per-folder databases: when
+ * $header_cache names a single file for all the folders, only the
+ * database is compacted. Any batch of writes in progress is committed.
+ */
+int mutt_hcache_compact(header_cache_t *h, hcache_keep_t keep, void *data,
+                        bool force, long *reclaimed);
+
+/**
+ * mutt_hcache_keep_hash - hcache_keep_t for a HASH of the keys to keep.
+ *
+ * @param key Key of a record.
+ * @param data HASH whose keys are those of the records to keep.
+ * @return 1 if key is in the HASH, 0 otherwise.
+ */
+int mutt_hcache_keep_hash(const char *key, void *data);
+
 /**
  * mutt_hcache_backend_list - get a list of backend identification strings.
  *
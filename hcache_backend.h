@@ -43,9 +43,10 @@ typedef void *(*hcache_open_t)(const char *path);
  * @param ctx The backend-specific context retrieved via hcache_open.
  * @param key A message identification string.
  * @param keylen The length of the string pointed to by key.
+ * @param dlen If not NULL, receives the length of the data found.
  * @return Pointer to the message's headers on success, NULL otherwise.
  */
-typedef void *(*hcache_fetch_t)(void *ctx, const char *key, size_t keylen);
+typedef void *(*hcache_fetch_t)(void *ctx, const char *key, size_t keylen, size_t *dlen);
 
 /**
  * hcache_free_t - backend-specific routine to free fetched data.
@@ -78,6 +79,63 @@ typedef int (*hcache_store_t)(void *ctx, const char *key, size_t keylen,
  */
 typedef int (*hcache_delete_t)(void *ctx, const char *key, size_t keylen);
 
+/**
+ * hcache_begin_t - backend-specific routine to start a batch of writes.
+ *
+ * @param ctx The backend-specific context retrieved via hcache_open.
+ * @return 0 on success, a backend-specific error code otherwise.
+ *
+ * All the stores and deletes issued until the matching hcache_commit are
+ * grouped together, so that backends supporting transactions only pay for a
+ * single commit. Backends without transactions may treat this as a no-op.
+ */
+typedef int (*hcache_begin_t)(void *ctx);
+
+/**
+ * hcache_commit_t - backend-specific routine to complete a batch of writes.
+ *
+ * @param ctx The backend-specific context retrieved via hcache_open.
+ * @return 0 on success, a backend-specific error code otherwise.
+ *
+ * Backends without transactions should flush the pending writes to disk.
+ */
+typedef int (*hcache_commit_t)(void *ctx);
+
+/**
+ * hcache_walk_cb_t - callback invoked by hcache_walk for each key.
+ *
+ * @param key A key found in the database, not NUL-terminated.
+ * @param keylen The length of the string pointed to by key.
+ * @param data The data passed to hcache_walk.
+ * @return 0 to continue the walk, non-zero to stop it.
+ */
+typedef int (*hcache_walk_cb_t)(const char *key, size_t keylen, void *data);
+
+/**
+ * hcache_walk_t - backend-specific routine to list the keys of the database.
+ *
+ * @param ctx The backend-specific context retrieved via hcache_open.
+ * @param cb Function to call for each key.
+ * @param data Data to pass to cb.
+ * @return 0 on success, a backend-specific error code otherwise.
+ *
+ * The callback must not modify the database.
+ */
+typedef int (*hcache_walk_t)(void *ctx, hcache_walk_cb_t cb, void *data);
+
+/**
+ * hcache_compact_t - backend-specific routine to reclaim unused space.
+ *
+ * @param ctx The backend-specific context retrieved via hcache_open.
+ * @return 0 on success, a backend-specific error code otherwise.
+ *
+ * Backends rewrite or defragment the database file so that the space left by
+ * deleted records is returned to the file system. Backends which can only do
+ * so by reopening the database replace the context, hence the
+ * pointer-to-pointer; it is set to NULL if the database cannot be reopened.
+ */
+typedef int (*hcache_compact_t)(void **ctx);
+
 /**
  * hcache_close_t - backend-specific routine to close a context.
  *
@@ -104,6 +162,10 @@ typedef struct
   hcache_free_t    free;
   hcache_store_t   store;
   hcache_delete_t  delete;
+  hcache_begin_t   begin;
+  hcache_commit_t  commit;
+  hcache_walk_t    walk;
+  hcache_compact_t compact;
   hcache_close_t   close;
   hcache_backend_t backend;
 } hcache_ops_t;
@@ -124,6 +186,10 @@ typedef struct
       .free    = hcache_##_name##_free,                                        \
       .store   = hcache_##_name##_store,                                       \
       .delete  = hcache_##_name##_delete,                                      \
+      .begin   = hcache_##_name##_begin,                                       \
+      .commit  = hcache_##_name##_commit,                                      \
+      .walk    = hcache_##_name##_walk,                                        \
+      .compact = hcache_##_name##_compact,                                     \
       .close   = hcache_##_name##_close,                                       \
       .backend = hcache_##_name##_backend,                                     \
   };
@@ -112,7 +112,7 @@ fail_close:
   return NULL;
 }
 
-static void *hcache_bdb_fetch(void *vctx, const char *key, size_t keylen)
+static void *hcache_bdb_fetch(void *vctx, const char *key, size_t keylen, size_t *dlen)
 {
   DBT dkey;
   DBT data;
@@ -128,6 +128,8 @@ static void *hcache_bdb_fetch(void *vctx, const char *key, size_t keylen)
 
   ctx->db->get(ctx->db, NULL, &dkey, &data, 0);
 
+  if (dlen)
+    *dlen = data.size;
   return data.data;
 }
 
@@ -169,6 +171,59 @@ static int hcache_bdb_delete(void *vctx, const char *key, size_t keylen)
   return ctx->db->del(ctx->db, NULL, &dkey, 0);
 }
 
+static int hcache_bdb_begin(void *vctx)
+{
+  /* The environment is opened without DB_INIT_TXN: writes only hit the
+   * memory pool until they are flushed by hcache_bdb_commit */
+  return vctx ? 0 : -1;
+}
+
+static int hcache_bdb_commit(void *vctx)
+{
+  if (!vctx)
+    return -1;
+
+  hcache_db_ctx_t *ctx = vctx;
+
+  return ctx->db->sync(ctx->db, 0);
+}
+
+static int hcache_bdb_walk(void *vctx, hcache_walk_cb_t cb, void *data)
+{
+  DBC *cursor = NULL;
+  DBT key;
+  DBT value;
+  int ret;
+
+  if (!vctx)
+    return -1;
+
+  hcache_db_ctx_t *ctx = vctx;
+
+  ret = ctx->db->cursor(ctx->db, NULL, &cursor, 0);
+  if (ret)
+    return ret;
+
+  dbt_empty_init(&key);
+  dbt_empty_init(&value);
+  while ((ret = cursor->get(cursor, &key, &value, DB_NEXT)) == 0)
+    if (cb(key.data, key.size, data))
+      break;
+
+  cursor->close(cursor);
+  return (ret == DB_NOTFOUND) ? 0 : ret;
+}
+
+static int hcache_bdb_compact(void **vctx)
+{
+  if (!vctx || !*vctx)
+    return -1;
+
+  hcache_db_ctx_t *ctx = *vctx;
+
+  return ctx->db->compact(ctx->db, NULL, NULL, NULL, NULL, DB_FREE_SPACE, NULL);
+}
+
 static void hcache_bdb_close(void **vctx)
 {
   if (!vctx || !*vctx)
@@ -0,0 +1,497 @@
+/**
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Header cache micro-benchmark.
+ *
+ * A synthetic corpus of messages is generated in memory, then for each
+ * compiled-in header cache backend this program measures:
+ *
+ *  - the throughput of mutt_hcache_dump() and mutt_hcache_restore()
+ *  - the latency percentiles of mutt_hcache_store(), mutt_hcache_fetch() and
+ *    mutt_hcache_fetch_flags()
+ *  - the size of the database on disk
+ *  - the time needed to open the database and fetch every message, with a
+ *    cold (as far as posix_fadvise() allows) and a warm page cache, then
+ *    again once the records are in the memory tier ($header_cache_memory)
+ *  - the time needed by mutt_hcache_compact() to drop half of the messages
+ *
+ * The program is linked with the same objects as mutt itself and is built
+ * with "make hcache_bench".
+ */
+
+#include "config.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "mutt.h"
+#include "bench.h"
+#include "hcache.h"
+
+static const char *Names[] = {
+  "Alice Liddell", "Bob Dobbs",    "Carol Danvers", "Dave Bowman",
+  "Eve Moneypenny", "Frank Poole", "Grace Hopper",  "Heidi Klum",
+  "Ivan Ivanovich", "Judy Garland", "Mallory Knox", "Zoë Ångström",
+};
+
+static const char *Domains[] = {
+  "example.com", "example.org", "lists.example.net", "mail.example.de",
+};
+
+static const char *Words[] = {
+  "patch",  "review",  "header", "cache",    "backend", "release",
+  "build",  "failure", "fix",    "question", "report",  "thread",
+  "memory", "leak",    "crash",  "proposal", "meeting", "agenda",
+};
+
+static unsigned long Seed = 42;
+
+static unsigned long bench_rand(void)
+{
+  /* Numerical Recipes LCG: deterministic across platforms */
+  Seed = Seed * 1664525UL + 1013904223UL;
+  return (Seed >> 8) & 0xffffff;
+}
+
+#define PICK(a) (a[bench_rand() % (sizeof(a) / sizeof(a[0]))])
+
+static ADDRESS *bench_address(void)
+{
+  char buf[STRING];
+  const char *name = PICK(Names);
+  ADDRESS *a = rfc822_new_address();
+
+  a->personal = safe_strdup(name);
+  snprintf(buf, sizeof(buf), "%.*s%lu@%s", 5, name, bench_rand() % 100, PICK(Domains));
+  a->mailbox = safe_strdup(buf);
+  return a;
+}
+
+static ADDRESS *bench_address_list(int max)
+{
+  ADDRESS *head = NULL;
+  ADDRESS **last = &head;
+  int n = bench_rand() % (max + 1);
+
+  for (; n; n--)
+  {
+    *last = bench_address();
+    last = &(*last)->next;
+  }
+  return head;
+}
+
+static void bench_message_id(char *buf, size_t buflen, int i)
+{
+  snprintf(buf, buflen, "<%d.%lx@%s>", i, bench_rand(), PICK(Domains));
+}
+
+static HEADER *bench_header(int i)
+{
+  char buf[LONG_STRING];
+  HEADER *h = mutt_new_header();
+  ENVELOPE *e = h->env = mutt_new_envelope();
+  BODY *b = h->content = mutt_new_body();
+  LIST **last = NULL;
+  int n;
+
+  e->return_path = bench_address();
+  e->from = bench_address();
+  e->to = bench_address_list(3);
+  e->cc = bench_address_list(4);
+
+  snprintf(buf, sizeof(buf), "%s%s %s %s #%d", (i % 3) ? "Re: " : "",
+           PICK(Words), PICK(Words), PICK(Words), i);
+  e->subject = safe_strdup(buf);
+  e->real_subj = e->subject + ((i % 3) ? 4 : 0);
+
+  bench_message_id(buf, sizeof(buf), i);
+  e->message_id = safe_strdup(buf);
+
+  e->date = safe_strdup("Mon, 24 Apr 2017 10:00:00 +0200");
+
+  last = &e->references;
+  for (n = bench_rand() % 12; n; n--)
+  {
+    bench_message_id(buf, sizeof(buf), bench_rand() % (i + 1));
+    *last = mutt_new_list();
+    (*last)->data = safe_strdup(buf);
+    last = &(*last)->next;
+  }
+  if (e->references)
+    e->in_reply_to = mutt_add_list(NULL, e->references->data);
+
+  b->subtype = safe_strdup("plain");
+  b->length = 512 + bench_rand() % 65536;
+  b->offset = 1024;
+  mutt_set_parameter("charset", "utf-8", &b->parameter);
+
+  h->date_sent = h->received = 1493020800 + i * 60;
+  h->read = bench_rand() % 2;
+  h->flagged = (bench_rand() % 10) == 0;
+  h->lines = b->length / 60;
+  h->index = i;
+
+  return h;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+  double x = *(const double *) a;
+  double y = *(const double *) b;
+  return (x > y) - (x < y);
+}
+
+static void print_latency(const char *what, double *t, int n)
+{
+  qsort(t, n, sizeof(double), cmp_double);
+  printf("  %-8s p50 %8.2fus  p90 %8.2fus  p99 %8.2fus  max %8.2fus\n", what,
+         t[n / 2] * 1e6, t[n * 9 / 10] * 1e6, t[n * 99 / 100] * 1e6, t[n - 1] * 1e6);
+}
+
+/* Sum the size of the files in dir, and optionally evict them from the page
+ * cache (best effort, this does not touch dirty pages) */
+static off_t dir_size(const char *dir, int evict)
+{
+  char path[_POSIX_PATH_MAX];
+  struct dirent *de = NULL;
+  struct stat sb;
+  off_t size = 0;
+  DIR *d = opendir(dir);
+
+  if (!d)
+    return 0;
+
+  while ((de = readdir(d)))
+  {
+    if (de->d_name[0] == '.')
+      continue;
+    if (snprintf(path, sizeof(path), "%s/%s", dir, de->d_name) >= sizeof(path))
+      continue;
+    if (stat(path, &sb) != 0 || !S_ISREG(sb.st_mode))
+      continue;
+    size += sb.st_size;
+#ifdef POSIX_FADV_DONTNEED
+    if (evict)
+    {
+      int fd = open(path, O_RDONLY);
+      if (fd >= 0)
+      {
+        fdatasync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+      }
+    }
+#endif
+  }
+  closedir(d);
+  return size;
+}
+
+static void rm_dir(const char *dir)
+{
+  char path[_POSIX_PATH_MAX];
+  struct dirent *de = NULL;
+  DIR *d = opendir(dir);
+
+  if (!d)
+    return;
+
+  while ((de = readdir(d)))
+  {
+    if (de->d_name[0] == '.')
+      continue;
+    if (snprintf(path, sizeof(path), "%s/%s", dir, de->d_name) < sizeof(path))
+      unlink(path);
+  }
+  closedir(d);
+  rmdir(dir);
+}
+
+static double open_and_fetch_all(const char *dir, int n)
+{
+  char key[SHORT_STRING];
+  double start = bench_now();
+  header_cache_t *hc = mutt_hcache_open(dir, "bench", NULL);
+  int i;
+
+  for (i = 0; i < n; i++)
+  {
+    int keylen = snprintf(key, sizeof(key), "/%d", i);
+    void *data = mutt_hcache_fetch(hc, key, keylen);
+    if (data)
+    {
+      HEADER *h = mutt_hcache_restore(data);
+      mutt_free_header(&h);
+    }
+    mutt_hcache_free(hc, &data);
+  }
+  mutt_hcache_close(hc);
+
+  return bench_now() - start;
+}
+
+/* keep one message out of two, as if the other half had been expunged */
+static int keep_even(const char *key, void *data)
+{
+  return (atoi(key + 1) % 2) == 0;
+}
+
+static void compact_half(const char *dir)
+{
+  header_cache_t *hc = mutt_hcache_open(dir, "bench", NULL);
+  char size[SHORT_STRING];
+  long reclaimed = 0;
+  double start = bench_now();
+  int dropped = mutt_hcache_compact(hc, keep_even, NULL, true, &reclaimed);
+  double elapsed = bench_now() - start;
+
+  mutt_hcache_close(hc);
+  mutt_pretty_size(size, sizeof(size), (reclaimed > 0) ? reclaimed : 0);
+  printf("  compact  %8.3fs  (%d records dropped, %s reclaimed)\n", elapsed,
+         dropped, size);
+}
+
+static void bench_backend(const char *backend, const char *base, HEADER **hdrs,
+                          int n, short memory)
+{
+  char dir[_POSIX_PATH_MAX];
+  char key[SHORT_STRING];
+  double *lat = NULL;
+  void **records = NULL;
+  double start, dump_time, restore_time;
+  size_t bytes = 0;
+  int missing = 0;
+  header_cache_t *hc = NULL;
+  int i;
+
+  if (snprintf(dir, sizeof(dir), "%s/%s/", base, backend) >= sizeof(dir))
+  {
+    printf("%s: the path of the header cache is too long\n", backend);
+    return;
+  }
+  mutt_str_replace(&HeaderCacheBackend, backend);
+
+  hc = mutt_hcache_open(dir, "bench", NULL);
+  if (!hc)
+  {
+    printf("%s: cannot open the header cache in %s\n", backend, dir);
+    return;
+  }
+  lat = safe_calloc(n, sizeof(double));
+  records = safe_calloc(n, sizeof(void *));
+
+  printf("%s\n", backend);
+
+  /* dump/restore throughput, independent from the backend */
+  start = bench_now();
+  for (i = 0; i < n; i++)
+  {
+    int len;
+    records[i] = mutt_hcache_dump(hc, hdrs[i], &len, 0);
+    bytes += len;
+  }
+  dump_time = bench_now() - start;
+
+  start = bench_now();
+  for (i = 0; i < n; i++)
+  {
+    HEADER *h = mutt_hcache_restore(records[i]);
+    mutt_free_header(&h);
+  }
+  restore_time = bench_now() - start;
+
+  for (i = 0; i < n; i++)
+    FREE(&records[i]);
+  FREE(&records);
+
+  printf("  dump     %10.0f msg/s  %8.2f MB/s  (avg record %zu bytes)\n",
+         n / dump_time, bytes / dump_time / 1e6, bytes / n);
+  printf("  restore  %10.0f msg/s\n", n / restore_time);
+
+  /* store latency, in a single batch as when a folder is first opened */
+  mutt_hcache_begin(hc);
+  for (i = 0; i < n; i++)
+  {
+    int keylen = snprintf(key, sizeof(key), "/%d", i);
+    start = bench_now();
+    mutt_hcache_store(hc, key, keylen, hdrs[i], 0);
+    lat[i] = bench_now() - start;
+  }
+  mutt_hcache_commit(hc);
+  print_latency("store", lat, n);
+
+  /* fetch latency, in random order */
+  for (i = 0; i < n; i++)
+  {
+    int keylen = snprintf(key, sizeof(key), "/%lu", bench_rand() % n);
+    start = bench_now();
+    void *data = mutt_hcache_fetch(hc, key, keylen);
+    lat[i] = bench_now() - start;
+    if (!data)
+      missing++;
+    mutt_hcache_free(hc, &data);
+  }
+  print_latency("fetch", lat, n);
+
+  /* flags-only fetch latency, as used when checking a folder for changes */
+  for (i = 0; i < n; i++)
+  {
+    hcache_flags_t flags;
+    int keylen = snprintf(key, sizeof(key), "/%lu", bench_rand() % n);
+    start = bench_now();
+    if (mutt_hcache_fetch_flags(hc, key, keylen, &flags) != 0)
+      missing++;
+    lat[i] = bench_now() - start;
+  }
+  print_latency("flags", lat, n);
+  mutt_hcache_close(hc);
+
+  if (missing)
+    printf("  WARNING: %d fetches failed\n", missing);
+
+  printf("  size     %10.2f MB on disk\n", dir_size(dir, 1) / 1e6);
+  printf("  open     cold %8.3fs", open_and_fetch_all(dir, n));
+  printf("  warm %8.3fs", open_and_fetch_all(dir, n));
+  HeaderCacheMemory = memory;
+  open_and_fetch_all(dir, n);
+  printf("  memory %8.3fs\n", open_and_fetch_all(dir, n));
+  HeaderCacheMemory = 0;
+  compact_half(dir);
+
+  rm_dir(dir);
+  FREE(&lat);
+}
+
+static void usage(const char *progname)
+{
+  fprintf(stderr, "usage: %s [-l] [-z level] [-m MB] [-n messages] [-d directory] [-b backend]...\n"
+                  "  -l restore headers lazily, as with $header_cache_lazy\n"
+#ifdef HAVE_ZLIB
+                  "  -z compress records at the given zlib level, as with "
+                  "$header_cache_zlib and $header_cache_compress_level\n"
+#endif
+                  "  -m size of the memory tier, as with $header_cache_memory "
+                  "(default: 256)\n"
+                  "  -n number of synthetic messages (default: 100000)\n"
+                  "  -d scratch directory (default: $TMPDIR or /tmp)\n"
+                  "  -b backend to test (default: all compiled-in backends)\n",
+          progname);
+  exit(1);
+}
+
+int main(int argc, char **argv)
+{
+  char base[_POSIX_PATH_MAX];
+  const char *tmpdir = getenv("TMPDIR");
+  char *backends = NULL;
+  char *b = NULL;
+  char *next = NULL;
+  HEADER **hdrs = NULL;
+  int n = 100000;
+  short memory = 256;
+  int ch;
+  int i;
+
+  bench_init();
+
+  while ((ch = getopt(argc, argv, "lz:m:n:d:b:")) != -1)
+  {
+    switch (ch)
+    {
+      case 'l':
+        set_option(OPTHCACHELAZY);
+        break;
+#ifdef HAVE_ZLIB
+      case 'z':
+      {
+        int level;
+        if (mutt_atoi(optarg, &level) < 0 || level < 1 || level > 9)
+          usage(argv[0]);
+        HeaderCacheCompressLevel = level;
+        set_option(OPTHCACHEZLIB);
+        break;
+      }
+#endif
+      case 'm':
+        if (mutt_atos(optarg, &memory) < 0 || memory <= 0)
+          usage(argv[0]);
+        break;
+      case 'n':
+        if (mutt_atoi(optarg, &n) < 0 || n <= 0)
+          usage(argv[0]);
+        break;
+      case 'd':
+        tmpdir = optarg;
+        break;
+      case 'b':
+        if (!mutt_hcache_is_valid_backend(optarg))
+        {
+          fprintf(stderr, "%s: unknown backend %s\n", argv[0], optarg);
+          exit(1);
+        }
+        if (backends)
+        {
+          char *tmp = backends;
+          safe_asprintf(&backends, "%s, %s", tmp, optarg);
+          FREE(&tmp);
+        }
+        else
+          backends = safe_strdup(optarg);
+        break;
+      default:
+        usage(argv[0]);
+    }
+  }
+
+  if (!backends)
+    backends = (char *) mutt_hcache_backend_list();
+
+  snprintf(base, sizeof(base), "%s/hcache-bench-XXXXXX", tmpdir ? tmpdir : "/tmp");
+  if (!mkdtemp(base))
+  {
+    fprintf(stderr, "%s: %s: %s\n", argv[0], base, strerror(errno));
+    exit(1);
+  }
+
+  printf("Generating %d messages...\n", n);
+  hdrs = safe_calloc(n, sizeof(HEADER *));
+  for (i = 0; i < n; i++)
+    hdrs[i] = bench_header(i);
+
+  for (b = backends; b && *b; b = next)
+  {
+    next = strchr(b, ',');
+    if (next)
+    {
+      *next++ = '\0';
+      SKIPWS(next);
+    }
+    bench_backend(b, base, hdrs, n, memory);
+  }
+
+  for (i = 0; i < n; i++)
+    mutt_free_header(&hdrs[i]);
+  FREE(&hdrs);
+  FREE(&backends);
+  rmdir(base);
+
+  return 0;
+}
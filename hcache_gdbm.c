@@ -38,7 +38,7 @@ static void *hcache_gdbm_open(const char *path)
   return gdbm_open((char *) path, pagesize, GDBM_READER, 00600, NULL);
 }
 
-static void *hcache_gdbm_fetch(void *ctx, const char *key, size_t keylen)
+static void *hcache_gdbm_fetch(void *ctx, const char *key, size_t keylen, size_t *dlen)
 {
   datum dkey;
   datum data;
@@ -51,6 +51,8 @@ static void *hcache_gdbm_fetch(void *ctx, const char *key, size_t keylen)
   dkey.dptr = (char *) key;
   dkey.dsize = keylen;
   data = gdbm_fetch(db, dkey);
+  if (dlen)
+    *dlen = data.dsize;
   return data.dptr;
 }
 
@@ -93,6 +95,58 @@ static int hcache_gdbm_delete(void *ctx, const char *key, size_t keylen)
   return gdbm_delete(db, dkey);
 }
 
+static int hcache_gdbm_begin(void *ctx)
+{
+  /* gdbm has no transactions, the database is not opened with GDBM_SYNC */
+  return ctx ? 0 : -1;
+}
+
+static int hcache_gdbm_commit(void *ctx)
+{
+  if (!ctx)
+    return -1;
+
+  GDBM_FILE db = ctx;
+
+  gdbm_sync(db);
+  return 0;
+}
+
+static int hcache_gdbm_walk(void *ctx, hcache_walk_cb_t cb, void *data)
+{
+  datum key, next;
+
+  if (!ctx)
+    return -1;
+
+  GDBM_FILE db = ctx;
+
+  key = gdbm_firstkey(db);
+  while (key.dptr)
+  {
+    if (cb(key.dptr, key.dsize, data))
+    {
+      FREE(&key.dptr);
+      break;
+    }
+    next = gdbm_nextkey(db, key);
+    FREE(&key.dptr);
+    key = next;
+  }
+
+  return 0;
+}
+
+static int hcache_gdbm_compact(void **ctx)
+{
+  if (!ctx || !*ctx)
+    return -1;
+
+  GDBM_FILE db = *ctx;
+
+  return gdbm_reorganize(db);
+}
+
 static void hcache_gdbm_close(void **ctx)
 {
   if (!ctx)
@@ -53,15 +53,20 @@ static void *hcache_kyotocabinet_open(const char *path)
   }
 }
 
-static void *hcache_kyotocabinet_fetch(void *ctx, const char *key, size_t keylen)
+static void *hcache_kyotocabinet_fetch(void *ctx, const char *key,
+                                       size_t keylen, size_t *dlen)
 {
   size_t sp;
+  void *data = NULL;
 
   if (!ctx)
     return NULL;
 
   KCDB *db = ctx;
-  return kcdbget(db, key, keylen, &sp);
+  data = kcdbget(db, key, keylen, &sp);
+  if (dlen)
+    *dlen = sp;
+  return data;
 }
 
 static void hcache_kyotocabinet_free(void *vctx, void **data)
@@ -89,6 +94,78 @@ static int hcache_kyotocabinet_delete(void *ctx, const char *key, size_t keylen)
   return kcdbremove(db, key, keylen);
 }
 
+static int hcache_kyotocabinet_begin(void *ctx)
+{
+  if (!ctx)
+    return -1;
+
+  KCDB *db = ctx;
+  if (!kcdbbegintran(db, 0))
+  {
+#ifdef DEBUG
+    int ecode = kcdbecode(db);
+    mutt_debug(2, "kcdbbegintran failed: %s (ecode %d)\n", kcdbemsg(db), ecode);
+#endif
+    return -1;
+  }
+
+  return 0;
+}
+
+static int hcache_kyotocabinet_commit(void *ctx)
+{
+  if (!ctx)
+    return -1;
+
+  KCDB *db = ctx;
+  if (!kcdbendtran(db, 1))
+  {
+#ifdef DEBUG
+    int ecode = kcdbecode(db);
+    mutt_debug(2, "kcdbendtran failed: %s (ecode %d)\n", kcdbemsg(db), ecode);
+#endif
+    return -1;
+  }
+
+  return 0;
+}
+
+static int hcache_kyotocabinet_walk(void *ctx, hcache_walk_cb_t cb, void *data)
+{
+  char *key = NULL;
+  size_t keylen;
+  int stop = 0;
+
+  if (!ctx)
+    return -1;
+
+  KCDB *db = ctx;
+  KCCUR *cur = kcdbcursor(db);
+
+  if (kccurjump(cur))
+  {
+    while (!stop && (key = kccurgetkey(cur, &keylen, 1)))
+    {
+      stop = cb(key, keylen, data);
+      kcfree(key);
+    }
+  }
+  kccurdel(cur);
+
+  return 0;
+}
+
+static int hcache_kyotocabinet_compact(void **ctx)
+{
+  if (!ctx || !*ctx)
+    return -1;
+
+  /* The C API offers no defragmentation: tree databases reuse the space of
+   * removed records, so only make sure they are on disk. */
+  KCDB *db = *ctx;
+  return kcdbsync(db, 1, NULL, NULL) ? 0 : -1;
+}
+
 static void hcache_kyotocabinet_close(void **ctx)
 {
   if (!ctx || !*ctx)
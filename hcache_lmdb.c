@@ -19,7 +19,10 @@
  */
 
 #include "config.h"
+#include <errno.h>
 #include <lmdb.h>
+#include <stdio.h>
+#include <unistd.h>
 #include "hcache_backend.h"
 #include "lib.h"
 
@@ -139,7 +142,7 @@ fail_env:
   return NULL;
 }
 
-static void *hcache_lmdb_fetch(void *vctx, const char *key, size_t keylen)
+static void *hcache_lmdb_fetch(void *vctx, const char *key, size_t keylen, size_t *dlen)
 {
   MDB_val dkey;
   MDB_val data;
@@ -172,6 +175,8 @@ static void *hcache_lmdb_fetch(void *vctx, const char *key, size_t keylen)
     return NULL;
   }
 
+  if (dlen)
+    *dlen = data.mv_size;
   return data.mv_data;
 }
 
@@ -247,6 +252,77 @@ static int hcache_lmdb_delete(void *vctx, const char *key, size_t keylen)
   return rc;
 }
 
+static int hcache_lmdb_begin(void *vctx)
+{
+  int rc;
+
+  if (!vctx)
+    return -1;
+
+  hcache_lmdb_ctx_t *ctx = vctx;
+
+  rc = mdb_get_w_txn(ctx);
+  if (rc != MDB_SUCCESS)
+    mutt_debug(2, "hcache_lmdb_begin: mdb_get_w_txn: %s\n", mdb_strerror(rc));
+
+  return rc;
+}
+
+static int hcache_lmdb_commit(void *vctx)
+{
+  int rc = MDB_SUCCESS;
+
+  if (!vctx)
+    return -1;
+
+  hcache_lmdb_ctx_t *ctx = vctx;
+
+  if (ctx->txn && ctx->txn_mode == txn_write)
+  {
+    rc = mdb_txn_commit(ctx->txn);
+    if (rc != MDB_SUCCESS)
+      mutt_debug(2, "hcache_lmdb_commit: mdb_txn_commit: %s\n", mdb_strerror(rc));
+    ctx->txn_mode = txn_uninitialized;
+    ctx->txn = NULL;
+  }
+
+  return rc;
+}
+
+static int hcache_lmdb_walk(void *vctx, hcache_walk_cb_t cb, void *data)
+{
+  MDB_cursor *cursor = NULL;
+  MDB_val key;
+  MDB_val value;
+  int rc;
+
+  if (!vctx)
+    return -1;
+
+  hcache_lmdb_ctx_t *ctx = vctx;
+
+  rc = mdb_get_r_txn(ctx);
+  if (rc != MDB_SUCCESS)
+    return rc;
+
+  rc = mdb_cursor_open(ctx->txn, ctx->db, &cursor);
+  if (rc != MDB_SUCCESS)
+  {
+    mutt_debug(2, "hcache_lmdb_walk: mdb_cursor_open: %s\n", mdb_strerror(rc));
+    return rc;
+  }
+
+  for (rc = mdb_cursor_get(cursor, &key, &value, MDB_FIRST); rc == MDB_SUCCESS;
+       rc = mdb_cursor_get(cursor, &key, &value, MDB_NEXT))
+  {
+    if (cb(key.mv_data, key.mv_size, data))
+      break;
+  }
+  mdb_cursor_close(cursor);
+
+  return (rc == MDB_NOTFOUND) ? MDB_SUCCESS : rc;
+}
+
 static void hcache_lmdb_close(void **vctx)
 {
   if (!vctx || !*vctx)
@@ -265,6 +341,46 @@ static void hcache_lmdb_close(void **vctx)
   FREE(vctx); /* __FREE_CHECKED__ */
 }
 
+static int hcache_lmdb_compact(void **vctx)
+{
+  char path[_POSIX_PATH_MAX];
+  char tmp[_POSIX_PATH_MAX];
+  const char *envpath = NULL;
+  int rc;
+
+  if (!vctx || !*vctx)
+    return -1;
+
+  hcache_lmdb_ctx_t *ctx = *vctx;
+
+  /* LMDB never shrinks its file: write a compacted copy and swap it in */
+  rc = mdb_env_get_path(ctx->env, &envpath);
+  if (rc != MDB_SUCCESS)
+    return rc;
+  strfcpy(path, envpath, sizeof(path));
+  snprintf(tmp, sizeof(tmp), "%s.compact", path);
+  unlink(tmp);
+
+  hcache_lmdb_commit(ctx);
+  rc = mdb_env_copy2(ctx->env, tmp, MDB_CP_COMPACT);
+  if (rc != MDB_SUCCESS)
+  {
+    mutt_debug(2, "hcache_lmdb_compact: mdb_env_copy2: %s\n", mdb_strerror(rc));
+    unlink(tmp);
+    return rc;
+  }
+
+  hcache_lmdb_close(vctx);
+  if (rename(tmp, path) != 0)
+  {
+    rc = errno;
+    unlink(tmp);
+  }
+  *vctx = hcache_lmdb_open(path);
+
+  return *vctx ? rc : -1;
+}
+
 static const char *hcache_lmdb_backend(void)
 {
   return "lmdb " MDB_VERSION_STRING;
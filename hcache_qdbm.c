@@ -35,13 +35,19 @@ static void *hcache_qdbm_open(const char *path)
   return vlopen(path, flags, VL_CMPLEX);
 }
 
-static void *hcache_qdbm_fetch(void *ctx, const char *key, size_t keylen)
+static void *hcache_qdbm_fetch(void *ctx, const char *key, size_t keylen, size_t *dlen)
 {
+  int sp;
+  void *data = NULL;
+
   if (!ctx)
     return NULL;
 
   VILLA *db = ctx;
-  return vlget(db, key, keylen, NULL);
+  data = vlget(db, key, keylen, &sp);
+  if (data && dlen)
+    *dlen = sp;
+  return data;
 }
 
 static void hcache_qdbm_free(void *ctx, void **data)
@@ -67,6 +73,59 @@ static int hcache_qdbm_delete(void *ctx, const char *key, size_t keylen)
   return vlout(db, key, keylen);
 }
 
+static int hcache_qdbm_begin(void *ctx)
+{
+  if (!ctx)
+    return -1;
+
+  VILLA *db = ctx;
+  return vltranbegin(db) ? 0 : -1;
+}
+
+static int hcache_qdbm_commit(void *ctx)
+{
+  if (!ctx)
+    return -1;
+
+  VILLA *db = ctx;
+  return vltrancommit(db) ? 0 : -1;
+}
+
+static int hcache_qdbm_walk(void *ctx, hcache_walk_cb_t cb, void *data)
+{
+  char *key = NULL;
+  int keylen;
+  int stop = 0;
+
+  if (!ctx)
+    return -1;
+
+  VILLA *db = ctx;
+
+  if (!vlcurfirst(db))
+    return 0;
+
+  do
+  {
+    key = vlcurkey(db, &keylen);
+    if (!key)
+      break;
+    stop = cb(key, keylen, data);
+    FREE(&key);
+  } while (!stop && vlcurnext(db));
+
+  return 0;
+}
+
+static int hcache_qdbm_compact(void **ctx)
+{
+  if (!ctx || !*ctx)
+    return -1;
+
+  VILLA *db = *ctx;
+  return vloptimize(db) ? 0 : -1;
+}
+
 static void hcache_qdbm_close(void **ctx)
 {
   if (!ctx || !*ctx)
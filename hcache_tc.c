@@ -44,15 +44,20 @@ static void *hcache_tokyocabinet_open(const char *path)
   }
 }
 
-static void *hcache_tokyocabinet_fetch(void *ctx, const char *key, size_t keylen)
+static void *hcache_tokyocabinet_fetch(void *ctx, const char *key,
+                                       size_t keylen, size_t *dlen)
 {
   int sp;
+  void *data = NULL;
 
   if (!ctx)
     return NULL;
 
   TCBDB *db = ctx;
-  return tcbdbget(db, key, keylen, &sp);
+  data = tcbdbget(db, key, keylen, &sp);
+  if (data && dlen)
+    *dlen = sp;
+  return data;
 }
 
 static void hcache_tokyocabinet_free(void *ctx, void **data)
@@ -79,6 +84,88 @@ static int hcache_tokyocabinet_delete(void *ctx, const char *key, size_t keylen)
   return tcbdbout(db, key, keylen);
 }
 
+static int hcache_tokyocabinet_begin(void *ctx)
+{
+  if (!ctx)
+    return -1;
+
+  TCBDB *db = ctx;
+  if (!tcbdbtranbegin(db))
+  {
+#ifdef DEBUG
+    int ecode = tcbdbecode(db);
+    mutt_debug(2, "tcbdbtranbegin failed: %s (ecode %d)\n", tcbdberrmsg(ecode), ecode);
+#endif
+    return -1;
+  }
+
+  return 0;
+}
+
+static int hcache_tokyocabinet_commit(void *ctx)
+{
+  if (!ctx)
+    return -1;
+
+  TCBDB *db = ctx;
+  if (!tcbdbtrancommit(db))
+  {
+#ifdef DEBUG
+    int ecode = tcbdbecode(db);
+    mutt_debug(2, "tcbdbtrancommit failed: %s (ecode %d)\n", tcbdberrmsg(ecode), ecode);
+#endif
+    return -1;
+  }
+
+  return 0;
+}
+
+static int hcache_tokyocabinet_walk(void *ctx, hcache_walk_cb_t cb, void *data)
+{
+  char *key = NULL;
+  int keylen;
+  int stop = 0;
+
+  if (!ctx)
+    return -1;
+
+  TCBDB *db = ctx;
+  BDBCUR *cur = tcbdbcurnew(db);
+
+  if (tcbdbcurfirst(cur))
+  {
+    do
+    {
+      key = tcbdbcurkey(cur, &keylen);
+      if (!key)
+        break;
+      stop = cb(key, keylen, data);
+      FREE(&key);
+    } while (!stop && tcbdbcurnext(cur));
+  }
+  tcbdbcurdel(cur);
+
+  return 0;
+}
+
+static int hcache_tokyocabinet_compact(void **ctx)
+{
+  if (!ctx || !*ctx)
+    return -1;
+
+  TCBDB *db = *ctx;
+  if (!tcbdboptimize(db, 0, 0, 0, -1, -1, UINT8_MAX))
+  {
+#ifdef DEBUG
+    int ecode = tcbdbecode(db);
+    mutt_debug(2, "tcbdboptimize failed: %s (ecode %d)\n", tcbdberrmsg(ecode), ecode);
+#endif
+    return -1;
+  }
+
+  return 0;
+}
+
 static void hcache_tokyocabinet_close(void **ctx)
 {
   if (!ctx || !*ctx)
@@ -27,6 +27,7 @@
 #include "mutt_crypt.h"
 #include "mutt_curses.h"
 #include "mutt_idna.h"
+#include "mx.h"
 #include "sort.h"
 #ifdef HAVE_ALLOCA_H
 #include <alloca.h>
@@ -51,8 +52,33 @@ enum
   FlagCharZEmpty
 };
 
+/* Match an interned mailbox against the list patterns once, until they are
+ * changed.  Returns MX_STRING_MAIL_LIST and MX_STRING_SUBSCRIBED flags.
+ */
+static unsigned char interned_lists(const char *mailbox)
+{
+  struct mx_string *str = mx_string(mailbox);
+
+  if (str->lists_serial != MailListsSerial)
+  {
+    str->lists = 0;
+    if (!mutt_match_rx_list(mailbox, UnMailLists))
+    {
+      if (mutt_match_rx_list(mailbox, MailLists))
+        str->lists |= MX_STRING_MAIL_LIST;
+      if (!mutt_match_rx_list(mailbox, UnSubscribedLists) &&
+          mutt_match_rx_list(mailbox, SubscribedLists))
+        str->lists |= MX_STRING_SUBSCRIBED;
+    }
+    str->lists_serial = MailListsSerial;
+  }
+  return str->lists;
+}
+
 bool mutt_is_mail_list(ADDRESS *addr)
 {
+  if (addr->interned && addr->mailbox)
+    return (interned_lists(addr->mailbox) & MX_STRING_MAIL_LIST) != 0;
   if (!mutt_match_rx_list(addr->mailbox, UnMailLists))
     return mutt_match_rx_list(addr->mailbox, MailLists);
   return false;
@@ -60,6 +86,8 @@ bool mutt_is_mail_list(ADDRESS *addr)
 
 bool mutt_is_subscribed_list(ADDRESS *addr)
 {
+  if (addr->interned && addr->mailbox)
+    return (interned_lists(addr->mailbox) & MX_STRING_SUBSCRIBED) != 0;
   if (!mutt_match_rx_list(addr->mailbox, UnMailLists) &&
       !mutt_match_rx_list(addr->mailbox, UnSubscribedLists))
     return mutt_match_rx_list(addr->mailbox, SubscribedLists);
@@ -957,11 +985,11 @@ static const char *hdr_format_str(char *dest, size_t destlen, size_t col, int co
           colorlen = add_index_color(dest, destlen, flags, MT_COLOR_INDEX_SUBJECT);
           mutt_format_s(dest + colorlen, destlen - colorlen, "", NONULL(subj));
           add_index_color(dest + colorlen, destlen - colorlen, flags, MT_COLOR_INDEX);
-          snprintf(buf2, sizeof(buf2), "%s%s", hdr->tree, dest);
+          snprintf(buf2, sizeof(buf2), "%s%s", hdr->cold->tree, dest);
           mutt_format_s_tree(dest, destlen, prefix, buf2);
         }
         else
-          mutt_format_s_tree(dest, destlen, prefix, hdr->tree);
+          mutt_format_s_tree(dest, destlen, prefix, hdr->cold->tree);
       }
       else
       {
@@ -0,0 +1,224 @@
+/**
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Message index micro-benchmark.
+ *
+ * This program fills a mailbox with synthetic messages, allocated with
+ * mx_new_header() like the local backends do, and measures:
+ *
+ *  - mutt_sort_headers() for a few sort orders, starting from the mailbox
+ *    order each time
+ *  - mutt_pattern_func() limiting the mailbox with a few patterns
+ *
+ * These are the loops which visit every HEADER of a mailbox, so they show
+ * the effect of the layout of struct header (see struct header_cold).
+ *
+ * The program is linked with the same objects as mutt itself and is built
+ * with "make header_bench".
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "mutt.h"
+#include "bench.h"
+#include "mx.h"
+#include "sort.h"
+
+static void quiet_message(const char *fmt, ...)
+{
+}
+
+/* Fill the mailbox with n messages from a few thousand senders, in threads
+ * of eight messages.  As in a real folder, the messages were mostly sent in
+ * the order they were delivered. */
+static void fill_mailbox(CONTEXT *ctx, int n)
+{
+  char buf[STRING];
+  HEADER *h = NULL;
+  ENVELOPE *env = NULL;
+  int i;
+
+  srandom(1);
+  mx_reserve_memory(ctx, n);
+  for (i = 0; i < n; i++)
+  {
+    h = mx_new_header(ctx);
+    env = h->env;
+
+    env->from = rfc822_new_address();
+    snprintf(buf, sizeof(buf), "User %d", (int) (random() % 5000));
+    env->from->personal = safe_strdup(buf);
+    snprintf(buf, sizeof(buf), "user%d@example.com", (int) (random() % 5000));
+    env->from->mailbox = safe_strdup(buf);
+    snprintf(buf, sizeof(buf), "Topic %d", i / 8);
+    env->subject = safe_strdup(buf);
+    env->real_subj = env->subject;
+    snprintf(buf, sizeof(buf), "<%d@example.com>", i);
+    env->message_id = safe_strdup(buf);
+    if (i % 8)
+    {
+      snprintf(buf, sizeof(buf), "<%d@example.com>", i - 1 - (int) (random() % (i % 8)));
+      env->in_reply_to = mutt_new_list();
+      env->in_reply_to->data = safe_strdup(buf);
+    }
+
+    h->date_sent = 1262304000 + i * 180 + random() % 86400;
+    h->received = h->date_sent + random() % 3600;
+    h->score = random() % 100;
+    h->lines = random() % 500;
+    h->read = (random() % 4) != 0;
+    h->old = !h->read && (random() % 2);
+    h->flagged = (random() % 20) == 0;
+    h->replied = (random() % 10) == 0;
+    h->content->length = h->lines * 60;
+    h->active = true;
+    h->index = i;
+    h->msgno = i;
+    h->virtual = i;
+
+    ctx->hdrs[i] = h;
+    ctx->v2r[i] = i;
+    ctx->msgcount++;
+    ctx->vcount++;
+  }
+}
+
+static void bench_sort(CONTEXT *ctx, const char *name, int sort, int repeat)
+{
+  double best = 0, t;
+  int r;
+
+  for (r = 0; r < repeat; r++)
+  {
+    Sort = SORT_ORDER;
+    mutt_sort_headers(ctx, 1);
+    Sort = sort;
+    t = bench_now();
+    mutt_sort_headers(ctx, 1);
+    t = bench_now() - t;
+    if (r == 0 || t < best)
+      best = t;
+  }
+  printf("  %-24s %9.1f ms\n", name, best * 1000);
+}
+
+static void bench_limit(CONTEXT *ctx, const char *pattern, int repeat)
+{
+  double best = 0, t;
+  int r;
+
+  for (r = 0; r < repeat; r++)
+  {
+    mutt_str_replace(&ctx->pattern, pattern);
+    t = bench_now();
+    mutt_pattern_func(MUTT_LIMIT, NULL);
+    t = bench_now() - t;
+    if (r == 0 || t < best)
+      best = t;
+  }
+  printf("  %-24s %9.1f ms  %9d messages\n", pattern, best * 1000, ctx->vcount);
+}
+
+/* A ~d pattern matching the middle half of the generated messages, whatever
+ * their number */
+static void date_range(CONTEXT *ctx, char *buf, size_t buflen)
+{
+  char from[16], to[16];
+  time_t t;
+
+  t = ctx->hdrs[ctx->msgcount / 4]->date_sent;
+  strftime(from, sizeof(from), "%d/%m/%Y", localtime(&t));
+  t = ctx->hdrs[ctx->msgcount * 3 / 4]->date_sent;
+  strftime(to, sizeof(to), "%d/%m/%Y", localtime(&t));
+  snprintf(buf, buflen, "~d %s-%s", from, to);
+}
+
+static void usage(const char *progname)
+{
+  fprintf(stderr, "usage: %s [-n messages] [-r repeat]\n"
+                  "  -n number of synthetic messages (default: 1000000)\n"
+                  "  -r runs of each test, the best one is shown (default: 5)\n",
+          progname);
+  exit(1);
+}
+
+int main(int argc, char **argv)
+{
+  char range[STRING];
+  CONTEXT ctx;
+  double t;
+  int n = 1000000;
+  int repeat = 5;
+  int ch;
+
+  bench_init();
+  /* keep "No messages matched criteria." out of the results */
+  mutt_error = mutt_message = quiet_message;
+
+  while ((ch = getopt(argc, argv, "n:r:")) != -1)
+  {
+    switch (ch)
+    {
+      case 'n':
+        if (mutt_atoi(optarg, &n) < 0 || n <= 0)
+          usage(argv[0]);
+        break;
+      case 'r':
+        if (mutt_atoi(optarg, &repeat) < 0 || repeat <= 0)
+          usage(argv[0]);
+        break;
+      default:
+        usage(argv[0]);
+    }
+  }
+
+  memset(&ctx, 0, sizeof(ctx));
+  ctx.quiet = true;
+  ctx.readonly = true;
+  Context = &ctx;
+
+  printf("sizeof(HEADER) = %d\n", (int) sizeof(HEADER));
+  t = bench_now();
+  fill_mailbox(&ctx, n);
+  printf("Generated %d messages in %.1f ms\n", n, (bench_now() - t) * 1000);
+  date_range(&ctx, range, sizeof(range));
+
+  SortAux = SORT_ORDER;
+  printf("mutt_sort_headers():\n");
+  bench_sort(&ctx, "date", SORT_DATE, repeat);
+  bench_sort(&ctx, "received", SORT_RECEIVED, repeat);
+  bench_sort(&ctx, "score", SORT_SCORE, repeat);
+  bench_sort(&ctx, "from", SORT_FROM, repeat);
+  bench_sort(&ctx, "threads", SORT_THREADS, repeat);
+
+  Sort = SORT_DATE;
+  mutt_sort_headers(&ctx, 1);
+  printf("mutt_pattern_func(MUTT_LIMIT):\n");
+  bench_limit(&ctx, "~A", repeat);
+  bench_limit(&ctx, "~F", repeat);
+  bench_limit(&ctx, "~N", repeat);
+  bench_limit(&ctx, "~n 90-", repeat);
+  bench_limit(&ctx, range, repeat);
+  bench_limit(&ctx, "~f user42@", repeat);
+
+  Context = NULL;
+  mx_fastclose_mailbox(&ctx);
+  return 0;
+}
@@ -187,6 +187,13 @@ static void cmd_parse_expunge(IMAP_DATA *idata, const char *s)
       h->index--;
   }
 
+  if (idata->loadcount)
+  {
+    idata->loadcount--;
+    if (expno <= idata->loadfirst)
+      idata->loadfirst--;
+  }
+
   idata->reopen |= IMAP_EXPUNGE_PENDING;
 }
 
@@ -203,7 +210,8 @@ static void cmd_parse_fetch(IMAP_DATA *idata, char *s)
 
   msgno = atoi(s);
 
-  if (msgno <= idata->ctx->msgcount)
+  /* a mailbox still loading has read its newest messages first */
+  if ((msgno <= idata->ctx->msgcount) || idata->loadcount)
     /* see cmd_parse_expunge */
     for (cur = 0; cur < idata->ctx->msgcount; cur++)
     {
@@ -673,7 +681,15 @@ static int cmd_handle_untagged(IMAP_DATA *idata)
       /* new mail arrived */
       count = atoi(pn);
 
-      if (!(idata->reopen & IMAP_EXPUNGE_PENDING) && count < idata->ctx->msgcount)
+      if (idata->loadcount)
+      {
+        /* the mailbox is still being read, the new messages are read with
+         * the others (see imap_load_mailbox) */
+        mutt_debug(2, "cmd_handle_untagged: %d messages total, still loading\n",
+                   count);
+        idata->loadcount = count;
+      }
+      else if (!(idata->reopen & IMAP_EXPUNGE_PENDING) && count < idata->ctx->msgcount)
       {
         /* Notes 6.0.3 has a tendency to report fewer messages exist than
          * it should. */
@@ -277,7 +277,7 @@ void imap_expunge_mailbox(IMAP_DATA *idata)
 
       int_hash_delete(idata->uid_hash, HEADER_DATA(h)->uid, h, NULL);
 
-      imap_free_header_data((IMAP_HEADER_DATA **) &h->data);
+      imap_free_header_data((IMAP_HEADER_DATA **) &h->cold->data);
     }
   }
 
@@ -556,6 +556,7 @@ static int imap_open_mailbox(CONTEXT *ctx)
   char buf[LONG_STRING];
   char bufout[LONG_STRING];
   int count = 0;
+  int first;
   IMAP_MBOX mx, pmx;
   int rc;
 
@@ -593,6 +594,8 @@ static int imap_open_mailbox(CONTEXT *ctx)
   idata->status = false;
   memset(idata->ctx->rights, 0, sizeof(idata->ctx->rights));
   idata->newMailCount = 0;
+  idata->loadcount = 0;
+  idata->loadfirst = 0;
 
   mutt_message(_("Selecting %s..."), idata->mailbox);
   imap_munge_mbox_name(idata, buf, sizeof(buf), idata->mailbox);
@@ -741,23 +744,39 @@ static int imap_open_mailbox(CONTEXT *ctx)
         mutt_bit_isset(idata->ctx->rights, MUTT_ACL_INSERT)))
     ctx->readonly = true;
 
-  ctx->hdrmax = count;
-  ctx->hdrs = safe_calloc(count, sizeof(HEADER *));
-  ctx->v2r = safe_calloc(count, sizeof(int));
   ctx->msgcount = 0;
+  mx_reserve_memory(ctx, count);
 
-  if (count && (imap_read_headers(idata, 0, count - 1) < 0))
+  /* only read the newest headers of a large mailbox, the index asks for the
+   * others with imap_load_mailbox() */
+  first = 0;
+  if (ctx->progressive && (ImapProgressiveOpen > 0) &&
+      (count > ImapProgressiveOpen))
+  {
+    first = count - ImapProgressiveOpen;
+    idata->loadcount = count;
+  }
+  idata->loadfirst = first;
+
+  if ((count > first) && (imap_read_headers(idata, first, count - 1) < 0))
   {
     mutt_error(_("Error opening mailbox"));
     mutt_sleep(1);
     goto fail;
   }
 
+  if (idata->loadfirst || (ctx->msgcount < idata->loadcount))
+    ctx->loading = true;
+  else
+    idata->loadcount = 0;
+
   mutt_debug(2, "imap_open_mailbox: msgcount is %d\n", ctx->msgcount);
   FREE(&mx.mbox);
   return 0;
 
 fail:
+  idata->loadcount = 0;
+  idata->loadfirst = 0;
   if (idata->state == IMAP_SELECTED)
     idata->state = IMAP_AUTHENTICATED;
 fail_noidata:
@@ -765,6 +784,79 @@ fail_noidata:
   return -1;
 }
 
+/**
+ * imap_load_mailbox - Read the next headers of a mailbox opened progressively
+ * @ctx: Mailbox
+ * @retval  0 Success
+ * @retval -1 Error
+ *
+ * The messages read so far are the ones numbered loadfirst + 1 to
+ * loadfirst + msgcount.  Mail which arrived since the mailbox was opened is
+ * read first, then the older messages, newest first.  Reads up to
+ * $imap_progressive_open headers, or all the remaining ones if the variable
+ * was reset since the mailbox was opened.
+ */
+static int imap_load_mailbox(CONTEXT *ctx)
+{
+  IMAP_DATA *idata = ctx->data;
+  int oldcount = ctx->msgcount;
+  int first, last;
+  int rc = 0;
+
+  /* the headers must be renumbered first.  The index rethreads them when it
+   * next checks the mailbox, see imap_check() */
+  if (idata->reopen & IMAP_EXPUNGE_PENDING)
+  {
+    imap_allow_reopen(ctx);
+    imap_cmd_finish(idata);
+    imap_disallow_reopen(ctx);
+    if (!(idata->reopen & IMAP_EXPUNGE_PENDING))
+      return 0;
+
+    idata->loadcount = 0;
+    idata->loadfirst = 0;
+    ctx->loading = false;
+    return -1;
+  }
+
+  if (idata->loadfirst + ctx->msgcount < idata->loadcount)
+  {
+    first = idata->loadfirst + ctx->msgcount;
+    last = idata->loadcount - 1;
+    if ((ImapProgressiveOpen > 0) && (last - first >= ImapProgressiveOpen))
+      last = first + ImapProgressiveOpen - 1;
+  }
+  else
+  {
+    last = (int) idata->loadfirst - 1;
+    first = 0;
+    if ((ImapProgressiveOpen > 0) && (last >= ImapProgressiveOpen))
+      first = last - ImapProgressiveOpen + 1;
+  }
+
+  if ((last >= first) && (imap_read_headers(idata, first, last) < 0))
+  {
+    mutt_error(_("Error opening mailbox"));
+    mutt_sleep(1);
+    rc = -1;
+  }
+  else if (first < (int) idata->loadfirst)
+    idata->loadfirst -= ctx->msgcount - oldcount;
+
+  /* stop when done, and don't loop over headers the server won't send */
+  if ((rc < 0) ||
+      ((ctx->msgcount == oldcount) && !(idata->reopen & IMAP_EXPUNGE_PENDING)) ||
+      (!idata->loadfirst && (ctx->msgcount >= idata->loadcount)))
+  {
+    idata->loadcount = 0;
+    idata->loadfirst = 0;
+    ctx->loading = false;
+  }
+
+  mutt_debug(2, "imap_load_mailbox: msgcount is %d\n", ctx->msgcount);
+  return rc;
+}
+
 static int imap_open_mailbox_append(CONTEXT *ctx, int flags)
 {
   IMAP_DATA *idata = NULL;
@@ -1031,7 +1123,7 @@ out:
 /* returns 0 if mutt's flags match cached server flags */
 static bool compare_flags(HEADER *h)
 {
-  IMAP_HEADER_DATA *hd = (IMAP_HEADER_DATA *) h->data;
+  IMAP_HEADER_DATA *hd = (IMAP_HEADER_DATA *) h->cold->data;
 
   if (h->read != hd->read)
     return true;
@@ -1366,6 +1458,8 @@ int imap_close_mailbox(CONTEXT *ctx)
     }
 
     idata->reopen &= IMAP_REOPEN_ALLOW;
+    idata->loadcount = 0;
+    idata->loadfirst = 0;
     FREE(&(idata->mailbox));
     mutt_free_list(&idata->flags);
     idata->ctx = NULL;
@@ -1374,8 +1468,8 @@ int imap_close_mailbox(CONTEXT *ctx)
   /* free IMAP part of headers */
   for (i = 0; i < ctx->msgcount; i++)
     /* mailbox may not have fully loaded */
-    if (ctx->hdrs[i] && ctx->hdrs[i]->data)
-      imap_free_header_data((IMAP_HEADER_DATA **) &(ctx->hdrs[i]->data));
+    if (ctx->hdrs[i] && ctx->hdrs[i]->cold->data)
+      imap_free_header_data((IMAP_HEADER_DATA **) &(ctx->hdrs[i]->cold->data));
   hash_destroy(&idata->uid_hash, NULL);
 
   for (i = 0; i < IMAP_CACHE_LEN; i++)
@@ -1392,6 +1486,68 @@ int imap_close_mailbox(CONTEXT *ctx)
   return 0;
 }
 
+#ifdef USE_HCACHE
+/* imap_compact_hcache: drop the cached headers of expunged messages */
+static int imap_compact_hcache(CONTEXT *ctx, bool force, long *reclaimed)
+{
+  IMAP_DATA *idata = ctx->data;
+  header_cache_t *hc = NULL;
+  HASH *keys = NULL;
+  char key[16];
+  int i, rc;
+
+  if (!idata || ctx != idata->ctx)
+    return -1;
+
+  hc = imap_hcache_open(idata, NULL);
+  if (!hc)
+    return -1;
+
+  /* the keys used by imap_hcache_put() and imap_read_headers() */
+  keys = hash_create(ctx->msgcount + 2, MUTT_HASH_STRDUP_KEYS);
+  hash_insert(keys, "/UIDVALIDITY", idata);
+  hash_insert(keys, "/UIDNEXT", idata);
+  hash_insert(keys, HCACHE_THREADS_KEY, idata);
+  for (i = 0; i < ctx->msgcount; i++)
+  {
+    /* don't lose the headers of a mailbox which didn't fully load */
+    if (!ctx->hdrs[i] || !ctx->hdrs[i]->cold->data)
+      break;
+    snprintf(key, sizeof(key), "/%u", HEADER_DATA(ctx->hdrs[i])->uid);
+    hash_insert(keys, key, ctx->hdrs[i]);
+  }
+
+  if (i == ctx->msgcount)
+    rc = mutt_hcache_compact(hc, mutt_hcache_keep_hash, keys, force, reclaimed);
+  else
+    rc = -1;
+
+  hash_destroy(&keys, NULL);
+  mutt_hcache_close(hc);
+  return rc;
+}
+
+static header_cache_t *imap_open_hcache(CONTEXT *ctx)
+{
+  IMAP_DATA *idata = ctx->data;
+
+  if (!idata || ctx != idata->ctx)
+    return NULL;
+  return imap_hcache_open(idata, NULL);
+}
+
+/* the key used by imap_hcache_put(), and the UIDVALIDITY of the mailbox,
+ * since the UIDs of another one can be the same */
+static int imap_hcache_key(CONTEXT *ctx, HEADER *h, char *buf, size_t buflen)
+{
+  IMAP_DATA *idata = ctx->data;
+
+  if (!h->cold->data)
+    return -1;
+  return snprintf(buf, buflen, "/%u:%u", HEADER_DATA(h)->uid, idata->uid_validity);
+}
+#endif
+
 /* use the NOOP or IDLE command to poll for new mail
  *
  * return values:
@@ -2168,4 +2324,10 @@ struct mx_ops mx_imap_ops = {
     .open_new_msg = imap_open_new_message,
     .check = imap_check_mailbox_reopen,
     .sync = NULL, /* imap syncing is handled by imap_sync_mailbox */
+#ifdef USE_HCACHE
+    .compact_hcache = imap_compact_hcache,
+    .open_hcache = imap_open_hcache,
+    .hcache_key = imap_hcache_key,
+#endif
+    .load = imap_load_mailbox,
 };
@@ -213,6 +213,8 @@ typedef struct
   unsigned short check_status;
   unsigned char reopen;
   unsigned int newMailCount;
+  unsigned int loadcount; /* messages to read, see imap_load_mailbox() */
+  unsigned int loadfirst; /* sequence number - 1 of the oldest message read */
   IMAP_CACHE cache[IMAP_CACHE_LEN];
   HASH *uid_hash;
   unsigned int uid_validity;
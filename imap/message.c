@@ -347,6 +347,39 @@ static void flush_buffer(char *buf, size_t *len, CONNECTION *conn)
   *len = 0;
 }
 
+/* make_fetch_set: put the sequence set of the messages msgno to msgend which
+ *   weren't restored from the header cache in set, and return the number of
+ *   the last one.  cached holds the restored headers from msgbegin on. */
+static int make_fetch_set(BUFFER *set, HEADER **cached, int ncached,
+                          int msgbegin, int msgno, int msgend)
+{
+  int first = -1, last = 0;
+
+  for (; (msgno <= msgend + 1) && (set->dptr - set->data < IMAP_MAX_CMDLEN); msgno++)
+  {
+    if ((msgno <= msgend) &&
+        !((msgno - msgbegin < ncached) && cached[msgno - msgbegin]))
+    {
+      if (first < 0)
+        first = msgno;
+      continue;
+    }
+    if (first < 0)
+      continue;
+
+    if (last)
+      mutt_buffer_addch(set, ',');
+    if (msgno - 1 > first)
+      mutt_buffer_printf(set, "%d:%d", first + 1, msgno);
+    else
+      mutt_buffer_printf(set, "%d", first + 1);
+    last = msgno;
+    first = -1;
+  }
+
+  return last;
+}
+
 /* imap_read_headers:
  * Changed to read many headers instead of just one. It will return the
  * msgno of the last message read. It will return a value other than
@@ -358,10 +391,12 @@ int imap_read_headers(IMAP_DATA *idata, int msgbegin, int msgend)
   char *hdrreq = NULL;
   FILE *fp = NULL;
   char tempfile[_POSIX_PATH_MAX];
-  int msgno, idx = msgbegin - 1;
+  int msgno, idx;
   IMAP_HEADER h;
   IMAP_STATUS *status = NULL;
-  int rc, mfhrc, oldmsgcount;
+  HEADER **cached = NULL; /* restored from the header cache, from msgbegin on */
+  int ncached = 0;
+  int rc, mfhrc, oldmsgcount, base;
   int fetchlast = 0;
   int maxuid = 0;
   static const char *const want_headers =
@@ -374,8 +409,7 @@ int imap_read_headers(IMAP_DATA *idata, int msgbegin, int msgend)
 #ifdef USE_HCACHE
   char buf[LONG_STRING];
   void *uid_validity = NULL;
-  void *puidnext = NULL;
-  unsigned int uidnext = 0;
+  HEADER *hdr = NULL;
   int evalhc = 0;
 #endif /* USE_HCACHE */
 
@@ -409,27 +443,26 @@ int imap_read_headers(IMAP_DATA *idata, int msgbegin, int msgend)
   }
   unlink(tempfile);
 
+  /* the headers are appended to the context, whatever their sequence numbers:
+   * a mailbox opened progressively reads its newest messages first */
+  oldmsgcount = ctx->msgcount;
+  base = oldmsgcount - msgbegin;
+  idx = oldmsgcount - 1;
+
   /* make sure context has room to hold the mailbox */
-  while ((msgend) >= idata->ctx->hdrmax)
-    mx_alloc_memory(idata->ctx);
+  mx_reserve_memory(idata->ctx, base + msgend + 1);
 
-  oldmsgcount = ctx->msgcount;
   idata->reopen &= ~(IMAP_REOPEN_ALLOW | IMAP_NEWMAIL_PENDING);
   idata->newMailCount = 0;
 
 #ifdef USE_HCACHE
   idata->hcache = imap_hcache_open(idata, NULL);
 
-  if (idata->hcache && !msgbegin)
+  /* a mailbox opened progressively evaluates the cache for each slice */
+  if (idata->hcache && ((!msgbegin && !oldmsgcount) || idata->loadcount))
   {
     uid_validity = mutt_hcache_fetch_raw(idata->hcache, "/UIDVALIDITY", 12);
-    puidnext = mutt_hcache_fetch_raw(idata->hcache, "/UIDNEXT", 8);
-    if (puidnext)
-    {
-      uidnext = *(unsigned int *) puidnext;
-      mutt_hcache_free(idata->hcache, &puidnext);
-    }
-    if (uid_validity && uidnext && *(unsigned int *) uid_validity == idata->uid_validity)
+    if (uid_validity && *(unsigned int *) uid_validity == idata->uid_validity)
       evalhc = 1;
     mutt_hcache_free(idata->hcache, &uid_validity);
   }
@@ -440,90 +473,86 @@ int imap_read_headers(IMAP_DATA *idata, int msgbegin, int msgend)
     mutt_progress_init(&progress, _("Evaluating cache..."), MUTT_PROGRESS_MSG,
                        ReadInc, msgend + 1);
 
-    snprintf(buf, sizeof(buf), "UID FETCH 1:%u (UID FLAGS)", uidnext - 1);
+    ncached = msgend - msgbegin + 1;
+    cached = safe_calloc(ncached, sizeof(HEADER *));
+    snprintf(buf, sizeof(buf), "FETCH %d:%d (UID FLAGS)", msgbegin + 1, msgend + 1);
 
     imap_cmd_start(idata, buf);
 
-    rc = IMAP_CMD_CONTINUE;
-    for (msgno = msgbegin; rc == IMAP_CMD_CONTINUE; msgno++)
+    /* the messages missing from the cache are fetched with the others below */
+    memset(&h, 0, sizeof(h));
+    mfhrc = 0;
+    msgno = msgbegin;
+    while ((rc = imap_cmd_step(idata)) == IMAP_CMD_CONTINUE)
     {
-      mutt_progress_update(&progress, msgno + 1, -1);
-
-      memset(&h, 0, sizeof(h));
-      h.data = safe_calloc(1, sizeof(IMAP_HEADER_DATA));
-      do
-      {
-        mfhrc = 0;
-
-        rc = imap_cmd_step(idata);
-        if (rc != IMAP_CMD_CONTINUE)
-        {
-          imap_free_header_data(&h.data);
-          break;
-        }
+      if (!h.data)
+        h.data = safe_calloc(1, sizeof(IMAP_HEADER_DATA));
 
-        /* hole in the header cache */
-        if (!evalhc)
-          continue;
+      if ((mfhrc = msg_fetch_header(ctx, &h, idata->buf, NULL)) == -1)
+        continue;
+      else if (mfhrc < 0)
+        break;
 
-        if ((mfhrc = msg_fetch_header(ctx, &h, idata->buf, NULL)) == -1)
-          continue;
-        else if (mfhrc < 0)
-        {
-          imap_free_header_data(&h.data);
-          break;
-        }
+      mutt_progress_update(&progress, ++msgno, -1);
 
-        if (!h.data->uid)
-        {
-          mutt_debug(2, "imap_read_headers: skipping hcache FETCH "
-                        "response for unknown message number %d\n",
-                     h.sid);
-          mfhrc = -1;
-          continue;
-        }
+      if (!h.data->uid || (h.sid <= msgbegin) || (h.sid > msgend + 1) ||
+          cached[h.sid - 1 - msgbegin])
+      {
+        mutt_debug(2, "imap_read_headers: skipping hcache FETCH "
+                      "response for unknown message number %d\n",
+                   h.sid);
+        imap_free_header_data(&h.data);
+        continue;
+      }
 
-        idx++;
-        ctx->hdrs[idx] = imap_hcache_get(idata, h.data->uid);
-        if (ctx->hdrs[idx])
-        {
-          ctx->hdrs[idx]->index = idx;
-          /* messages which have not been expunged are ACTIVE (borrowed from mh
-           * folders) */
-          ctx->hdrs[idx]->active = true;
-          ctx->hdrs[idx]->read = h.data->read;
-          ctx->hdrs[idx]->old = h.data->old;
-          ctx->hdrs[idx]->deleted = h.data->deleted;
-          ctx->hdrs[idx]->flagged = h.data->flagged;
-          ctx->hdrs[idx]->replied = h.data->replied;
-          ctx->hdrs[idx]->changed = h.data->changed;
-          /*  ctx->hdrs[msgno]->received is restored from mutt_hcache_restore */
-          ctx->hdrs[idx]->data = (void *) (h.data);
-
-          ctx->msgcount++;
-          ctx->size += ctx->hdrs[idx]->content->length;
-        }
-        else
-        {
-          /* bad header in the cache, we'll have to refetch. */
-          mutt_debug(3, "bad cache entry at %d, giving up\n", h.sid - 1);
-          imap_free_header_data(&h.data);
-          evalhc = 0;
-          idx--;
-        }
-      } while (rc != IMAP_CMD_OK && mfhrc == -1);
-      if (rc == IMAP_CMD_OK)
-        break;
-      if ((mfhrc < -1) || ((rc != IMAP_CMD_CONTINUE) && (rc != IMAP_CMD_OK)))
+      hdr = imap_hcache_get(idata, h.data->uid);
+      if (!hdr)
       {
+        mutt_debug(3, "no cache entry for message %d\n", h.sid);
         imap_free_header_data(&h.data);
-        imap_hcache_close(idata);
-        goto error_out_1;
+        continue;
       }
+
+      hdr->index = h.sid - 1;
+      /* messages which have not been expunged are ACTIVE (borrowed from mh
+       * folders) */
+      hdr->active = true;
+      hdr->read = h.data->read;
+      hdr->old = h.data->old;
+      hdr->deleted = h.data->deleted;
+      hdr->flagged = h.data->flagged;
+      hdr->replied = h.data->replied;
+      hdr->changed = h.data->changed;
+      /*  hdr->received is restored from mutt_hcache_restore */
+      hdr->cold->data = (void *) (h.data);
+      h.data = NULL;
+      cached[h.sid - 1 - msgbegin] = hdr;
+    }
+    imap_free_header_data(&h.data);
+    if ((mfhrc < -1) || (rc != IMAP_CMD_OK))
+    {
+      imap_hcache_close(idata);
+      goto error_out_1;
+    }
+
+    /* the sequence numbers have changed: imap_load_mailbox() reads the slice
+     * again once the expunge is processed */
+    if (idata->loadcount && (idata->reopen & IMAP_EXPUNGE_PENDING))
+    {
+      mutt_debug(2, "imap_read_headers: expunge while evaluating the cache\n");
+      msgbegin = msgend + 1;
+    }
+    /* the new messages aren't in cached, they are fetched below */
+    else if (idata->reopen & IMAP_NEWMAIL_PENDING)
+    {
+      msgend = idata->newMailCount - 1;
+      mx_reserve_memory(ctx, base + msgend + 1);
+      idata->reopen &= ~IMAP_NEWMAIL_PENDING;
+      idata->newMailCount = 0;
     }
-    /* could also look for first null header in case hcache is holey */
-    msgbegin = ctx->msgcount;
   }
+
+  mutt_hcache_begin(idata->hcache);
 #endif /* USE_HCACHE */
 
   mutt_progress_init(&progress, _("Fetching message headers..."),
@@ -533,15 +562,28 @@ int imap_read_headers(IMAP_DATA *idata, int msgbegin, int msgend)
   {
     mutt_progress_update(&progress, msgno + 1, -1);
 
+    /* keep the headers in the order of their sequence numbers */
+    if ((msgno - msgbegin < ncached) && cached[msgno - msgbegin])
+    {
+      idx++;
+      ctx->hdrs[idx] = cached[msgno - msgbegin];
+      cached[msgno - msgbegin] = NULL;
+      ctx->msgcount++;
+      ctx->size += ctx->hdrs[idx]->content->length;
+      continue;
+    }
+
     /* we may get notification of new mail while fetching headers */
     if (msgno + 1 > fetchlast)
     {
       char *cmd = NULL;
+      BUFFER *set = mutt_buffer_new();
 
-      fetchlast = msgend + 1;
-      safe_asprintf(&cmd, "FETCH %d:%d (UID FLAGS INTERNALDATE RFC822.SIZE %s)",
-                    msgno + 1, fetchlast, hdrreq);
+      fetchlast = make_fetch_set(set, cached, ncached, msgbegin, msgno, msgend);
+      safe_asprintf(&cmd, "FETCH %s (UID FLAGS INTERNALDATE RFC822.SIZE %s)",
+                    set->data, hdrreq);
       imap_cmd_start(idata, cmd);
+      mutt_buffer_free(&set);
       FREE(&cmd);
     }
 
@@ -579,7 +621,7 @@ int imap_read_headers(IMAP_DATA *idata, int msgbegin, int msgend)
       fputs("\n\n", fp);
 
       idx++;
-      if (idx > msgend)
+      if (idx > base + msgend)
       {
         mutt_debug(1, "imap_read_headers: skipping FETCH response for "
                       "unknown message number %d\n",
@@ -609,7 +651,7 @@ int imap_read_headers(IMAP_DATA *idata, int msgbegin, int msgend)
       ctx->hdrs[idx]->replied = h.data->replied;
       ctx->hdrs[idx]->changed = h.data->changed;
       ctx->hdrs[idx]->received = h.received;
-      ctx->hdrs[idx]->data = (void *) (h.data);
+      ctx->hdrs[idx]->cold->data = (void *) (h.data);
 
       if (maxuid < h.data->uid)
         maxuid = h.data->uid;
@@ -642,8 +684,7 @@ int imap_read_headers(IMAP_DATA *idata, int msgbegin, int msgend)
     if (idata->reopen & IMAP_NEWMAIL_PENDING)
     {
       msgend = idata->newMailCount - 1;
-      while ((msgend) >= ctx->hdrmax)
-        mx_alloc_memory(ctx);
+      mx_reserve_memory(ctx, base + msgend + 1);
       idata->reopen &= ~IMAP_NEWMAIL_PENDING;
       idata->newMailCount = 0;
     }
@@ -665,12 +706,15 @@ int imap_read_headers(IMAP_DATA *idata, int msgbegin, int msgend)
     mutt_hcache_store_raw(idata->hcache, "/UIDNEXT", 8, &idata->uidnext,
                           sizeof(idata->uidnext));
 
+  mutt_hcache_commit(idata->hcache);
   imap_hcache_close(idata);
 #endif /* USE_HCACHE */
 
   if (ctx->msgcount > oldmsgcount)
   {
-    mx_alloc_memory(ctx);
+    /* keep a free slot */
+    if (ctx->msgcount == ctx->hdrmax)
+      mx_alloc_memory(ctx);
     mx_update_context(ctx, ctx->msgcount - oldmsgcount);
     imap_update_context(idata, oldmsgcount);
   }
@@ -680,6 +724,14 @@ int imap_read_headers(IMAP_DATA *idata, int msgbegin, int msgend)
   retval = msgend;
 
 error_out_1:
+  for (idx = 0; idx < ncached; idx++)
+  {
+    if (!cached[idx])
+      continue;
+    imap_free_header_data((IMAP_HEADER_DATA **) &cached[idx]->cold->data);
+    mutt_free_header(&cached[idx]);
+  }
+  FREE(&cached);
   safe_fclose(&fp);
 
 error_out_0:
@@ -702,6 +754,7 @@ int imap_fetch_message(CONTEXT *ctx, MESSAGE *msg, int msgno)
   int cacheno;
   IMAP_CACHE *cache = NULL;
   bool read;
+  bool old;
   int rc;
 
   /* Sam's weird courier server returns an OK response even when FETCH
@@ -856,11 +909,15 @@ parsemsg:
    * picked up in mutt_read_rfc822_header, we mark the message (and context
    * changed). Another possibility: ignore Status on IMAP? */
   read = h->read;
+  old = h->old;
   newenv = mutt_read_rfc822_header(msg->fp, h, 0, 0);
   mutt_merge_envelopes(h->env, &newenv);
 
   /* see above. We want the new status in h->read, so we unset it manually
-   * and let mutt_set_flag set it correctly, updating context. */
+   * and let mutt_set_flag set it correctly, updating context.  The Status
+   * header may have changed h->old too, behind the back of the unread
+   * counts of the thread: the server's notion wins. */
+  h->old = old;
   if (read != h->read)
   {
     h->read = read;
@@ -1290,7 +1347,7 @@ char *imap_set_flags(IMAP_DATA *idata, HEADER *h, char *s)
   bool readonly;
 
   memset(&newh, 0, sizeof(newh));
-  hd = h->data;
+  hd = h->cold->data;
   newh.data = hd;
 
   mutt_debug(2, "imap_fetch_message: parsing FLAGS\n");
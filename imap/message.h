@@ -50,6 +50,6 @@ typedef struct
 } IMAP_HEADER;
 
 /* -- macros -- */
-#define HEADER_DATA(ph) ((IMAP_HEADER_DATA *) ((ph)->data))
+#define HEADER_DATA(ph) ((IMAP_HEADER_DATA *) ((ph)->cold->data))
 
 #endif /* _MUTT_IMAP_MESSAGE_H */
@@ -41,6 +41,8 @@
 #include "mutt_regex.h"
 #include "mx.h"
 #include "myvar.h"
+#include "pager.h"
+#include "stats.h"
 #include "version.h"
 #ifdef USE_SSL
 #include "mutt_ssl.h"
@@ -785,6 +787,97 @@ static int finish_source(BUFFER *tmp, BUFFER *s, unsigned long data, BUFFER *err
   return 1;
 }
 
+#ifdef USE_HCACHE
+/**
+ * parse_hcache_compact - 'hcache-compact' command
+ * @tmp:  Temporary space shared by all command handlers
+ * @s:    Current line of the config file
+ * @data: data field from init.h:struct command_t
+ * @err:  Buffer for any error message
+ * @retval  0 Success
+ * @retval -1 Failed
+ *
+ * Drop the cached headers of the messages which are no longer in the current
+ * mailbox and compact its header cache database.
+ */
+static int parse_hcache_compact(BUFFER *tmp, BUFFER *s, unsigned long data, BUFFER *err)
+{
+  char size[SHORT_STRING];
+  long reclaimed = 0;
+  int dropped;
+
+  if (MoreArgs(s))
+  {
+    snprintf(err->data, err->dsize, _("hcache-compact: too many arguments"));
+    return -1;
+  }
+
+  if (!Context)
+  {
+    snprintf(err->data, err->dsize, _("No mailbox is open."));
+    return -1;
+  }
+
+  dropped = mx_compact_hcache(Context, true, &reclaimed);
+  if (dropped < 0)
+  {
+    snprintf(err->data, err->dsize, _("hcache-compact: no header cache for this mailbox"));
+    return -1;
+  }
+
+  mutt_pretty_size(size, sizeof(size), (reclaimed > 0) ? reclaimed : 0);
+  mutt_message(_("Dropped %d cached headers, reclaimed %s."), dropped, size);
+  return 0;
+}
+#endif
+
+/**
+ * parse_stats - 'stats' command
+ * @tmp:  Temporary space shared by all command handlers
+ * @s:    Current line of the config file
+ * @data: data field from init.h:struct command_t
+ * @err:  Buffer for any error message
+ * @retval  0 Success
+ * @retval -1 Failed
+ *
+ * Show the timings and counters of the mailbox operations in the pager, or
+ * forget them with 'stats reset'.
+ */
+static int parse_stats(BUFFER *tmp, BUFFER *s, unsigned long data, BUFFER *err)
+{
+  char tempfile[_POSIX_PATH_MAX];
+  FILE *fp = NULL;
+
+  if (MoreArgs(s))
+  {
+    mutt_extract_token(tmp, s, 0);
+    if ((mutt_strcmp(tmp->data, "reset") != 0) || MoreArgs(s))
+    {
+      snprintf(err->data, err->dsize, _("Usage: stats [reset]"));
+      return -1;
+    }
+    mutt_stats_reset();
+    return 0;
+  }
+
+  if (option(OPTNOCURSES))
+  {
+    mutt_stats_report(stdout);
+    return 0;
+  }
+
+  mutt_mktemp(tempfile, sizeof(tempfile));
+  if (!(fp = safe_fopen(tempfile, "w")))
+  {
+    snprintf(err->data, err->dsize, _("Could not create temporary file %s"), tempfile);
+    return -1;
+  }
+  mutt_stats_report(fp);
+  safe_fclose(&fp);
+  mutt_do_pager(_("Statistics"), tempfile, 0, NULL);
+  return 0;
+}
+
 /**
  * parse_ifdef - 'ifdef' command: conditional config
  * @tmp:  Temporary space shared by all command handlers
@@ -1206,6 +1299,8 @@ static int parse_lists(BUFFER *buf, BUFFER *s, unsigned long data, BUFFER *err)
 {
   group_context_t *gc = NULL;
 
+  MailListsSerial++; /* forget the cached results of mutt_is_mail_list() */
+
   do
   {
     mutt_extract_token(buf, s, 0);
@@ -1585,6 +1680,7 @@ static int parse_unattachments(BUFFER *buf, BUFFER *s, unsigned long data, BUFFE
 
 static int parse_unlists(BUFFER *buf, BUFFER *s, unsigned long data, BUFFER *err)
 {
+  MailListsSerial++;
   do
   {
     mutt_extract_token(buf, s, 0);
@@ -1603,6 +1699,8 @@ static int parse_subscribe(BUFFER *buf, BUFFER *s, unsigned long data, BUFFER *e
 {
   group_context_t *gc = NULL;
 
+  MailListsSerial++;
+
   do
   {
     mutt_extract_token(buf, s, 0);
@@ -1631,6 +1729,7 @@ bail:
 
 static int parse_unsubscribe(BUFFER *buf, BUFFER *s, unsigned long data, BUFFER *err)
 {
+  MailListsSerial++;
   do
   {
     mutt_extract_token(buf, s, 0);
@@ -1081,14 +1081,22 @@ struct option_t MuttVars[] = {
   ** be a single global header cache. By default it is \fIunset\fP so no header
   ** caching will be used.
   ** .pp
-  ** Header caching can greatly improve speed when opening POP, IMAP
-  ** MH or Maildir folders, see ``$caching'' for details.
+  ** Header caching can greatly improve speed when opening POP, IMAP,
+  ** MH, Maildir, mbox or MMDF folders, see ``$caching'' for details.
   */
   { "header_cache_backend", DT_HCACHE, R_NONE, UL &HeaderCacheBackend, UL 0 },
   /*
   ** .pp
   ** This variable specifies the header cache backend.
   */
+  { "header_cache_compact", DT_BOOL, R_NONE, OPTHCACHECOMPACT, 0 },
+  /*
+  ** .pp
+  ** When \fIset\fP, closing a folder drops the cached headers of the
+  ** messages which are no longer in it and, if any were dropped, compacts
+  ** the header cache database. The same can be done at any time with the
+  ** \fChcache-compact\fP command.
+  */
 #if defined(HAVE_QDBM) || defined(HAVE_TC) || defined(HAVE_KC)
   { "header_cache_compress", DT_BOOL, R_NONE, OPTHCACHECOMPRESS, 1 },
   /*
@@ -1102,6 +1110,35 @@ struct option_t MuttVars[] = {
   ** cached folders.
   */
 #endif /* HAVE_QDBM */
+#ifdef HAVE_ZLIB
+  { "header_cache_compress_level", DT_NUM, R_NONE, UL &HeaderCacheCompressLevel, 1 },
+  /*
+  ** .pp
+  ** The zlib compression level, from 1 (fastest) to 9 (smallest), used
+  ** for the header cache records when $$header_cache_zlib is \fIset\fP.
+  */
+#endif /* HAVE_ZLIB */
+  { "header_cache_lazy", DT_BOOL, R_NONE, OPTHCACHELAZY, 0 },
+  /*
+  ** .pp
+  ** When \fIset\fP, only the parts of the cached headers needed to display,
+  ** sort, limit and thread the index are restored when a folder is opened.
+  ** The remaining fields (e.g. the Return-Path, Mail-Followup-To and user
+  ** defined headers) are restored the first time a message is opened,
+  ** replied to or copied. This makes opening large cached folders faster
+  ** at the cost of a little extra memory per message.
+  */
+  { "header_cache_memory", DT_NUM, R_NONE, UL &HeaderCacheMemory, 0 },
+  /*
+  ** .pp
+  ** The amount of memory, in megabytes, used to keep the most recently
+  ** fetched header cache records, so that going back to a folder opened
+  ** a short while ago does not need to read them from the database again.
+  ** A record takes about 1K, and a folder larger than this cache gets no
+  ** benefit from it. The records are checked against the modification
+  ** time, in seconds, and the size of the database only. The default, 0,
+  ** disables this memory cache.
+  */
 #if defined(HAVE_GDBM) || defined(HAVE_BDB)
   { "header_cache_pagesize", DT_STR, R_NONE, UL &HeaderCachePageSize, UL "16384" },
   /*
@@ -1112,6 +1149,19 @@ struct option_t MuttVars[] = {
   ** or less optimal for most use cases.
   */
 #endif /* HAVE_GDBM || HAVE_BDB */
+#ifdef HAVE_ZLIB
+  { "header_cache_zlib", DT_BOOL, R_NONE, OPTHCACHEZLIB, 0 },
+  /*
+  ** .pp
+  ** When \fIset\fP, mutt compresses each cached header on its own with
+  ** zlib, using the level set by $$header_cache_compress_level. This
+  ** shrinks the database to about half its size, at the cost of some CPU
+  ** time for every header stored or fetched. The backends which compress
+  ** the whole database themselves when $$header_cache_compress is
+  ** \fIset\fP are left to do so. Records written either way can be read
+  ** back regardless of the current value of this option.
+  */
+#endif /* HAVE_ZLIB */
 #endif /* USE_HCACHE */
   { "help",             DT_BOOL, R_REFLOW, OPTHELP, 1 },
   /*
@@ -1380,6 +1430,17 @@ struct option_t MuttVars[] = {
   ** .pp
   ** \fBNote:\fP Changes to this variable have no effect on open connections.
   */
+  { "imap_progressive_open", DT_NUM, R_NONE, UL &ImapProgressiveOpen, 0 },
+  /*
+  ** .pp
+  ** When set to a value greater than zero, mutt shows the index of a large
+  ** IMAP mailbox as soon as the headers of this many messages have been
+  ** read, and fetches the remaining headers, this many at a time, while you
+  ** are not typing.  The most recent messages are read first, and the
+  ** older ones are added to the index as they are read.
+  ** .pp
+  ** When set to 0, the whole mailbox is read before the index is shown.
+  */
   { "imap_servernoise",         DT_BOOL, R_NONE, OPTIMAPSERVERNOISE, 1 },
   /*
   ** .pp
@@ -1525,6 +1586,15 @@ struct option_t MuttVars[] = {
   ** Note that these expandos are supported in
   ** ``$save-hook'', ``$fcc-hook'' and ``$fcc-save-hook'', too.
   */
+  { "index_sort_threads", DT_NUM, R_NONE, UL &IndexSortThreads, 0 },
+  /*
+  ** .pp
+  ** The number of threads used to sort the index of a large mailbox by any
+  ** $$sort method but \fIthreads\fP. A value of 0 uses one thread per
+  ** processor, up to 16. A value of 1 sorts on the calling thread only, as
+  ** does a build without thread support. Mailboxes of less than 50000
+  ** messages are always sorted on one thread.
+  */
 #ifdef USE_NNTP
   { "inews",            DT_PATH, R_NONE, UL &Inews, UL "" },
   /*
@@ -1640,6 +1710,15 @@ struct option_t MuttVars[] = {
   ** folders).
   */
 #endif
+  { "maildir_parse_threads", DT_NUM, R_NONE, UL &MaildirParseThreads, 0 },
+  /*
+  ** .pp
+  ** The number of threads used to read and parse the messages of a Maildir
+  ** or MH folder which are not in the header cache, e.g. when a large folder
+  ** is opened for the first time. A value of 0 uses one thread per
+  ** processor, up to 16. A value of 1 parses the messages one after the
+  ** other, as does a build without thread support.
+  */
   { "maildir_trash", DT_BOOL, R_NONE, OPTMAILDIRTRASH, 0 },
   /*
   ** .pp
@@ -1697,6 +1776,44 @@ struct option_t MuttVars[] = {
   ** .pp
   ** Also see the $$move variable.
   */
+#ifdef USE_MMAP
+  { "mbox_mmap",        DT_BOOL, R_NONE, OPTMBOXMMAP, 0 },
+  /*
+  ** .pp
+  ** When \fIset\fP, mbox folders are read through a memory map: the message
+  ** separators are searched for in the mapped file and the headers are
+  ** parsed from it, instead of reading the folder line by line. This is
+  ** much faster for large folders.
+  ** .pp
+  ** \fBNote:\fP if another program truncates the folder while it is being
+  ** read, mutt is killed by a SIGBUS signal, where reading line by line
+  ** would only report an error. Only set this if nothing else shortens your
+  ** mbox folders behind mutt's back, and not on network filesystems.
+  */
+#endif
+  { "mbox_pad_status",  DT_BOOL, R_NONE, OPTMBOXPADSTATUS, 0 },
+  /*
+  ** .pp
+  ** When \fIset\fP, the ``Status:'' and ``X-Status:'' header fields of the
+  ** messages written to mbox and MMDF folders are always present and padded
+  ** to a fixed width. When only the flags of such a message are changed,
+  ** e.g. when it is read, the folder is then updated in place instead of
+  ** being rewritten from that message to its end.
+  ** .pp
+  ** This applies to the messages saved to a folder and to those rewritten
+  ** when it is synchronized, not to the messages delivered to it by other
+  ** programs.
+  */
+  { "mbox_parse_threads", DT_NUM, R_NONE, UL &MboxParseThreads, 0 },
+  /*
+  ** .pp
+  ** The number of threads used to parse the headers of an mbox folder
+  ** when it is read through a memory map (see $$mbox_mmap). The message
+  ** separators are found first, then the headers are parsed concurrently. A
+  ** value of 0 uses one thread per processor, up to 16. A value of 1 parses
+  ** the messages one after the other, as does a build without thread
+  ** support.
+  */
   { "mbox_type",        DT_MAGIC,R_NONE, UL &DefaultMagic, MUTT_MBOX },
   /*
   ** .pp
@@ -3831,6 +3948,22 @@ struct option_t MuttVars[] = {
   ** required.)
   */
 #endif /* defined(USE_SSL) */
+  { "stats_file",       DT_PATH, R_NONE, UL &StatsFile, 0 },
+  /*
+  ** .pp
+  ** When set, mutt writes the statistics of the session to this file when it
+  ** exits: the time spent opening, checking, writing, sorting and limiting
+  ** mailboxes, and counters such as the header cache hits.  The same report
+  ** is shown by the ``stats'' command.
+  */
+  { "stats_trace_file", DT_PATH, R_NONE, UL &StatsTraceFile, 0 },
+  /*
+  ** .pp
+  ** When set, mutt records each mailbox operation timed for the
+  ** ``stats'' command in this file, as a Chrome trace event.  The file can be
+  ** opened with chrome://tracing or https://ui.perfetto.dev to see where
+  ** the time goes.  It is overwritten when mutt starts writing to it.
+  */
   { "status_chars",     DT_MBCHARTBL, R_BOTH, UL &StChars, UL "-*%A" },
   /*
   ** .pp
@@ -4419,6 +4552,10 @@ static int parse_subjectrx_list(BUFFER *, BUFFER *, unsigned long, BUFFER *);
 static int parse_unsubjectrx_list(BUFFER *, BUFFER *, unsigned long, BUFFER *);
 static int parse_alternates(BUFFER *, BUFFER *, unsigned long, BUFFER *);
 static int parse_unalternates(BUFFER *, BUFFER *, unsigned long, BUFFER *);
+#ifdef USE_HCACHE
+static int parse_hcache_compact(BUFFER *, BUFFER *, unsigned long, BUFFER *);
+#endif
+static int parse_stats(BUFFER *, BUFFER *, unsigned long, BUFFER *);
 
 /* Parse -group arguments */
 static int parse_group_context(group_context_t **ctx, BUFFER *buf, BUFFER *s,
@@ -4456,6 +4593,9 @@ const struct command_t Commands[] = {
   { "append-hook",      mutt_parse_hook,        MUTT_APPENDHOOK },
 #endif
   { "group",            parse_group,            MUTT_GROUP },
+#ifdef USE_HCACHE
+  { "hcache-compact",   parse_hcache_compact,   0 },
+#endif
   { "ungroup",          parse_group,            MUTT_UNGROUP },
   { "hdr_order",        parse_list,             UL &HeaderOrderList },
   { "ifdef",            parse_ifdef,            0 },
@@ -4505,6 +4645,7 @@ const struct command_t Commands[] = {
   { "nospam",           parse_spam_list,        MUTT_NOSPAM },
   { "shutdown-hook",    mutt_parse_hook,        MUTT_SHUTDOWNHOOK | MUTT_GLOBALHOOK },
   { "startup-hook",     mutt_parse_hook,        MUTT_STARTUPHOOK | MUTT_GLOBALHOOK },
+  { "stats",            parse_stats,            0 },
   { "subscribe",        parse_subscribe,        0 },
   { "subjectrx",        parse_subjectrx_list,   UL &SubjectRxList },
   { "unsubjectrx",      parse_unsubjectrx_list, UL &SubjectRxList },
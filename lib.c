@@ -870,13 +870,18 @@ size_t mutt_quote_filename(char *d, size_t l, const char *f)
 
 /* NULL-pointer aware string comparison functions */
 
+/* interned strings (see mx_intern()) are equal when they are the same */
 int mutt_strcmp(const char *a, const char *b)
 {
+  if (a == b)
+    return 0;
   return strcmp(NONULL(a), NONULL(b));
 }
 
 int mutt_strcasecmp(const char *a, const char *b)
 {
+  if (a == b)
+    return 0;
   return strcasecmp(NONULL(a), NONULL(b));
 }
 
@@ -1028,15 +1033,19 @@ void mutt_debug(int level, const char *fmt, ...)
   if (debuglevel < level || !debugfile)
     return;
 
+  /* the stream lock also guards buf and last against concurrent callers */
+  flockfile(debugfile);
   if (now > last)
   {
-    strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", localtime(&now));
+    struct tm tm;
+    strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", localtime_r(&now, &tm));
     last = now;
   }
   fprintf(debugfile, "[%s] ", buf);
   va_start(ap, fmt);
   vfprintf(debugfile, fmt, ap);
   va_end(ap);
+  funlockfile(debugfile);
 }
 #endif
 
@@ -29,6 +29,8 @@
 #define MUTT_PEEK      (1 << 5) /* revert atime back after taking a look (if applicable) */
 #define MUTT_APPENDNEW (1 << 6) /* set in mx_open_mailbox_append if the mailbox doesn't
                                  * exist. used by maildir/mh to create the mailbox. */
+#define MUTT_PROGRESSIVE (1 << 7) /* the headers may be read after the mailbox is
+                                   * opened, see mx_load_mailbox() */
 
 /* mx_open_new_message() */
 #define MUTT_ADD_FROM  (1 << 0) /* add a From_ line */
@@ -40,7 +42,8 @@ enum
   MUTT_NEW_MAIL = 1, /* new mail received in mailbox */
   MUTT_LOCKED,       /* couldn't lock the mailbox */
   MUTT_REOPENED,     /* mailbox was reopened */
-  MUTT_FLAGS         /* nondestructive flags change (IMAP) */
+  MUTT_FLAGS,        /* nondestructive flags change (IMAP) */
+  MUTT_LOADED        /* more headers read, see mx_load_mailbox() */
 };
 
 typedef struct _message
@@ -73,6 +76,7 @@ int mx_close_message(CONTEXT *ctx, MESSAGE **msg);
 int mx_get_magic(const char *path);
 int mx_set_magic(const char *s);
 int mx_check_mailbox(CONTEXT *ctx, int *index_hint);
+int mx_load_mailbox(CONTEXT *ctx);
 #ifdef USE_IMAP
 bool mx_is_imap(const char *p);
 #endif
@@ -33,6 +33,7 @@
 #include "mutt_crypt.h"
 #include "mutt_curses.h"
 #include "mutt_idna.h"
+#include "stats.h"
 #include "url.h"
 #include "version.h"
 #ifdef USE_SIDEBAR
@@ -890,7 +891,8 @@ int main(int argc, char **argv, char **environ)
     mutt_startup_shutdown_hook(MUTT_STARTUPHOOK);
 
     if ((Context = mx_open_mailbox(
-             folder, ((flags & MUTT_RO) || option(OPTREADONLY)) ? MUTT_READONLY : 0, NULL)) ||
+             folder, (((flags & MUTT_RO) || option(OPTREADONLY)) ? MUTT_READONLY : 0) | MUTT_PROGRESSIVE,
+             NULL)) ||
         !explicit_folder)
     {
 #ifdef USE_SIDEBAR
@@ -906,6 +908,7 @@ int main(int argc, char **argv, char **environ)
 #ifdef USE_SASL
     mutt_sasl_done();
 #endif
+    mutt_stats_finish();
     mutt_free_opts();
     mutt_free_windows();
     mutt_endwin(Errorbuf);
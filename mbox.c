@@ -21,9 +21,16 @@
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+#include <signal.h>
 #include <string.h>
 #include <sys/file.h>
 #include <sys/stat.h>
+#ifdef USE_MMAP
+#include <sys/mman.h>
+#endif
 #include <unistd.h>
 #include <utime.h>
 #include "mutt.h"
@@ -32,6 +39,11 @@
 #include "mutt_curses.h"
 #include "mx.h"
 #include "sort.h"
+#include "stats.h"
+#ifdef USE_HCACHE
+#include "hcache.h"
+#include "md5.h"
+#endif
 
 /* struct used by mutt_sync_mailbox() to store new offsets */
 struct m_update_t
@@ -136,7 +148,7 @@ static int mmdf_parse_mailbox(CONTEXT *ctx)
 
       if (ctx->msgcount == ctx->hdrmax)
         mx_alloc_memory(ctx);
-      ctx->hdrs[ctx->msgcount] = hdr = mutt_new_header();
+      ctx->hdrs[ctx->msgcount] = hdr = mx_new_header(ctx);
       hdr->offset = loc;
       hdr->index = ctx->msgcount;
 
@@ -205,12 +217,14 @@ static int mmdf_parse_mailbox(CONTEXT *ctx)
         hdr->content->length = loc - hdr->content->offset;
       }
 
+      mutt_env_restore_lazy(hdr->env);
       if (!hdr->env->return_path && return_path[0])
         hdr->env->return_path = rfc822_parse_adrlist(hdr->env->return_path, return_path);
 
       if (!hdr->env->from)
         hdr->env->from = rfc822_cpy_adr(hdr->env->return_path, 0);
 
+      mx_intern_envelope(ctx, hdr->env);
       ctx->msgcount++;
     }
     else
@@ -233,6 +247,467 @@ static int mmdf_parse_mailbox(CONTEXT *ctx)
   return 0;
 }
 
+/**
+ * mbox_end_message - Fill in the size of a message once its end is known
+ * @h:     Message
+ * @loc:   Offset of the next message separator (or of the end of the folder)
+ * @lines: Number of lines after the header of the message
+ *
+ * This is only needed when the message had no valid Content-Length.
+ */
+static void mbox_end_message(HEADER *h, LOFF_T loc, int lines)
+{
+  if (h->content->length < 0)
+  {
+    h->content->length = loc - h->content->offset - 1;
+    if (h->content->length < 0)
+      h->content->length = 0;
+  }
+  if (!h->lines)
+    h->lines = lines ? lines - 1 : 0;
+}
+
+#ifdef USE_MMAP
+/**
+ * mbox_count_lines - Count the lines in a region of the folder
+ * @p:   Start of the region
+ * @end: End of the region
+ * @retval n Number of newlines
+ */
+static int mbox_count_lines(const char *p, const char *end)
+{
+  int n = 0;
+
+  while ((p < end) && (p = memchr(p, '\n', end - p)))
+  {
+    n++;
+    p++;
+  }
+  return n;
+}
+
+/**
+ * mbox_from_line - Check whether a line of the folder starts a message
+ * @p:           Start of the line
+ * @len:         Length of the line, including the newline
+ * @return_path: Buffer for the sender found in the line
+ * @pathlen:     Length of the buffer
+ * @t:           Set to the time found in the line
+ * @retval true  The line is a message separator
+ */
+static bool mbox_from_line(const char *p, size_t len, char *return_path,
+                           size_t pathlen, time_t *t)
+{
+  char buf[HUGE_STRING];
+
+  if ((len <= 5) || (memcmp(p, "From ", 5) != 0))
+    return false;
+
+  len = MIN(len, sizeof(buf) - 1);
+  memcpy(buf, p, len);
+  buf[len] = 0;
+  return is_from(buf, return_path, pathlen, t);
+}
+
+/**
+ * mbox_skip_body - Skip over the body of a message whose header was parsed
+ * @ctx: Context
+ * @map: Mapped folder
+ * @h:   Message
+ * @retval n Offset where to look for the next message
+ *
+ * As in mbox_parse_mailbox(), the body is skipped if the content-length looks
+ * valid, counting its lines if they aren't known.
+ */
+static LOFF_T mbox_skip_body(CONTEXT *ctx, const char *map, HEADER *h)
+{
+  LOFF_T loc = h->content->offset;
+  LOFF_T tmploc;
+
+  if ((loc < 0) || (loc > ctx->size))
+    loc = ctx->size;
+
+  if (h->content->length > 0)
+  {
+    tmploc = loc + h->content->length + 1;
+
+    if (0 < tmploc && tmploc < ctx->size)
+    {
+      if ((ctx->size - tmploc < 5) || (memcmp(map + tmploc, "From ", 5) != 0))
+      {
+        mutt_debug(1, "mbox_skip_body: bad content-length in message "
+                      "%d (cl=" OFF_T_FMT ")\n",
+                   h->index, h->content->length);
+        h->content->length = -1;
+      }
+    }
+    else if (tmploc != ctx->size)
+      h->content->length = -1;
+
+    if (h->content->length != -1)
+    {
+      if (h->lines == 0)
+        h->lines = mbox_count_lines(map + loc, map + tmploc - 1);
+      loc = tmploc;
+    }
+  }
+
+  return loc;
+}
+
+/**
+ * mbox_add_message - Append a message found by the scan to the context
+ * @ctx:         Context
+ * @h:           Message, whose header has been parsed
+ * @return_path: Sender found in its separator
+ */
+static void mbox_add_message(CONTEXT *ctx, HEADER *h, const char *return_path)
+{
+  if (ctx->msgcount == ctx->hdrmax)
+    mx_alloc_memory(ctx);
+
+  ctx->hdrs[ctx->msgcount] = h;
+  h->index = ctx->msgcount++;
+
+  mutt_env_restore_lazy(h->env);
+  if (!h->env->return_path && return_path[0])
+    h->env->return_path = rfc822_parse_adrlist(h->env->return_path, return_path);
+
+  if (!h->env->from)
+    h->env->from = rfc822_cpy_adr(h->env->return_path, 0);
+
+  mx_intern_envelope(ctx, h->env);
+}
+
+#if defined(HAVE_PTHREAD) && defined(HAVE_FMEMOPEN)
+/* Upper bound for $mbox_parse_threads, and its value when set to 0 */
+#define MBOX_MAX_PARSE_THREADS 16
+
+/* A line of the folder which looks like a message separator */
+struct mbox_from
+{
+  LOFF_T offset; /* start of the line */
+  LOFF_T hdr;    /* start of the header which follows it */
+  time_t t;      /* time found in the line */
+  long lines;    /* newlines in the folder before the line */
+  HEADER *h;     /* header parsed at hdr */
+};
+
+/* The separators found by mbox_scan_threads().  The header following each of
+ * them is parsed in any order, possibly by several threads, each filling the
+ * HEADER of the separators it takes and nothing else. */
+struct mbox_jobs
+{
+  const char *map;
+  size_t size;
+  struct mbox_from *from;
+  int count;
+  int alloc;
+  int next; /* first separator not taken yet */
+  int done; /* headers parsed */
+  pthread_mutex_t lock;
+};
+
+/**
+ * mbox_next_job - Take the next header to parse
+ * @jobs:     Headers to parse
+ * @finished: The caller has just parsed a header
+ * @done:     If not NULL, set to the number of headers parsed
+ * @retval n  Index of the separator whose header is to be parsed
+ * @retval -1 All the headers have been taken
+ */
+static int mbox_next_job(struct mbox_jobs *jobs, bool finished, int *done)
+{
+  int i = -1;
+
+  pthread_mutex_lock(&jobs->lock);
+  if (finished)
+    jobs->done++;
+  if (done)
+    *done = jobs->done;
+  if (jobs->next < jobs->count)
+    i = jobs->next++;
+  pthread_mutex_unlock(&jobs->lock);
+
+  return i;
+}
+
+static void mbox_do_job(struct mbox_jobs *jobs, FILE *fp, int i)
+{
+  struct mbox_from *from = &jobs->from[i];
+
+  from->h->received = from->t - mutt_local_tz(from->t);
+  from->h->offset = from->offset;
+  if (fseeko(fp, from->hdr, SEEK_SET) != 0)
+    mutt_debug(1, "mbox_do_job: fseek() failed\n");
+  from->h->env = mutt_read_rfc822_header(fp, from->h, 0, 0);
+}
+
+static void *mbox_parse_worker(void *data)
+{
+  struct mbox_jobs *jobs = data;
+  FILE *fp = fmemopen((void *) jobs->map, jobs->size, "r");
+  int i;
+
+  if (!fp)
+    return NULL;
+
+  for (i = mbox_next_job(jobs, false, NULL); i >= 0;
+       i = mbox_next_job(jobs, true, NULL))
+    mbox_do_job(jobs, fp, i);
+
+  safe_fclose(&fp);
+  return NULL;
+}
+
+/**
+ * mbox_scan_threads - Read the messages of a mapped folder on several threads
+ * @ctx:      Context
+ * @map:      Mapped folder
+ * @fp:       Stream reading the map
+ * @start:    Offset of the first line to read
+ * @nthreads: Number of threads to use
+ * @progress: Progress bar, if the context isn't quiet
+ * @count:    Incremented for each message read
+ * @lines:    Number of lines after the header of the last message
+ * @retval n  Offset where the scan stopped
+ *
+ * The separators are found first, then the headers following all of them are
+ * parsed concurrently.  Finally the messages are put together in file order,
+ * as mbox_scan_mmap() would have: the headers following separators that turn
+ * out to be in the body of a message with a valid content-length are dropped.
+ */
+static LOFF_T mbox_scan_threads(CONTEXT *ctx, const char *map, FILE *fp,
+                                LOFF_T start, int nthreads,
+                                progress_t *progress, int *count, int *lines)
+{
+  char return_path[STRING];
+  const char *end = map + ctx->size;
+  const char *p = map + start;
+  const char *nl = NULL;
+  struct mbox_jobs jobs;
+  struct mbox_from *from = NULL;
+  pthread_t threads[MBOX_MAX_PARSE_THREADS - 1];
+  sigset_t all, old;
+  int started = 0;
+  int done;
+  long nls = 0;
+  LOFF_T loc = start;
+  LOFF_T offset;
+  size_t len;
+  time_t t;
+  int i, k;
+
+  memset(&jobs, 0, sizeof(jobs));
+  jobs.map = map;
+  jobs.size = ctx->size;
+
+  /* find the separators, counting the lines on the way */
+  while (p < end)
+  {
+    nl = memchr(p, '\n', end - p);
+    len = (nl ? nl + 1 : end) - p;
+    if (mbox_from_line(p, len, return_path, sizeof(return_path), &t))
+    {
+      if (jobs.count == jobs.alloc)
+      {
+        jobs.alloc = jobs.alloc ? 2 * jobs.alloc : 1024;
+        safe_realloc(&jobs.from, jobs.alloc * sizeof(struct mbox_from));
+      }
+      from = &jobs.from[jobs.count++];
+      from->offset = p - map;
+      from->hdr = from->offset + len;
+      from->t = t;
+      from->lines = nls;
+      /* the pool of the context isn't shared with the workers */
+      from->h = mx_new_header(ctx);
+    }
+    if (nl)
+      nls++;
+    p += len;
+  }
+
+  nthreads = MIN(nthreads, jobs.count);
+  pthread_mutex_init(&jobs.lock, NULL);
+
+  /* leave the signals to the main thread */
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &old);
+  for (; started < nthreads - 1; started++)
+    if (pthread_create(&threads[started], NULL, mbox_parse_worker, &jobs) != 0)
+      break;
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+  mutt_debug(2, "mbox_scan_threads: parsing %d headers with %d threads\n",
+             jobs.count, started + 1);
+
+  i = mbox_next_job(&jobs, false, NULL);
+  while (i >= 0)
+  {
+    mbox_do_job(&jobs, fp, i);
+    offset = jobs.from[i].offset;
+    i = mbox_next_job(&jobs, true, &done);
+    if (!ctx->quiet)
+      mutt_progress_update(progress, done, (int) (offset / (ctx->size / 100 + 1)));
+  }
+
+  while (started > 0)
+    pthread_join(threads[--started], NULL);
+  pthread_mutex_destroy(&jobs.lock);
+
+  /* put the messages together, skipping over the bodies as if reading the
+   * folder from start to end */
+  mx_reserve_memory(ctx, ctx->msgcount + jobs.count);
+  for (k = 0; k < jobs.count && SigInt != 1; k++)
+  {
+    from = &jobs.from[k];
+    if (from->offset < loc)
+    {
+      mx_free_header(ctx, &from->h);
+      continue;
+    }
+
+    /* the lines between loc and this separator */
+    if (k == 0)
+      *lines += from->lines - mbox_count_lines(map + start, map + loc);
+    else
+      *lines += from->lines - jobs.from[k - 1].lines -
+                mbox_count_lines(map + jobs.from[k - 1].offset, map + loc);
+
+    if (*count > 0)
+      mbox_end_message(ctx->hdrs[ctx->msgcount - 1], from->offset, *lines);
+    (*count)++;
+
+    mbox_from_line(map + from->offset, from->hdr - from->offset, return_path,
+                   sizeof(return_path), &t);
+    mbox_add_message(ctx, from->h, return_path);
+    loc = mbox_skip_body(ctx, map, from->h);
+    from->h = NULL;
+    *lines = 0;
+  }
+
+  if (k < jobs.count)
+  {
+    /* interrupted */
+    for (; k < jobs.count; k++)
+      mx_free_header(ctx, &jobs.from[k].h);
+  }
+  else
+  {
+    *lines += mbox_count_lines(map + loc, end);
+    if ((loc < ctx->size) && (end[-1] != '\n'))
+      (*lines)++;
+    loc = ctx->size;
+  }
+
+  FREE(&jobs.from);
+  return loc;
+}
+#endif /* HAVE_PTHREAD && HAVE_FMEMOPEN */
+
+/**
+ * mbox_scan_mmap - Read the messages of a mbox folder through a memory map
+ * @ctx:      Context, whose file is positioned where to start reading
+ * @progress: Progress bar, if the context isn't quiet
+ * @count:    Incremented for each message read
+ * @lines:    Set to the number of lines after the header of the last message
+ * @retval  0 Success, ctx->fp is positioned where the scan stopped
+ * @retval -1 The folder couldn't be mapped, nothing was read
+ *
+ * This does the same as the fgets() loop of mbox_parse_mailbox(), but the
+ * lines are delimited with memchr() in the mapped folder, which is much faster
+ * than copying them out of stdio.  The headers are parsed straight from the
+ * map when fmemopen() is available, on $mbox_parse_threads threads.
+ */
+static int mbox_scan_mmap(CONTEXT *ctx, progress_t *progress, int *count, int *lines)
+{
+  char return_path[STRING];
+  const char *map = NULL, *end = NULL, *p = NULL, *nl = NULL;
+  HEADER *curhdr = NULL;
+  FILE *fp = NULL;
+  LOFF_T loc;
+  size_t len;
+  time_t t;
+#if defined(HAVE_PTHREAD) && defined(HAVE_FMEMOPEN)
+  int nthreads = MboxParseThreads;
+#endif
+
+  loc = ftello(ctx->fp);
+  if ((loc < 0) || (ctx->size != (LOFF_T)(size_t) ctx->size))
+    return -1;
+  if (loc >= ctx->size)
+    return 0;
+
+  map = mmap(NULL, ctx->size, PROT_READ, MAP_PRIVATE, fileno(ctx->fp), 0);
+  if (map == MAP_FAILED)
+  {
+    mutt_debug(1, "mbox_scan_mmap: mmap() failed: %s\n", strerror(errno));
+    return -1;
+  }
+#ifdef MADV_SEQUENTIAL
+  madvise((void *) map, ctx->size, MADV_SEQUENTIAL);
+#endif
+#ifdef HAVE_FMEMOPEN
+  fp = fmemopen((void *) map, ctx->size, "r");
+#endif
+
+  end = map + ctx->size;
+  p = map + loc;
+
+#if defined(HAVE_PTHREAD) && defined(HAVE_FMEMOPEN)
+  if (nthreads <= 0)
+    nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+  nthreads = MIN(nthreads, MBOX_MAX_PARSE_THREADS);
+  if (fp && (nthreads > 1))
+    p = map + mbox_scan_threads(ctx, map, fp, loc, nthreads, progress, count, lines);
+#endif
+
+  if (!fp)
+    fp = ctx->fp;
+
+  while ((p < end) && (SigInt != 1))
+  {
+    nl = memchr(p, '\n', end - p);
+    len = (nl ? nl + 1 : end) - p;
+
+    if (!mbox_from_line(p, len, return_path, sizeof(return_path), &t))
+    {
+      (*lines)++;
+      p += len;
+      continue;
+    }
+
+    loc = p - map;
+    if (*count > 0)
+      mbox_end_message(ctx->hdrs[ctx->msgcount - 1], loc, *lines);
+
+    (*count)++;
+
+    if (!ctx->quiet)
+      mutt_progress_update(progress, *count, (int) (loc / (ctx->size / 100 + 1)));
+
+    curhdr = mx_new_header(ctx);
+    curhdr->received = t - mutt_local_tz(t);
+    curhdr->offset = loc;
+    if (fseeko(fp, loc + len, SEEK_SET) != 0)
+      mutt_debug(1, "mbox_scan_mmap: fseek() failed\n");
+    curhdr->env = mutt_read_rfc822_header(fp, curhdr, 0, 0);
+
+    mbox_add_message(ctx, curhdr, return_path);
+    *lines = 0;
+    p = map + mbox_skip_body(ctx, map, curhdr);
+  }
+
+  if (fp != ctx->fp)
+    safe_fclose(&fp);
+  munmap((void *) map, ctx->size);
+
+  if (fseeko(ctx->fp, p - map, SEEK_SET) != 0)
+    mutt_debug(1, "mbox_scan_mmap: fseek() failed\n");
+
+  return 0;
+}
+#endif /* USE_MMAP */
+
 /* Note that this function is also called when new mail is appended to the
  * currently open folder, and NOT just when the mailbox is initially read.
  *
@@ -246,7 +721,7 @@ static int mbox_parse_mailbox(CONTEXT *ctx)
   HEADER *curhdr = NULL;
   time_t t;
   int count = 0, lines = 0;
-  LOFF_T loc;
+  LOFF_T loc, start;
 #ifdef NFS_ATTRIBUTE_HACK
   struct utimbuf newtime;
 #endif
@@ -282,6 +757,12 @@ static int mbox_parse_mailbox(CONTEXT *ctx)
     mutt_progress_init(&progress, msgbuf, MUTT_PROGRESS_MSG, ReadInc, 0);
   }
 
+  start = ftello(ctx->fp);
+#ifdef USE_MMAP
+  if (option(OPTMBOXMMAP) && (mbox_scan_mmap(ctx, &progress, &count, &lines) == 0))
+    goto scanned;
+#endif
+
   loc = ftello(ctx->fp);
   while ((fgets(buf, sizeof(buf), ctx->fp) != NULL) && (SigInt != 1))
   {
@@ -289,18 +770,7 @@ static int mbox_parse_mailbox(CONTEXT *ctx)
     {
       /* Save the Content-Length of the previous message */
       if (count > 0)
-      {
-#define PREV ctx->hdrs[ctx->msgcount - 1]
-
-        if (PREV->content->length < 0)
-        {
-          PREV->content->length = loc - PREV->content->offset - 1;
-          if (PREV->content->length < 0)
-            PREV->content->length = 0;
-        }
-        if (!PREV->lines)
-          PREV->lines = lines ? lines - 1 : 0;
-      }
+        mbox_end_message(ctx->hdrs[ctx->msgcount - 1], loc, lines);
 
       count++;
 
@@ -311,7 +781,7 @@ static int mbox_parse_mailbox(CONTEXT *ctx)
       if (ctx->msgcount == ctx->hdrmax)
         mx_alloc_memory(ctx);
 
-      curhdr = ctx->hdrs[ctx->msgcount] = mutt_new_header();
+      curhdr = ctx->hdrs[ctx->msgcount] = mx_new_header(ctx);
       curhdr->received = t - mutt_local_tz(t);
       curhdr->offset = loc;
       curhdr->index = ctx->msgcount;
@@ -386,6 +856,7 @@ static int mbox_parse_mailbox(CONTEXT *ctx)
 
       ctx->msgcount++;
 
+      mutt_env_restore_lazy(curhdr->env);
       if (!curhdr->env->return_path && return_path[0])
         curhdr->env->return_path =
             rfc822_parse_adrlist(curhdr->env->return_path, return_path);
@@ -393,6 +864,8 @@ static int mbox_parse_mailbox(CONTEXT *ctx)
       if (!curhdr->env->from)
         curhdr->env->from = rfc822_cpy_adr(curhdr->env->return_path, 0);
 
+      mx_intern_envelope(ctx, curhdr->env);
+
       lines = 0;
     }
     else
@@ -401,6 +874,13 @@ static int mbox_parse_mailbox(CONTEXT *ctx)
     loc = ftello(ctx->fp);
   }
 
+#ifdef USE_MMAP
+scanned:
+#endif
+  loc = ftello(ctx->fp);
+  if ((start >= 0) && (loc > start))
+    mutt_stats_add(STATS_BYTES_READ, loc - start);
+
   /*
    * Only set the content-length of the previous message if we have read more
    * than one message during _this_ invocation.  If this routine is called
@@ -409,16 +889,7 @@ static int mbox_parse_mailbox(CONTEXT *ctx)
    */
   if (count > 0)
   {
-    if (PREV->content->length < 0)
-    {
-      PREV->content->length = ftello(ctx->fp) - PREV->content->offset - 1;
-      if (PREV->content->length < 0)
-        PREV->content->length = 0;
-    }
-
-    if (!PREV->lines)
-      PREV->lines = lines ? lines - 1 : 0;
-
+    mbox_end_message(ctx->hdrs[ctx->msgcount - 1], ftello(ctx->fp), lines);
     mx_update_context(ctx, count);
   }
 
@@ -431,12 +902,338 @@ static int mbox_parse_mailbox(CONTEXT *ctx)
   return 0;
 }
 
-#undef PREV
+#ifdef USE_HCACHE
+/**
+ * struct mbox_index - Summary of an indexed mbox/mmdf folder
+ *
+ * It is stored in the header cache under MBOX_INDEX_KEY, next to one record
+ * per message stored under its index.  The checksums of the first line of the
+ * first and last messages catch most rewrites which keep the size and mtime
+ * of the folder, or which happen to make it grow.
+ */
+struct mbox_index
+{
+  short magic;
+  LOFF_T size;                 /* size of the folder when it was indexed */
+  time_t mtime;                /* and its modification time */
+  int msgcount;                /* number of message records */
+  LOFF_T first;                /* offset of the first message */
+  LOFF_T last;                 /* offset of the last message */
+  unsigned char first_sum[16]; /* md5 of the first line of the first message */
+  unsigned char last_sum[16];  /* md5 of the first line of the last message */
+};
+
+#define MBOX_INDEX_KEY "/INDEX"
+
+/**
+ * mbox_line_sum - Checksum a line of the folder
+ * @fp:     Folder
+ * @offset: Offset of the line
+ * @sum:    Buffer for the md5 of the line (16 bytes)
+ * @retval  0 Success
+ * @retval -1 The line couldn't be read
+ */
+static int mbox_line_sum(FILE *fp, LOFF_T offset, unsigned char *sum)
+{
+  char buf[LONG_STRING];
+
+  if (fseeko(fp, offset, SEEK_SET) != 0 || !fgets(buf, sizeof(buf), fp))
+    return -1;
+  md5_buffer(buf, strlen(buf), sum);
+  return 0;
+}
+
+/**
+ * mbox_index_key - Header cache key of the record of a message
+ * @buf:    Buffer for the key
+ * @buflen: Length of the buffer
+ * @index:  Index of the message in the folder
+ * @retval n Length of the key
+ */
+static size_t mbox_index_key(char *buf, size_t buflen, int index)
+{
+  return snprintf(buf, buflen, "/%d", index);
+}
+
+/**
+ * mbox_index_fetch - Fetch the index of a folder
+ * @hc:  Header cache
+ * @idx: Filled in with the index
+ * @retval  0 Success
+ * @retval -1 The folder is not indexed
+ */
+static int mbox_index_fetch(header_cache_t *hc, struct mbox_index *idx)
+{
+  void *data = mutt_hcache_fetch_raw(hc, MBOX_INDEX_KEY, strlen(MBOX_INDEX_KEY));
+
+  if (!data)
+    return -1;
+  memcpy(idx, data, sizeof(struct mbox_index));
+  mutt_hcache_free(hc, &data);
+  return 0;
+}
+
+/**
+ * mbox_index_restore - Read the messages of a folder from its index
+ * @ctx: Context, whose file is locked
+ * @hc:  Header cache
+ * @retval  1 All the messages were restored
+ * @retval  0 The folder grew since it was indexed: the messages of the
+ *            indexed part were restored and ctx->fp is positioned at its end
+ * @retval -1 There is no usable index, nothing was restored
+ */
+static int mbox_index_restore(CONTEXT *ctx, header_cache_t *hc)
+{
+  struct mbox_index idx;
+  struct stat sb;
+  unsigned char sum[16];
+  char key[SHORT_STRING];
+  char msgbuf[STRING];
+  char buf[LONG_STRING];
+  progress_t progress;
+  void *data = NULL;
+  HEADER *h = NULL;
+  size_t keylen;
+  int i;
+
+  if (!hc || mbox_index_fetch(hc, &idx) != 0 || fstat(fileno(ctx->fp), &sb) != 0)
+    return -1;
+
+  if (idx.magic != ctx->magic || idx.msgcount < 0 || sb.st_size < idx.size ||
+      (sb.st_size == idx.size && sb.st_mtime != idx.mtime))
+    return -1;
+
+  if (idx.msgcount > 0)
+  {
+    if (mbox_line_sum(ctx->fp, idx.first, sum) != 0 ||
+        memcmp(sum, idx.first_sum, sizeof(sum)) != 0 ||
+        mbox_line_sum(ctx->fp, idx.last, sum) != 0 ||
+        memcmp(sum, idx.last_sum, sizeof(sum)) != 0)
+    {
+      mutt_debug(1, "mbox_index_restore: %s was rewritten\n", ctx->path);
+      return -1;
+    }
+  }
+
+  /* only appending to the folder keeps the index valid: as in
+   * mbox_check_mailbox(), expect a message separator where it used to end */
+  if (sb.st_size > idx.size)
+  {
+    if (fseeko(ctx->fp, idx.size, SEEK_SET) != 0 ||
+        !fgets(buf, sizeof(buf), ctx->fp) ||
+        (ctx->magic == MUTT_MBOX && (mutt_strncmp("From ", buf, 5) != 0)) ||
+        (ctx->magic == MUTT_MMDF && (mutt_strcmp(MMDF_SEP, buf) != 0)))
+      return -1;
+  }
+
+  if (!ctx->quiet)
+  {
+    snprintf(msgbuf, sizeof(msgbuf), _("Reading %s..."), ctx->path);
+    mutt_progress_init(&progress, msgbuf, MUTT_PROGRESS_MSG, ReadInc, idx.msgcount);
+  }
+
+  for (i = 0; i < idx.msgcount; i++)
+  {
+    if (!ctx->quiet)
+      mutt_progress_update(&progress, i + 1, -1);
+
+    keylen = mbox_index_key(key, sizeof(key), i);
+    data = mutt_hcache_fetch(hc, key, keylen);
+    if (!data)
+    {
+      mutt_debug(1, "mbox_index_restore: record %d of %s is missing\n", i, ctx->path);
+      while (ctx->msgcount > 0)
+        mx_free_header(ctx, &ctx->hdrs[--ctx->msgcount]);
+      return -1;
+    }
+    h = mutt_hcache_restore((unsigned char *) data);
+    mutt_hcache_free(hc, &data);
+    h->index = i;
+    mx_intern_envelope(ctx, h->env);
+
+    if (ctx->msgcount == ctx->hdrmax)
+      mx_alloc_memory(ctx);
+    ctx->hdrs[ctx->msgcount++] = h;
+  }
+
+  ctx->size = idx.size;
+  ctx->mtime = sb.st_mtime;
+  ctx->atime = sb.st_atime;
+  if (!ctx->readonly)
+    ctx->readonly = access(ctx->path, W_OK) ? true : false;
+
+  if (ctx->msgcount > 0)
+    mx_update_context(ctx, ctx->msgcount);
+
+  if (sb.st_size == idx.size)
+    return 1;
+
+  if (fseeko(ctx->fp, idx.size, SEEK_SET) != 0)
+    return -1;
+  return 0;
+}
+
+/**
+ * mbox_index_store - Save the record of a message of an indexed folder
+ * @hc: Header cache
+ * @h:  Message, as it is in the file
+ */
+static void mbox_index_store(header_cache_t *hc, HEADER *h)
+{
+  char key[SHORT_STRING];
+  size_t keylen;
+
+  keylen = mbox_index_key(key, sizeof(key), h->index);
+  if (h->read && !h->old)
+  {
+    /* mutt_copy_header() wrote "Status: RO" */
+    h->old = true;
+    mutt_hcache_store(hc, key, keylen, h, 0);
+    h->old = false;
+  }
+  else
+    mutt_hcache_store(hc, key, keylen, h, 0);
+}
+
+/**
+ * mbox_index_save - Update the index of a folder
+ * @ctx:      Context
+ * @hc:       Header cache
+ * @first:    Index of the first message whose record must be stored
+ * @expunged: If true, the deleted messages are no longer in the file and the
+ *            others have been renumbered
+ *
+ * The records of the messages before first are kept if they were indexed.
+ * If a message can't be stored as it is in the file, the index is dropped.
+ */
+static void mbox_index_save(CONTEXT *ctx, header_cache_t *hc, int first, bool expunged)
+{
+  struct mbox_index idx, old;
+  struct stat sb;
+  char key[SHORT_STRING];
+  size_t keylen;
+  HEADER *h = NULL;
+  int i;
+
+  if (!hc || fstat(fileno(ctx->fp), &sb) != 0)
+    return;
+
+  if (mbox_index_fetch(hc, &old) != 0 || old.magic != ctx->magic)
+    old.msgcount = 0;
+  if (first > old.msgcount)
+    first = old.msgcount;
+
+  memset(&idx, 0, sizeof(idx));
+  idx.magic = ctx->magic;
+  idx.size = sb.st_size;
+  idx.mtime = sb.st_mtime;
+
+  mutt_hcache_begin(hc);
+  for (i = 0; i < ctx->msgcount; i++)
+  {
+    h = ctx->hdrs[i];
+    if (expunged && h->deleted)
+      continue;
+    if (h->index >= first)
+    {
+      /* the record must describe the message as it is in the file */
+      if (h->changed && !expunged)
+      {
+        mutt_hcache_delete(hc, MBOX_INDEX_KEY, strlen(MBOX_INDEX_KEY));
+        mutt_hcache_commit(hc);
+        return;
+      }
+      mbox_index_store(hc, h);
+    }
+    /* the folder may be sorted in any order */
+    if (h->index == 0)
+      idx.first = h->offset;
+    if (h->index >= idx.msgcount)
+    {
+      idx.msgcount = h->index + 1;
+      idx.last = h->offset;
+    }
+  }
+
+  /* drop the records of the messages which are gone */
+  for (i = idx.msgcount; i < old.msgcount; i++)
+  {
+    keylen = mbox_index_key(key, sizeof(key), i);
+    mutt_hcache_delete(hc, key, keylen);
+  }
+
+  if (idx.msgcount > 0)
+  {
+    if (mbox_line_sum(ctx->fp, idx.first, idx.first_sum) != 0 ||
+        mbox_line_sum(ctx->fp, idx.last, idx.last_sum) != 0)
+    {
+      mutt_hcache_delete(hc, MBOX_INDEX_KEY, strlen(MBOX_INDEX_KEY));
+      mutt_hcache_commit(hc);
+      return;
+    }
+  }
+
+  mutt_hcache_store_raw(hc, MBOX_INDEX_KEY, strlen(MBOX_INDEX_KEY), &idx, sizeof(idx));
+  mutt_hcache_commit(hc);
+}
+
+static header_cache_t *mbox_open_hcache(CONTEXT *ctx)
+{
+  return mutt_hcache_open(HeaderCache, ctx->path, NULL);
+}
+
+/* the key of the record of a message, and its offset, which tells it apart
+ * from the message found there before the folder was rewritten */
+static int mbox_hcache_key(CONTEXT *ctx, HEADER *h, char *buf, size_t buflen)
+{
+  return snprintf(buf, buflen, "/%d:%lld", h->index, (long long) h->offset);
+}
+
+/* hcache_keep_t for the records of an indexed folder: the index, the thread
+ * tree, and the message records it covers */
+static int mbox_hcache_keep(const char *key, void *data)
+{
+  int msgcount = *(int *) data;
+  char *end = NULL;
+  long index;
+
+  if ((mutt_strcmp(key, MBOX_INDEX_KEY) == 0) || (mutt_strcmp(key, HCACHE_THREADS_KEY) == 0))
+    return 1;
+  if ((key[0] != '/') || (key[1] < '0') || (key[1] > '9'))
+    return 0;
+  index = strtol(key + 1, &end, 10);
+  return (*end == '\0') && (index < msgcount);
+}
+
+static int mbox_compact_hcache(CONTEXT *ctx, bool force, long *reclaimed)
+{
+  header_cache_t *hc = NULL;
+  struct mbox_index idx;
+  int rc;
+
+  hc = mutt_hcache_open(HeaderCache, ctx->path, NULL);
+  if (!hc)
+    return -1;
+
+  /* the records beyond the index are left over from a larger folder */
+  if (mbox_index_fetch(hc, &idx) != 0 || idx.magic != ctx->magic)
+    idx.msgcount = 0;
+
+  rc = mutt_hcache_compact(hc, mbox_hcache_keep, &idx.msgcount, force, reclaimed);
+
+  mutt_hcache_close(hc);
+  return rc;
+}
+#endif /* USE_HCACHE */
 
 /* open a mbox or mmdf style mailbox */
 static int mbox_open_mailbox(CONTEXT *ctx)
 {
   int rc;
+#ifdef USE_HCACHE
+  header_cache_t *hc = NULL;
+  int indexed, restored;
+#endif
 
   if ((ctx->fp = fopen(ctx->path, "r")) == NULL)
   {
@@ -450,6 +1247,14 @@ static int mbox_open_mailbox(CONTEXT *ctx)
     return -1;
   }
 
+#ifdef USE_HCACHE
+  hc = mutt_hcache_open(HeaderCache, ctx->path, NULL);
+  indexed = mbox_index_restore(ctx, hc);
+  restored = ctx->msgcount;
+  if (indexed == 1)
+    rc = 0;
+  else
+#endif
   if (ctx->magic == MUTT_MBOX)
     rc = mbox_parse_mailbox(ctx);
   else if (ctx->magic == MUTT_MMDF)
@@ -458,6 +1263,13 @@ static int mbox_open_mailbox(CONTEXT *ctx)
     rc = -1;
   mutt_touch_atime(fileno(ctx->fp));
 
+#ifdef USE_HCACHE
+  /* store the messages which were parsed */
+  if (rc == 0 && indexed != 1)
+    mbox_index_save(ctx, hc, restored, false);
+  mutt_hcache_close(hc);
+#endif
+
   mbox_unlock_mailbox(ctx);
   mutt_unblock_signals();
   return rc;
@@ -584,7 +1396,7 @@ static int strict_cmp_lists(const LIST *a, const LIST *b)
   return 1;
 }
 
-static int strict_cmp_envelopes(const ENVELOPE *e1, const ENVELOPE *e2)
+static int strict_cmp_envelopes(ENVELOPE *e1, ENVELOPE *e2)
 {
   if (e1 && e2)
   {
@@ -593,11 +1405,13 @@ static int strict_cmp_envelopes(const ENVELOPE *e1, const ENVELOPE *e2)
         !strict_cmp_lists(e1->references, e2->references) ||
         !strict_addrcmp(e1->from, e2->from) || !strict_addrcmp(e1->sender, e2->sender) ||
         !strict_addrcmp(e1->reply_to, e2->reply_to) ||
-        !strict_addrcmp(e1->to, e2->to) || !strict_addrcmp(e1->cc, e2->cc) ||
-        !strict_addrcmp(e1->return_path, e2->return_path))
+        !strict_addrcmp(e1->to, e2->to) || !strict_addrcmp(e1->cc, e2->cc))
       return 0;
-    else
-      return 1;
+
+    /* a header from the cache may not have its return path yet */
+    mutt_env_restore_lazy(e1);
+    mutt_env_restore_lazy(e2);
+    return strict_addrcmp(e1->return_path, e2->return_path);
   }
   else
   {
@@ -659,15 +1473,139 @@ int mbox_strict_cmp_headers(const HEADER *h1, const HEADER *h2)
   }
 }
 
+/**
+ * mbox_message_start - Get the offset of the separator of a message
+ * @ctx: Mailbox
+ * @h:   Message
+ * @retval n Offset of the "From " line, or of the MMDF separator
+ */
+static LOFF_T mbox_message_start(CONTEXT *ctx, HEADER *h)
+{
+  if (ctx->magic == MUTT_MMDF)
+    return h->offset - (sizeof(MMDF_SEP) - 1);
+  return h->offset;
+}
+
+/**
+ * mbox_is_separator - Is there a message separator at an offset
+ * @ctx:    Mailbox
+ * @offset: Offset in the file
+ * @retval true A message starts at the offset
+ */
+static bool mbox_is_separator(CONTEXT *ctx, LOFF_T offset)
+{
+  char buf[sizeof(MMDF_SEP)];
+  size_t len = (ctx->magic == MUTT_MMDF) ? sizeof(MMDF_SEP) - 1 : 5;
+
+  if (offset < 0 || pread(fileno(ctx->fp), buf, len, offset) != (ssize_t) len)
+    return false;
+  if (ctx->magic == MUTT_MMDF)
+    return memcmp(buf, MMDF_SEP, len) == 0;
+  return memcmp(buf, "From ", len) == 0;
+}
+
+/**
+ * mbox_message_unchanged - Does a message still have its header in the file
+ * @ctx: Mailbox
+ * @h:   Message, as it was parsed
+ * @retval true The header of the message, where it used to be, has its Message-ID
+ */
+static bool mbox_message_unchanged(CONTEXT *ctx, HEADER *h)
+{
+  char *buf = NULL;
+  size_t len;
+  bool rc = false;
+
+  if (!h->env->message_id)
+    return true;
+  if (h->content->offset <= h->offset)
+    return false;
+
+  len = MIN(h->content->offset - h->offset, HUGE_STRING * 8);
+  buf = safe_malloc(len + 1);
+  if (pread(fileno(ctx->fp), buf, len, h->offset) == (ssize_t) len)
+  {
+    buf[len] = '\0';
+    rc = (strstr(buf, h->env->message_id) != NULL);
+  }
+  FREE(&buf);
+  return rc;
+}
+
+/**
+ * mbox_unchanged_prefix - Count the messages at the start of a folder which are unchanged
+ * @ctx:      Mailbox, reopened after it was changed
+ * @hdrs:     Messages as they were parsed, in file order
+ * @msgcount: Number of messages
+ * @retval n Number of messages which can be kept
+ *
+ * Every message must still start at its old offset, and a sample of them,
+ * denser towards the end of the prefix, must still have their Message-ID.
+ * The message after the prefix starts at a separator, so that the folder can
+ * be parsed from there.
+ */
+static int mbox_unchanged_prefix(CONTEXT *ctx, HEADER **hdrs, int msgcount)
+{
+  int keep, k;
+
+  for (keep = 0; keep < msgcount; keep++)
+    if (!mbox_is_separator(ctx, mbox_message_start(ctx, hdrs[keep])))
+      break;
+
+  /* the message before the first one which has moved has changed too */
+  keep--;
+
+  for (k = 1; k <= keep; k *= 2)
+    if (!mbox_message_unchanged(ctx, hdrs[keep - k]))
+      keep -= k;
+
+  if (keep > 0 && !mbox_message_unchanged(ctx, hdrs[0]))
+    keep = 0;
+
+  return MAX(keep, 0);
+}
+
+/**
+ * mbox_find_old_header - Find the old version of a reparsed message
+ * @hash: Old messages, keyed on their Message-ID
+ * @h:    Reparsed message
+ * @retval ptr Old message, preferably at the same offset
+ * @retval NULL There isn't one
+ */
+static HEADER *mbox_find_old_header(HASH *hash, HEADER *h)
+{
+  const char *key = NONULL(h->env->message_id);
+  struct hash_elem *elem = NULL;
+  HEADER *old = NULL, *found = NULL;
+
+  for (elem = hash_find_bucket(hash, key); elem; elem = elem->next)
+  {
+    old = elem->data;
+    if (mutt_strcmp(elem->key.strkey, key) != 0 || !mbox_strict_cmp_headers(h, old))
+      continue;
+    if (old->offset == h->offset)
+      return old;
+    if (!found || old->msgno < found->msgno)
+      found = old;
+  }
+
+  return found;
+}
+
 static int reopen_mailbox(CONTEXT *ctx, int *index_hint)
 {
-  int (*cmp_headers)(const HEADER *, const HEADER *) = NULL;
-  HEADER **old_hdrs;
+  HEADER **old_hdrs = NULL;
+  HEADER *h = NULL;
+  HASH *old_hash = NULL;
   int old_msgcount;
   int msg_mod = 0;
   int index_hint_set;
+  int keep = 0;
   int i, j;
   int rc = -1;
+#ifdef USE_HCACHE
+  header_cache_t *hc = NULL;
+#endif
 
   /* silent operations */
   ctx->quiet = true;
@@ -686,9 +1624,6 @@ static int reopen_mailbox(CONTEXT *ctx, int *index_hint)
     Sort = old_sort;
   }
 
-  old_hdrs = NULL;
-  old_msgcount = 0;
-
   /* simulate a close */
   if (ctx->id_hash)
     hash_destroy(&ctx->id_hash, NULL);
@@ -697,19 +1632,11 @@ static int reopen_mailbox(CONTEXT *ctx, int *index_hint)
   hash_destroy(&ctx->label_hash, NULL);
   mutt_clear_threads(ctx);
   FREE(&ctx->v2r);
-  if (ctx->readonly)
-  {
-    for (i = 0; i < ctx->msgcount; i++)
-      mutt_free_header(&(ctx->hdrs[i])); /* nothing to do! */
-    FREE(&ctx->hdrs);
-  }
-  else
-  {
-    /* save the old headers */
-    old_msgcount = ctx->msgcount;
-    old_hdrs = ctx->hdrs;
-    ctx->hdrs = NULL;
-  }
+
+  /* save the old headers */
+  old_msgcount = ctx->msgcount;
+  old_hdrs = ctx->hdrs;
+  ctx->hdrs = NULL;
 
   ctx->hdrmax = 0; /* force allocation of new headers */
   ctx->msgcount = 0;
@@ -728,9 +1655,28 @@ static int reopen_mailbox(CONTEXT *ctx, int *index_hint)
   {
     case MUTT_MBOX:
     case MUTT_MMDF:
-      cmp_headers = mbox_strict_cmp_headers;
       safe_fclose(&ctx->fp);
       if (!(ctx->fp = safe_fopen(ctx->path, "r")))
+      {
+        rc = -1;
+        break;
+      }
+
+      /* keep the messages which are unchanged, and only parse the rest */
+      keep = mbox_unchanged_prefix(ctx, old_hdrs, old_msgcount);
+      mutt_debug(2, "reopen_mailbox: keeping %d of %d messages\n", keep, old_msgcount);
+      mx_reserve_memory(ctx, old_msgcount);
+      for (i = 0; i < keep; i++)
+      {
+        if (old_hdrs[i]->tagged)
+          ctx->tagged++;
+        ctx->hdrs[ctx->msgcount++] = old_hdrs[i];
+        old_hdrs[i] = NULL;
+      }
+      if (keep > 0)
+        mx_update_context(ctx, keep);
+
+      if (fseeko(ctx->fp, (keep > 0) ? mbox_message_start(ctx, old_hdrs[keep]) : 0, SEEK_SET) != 0)
         rc = -1;
       else
         rc = ((ctx->magic == MUTT_MBOX) ? mbox_parse_mailbox : mmdf_parse_mailbox)(ctx);
@@ -745,7 +1691,7 @@ static int reopen_mailbox(CONTEXT *ctx, int *index_hint)
   {
     /* free the old headers */
     for (j = 0; j < old_msgcount; j++)
-      mutt_free_header(&(old_hdrs[j]));
+      mx_free_header(ctx, &(old_hdrs[j]));
     FREE(&old_hdrs);
 
     ctx->quiet = false;
@@ -756,80 +1702,68 @@ static int reopen_mailbox(CONTEXT *ctx, int *index_hint)
 
   /* now try to recover the old flags */
 
-  index_hint_set = (index_hint == NULL);
+  index_hint_set = (index_hint == NULL) || (*index_hint < keep);
 
   if (!ctx->readonly)
   {
-    for (i = 0; i < ctx->msgcount; i++)
+    old_hash = hash_create(MAX(old_msgcount - keep, 1), MUTT_HASH_ALLOW_DUPS);
+    for (j = keep; j < old_msgcount; j++)
+      hash_insert(old_hash, NONULL(old_hdrs[j]->env->message_id), old_hdrs[j]);
+
+    for (i = keep; i < ctx->msgcount; i++)
     {
-      int found = 0;
+      h = mbox_find_old_header(old_hash, ctx->hdrs[i]);
+      if (!h)
+        continue;
+      j = h->msgno;
 
-      /* some messages have been deleted, and new  messages have been
-       * appended at the end; the heuristic is that old messages have then
-       * "advanced" towards the beginning of the folder, so we begin the
-       * search at index "i"
-       */
-      for (j = i; j < old_msgcount; j++)
+      /* this is best done here */
+      if (!index_hint_set && *index_hint == j)
       {
-        if (old_hdrs[j] == NULL)
-          continue;
-        if (cmp_headers(ctx->hdrs[i], old_hdrs[j]))
-        {
-          found = 1;
-          break;
-        }
-      }
-      if (!found)
-      {
-        for (j = 0; j < i && j < old_msgcount; j++)
-        {
-          if (old_hdrs[j] == NULL)
-            continue;
-          if (cmp_headers(ctx->hdrs[i], old_hdrs[j]))
-          {
-            found = 1;
-            break;
-          }
-        }
+        *index_hint = i;
+        index_hint_set = 1;
       }
 
-      if (found)
+      if (h->changed)
       {
-        /* this is best done here */
-        if (!index_hint_set && *index_hint == j)
-          *index_hint = i;
-
-        if (old_hdrs[j]->changed)
-        {
-          /* Only update the flags if the old header was changed;
-           * otherwise, the header may have been modified externally,
-           * and we don't want to lose _those_ changes
-           */
-          mutt_set_flag(ctx, ctx->hdrs[i], MUTT_FLAG, old_hdrs[j]->flagged);
-          mutt_set_flag(ctx, ctx->hdrs[i], MUTT_REPLIED, old_hdrs[j]->replied);
-          mutt_set_flag(ctx, ctx->hdrs[i], MUTT_OLD, old_hdrs[j]->old);
-          mutt_set_flag(ctx, ctx->hdrs[i], MUTT_READ, old_hdrs[j]->read);
-        }
-        mutt_set_flag(ctx, ctx->hdrs[i], MUTT_DELETE, old_hdrs[j]->deleted);
-        mutt_set_flag(ctx, ctx->hdrs[i], MUTT_PURGE, old_hdrs[j]->purge);
-        mutt_set_flag(ctx, ctx->hdrs[i], MUTT_TAG, old_hdrs[j]->tagged);
-
-        /* we don't need this header any more */
-        mutt_free_header(&(old_hdrs[j]));
+        /* Only update the flags if the old header was changed;
+         * otherwise, the header may have been modified externally,
+         * and we don't want to lose _those_ changes
+         */
+        mutt_set_flag(ctx, ctx->hdrs[i], MUTT_FLAG, h->flagged);
+        mutt_set_flag(ctx, ctx->hdrs[i], MUTT_REPLIED, h->replied);
+        mutt_set_flag(ctx, ctx->hdrs[i], MUTT_OLD, h->old);
+        mutt_set_flag(ctx, ctx->hdrs[i], MUTT_READ, h->read);
       }
+      mutt_set_flag(ctx, ctx->hdrs[i], MUTT_DELETE, h->deleted);
+      mutt_set_flag(ctx, ctx->hdrs[i], MUTT_PURGE, h->purge);
+      mutt_set_flag(ctx, ctx->hdrs[i], MUTT_TAG, h->tagged);
+
+      /* we don't need this header any more */
+      hash_delete(old_hash, NONULL(h->env->message_id), h, NULL);
+      mx_free_header(ctx, &(old_hdrs[j]));
     }
+    hash_destroy(&old_hash, NULL);
+  }
 
-    /* free the remaining old headers */
-    for (j = 0; j < old_msgcount; j++)
+  /* free the remaining old headers */
+  for (j = keep; j < old_msgcount; j++)
+  {
+    if (old_hdrs[j])
     {
-      if (old_hdrs[j])
-      {
-        mutt_free_header(&(old_hdrs[j]));
+      mx_free_header(ctx, &(old_hdrs[j]));
+      if (!ctx->readonly)
         msg_mod = 1;
-      }
     }
-    FREE(&old_hdrs);
   }
+  FREE(&old_hdrs);
+
+#ifdef USE_HCACHE
+  /* the records of the messages after the prefix are stale */
+  hc = mutt_hcache_open(HeaderCache, ctx->path, NULL);
+  mbox_index_save(ctx, hc, keep, false);
+  mutt_hcache_close(hc);
+#endif
 
   ctx->quiet = false;
 
@@ -851,6 +1785,10 @@ static int mbox_check_mailbox(CONTEXT *ctx, int *index_hint)
   char buffer[LONG_STRING];
   int unlock = 0;
   int modified = 0;
+#ifdef USE_HCACHE
+  header_cache_t *hc = NULL;
+  int oldmsgcount = ctx->msgcount;
+#endif
 
   if (stat(ctx->path, &st) == 0)
   {
@@ -902,6 +1840,12 @@ static int mbox_check_mailbox(CONTEXT *ctx, int *index_hint)
           else
             mmdf_parse_mailbox(ctx);
 
+#ifdef USE_HCACHE
+          hc = mutt_hcache_open(HeaderCache, ctx->path, NULL);
+          mbox_index_save(ctx, hc, oldmsgcount, false);
+          mutt_hcache_close(hc);
+#endif
+
           /* Only unlock the folder if it was locked inside of this routine.
            * It may have been locked elsewhere, like in
            * mutt_checkpoint_mailbox().
@@ -991,6 +1935,149 @@ void mbox_reset_atime(CONTEXT *ctx, struct stat *st)
   utime(ctx->path, &utimebuf);
 }
 
+/**
+ * mbox_patch_status - Change the status fields of a message in place
+ * @ctx: Mailbox, open for writing
+ * @h:   Message whose flags have changed
+ * @retval  0 Success
+ * @retval -1 Nothing was written: the message has no padded status fields,
+ *            or they can't be written
+ * @retval -2 A field was changed and couldn't be restored
+ *
+ * This only works for the fields written with CH_PAD_STATUS, which have room
+ * for any combination of flags.  Both fields are found before either is
+ * written, and the first one is put back if the second can't be written.
+ */
+static int mbox_patch_status(CONTEXT *ctx, HEADER *h)
+{
+  char status[MUTT_STATUS_WIDTH + 1], xstatus[MUTT_STATUS_WIDTH + 1];
+  char old[MUTT_STATUS_WIDTH];
+  LOFF_T soff = -1, xoff = -1;
+  size_t len, linelen;
+  ssize_t n;
+  bool twice = false;
+  char *buf = NULL, *p = NULL, *end = NULL, *nl = NULL;
+  int fd = fileno(ctx->fp);
+
+  if (h->content->offset <= h->offset)
+    return -1;
+  len = h->content->offset - h->offset;
+  if (len > HUGE_STRING * 8)
+    return -1;
+
+  buf = safe_malloc(len);
+  if (pread(fd, buf, len, h->offset) != (ssize_t) len)
+  {
+    FREE(&buf);
+    return -1;
+  }
+
+  /* both fields must be whole lines of the header, and appear once */
+  end = buf + len;
+  for (p = buf; p < end && (nl = memchr(p, '\n', end - p)); p = nl + 1)
+  {
+    linelen = nl - p;
+    if (linelen == 8 + MUTT_STATUS_WIDTH && mutt_strncmp(p, "Status: ", 8) == 0)
+    {
+      twice |= (soff >= 0);
+      soff = p - buf + 8;
+    }
+    else if (linelen == 10 + MUTT_STATUS_WIDTH && mutt_strncmp(p, "X-Status: ", 10) == 0)
+    {
+      twice |= (xoff >= 0);
+      xoff = p - buf + 10;
+    }
+  }
+  if (twice || soff < 0 || xoff < 0)
+  {
+    FREE(&buf);
+    return -1;
+  }
+
+  memcpy(old, buf + soff, MUTT_STATUS_WIDTH);
+  FREE(&buf);
+  soff += h->offset;
+  xoff += h->offset;
+
+  mutt_status_fields(h, status, xstatus, true);
+  n = pwrite(fd, status, MUTT_STATUS_WIDTH, soff);
+  if (n <= 0)
+    return -1;
+  if (n == MUTT_STATUS_WIDTH &&
+      pwrite(fd, xstatus, MUTT_STATUS_WIDTH, xoff) == MUTT_STATUS_WIDTH)
+    return 0;
+
+  /* the X-Status field is untouched, or damaged */
+  mutt_debug(1, "mbox_patch_status: can't write the status of message %d\n", h->msgno);
+  if (pwrite(fd, old, MUTT_STATUS_WIDTH, soff) == MUTT_STATUS_WIDTH)
+    return -1;
+
+  return -2;
+}
+
+/**
+ * mbox_sync_in_place - Write the flag changes which don't need a rewrite
+ * @ctx: Mailbox, open for writing and locked
+ * @retval n  Number of messages which still need to be rewritten
+ * @retval -1 The status of a message was left half written
+ *
+ * Messages whose headers or bodies have changed, and deleted messages, are
+ * left to the rewrite.
+ */
+static int mbox_sync_in_place(CONTEXT *ctx)
+{
+  HEADER *h = NULL;
+  int i, rc, patched = 0, left = 0;
+#ifdef USE_HCACHE
+  header_cache_t *hc = NULL;
+#endif
+
+  for (i = 0; i < ctx->msgcount; i++)
+  {
+    h = ctx->hdrs[i];
+    if (h->deleted || h->attach_del)
+      left++;
+    else if (h->changed)
+    {
+      if (h->xlabel_changed || h->env->irt_changed || h->env->refs_changed ||
+          (rc = mbox_patch_status(ctx, h)) == -1)
+      {
+        left++;
+        continue;
+      }
+      if (rc < 0)
+      {
+        left = -1;
+        break;
+      }
+
+      h->changed = false;
+      patched++;
+#ifdef USE_HCACHE
+      if (!hc && (hc = mutt_hcache_open(HeaderCache, ctx->path, NULL)))
+        mutt_hcache_begin(hc);
+      if (hc)
+        mbox_index_store(hc, h);
+#endif
+    }
+  }
+
+#ifdef USE_HCACHE
+  if (hc)
+  {
+    mutt_hcache_commit(hc);
+    mutt_hcache_close(hc);
+  }
+#endif
+
+  /* the data written behind the back of the stream must not be hidden by its
+   * buffer */
+  if (patched)
+    fflush(ctx->fp);
+
+  return left;
+}
+
 /* return values:
  *      0       success
  *      -1      failure
@@ -1011,6 +2098,9 @@ static int mbox_sync_mailbox(CONTEXT *ctx, int *index_hint)
   progress_t progress;
   char msgbuf[STRING];
   BUFFY *tmp = NULL;
+#ifdef USE_HCACHE
+  header_cache_t *hc = NULL;
+#endif
 
   /* sort message by their position in the mailbox on disk */
   if (Sort != SORT_ORDER)
@@ -1053,6 +2143,28 @@ static int mbox_sync_mailbox(CONTEXT *ctx, int *index_hint)
     /* fatal error */
     return -1;
 
+  /* flag changes are written in place where the status fields allow it */
+  if (option(OPTMBOXPADSTATUS) && stat(ctx->path, &statbuf) == 0 &&
+      (i = mbox_sync_in_place(ctx)) <= 0)
+  {
+    if (i < 0)
+    {
+      mutt_perror(_("Can't write message"));
+      goto bail;
+    }
+
+    mbox_unlock_mailbox(ctx);
+    mbox_reset_atime(ctx, &statbuf);
+    mutt_unblock_signals();
+    if ((ctx->fp = freopen(ctx->path, "r", ctx->fp)) == NULL)
+    {
+      mx_fastclose_mailbox(ctx);
+      mutt_error(_("Fatal error!  Could not reopen mailbox!"));
+      return -1;
+    }
+    return 0;
+  }
+
   /* Create a temporary file to write the new version of the mailbox in. */
   mutt_mktemp(tempfile, sizeof(tempfile));
   if ((i = open(tempfile, O_WRONLY | O_EXCL | O_CREAT, 0600)) == -1 ||
@@ -1147,7 +2259,8 @@ static int mbox_sync_mailbox(CONTEXT *ctx, int *index_hint)
       newOffset[i - first].hdr = ftello(fp) + offset;
 
       if (mutt_copy_message(fp, ctx, ctx->hdrs[i], MUTT_CM_UPDATE,
-                            CH_FROM | CH_UPDATE | CH_UPDATE_LEN) != 0)
+                            CH_FROM | CH_UPDATE | CH_UPDATE_LEN |
+                                (option(OPTMBOXPADSTATUS) ? CH_PAD_STATUS : 0)) != 0)
       {
         mutt_perror(tempfile);
         mutt_sleep(5);
@@ -1314,6 +2427,12 @@ static int mbox_sync_mailbox(CONTEXT *ctx, int *index_hint)
   FREE(&newOffset);
   FREE(&oldOffset);
   unlink(tempfile); /* remove partial copy of the mailbox */
+
+#ifdef USE_HCACHE
+  hc = mutt_hcache_open(HeaderCache, ctx->path, NULL);
+  mbox_index_save(ctx, hc, first, true);
+  mutt_hcache_close(hc);
+#endif
   mutt_unblock_signals();
 
   if (option(OPTCHECKMBOXSIZE))
@@ -1390,6 +2509,11 @@ struct mx_ops mx_mbox_ops = {
     .open_new_msg = mbox_open_new_message,
     .check = mbox_check_mailbox,
     .sync = mbox_sync_mailbox,
+#ifdef USE_HCACHE
+    .compact_hcache = mbox_compact_hcache,
+    .open_hcache = mbox_open_hcache,
+    .hcache_key = mbox_hcache_key,
+#endif
 };
 
 struct mx_ops mx_mmdf_ops = {
@@ -1402,4 +2526,9 @@ struct mx_ops mx_mmdf_ops = {
     .open_new_msg = mbox_open_new_message,
     .check = mbox_check_mailbox,
     .sync = mbox_sync_mailbox,
+#ifdef USE_HCACHE
+    .compact_hcache = mbox_compact_hcache,
+    .open_hcache = mbox_open_hcache,
+    .hcache_key = mbox_hcache_key,
+#endif
 };
@@ -28,6 +28,10 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#include <signal.h>
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -45,6 +49,10 @@
 #ifdef HAVE_SYS_TIME_H
 #include <sys/time.h>
 #endif
+#ifdef USE_INOTIFY
+#include <sys/inotify.h>
+#include <sys/vfs.h>
+#endif
 #ifdef USE_NOTMUCH
 #include "mutt_notmuch.h"
 #endif
@@ -78,6 +86,12 @@ struct mh_data
 {
   time_t mtime_cur;
   mode_t mh_umask;
+#ifdef USE_INOTIFY
+  bool watching; /* inotify_fd is valid */
+  int inotify_fd;
+  int wd[2];     /* watches on new and cur, or on the MH folder */
+  HASH *index;   /* canonical file name -> HEADER, built on demand */
+#endif
 };
 
 /* mh_sequences support */
@@ -91,6 +105,97 @@ static inline struct mh_data *mh_data(CONTEXT *ctx)
   return (struct mh_data *) ctx->data;
 }
 
+#ifdef USE_INOTIFY
+/* inotify does not report changes made by other hosts: keep polling the
+ * folders of these filesystems */
+static bool mh_remote_fs(const char *path)
+{
+  static const unsigned long remote[] = {
+    0x6969,     /* NFS */
+    0x517B,     /* SMB */
+    0xFF534D42, /* CIFS */
+    0xFE534D42, /* SMB2 */
+    0x65735546, /* FUSE */
+    0x73757245, /* CODA */
+    0x5346414F, /* AFS */
+    0x00C36400, /* CEPH */
+    0x01021997, /* 9P */
+  };
+  struct statfs sfs;
+
+  if (statfs(path, &sfs) != 0)
+    return true;
+
+  for (size_t i = 0; i < mutt_array_size(remote); i++)
+    if ((unsigned long) sfs.f_type == remote[i])
+      return true;
+
+  return false;
+}
+
+static void mh_unwatch(CONTEXT *ctx)
+{
+  struct mh_data *data = mh_data(ctx);
+
+  if (!data)
+    return;
+
+  hash_destroy(&data->index, NULL);
+  if (data->watching)
+  {
+    close(data->inotify_fd);
+    data->watching = false;
+  }
+}
+
+/**
+ * mh_watch - Start recording the changes made to a folder
+ * @ctx: Mailbox
+ *
+ * This must be done before the folder is scanned, so that no change goes
+ * unnoticed. If the folder cannot be watched, the check functions keep
+ * rescanning it.
+ */
+static void mh_watch(CONTEXT *ctx)
+{
+  struct mh_data *data = NULL;
+  char buf[_POSIX_PATH_MAX];
+  const uint32_t mask = IN_CREATE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE |
+                        IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+
+  if (!ctx->data)
+    ctx->data = safe_calloc(sizeof(struct mh_data), 1);
+  data = mh_data(ctx);
+
+  if (data->watching || mh_remote_fs(ctx->path))
+    return;
+
+  data->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (data->inotify_fd == -1)
+  {
+    mutt_debug(1, "mh_watch: inotify_init1: %s\n", strerror(errno));
+    return;
+  }
+  data->watching = true;
+
+  if (ctx->magic == MUTT_MAILDIR)
+  {
+    snprintf(buf, sizeof(buf), "%s/new", ctx->path);
+    data->wd[0] = inotify_add_watch(data->inotify_fd, buf, mask);
+    snprintf(buf, sizeof(buf), "%s/cur", ctx->path);
+    data->wd[1] = inotify_add_watch(data->inotify_fd, buf, mask);
+  }
+  else
+    data->wd[0] = data->wd[1] = inotify_add_watch(data->inotify_fd, ctx->path, mask);
+
+  if (data->wd[0] == -1 || data->wd[1] == -1)
+  {
+    mutt_debug(1, "mh_watch: %s: inotify_add_watch: %s\n", ctx->path, strerror(errno));
+    mh_unwatch(ctx);
+  }
+}
+#endif
+
 static void mhs_alloc(struct mh_sequences *mhs, int i)
 {
   int j;
@@ -484,10 +589,10 @@ static void mh_update_sequences(CONTEXT *ctx)
     if (ctx->hdrs[l]->deleted)
       continue;
 
-    if ((p = strrchr(ctx->hdrs[l]->path, '/')))
+    if ((p = strrchr(ctx->hdrs[l]->cold->path, '/')))
       p++;
     else
-      p = ctx->hdrs[l]->path;
+      p = ctx->hdrs[l]->cold->path;
 
     if (mutt_atoi(p, &i) < 0)
       continue;
@@ -610,10 +715,10 @@ static void mh_update_maildir(struct maildir *md, struct mh_sequences *mhs)
 
   for (; md; md = md->next)
   {
-    if ((p = strrchr(md->h->path, '/')))
+    if ((p = strrchr(md->h->cold->path, '/')))
       p++;
     else
-      p = md->h->path;
+      p = md->h->cold->path;
 
     if (mutt_atoi(p, &i) < 0)
       continue;
@@ -664,8 +769,8 @@ void maildir_parse_flags(HEADER *h, const char *path)
   {
     p += 3;
 
-    mutt_str_replace(&h->maildir_flags, p);
-    q = h->maildir_flags;
+    mutt_str_replace(&h->cold->maildir_flags, p);
+    q = h->cold->maildir_flags;
 
     while (*p)
     {
@@ -702,8 +807,8 @@ void maildir_parse_flags(HEADER *h, const char *path)
     }
   }
 
-  if (q == h->maildir_flags)
-    FREE(&h->maildir_flags);
+  if (q == h->cold->maildir_flags)
+    FREE(&h->cold->maildir_flags);
   else if (q)
     *q = '\0';
 }
@@ -833,10 +938,10 @@ static int maildir_parse_dir(CONTEXT *ctx, struct maildir ***last,
     {
       char tmp[_POSIX_PATH_MAX];
       snprintf(tmp, sizeof(tmp), "%s/%s", subdir, de->d_name);
-      h->path = safe_strdup(tmp);
+      h->cold->path = safe_strdup(tmp);
     }
     else
-      h->path = safe_strdup(de->d_name);
+      h->cold->path = safe_strdup(de->d_name);
 
     entry = safe_calloc(sizeof(struct maildir), 1);
     entry->h = h;
@@ -861,6 +966,13 @@ static int maildir_parse_dir(CONTEXT *ctx, struct maildir ***last,
 static bool maildir_add_to_context(CONTEXT *ctx, struct maildir *md)
 {
   int oldmsgcount = ctx->msgcount;
+  int count = 0;
+  struct maildir *p = NULL;
+
+  for (p = md; p; p = p->next)
+    if (p->h)
+      count++;
+  mx_reserve_memory(ctx, ctx->msgcount + count);
 
   while (md)
   {
@@ -873,9 +985,6 @@ static bool maildir_add_to_context(CONTEXT *ctx, struct maildir *md)
                  __FILE__, __LINE__, md->h->flagged ? "f" : "",
                  md->h->deleted ? "D" : "", md->h->replied ? "r" : "",
                  md->h->old ? "O" : "", md->h->read ? "R" : "");
-      if (ctx->msgcount == ctx->hdrmax)
-        mx_alloc_memory(ctx);
-
       ctx->hdrs[ctx->msgcount] = md->h;
       ctx->hdrs[ctx->msgcount]->index = ctx->msgcount;
       ctx->size += md->h->content->length + md->h->content->offset -
@@ -920,7 +1029,7 @@ static int md_cmp_inode(struct maildir *a, struct maildir *b)
 
 static int md_cmp_path(struct maildir *a, struct maildir *b)
 {
-  return strcmp(a->h->path, b->h->path);
+  return strcmp(a->h->cold->path, b->h->cold->path);
 }
 
 /*
@@ -1078,6 +1187,147 @@ static struct maildir *skip_duplicates(struct maildir *p, struct maildir **last)
 }
 #endif
 
+/* Upper bound for $maildir_parse_threads, and its value when set to 0 */
+#define MAILDIR_MAX_PARSE_THREADS 16
+
+/* The messages maildir_delayed_parsing() could not find in the header cache.
+ * They are parsed in any order, possibly by several threads, each filling
+ * the HEADER of the entries it takes and nothing else. */
+struct maildir_jobs
+{
+  int magic;
+  const char *folder;
+  struct maildir **md;
+  bool *ok;     /* whether each message could be parsed */
+  int count;
+  int alloc;
+  int next;     /* first message not taken yet */
+  int done;     /* messages parsed */
+#ifdef HAVE_PTHREAD
+  pthread_mutex_t lock;
+#endif
+};
+
+static void maildir_add_job(struct maildir_jobs *jobs, struct maildir *p)
+{
+  if (jobs->count == jobs->alloc)
+  {
+    jobs->alloc = jobs->alloc ? 2 * jobs->alloc : 256;
+    safe_realloc(&jobs->md, jobs->alloc * sizeof(struct maildir *));
+  }
+  jobs->md[jobs->count++] = p;
+}
+
+/**
+ * maildir_next_job - Take the next message to parse
+ * @jobs:     Messages to parse
+ * @finished: The caller has just parsed a message
+ * @done:     If not NULL, set to the number of messages parsed
+ * @retval n  Index of the message to parse
+ * @retval -1 All the messages have been taken
+ */
+static int maildir_next_job(struct maildir_jobs *jobs, bool finished, int *done)
+{
+  int i = -1;
+
+#ifdef HAVE_PTHREAD
+  pthread_mutex_lock(&jobs->lock);
+#endif
+  if (finished)
+    jobs->done++;
+  if (done)
+    *done = jobs->done;
+  if (jobs->next < jobs->count)
+    i = jobs->next++;
+#ifdef HAVE_PTHREAD
+  pthread_mutex_unlock(&jobs->lock);
+#endif
+
+  return i;
+}
+
+static bool maildir_do_job(struct maildir_jobs *jobs, int i)
+{
+  char fn[_POSIX_PATH_MAX];
+  struct maildir *p = jobs->md[i];
+
+  snprintf(fn, sizeof(fn), "%s/%s", jobs->folder, p->h->cold->path);
+  return maildir_parse_message(jobs->magic, fn, p->h->old, p->h) != NULL;
+}
+
+#ifdef HAVE_PTHREAD
+static void *maildir_parse_worker(void *data)
+{
+  struct maildir_jobs *jobs = data;
+  int i = maildir_next_job(jobs, false, NULL);
+
+  for (; i >= 0; i = maildir_next_job(jobs, true, NULL))
+    jobs->ok[i] = maildir_do_job(jobs, i);
+
+  return NULL;
+}
+#endif
+
+/**
+ * maildir_parse_jobs - Parse the messages which are not in the header cache
+ * @ctx:      Mailbox
+ * @jobs:     Messages to parse
+ * @progress: Progress bar, may be NULL
+ * @base:     Messages already accounted for in the progress bar
+ *
+ * The calling thread does its share of the work and reports the progress,
+ * while up to $maildir_parse_threads - 1 workers help it.
+ */
+static void maildir_parse_jobs(CONTEXT *ctx, struct maildir_jobs *jobs,
+                               progress_t *progress, int base)
+{
+  int i, done;
+#ifdef HAVE_PTHREAD
+  pthread_t threads[MAILDIR_MAX_PARSE_THREADS - 1];
+  sigset_t all, old;
+  int nthreads = MaildirParseThreads;
+  int started = 0;
+#endif
+
+  jobs->ok = safe_calloc(jobs->count, sizeof(bool));
+  jobs->magic = ctx->magic;
+  jobs->folder = ctx->path;
+
+#ifdef HAVE_PTHREAD
+  if (nthreads <= 0)
+    nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+  nthreads = MAX(1, MIN(MIN(nthreads, jobs->count), MAILDIR_MAX_PARSE_THREADS));
+
+  pthread_mutex_init(&jobs->lock, NULL);
+
+  /* leave the signals to the main thread */
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &old);
+  for (; started < nthreads - 1; started++)
+    if (pthread_create(&threads[started], NULL, maildir_parse_worker, jobs) != 0)
+      break;
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+  if (started)
+    mutt_debug(2, "maildir_parse_jobs: parsing %d messages with %d threads\n",
+               jobs->count, started + 1);
+#endif
+
+  i = maildir_next_job(jobs, false, NULL);
+  while (i >= 0)
+  {
+    jobs->ok[i] = maildir_do_job(jobs, i);
+    i = maildir_next_job(jobs, true, &done);
+    if (!ctx->quiet && progress)
+      mutt_progress_update(progress, base + done, -1);
+  }
+
+#ifdef HAVE_PTHREAD
+  while (started > 0)
+    pthread_join(threads[--started], NULL);
+  pthread_mutex_destroy(&jobs->lock);
+#endif
+}
+
 /*
  * This function does the second parsing pass
  */
@@ -1086,6 +1336,7 @@ static void maildir_delayed_parsing(CONTEXT *ctx, struct maildir **md, progress_
   struct maildir *p, *last = NULL;
   char fn[_POSIX_PATH_MAX];
   int count;
+  struct maildir_jobs jobs;
 #ifdef HAVE_DIRENT_D_INO
   int sort = 0;
 #endif
@@ -1113,15 +1364,18 @@ static void maildir_delayed_parsing(CONTEXT *ctx, struct maildir **md, progress_
         last->next = p;                                                        \
       sort = 1;                                                                \
       p = skip_duplicates(p, &last);                                           \
-      snprintf(fn, sizeof(fn), "%s/%s", ctx->path, p->h->path);                \
+      snprintf(fn, sizeof(fn), "%s/%s", ctx->path, p->h->cold->path);          \
     }                                                                          \
   } while (0)
 #else
 #define DO_SORT() /* nothing */
 #endif
 
+  memset(&jobs, 0, sizeof(jobs));
+
 #ifdef USE_HCACHE
   hc = mutt_hcache_open(HeaderCache, ctx->path, NULL);
+  mutt_hcache_begin(hc);
 #endif
 
   for (p = *md, count = 0; p; p = p->next, count++)
@@ -1133,11 +1387,11 @@ static void maildir_delayed_parsing(CONTEXT *ctx, struct maildir **md, progress_
     }
 
     if (!ctx->quiet && progress)
-      mutt_progress_update(progress, count, -1);
+      mutt_progress_update(progress, count - jobs.count, -1);
 
     DO_SORT();
 
-    snprintf(fn, sizeof(fn), "%s/%s", ctx->path, p->h->path);
+    snprintf(fn, sizeof(fn), "%s/%s", ctx->path, p->h->cold->path);
 
 #ifdef USE_HCACHE
     if (option(OPTHCACHEVERIFY))
@@ -1152,12 +1406,12 @@ static void maildir_delayed_parsing(CONTEXT *ctx, struct maildir **md, progress_
 
     if (ctx->magic == MUTT_MH)
     {
-      key = p->h->path;
+      key = p->h->cold->path;
       keylen = strlen(key);
     }
     else
     {
-      key = p->h->path + 3;
+      key = p->h->cold->path + 3;
       keylen = maildir_hcache_keylen(key);
     }
     data = mutt_hcache_fetch(hc, key, keylen);
@@ -1167,7 +1421,7 @@ static void maildir_delayed_parsing(CONTEXT *ctx, struct maildir **md, progress_
     {
       HEADER *h = mutt_hcache_restore((unsigned char *) data);
       h->old = p->h->old;
-      h->path = safe_strdup(p->h->path);
+      h->cold->path = safe_strdup(p->h->cold->path);
       mutt_free_header(&p->h);
       p->h = h;
       if (ctx->magic == MUTT_MAILDIR)
@@ -1177,32 +1431,47 @@ static void maildir_delayed_parsing(CONTEXT *ctx, struct maildir **md, progress_
     {
 #endif /* USE_HCACHE */
 
-      if (maildir_parse_message(ctx->magic, fn, p->h->old, p->h))
-      {
-        p->header_parsed = 1;
-#ifdef USE_HCACHE
-        if (ctx->magic == MUTT_MH)
-        {
-          key = p->h->path;
-          keylen = strlen(key);
-        }
-        else
-        {
-          key = p->h->path + 3;
-          keylen = maildir_hcache_keylen(key);
-        }
-        mutt_hcache_store(hc, key, keylen, p->h, 0);
-#endif
-      }
-      else
-        mutt_free_header(&p->h);
+      /* parsed below, possibly on several threads */
+      maildir_add_job(&jobs, p);
 #ifdef USE_HCACHE
     }
     mutt_hcache_free(hc, &data);
 #endif
     last = p;
   }
+
+  if (jobs.count)
+    maildir_parse_jobs(ctx, &jobs, progress, count - jobs.count);
+
+  /* merge the results in order, as if the messages had been parsed above */
+  for (int i = 0; i < jobs.count; i++)
+  {
+    p = jobs.md[i];
+    if (jobs.ok[i])
+    {
+      p->header_parsed = 1;
+#ifdef USE_HCACHE
+      if (ctx->magic == MUTT_MH)
+      {
+        key = p->h->cold->path;
+        keylen = strlen(key);
+      }
+      else
+      {
+        key = p->h->cold->path + 3;
+        keylen = maildir_hcache_keylen(key);
+      }
+      mutt_hcache_store(hc, key, keylen, p->h, 0);
+#endif
+    }
+    else
+      mutt_free_header(&p->h);
+  }
+  FREE(&jobs.md);
+  FREE(&jobs.ok);
+
 #ifdef USE_HCACHE
+  mutt_hcache_commit(hc);
   mutt_hcache_close(hc);
 #endif
 
@@ -1213,11 +1482,59 @@ static void maildir_delayed_parsing(CONTEXT *ctx, struct maildir **md, progress_
 
 static int mh_close_mailbox(CONTEXT *ctx)
 {
+#ifdef USE_INOTIFY
+  mh_unwatch(ctx);
+#endif
   FREE(&ctx->data);
 
   return 0;
 }
 
+#ifdef USE_HCACHE
+static int mh_compact_hcache(CONTEXT *ctx, bool force, long *reclaimed)
+{
+  header_cache_t *hc = NULL;
+  HASH *keys = NULL;
+  int rc;
+
+  hc = mutt_hcache_open(HeaderCache, ctx->path, NULL);
+  if (!hc)
+    return -1;
+
+  /* the keys used by maildir_delayed_parsing() and mh_sync_mailbox_message() */
+  keys = hash_create(ctx->msgcount + 1, 0);
+  for (int i = 0; i < ctx->msgcount; i++)
+  {
+    HEADER *h = ctx->hdrs[i];
+    hash_insert(keys, (ctx->magic == MUTT_MH) ? h->cold->path : h->cold->path + 3,
+                h);
+  }
+  hash_insert(keys, HCACHE_THREADS_KEY, ctx);
+
+  rc = mutt_hcache_compact(hc, mutt_hcache_keep_hash, keys, force, reclaimed);
+
+  hash_destroy(&keys, NULL);
+  mutt_hcache_close(hc);
+  return rc;
+}
+
+static header_cache_t *mh_open_hcache(CONTEXT *ctx)
+{
+  return mutt_hcache_open(HeaderCache, ctx->path, NULL);
+}
+
+/* a maildir file name is unique, but MH message numbers are reused: the date
+ * the message was received tells them apart */
+static int mh_hcache_key(CONTEXT *ctx, HEADER *h, char *buf, size_t buflen)
+{
+  const char *key = h->cold->path + 3;
+
+  if (ctx->magic == MUTT_MH)
+    return snprintf(buf, buflen, "%s:%ld", h->cold->path, (long) h->received);
+  return snprintf(buf, buflen, "%.*s", (int) maildir_hcache_keylen(key), key);
+}
+#endif
+
 /* Read a MH/maildir style mailbox.
  *
  * args:
@@ -1296,7 +1613,17 @@ static int maildir_read_dir(CONTEXT *ctx)
 
 static int maildir_open_mailbox(CONTEXT *ctx)
 {
+#ifdef USE_INOTIFY
+  mh_watch(ctx);
+  if (maildir_read_dir(ctx) == -1)
+  {
+    mh_unwatch(ctx);
+    return -1;
+  }
+  return 0;
+#else
   return maildir_read_dir(ctx);
+#endif
 }
 
 static int maildir_open_mailbox_append(CONTEXT *ctx, int flags)
@@ -1347,7 +1674,17 @@ static int maildir_open_mailbox_append(CONTEXT *ctx, int flags)
 
 static int mh_open_mailbox(CONTEXT *ctx)
 {
+#ifdef USE_INOTIFY
+  mh_watch(ctx);
+  if (mh_read_dir(ctx, NULL) == -1)
+  {
+    mh_unwatch(ctx);
+    return -1;
+  }
+  return 0;
+#else
   return mh_read_dir(ctx, NULL);
+#endif
 }
 
 static int mh_open_mailbox_append(CONTEXT *ctx, int flags)
@@ -1404,13 +1741,13 @@ void maildir_flags(char *dest, size_t destlen, HEADER *hdr)
    */
 
   if (hdr && (hdr->flagged || hdr->replied || hdr->read || hdr->deleted ||
-              hdr->old || hdr->maildir_flags))
+              hdr->old || hdr->cold->maildir_flags))
   {
     char tmp[LONG_STRING];
     snprintf(tmp, sizeof(tmp), "%s%s%s%s%s", hdr->flagged ? "F" : "",
              hdr->replied ? "R" : "", hdr->read ? "S" : "",
-             hdr->deleted ? "T" : "", NONULL(hdr->maildir_flags));
-    if (hdr->maildir_flags)
+             hdr->deleted ? "T" : "", NONULL(hdr->cold->maildir_flags));
+    if (hdr->cold->maildir_flags)
       qsort(tmp, strlen(tmp), 1, ch_compar);
     snprintf(dest, destlen, ":2,%s", tmp);
   }
@@ -1421,11 +1758,11 @@ static int maildir_mh_open_message(CONTEXT *ctx, MESSAGE *msg, int msgno, int is
   HEADER *cur = ctx->hdrs[msgno];
   char path[_POSIX_PATH_MAX];
 
-  snprintf(path, sizeof(path), "%s/%s", ctx->path, cur->path);
+  snprintf(path, sizeof(path), "%s/%s", ctx->path, cur->cold->path);
 
   msg->fp = fopen(path, "r");
   if (msg->fp == NULL && errno == ENOENT && is_maildir)
-    msg->fp = maildir_open_find_message(ctx->path, cur->path, NULL);
+    msg->fp = maildir_open_find_message(ctx->path, cur->cold->path, NULL);
 
   if (!msg->fp)
   {
@@ -1600,10 +1937,10 @@ static int _maildir_commit_message(CONTEXT *ctx, MESSAGE *msg, HEADER *hdr)
 
 #ifdef USE_NOTMUCH
       if (ctx->magic == MUTT_NOTMUCH)
-        nm_update_filename(ctx, hdr->path, full, hdr);
+        nm_update_filename(ctx, hdr->cold->path, full, hdr);
 #endif
       if (hdr)
-        mutt_str_replace(&hdr->path, path);
+        mutt_str_replace(&hdr->cold->path, path);
       mutt_str_replace(&msg->commited_path, full);
       FREE(&msg->path);
 
@@ -1689,7 +2026,7 @@ static int _mh_commit_message(CONTEXT *ctx, MESSAGE *msg, HEADER *hdr, short upd
     if (safe_rename(msg->path, path) == 0)
     {
       if (hdr)
-        mutt_str_replace(&hdr->path, tmp);
+        mutt_str_replace(&hdr->cold->path, tmp);
       mutt_str_replace(&msg->commited_path, path);
       FREE(&msg->path);
       break;
@@ -1737,8 +2074,8 @@ static int mh_rewrite_message(CONTEXT *ctx, int msgno)
 
   if ((rc = mutt_copy_message(dest->fp, ctx, h, MUTT_CM_UPDATE, CH_UPDATE | CH_UPDATE_LEN)) == 0)
   {
-    snprintf(oldpath, _POSIX_PATH_MAX, "%s/%s", ctx->path, h->path);
-    strfcpy(partpath, h->path, _POSIX_PATH_MAX);
+    snprintf(oldpath, _POSIX_PATH_MAX, "%s/%s", ctx->path, h->cold->path);
+    strfcpy(partpath, h->cold->path, _POSIX_PATH_MAX);
 
     if (ctx->magic == MUTT_MAILDIR)
       rc = _maildir_commit_message(ctx, dest, h);
@@ -1770,9 +2107,9 @@ static int mh_rewrite_message(CONTEXT *ctx, int msgno)
 
     if (ctx->magic == MUTT_MH && rc == 0)
     {
-      snprintf(newpath, _POSIX_PATH_MAX, "%s/%s", ctx->path, h->path);
+      snprintf(newpath, _POSIX_PATH_MAX, "%s/%s", ctx->path, h->cold->path);
       if ((rc = safe_rename(newpath, oldpath)) == 0)
-        mutt_str_replace(&h->path, partpath);
+        mutt_str_replace(&h->cold->path, partpath);
     }
   }
   else
@@ -1823,9 +2160,9 @@ static int maildir_sync_message(CONTEXT *ctx, int msgno)
     char suffix[16];
     char *p = NULL;
 
-    if ((p = strrchr(h->path, '/')) == NULL)
+    if ((p = strrchr(h->cold->path, '/')) == NULL)
     {
-      mutt_debug(1, "maildir_sync_message: %s: unable to find subdir!\n", h->path);
+      mutt_debug(1, "maildir_sync_message: %s: unable to find subdir!\n", h->cold->path);
       return -1;
     }
     p++;
@@ -1840,7 +2177,7 @@ static int maildir_sync_message(CONTEXT *ctx, int msgno)
     snprintf(partpath, sizeof(partpath), "%s/%s%s",
              (h->read || h->old) ? "cur" : "new", newpath, suffix);
     snprintf(fullpath, sizeof(fullpath), "%s/%s", ctx->path, partpath);
-    snprintf(oldpath, sizeof(oldpath), "%s/%s", ctx->path, h->path);
+    snprintf(oldpath, sizeof(oldpath), "%s/%s", ctx->path, h->cold->path);
 
     if (mutt_strcmp(fullpath, oldpath) == 0)
     {
@@ -1856,7 +2193,7 @@ static int maildir_sync_message(CONTEXT *ctx, int msgno)
       mutt_perror("rename");
       return -1;
     }
-    mutt_str_replace(&h->path, partpath);
+    mutt_str_replace(&h->cold->path, partpath);
   }
   return 0;
 }
@@ -1876,7 +2213,7 @@ int mh_sync_mailbox_message(CONTEXT *ctx, int msgno)
 
   if (h->deleted && (ctx->magic != MUTT_MAILDIR || !option(OPTMAILDIRTRASH)))
   {
-    snprintf(path, sizeof(path), "%s/%s", ctx->path, h->path);
+    snprintf(path, sizeof(path), "%s/%s", ctx->path, h->cold->path);
     if (ctx->magic == MUTT_MAILDIR || (option(OPTMHPURGE) && ctx->magic == MUTT_MH))
     {
 #ifdef USE_HCACHE
@@ -1884,12 +2221,12 @@ int mh_sync_mailbox_message(CONTEXT *ctx, int msgno)
       {
         if (ctx->magic == MUTT_MH)
         {
-          key = h->path;
+          key = h->cold->path;
           keylen = strlen(key);
         }
         else
         {
-          key = h->path + 3;
+          key = h->cold->path + 3;
           keylen = maildir_hcache_keylen(key);
         }
         mutt_hcache_delete(hc, key, keylen);
@@ -1900,9 +2237,9 @@ int mh_sync_mailbox_message(CONTEXT *ctx, int msgno)
     else if (ctx->magic == MUTT_MH)
     {
       /* MH just moves files out of the way when you delete them */
-      if (*h->path != ',')
+      if (*h->cold->path != ',')
       {
-        snprintf(tmp, sizeof(tmp), "%s/,%s", ctx->path, h->path);
+        snprintf(tmp, sizeof(tmp), "%s/,%s", ctx->path, h->cold->path);
         unlink(tmp);
         rename(path, tmp);
       }
@@ -1929,12 +2266,12 @@ int mh_sync_mailbox_message(CONTEXT *ctx, int msgno)
   {
     if (ctx->magic == MUTT_MH)
     {
-      key = h->path;
+      key = h->cold->path;
       keylen = strlen(key);
     }
     else
     {
-      key = h->path + 3;
+      key = h->cold->path + 3;
       keylen = maildir_hcache_keylen(key);
     }
     mutt_hcache_store(hc, key, keylen, h, 0);
@@ -1982,10 +2319,379 @@ static void maildir_update_tables(CONTEXT *ctx, int *index_hint)
       ctx->hdrs[i]->index = j++;
   }
 
+#ifdef USE_INOTIFY
+  /* expunged headers are about to be freed */
+  hash_destroy(&mh_data(ctx)->index, NULL);
+#endif
+
   mx_update_tables(ctx, 0);
   mutt_clear_threads(ctx);
 }
 
+#ifdef USE_INOTIFY
+/* Outcome of mh_read_events() */
+enum
+{
+  MH_EVENTS_OK = 0, /* the changes, if any, are in the list */
+  MH_EVENTS_LOST,   /* the queue overflowed: rescan the folder */
+};
+
+/**
+ * mh_read_events - Collect the names of the files changed since the last call
+ * @ctx:   Mailbox
+ * @names: List of names relative to the folder, each listed once
+ * @retval num MH_EVENTS_OK or MH_EVENTS_LOST
+ *
+ * Folders which are not watched (any more) report MH_EVENTS_LOST.
+ */
+static int mh_read_events(CONTEXT *ctx, LIST **names)
+{
+  struct mh_data *data = mh_data(ctx);
+  union {
+    struct inotify_event ev;
+    char buf[4096];
+  } u;
+  HASH *seen = NULL;
+  bool lost = false;
+  bool gone = false;
+  ssize_t len;
+
+  *names = NULL;
+  if (!data || !data->watching)
+    return MH_EVENTS_LOST;
+
+  while ((len = read(data->inotify_fd, u.buf, sizeof(u.buf))) > 0)
+  {
+    for (char *p = u.buf; p < u.buf + len;)
+    {
+      struct inotify_event *ev = (struct inotify_event *) p;
+      char name[_POSIX_PATH_MAX];
+
+      p += sizeof(struct inotify_event) + ev->len;
+
+      if (ev->mask & IN_Q_OVERFLOW)
+        lost = true;
+      if (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED | IN_UNMOUNT))
+        gone = true;
+      if (!ev->len || lost || gone)
+        continue;
+
+      if (ctx->magic == MUTT_MAILDIR)
+        snprintf(name, sizeof(name), "%s/%s", (ev->wd == data->wd[0]) ? "new" : "cur", ev->name);
+      else
+        strfcpy(name, ev->name, sizeof(name));
+
+      if (!seen)
+        seen = hash_create(31, 0);
+      if (hash_find(seen, name))
+        continue;
+
+      LIST *l = safe_calloc(1, sizeof(LIST));
+      l->data = safe_strdup(name);
+      l->next = *names;
+      *names = l;
+      hash_insert(seen, l->data, l);
+    }
+  }
+  hash_destroy(&seen, NULL);
+
+  if (len == -1 && errno != EAGAIN)
+    gone = true;
+
+  if (gone)
+  {
+    mutt_debug(1, "mh_read_events: %s is no longer watched\n", ctx->path);
+    mh_unwatch(ctx);
+  }
+  if (lost || gone)
+  {
+    mutt_free_list(names);
+    return MH_EVENTS_LOST;
+  }
+
+  return MH_EVENTS_OK;
+}
+
+/* The key of a message in mh_data::index */
+static char *mh_index_key(CONTEXT *ctx, const char *path, char *buf, size_t buflen)
+{
+  if (ctx->magic == MUTT_MAILDIR)
+    return maildir_canon_filename(buf, path, buflen);
+
+  strfcpy(buf, path, buflen);
+  return buf;
+}
+
+static void mh_index_add(CONTEXT *ctx, HEADER *h)
+{
+  char buf[_POSIX_PATH_MAX];
+
+  hash_insert(mh_data(ctx)->index, mh_index_key(ctx, h->cold->path, buf, sizeof(buf)), h);
+}
+
+static HEADER *mh_index_find(CONTEXT *ctx, const char *path)
+{
+  struct mh_data *data = mh_data(ctx);
+  char buf[_POSIX_PATH_MAX];
+
+  if (!data->index)
+  {
+    data->index = hash_create(MAX(1031, ctx->msgcount * 2), MUTT_HASH_STRDUP_KEYS);
+    for (int i = 0; i < ctx->msgcount; i++)
+      mh_index_add(ctx, ctx->hdrs[i]);
+  }
+
+  return hash_find(data->index, mh_index_key(ctx, path, buf, sizeof(buf)));
+}
+
+/* The list holds HEADERs owned by the mailbox */
+static void mh_gone_add(LIST **gone, HEADER *h)
+{
+  LIST *g = safe_calloc(1, sizeof(LIST));
+  g->data = (char *) h;
+  g->next = *gone;
+  *gone = g;
+}
+
+static void mh_gone_free(LIST **gone)
+{
+  while (*gone)
+  {
+    LIST *g = *gone;
+    *gone = g->next;
+    FREE(&g);
+  }
+}
+
+/* Remove the messages of the list from the mailbox */
+static void mh_expunge_gone(CONTEXT *ctx, LIST **gone, int *index_hint)
+{
+  for (int i = 0; i < ctx->msgcount; i++)
+    ctx->hdrs[i]->active = true;
+  for (LIST *g = *gone; g; g = g->next)
+    ((HEADER *) g->data)->active = false;
+  mh_gone_free(gone);
+
+  maildir_update_tables(ctx, index_hint);
+}
+
+/* Add the messages of the list to the mailbox and to its index */
+static bool mh_add_new(CONTEXT *ctx, struct maildir **md)
+{
+  int old_count = ctx->msgcount;
+  bool have_new = maildir_move_to_context(ctx, md);
+
+  if (mh_data(ctx)->index)
+    for (int i = old_count; i < ctx->msgcount; i++)
+      mh_index_add(ctx, ctx->hdrs[i]);
+
+  return have_new;
+}
+
+/**
+ * maildir_apply_events - Update a maildir mailbox from the files changed
+ * @ctx:        Mailbox
+ * @names:      Files created, renamed or removed, from mh_read_events()
+ * @index_hint: Current message, updated if messages are removed
+ * @retval num  MUTT_REOPENED, MUTT_NEW_MAIL or 0, as maildir_check_mailbox()
+ *
+ * The files are looked at as they are now rather than as the events tell,
+ * so that the events can be applied in any order, several times, or after
+ * mutt itself renamed the files.
+ */
+static int maildir_apply_events(CONTEXT *ctx, LIST *names, int *index_hint)
+{
+  struct maildir *md = NULL, **last = &md;
+  LIST *gone = NULL, *l = NULL;
+  char fn[_POSIX_PATH_MAX];
+  struct stat st;
+  HEADER *h = NULL;
+  bool occult = false;
+  bool have_new = false;
+
+  for (l = names; l; l = l->next)
+  {
+    const char *name = l->data + 4; /* skip new/ or cur/ */
+    if (*name == '.')
+      continue;
+
+    h = mh_index_find(ctx, l->data);
+    snprintf(fn, sizeof(fn), "%s/%s", ctx->path, l->data);
+    if (stat(fn, &st) == 0)
+    {
+      HEADER *n = mutt_new_header();
+      n->old = (strncmp(l->data, "cur/", 4) == 0);
+      maildir_parse_flags(n, name);
+
+      if (!h)
+      {
+        /* new message */
+        struct maildir *entry = safe_calloc(sizeof(struct maildir), 1);
+        n->cold->path = safe_strdup(l->data);
+        entry->h = n;
+#ifdef HAVE_DIRENT_D_INO
+        entry->inode = st.st_ino;
+#endif
+        *last = entry;
+        last = &entry->next;
+        continue;
+      }
+
+      /* moved or flagged by another program: as in maildir_check_mailbox() */
+      if (mutt_strcmp(h->cold->path, l->data) != 0)
+      {
+        mutt_str_replace(&h->cold->path, l->data);
+        if (!h->changed)
+          maildir_update_flags(ctx, h, n);
+        if (h->deleted == h->trash)
+          h->deleted = n->deleted;
+        h->trash = n->trash;
+      }
+      mutt_free_header(&n);
+    }
+    else if (h && (mutt_strcmp(h->cold->path, l->data) == 0))
+    {
+      /* maybe renamed: this is settled once all the names are known */
+      mh_gone_add(&gone, h);
+    }
+  }
+
+  /* still under the name which disappeared: removed */
+  for (LIST **g = &gone; *g;)
+  {
+    h = (HEADER *) (*g)->data;
+    snprintf(fn, sizeof(fn), "%s/%s", ctx->path, h->cold->path);
+    if (access(fn, F_OK) == 0)
+    {
+      LIST *dead = *g;
+      *g = dead->next;
+      FREE(&dead);
+    }
+    else
+      g = &(*g)->next;
+  }
+
+  if (gone)
+  {
+    occult = true;
+    mh_expunge_gone(ctx, &gone, index_hint);
+  }
+
+  if (md)
+  {
+    maildir_delayed_parsing(ctx, &md, NULL);
+    have_new = mh_add_new(ctx, &md);
+  }
+
+  return occult ? MUTT_REOPENED : (have_new ? MUTT_NEW_MAIL : 0);
+}
+
+/**
+ * mh_apply_events - Update an MH mailbox from the files changed
+ * @ctx:        Mailbox
+ * @names:      Files created, renamed or removed, from mh_read_events()
+ * @index_hint: Current message, updated if messages are removed
+ * @retval num  MUTT_REOPENED, MUTT_NEW_MAIL or 0, as mh_check_mailbox()
+ */
+static int mh_apply_events(CONTEXT *ctx, LIST *names, int *index_hint)
+{
+  struct maildir *md = NULL, **last = &md, *p = NULL;
+  struct mh_sequences mhs;
+  LIST *gone = NULL, *l = NULL;
+  char fn[_POSIX_PATH_MAX];
+  bool sequences = false;
+  bool occult = false;
+  bool have_new = false;
+  HEADER *h = NULL;
+
+  for (l = names; l; l = l->next)
+  {
+    if (mutt_strcmp(l->data, ".mh_sequences") == 0)
+      sequences = true;
+    if (!mh_valid_message(l->data))
+      continue;
+
+    snprintf(fn, sizeof(fn), "%s/%s", ctx->path, l->data);
+    if (access(fn, F_OK) == 0)
+    {
+      /* new or rewritten: told apart once parsed */
+      struct maildir *entry = safe_calloc(sizeof(struct maildir), 1);
+      entry->h = mutt_new_header();
+      entry->h->cold->path = safe_strdup(l->data);
+      *last = entry;
+      last = &entry->next;
+    }
+    else if ((h = mh_index_find(ctx, l->data)))
+      mh_gone_add(&gone, h);
+  }
+
+  if (!md && !gone && !sequences)
+    return 0;
+
+  memset(&mhs, 0, sizeof(mhs));
+  if (mh_read_sequences(&mhs, ctx->path) < 0)
+  {
+    maildir_free_maildir(&md);
+    mh_gone_free(&gone);
+    return -1;
+  }
+
+  if (md)
+  {
+    maildir_delayed_parsing(ctx, &md, NULL);
+    mh_update_maildir(md, &mhs);
+
+    for (p = md; p; p = p->next)
+    {
+      if (!p->h || !(h = mh_index_find(ctx, p->h->cold->path)))
+        continue;
+
+      if (mbox_strict_cmp_headers(h, p->h))
+      {
+        /* the same message: as in mh_check_mailbox() */
+        if (!h->changed)
+          maildir_update_flags(ctx, h, p->h);
+        mutt_free_header(&p->h);
+      }
+      else
+        mh_gone_add(&gone, h); /* another message under the same name */
+    }
+  }
+
+  if (sequences)
+  {
+    for (int i = 0; i < ctx->msgcount; i++)
+    {
+      HEADER n;
+      int num;
+      short f;
+
+      h = ctx->hdrs[i];
+      if (h->changed || (mutt_atoi(h->cold->path, &num) < 0))
+        continue;
+
+      f = mhs_check(&mhs, num);
+      memcpy(&n, h, sizeof(n));
+      n.read = (f & MH_SEQ_UNSEEN) ? false : true;
+      n.flagged = (f & MH_SEQ_FLAGGED) ? true : false;
+      n.replied = (f & MH_SEQ_REPLIED) ? true : false;
+      maildir_update_flags(ctx, h, &n);
+    }
+  }
+  mhs_free_sequences(&mhs);
+
+  if (gone)
+  {
+    occult = true;
+    mh_expunge_gone(ctx, &gone, index_hint);
+  }
+
+  have_new = mh_add_new(ctx, &md);
+
+  return occult ? MUTT_REOPENED : (have_new ? MUTT_NEW_MAIL : 0);
+}
+#endif /* USE_INOTIFY */
+
 /* This function handles arrival of new mail and reopening of
  * maildir folders.  The basic idea here is we check to see if either
  * the new or cur subdirectories have changed, and if so, we scan them
@@ -2009,6 +2715,10 @@ static int maildir_check_mailbox(CONTEXT *ctx, int *index_hint)
   HASH *fnames = NULL; /* hash table for quickly looking up the base filename
                                    for a maildir message */
   struct mh_data *data = mh_data(ctx);
+#ifdef USE_INOTIFY
+  LIST *names = NULL; /* files changed since the last check */
+  int events;
+#endif
 
   /* XXX seems like this check belongs in mx_check_mailbox()
    * rather than here.
@@ -2016,13 +2726,21 @@ static int maildir_check_mailbox(CONTEXT *ctx, int *index_hint)
   if (!option(OPTCHECKNEW))
     return 0;
 
+#ifdef USE_INOTIFY
+  events = mh_read_events(ctx, &names);
+#endif
+
   snprintf(buf, sizeof(buf), "%s/new", ctx->path);
-  if (stat(buf, &st_new) == -1)
-    return -1;
+  i = stat(buf, &st_new);
 
   snprintf(buf, sizeof(buf), "%s/cur", ctx->path);
-  if (stat(buf, &st_cur) == -1)
+  if (i == -1 || stat(buf, &st_cur) == -1)
+  {
+#ifdef USE_INOTIFY
+    mutt_free_list(&names);
+#endif
     return -1;
+  }
 
   /* determine which subdirectories need to be scanned */
   if (st_new.st_mtime > ctx->mtime)
@@ -2030,9 +2748,30 @@ static int maildir_check_mailbox(CONTEXT *ctx, int *index_hint)
   if (st_cur.st_mtime > data->mtime_cur)
     changed |= 2;
 
+#ifdef USE_INOTIFY
+  if (names)
+  {
+    /* only the files named by the events need to be looked at */
+    data->mtime_cur = st_cur.st_mtime;
+    ctx->mtime = st_new.st_mtime;
+    i = maildir_apply_events(ctx, names, index_hint);
+    mutt_free_list(&names);
+    return i;
+  }
+
+  /* events were dropped: look at everything */
+  if (events == MH_EVENTS_LOST && data->watching)
+    changed = 3;
+#endif
+
   if (!changed)
     return 0; /* nothing to do */
 
+#ifdef USE_INOTIFY
+  /* it would miss the messages found below */
+  hash_destroy(&data->index, NULL);
+#endif
+
   /* update the modification times on the mailbox */
   data->mtime_cur = st_cur.st_mtime;
   ctx->mtime = st_new.st_mtime;
@@ -2055,7 +2794,7 @@ static int maildir_check_mailbox(CONTEXT *ctx, int *index_hint)
 
   for (p = md; p; p = p->next)
   {
-    maildir_canon_filename(buf, p->h->path, sizeof(buf));
+    maildir_canon_filename(buf, p->h->cold->path, sizeof(buf));
     p->canon_fname = safe_strdup(buf);
     hash_insert(fnames, p->canon_fname, p);
   }
@@ -2064,7 +2803,7 @@ static int maildir_check_mailbox(CONTEXT *ctx, int *index_hint)
   for (i = 0; i < ctx->msgcount; i++)
   {
     ctx->hdrs[i]->active = false;
-    maildir_canon_filename(buf, ctx->hdrs[i]->path, sizeof(buf));
+    maildir_canon_filename(buf, ctx->hdrs[i]->cold->path, sizeof(buf));
     p = hash_find(fnames, buf);
     if (p && p->h)
     {
@@ -2074,8 +2813,8 @@ static int maildir_check_mailbox(CONTEXT *ctx, int *index_hint)
       /* check to see if the message has moved to a different
        * subdirectory.  If so, update the associated filename.
        */
-      if (mutt_strcmp(ctx->hdrs[i]->path, p->h->path) != 0)
-        mutt_str_replace(&ctx->hdrs[i]->path, p->h->path);
+      if (mutt_strcmp(ctx->hdrs[i]->cold->path, p->h->cold->path) != 0)
+        mutt_str_replace(&ctx->hdrs[i]->cold->path, p->h->cold->path);
 
       /* if the user hasn't modified the flags on this message, update
        * the flags we just detected.
@@ -2094,8 +2833,10 @@ static int maildir_check_mailbox(CONTEXT *ctx, int *index_hint)
      * Check to see if we have enough information to know if the
      * message has disappeared out from underneath us.
      */
-    else if (((changed & 1) && (strncmp(ctx->hdrs[i]->path, "new/", 4) == 0)) ||
-             ((changed & 2) && (strncmp(ctx->hdrs[i]->path, "cur/", 4) == 0)))
+    else if (((changed & 1) &&
+              (strncmp(ctx->hdrs[i]->cold->path, "new/", 4) == 0)) ||
+             ((changed & 2) &&
+              (strncmp(ctx->hdrs[i]->cold->path, "cur/", 4) == 0)))
     {
       /* This message disappeared, so we need to simulate a "reopen"
        * event.  We know it disappeared because we just scanned the
@@ -2150,13 +2891,26 @@ static int mh_check_mailbox(CONTEXT *ctx, int *index_hint)
   HASH *fnames = NULL;
   int i;
   struct mh_data *data = mh_data(ctx);
+#ifdef USE_INOTIFY
+  LIST *names = NULL; /* files changed since the last check */
+  int events;
+#endif
 
   if (!option(OPTCHECKNEW))
     return 0;
 
+#ifdef USE_INOTIFY
+  events = mh_read_events(ctx, &names);
+#endif
+
   strfcpy(buf, ctx->path, sizeof(buf));
   if (stat(buf, &st) == -1)
+  {
+#ifdef USE_INOTIFY
+    mutt_free_list(&names);
+#endif
     return -1;
+  }
 
   /* create .mh_sequences when there isn't one. */
   snprintf(buf, sizeof(buf), "%s/.mh_sequences", ctx->path);
@@ -2180,9 +2934,30 @@ static int mh_check_mailbox(CONTEXT *ctx, int *index_hint)
   if (st.st_mtime > ctx->mtime || st_cur.st_mtime > data->mtime_cur)
     modified = 1;
 
+#ifdef USE_INOTIFY
+  if (names)
+  {
+    /* only the files named by the events need to be looked at */
+    data->mtime_cur = st_cur.st_mtime;
+    ctx->mtime = st.st_mtime;
+    i = mh_apply_events(ctx, names, index_hint);
+    mutt_free_list(&names);
+    return i;
+  }
+
+  /* events were dropped: look at everything */
+  if (events == MH_EVENTS_LOST && data->watching)
+    modified = 1;
+#endif
+
   if (!modified)
     return 0;
 
+#ifdef USE_INOTIFY
+  /* it would miss the messages found below */
+  hash_destroy(&data->index, NULL);
+#endif
+
   data->mtime_cur = st_cur.st_mtime;
   ctx->mtime = st.st_mtime;
 
@@ -2205,7 +2980,7 @@ static int mh_check_mailbox(CONTEXT *ctx, int *index_hint)
   for (p = md; p; p = p->next)
   {
     /* the hash key must survive past the header, which is freed below. */
-    p->canon_fname = safe_strdup(p->h->path);
+    p->canon_fname = safe_strdup(p->h->cold->path);
     hash_insert(fnames, p->canon_fname, p);
   }
 
@@ -2213,7 +2988,7 @@ static int mh_check_mailbox(CONTEXT *ctx, int *index_hint)
   {
     ctx->hdrs[i]->active = false;
 
-    if ((p = hash_find(fnames, ctx->hdrs[i]->path)) && p->h &&
+    if ((p = hash_find(fnames, ctx->hdrs[i]->cold->path)) && p->h &&
         (mbox_strict_cmp_headers(ctx->hdrs[i], p->h)))
     {
       ctx->hdrs[i]->active = true;
@@ -2258,6 +3033,11 @@ static int mh_sync_mailbox(CONTEXT *ctx, int *index_hint)
   if (i != 0)
     return i;
 
+#ifdef USE_INOTIFY
+  /* messages may be renamed here, and expunged headers freed afterwards */
+  hash_destroy(&mh_data(ctx)->index, NULL);
+#endif
+
 #ifdef USE_HCACHE
   if (ctx->magic == MUTT_MAILDIR || ctx->magic == MUTT_MH)
     hc = mutt_hcache_open(HeaderCache, ctx->path, NULL);
@@ -2563,6 +3343,11 @@ struct mx_ops mx_maildir_ops = {
     .open_new_msg = maildir_open_new_message,
     .check = maildir_check_mailbox,
     .sync = mh_sync_mailbox,
+#ifdef USE_HCACHE
+    .compact_hcache = mh_compact_hcache,
+    .open_hcache = mh_open_hcache,
+    .hcache_key = mh_hcache_key,
+#endif
 };
 
 struct mx_ops mx_mh_ops = {
@@ -2575,4 +3360,9 @@ struct mx_ops mx_mh_ops = {
     .open_new_msg = mh_open_new_message,
     .check = mh_check_mailbox,
     .sync = mh_sync_mailbox,
+#ifdef USE_HCACHE
+    .compact_hcache = mh_compact_hcache,
+    .open_hcache = mh_open_hcache,
+    .hcache_key = mh_hcache_key,
+#endif
 };
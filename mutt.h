@@ -386,6 +386,11 @@ enum
 #if defined(HAVE_QDBM) || defined(HAVE_TC) || defined(HAVE_KC)
   OPTHCACHECOMPRESS,
 #endif /* HAVE_QDBM */
+#ifdef HAVE_ZLIB
+  OPTHCACHEZLIB,
+#endif
+  OPTHCACHECOMPACT,
+  OPTHCACHELAZY,
 #endif
   OPTHDRS,
   OPTHEADER,
@@ -435,6 +440,10 @@ enum
   OPTMAILDIRCHECKCUR,
   OPTMARKERS,
   OPTMARKOLD,
+#ifdef USE_MMAP
+  OPTMBOXMMAP,
+#endif
+  OPTMBOXPADSTATUS,
   OPTMENUSCROLL,  /* scroll menu instead of implicit next-page */
   OPTMENUMOVEOFF, /* allow menu to scroll past last entry */
 #if defined(USE_IMAP) || defined(USE_POP)
@@ -692,10 +701,16 @@ typedef struct envelope
   LIST *references;  /* message references (in reverse order) */
   LIST *in_reply_to; /* in-reply-to header content */
   LIST *userhdrs;    /* user defined headers */
+#ifdef USE_HCACHE
+  unsigned char *lazy; /* cached fields not restored yet, see mutt_env_restore_lazy() */
+#endif
   int kwtypes;
 
   bool irt_changed : 1;  /* In-Reply-To changed to link/break threads */
   bool refs_changed : 1; /* References changed to break thread */
+  bool pooled : 1;       /* part of a message node, see mx_new_header() */
+  bool interned : 1;     /* subject and real_subj belong to the mailbox, see mx_intern() */
+  bool refs_pooled : 1;  /* references and in_reply_to belong to the mailbox */
 } ENVELOPE;
 
 static inline ENVELOPE *mutt_new_envelope(void)
@@ -804,12 +819,39 @@ typedef struct body
 
   bool collapsed : 1; /* used by recvattach */
   bool attach_qualifies : 1;
+  bool pooled : 1; /* part of a message node, see mx_new_header() */
 
 } BODY;
 
 /* #3279: AIX defines conflicting struct thread */
 typedef struct mutt_thread THREAD;
 
+/* The fields of a message which are seldom used.  They are kept out of
+ * HEADER, so that the loops over all the messages of a mailbox (sorting,
+ * limiting, redrawing the index) touch fewer cache lines. */
+struct header_cold
+{
+  char *path;
+  char *tree; /* character string to print thread tree */
+  char *maildir_flags; /* unknown maildir flags */
+
+#ifdef MIXMASTER
+  LIST *chain;
+#endif
+
+#if defined(USE_POP) || defined(USE_IMAP) || defined(USE_NNTP) || defined(USE_NOTMUCH)
+  void *data;                       /* driver-specific data */
+  void (*free_cb)(struct header *); /* driver-specific data free function */
+#endif
+
+#ifdef USE_POP
+  int refno; /* message number on server */
+#endif
+
+  /* Number of qualifying attachments in message, if attach_valid */
+  short attach_total;
+};
+
 typedef struct header
 {
   unsigned int security : 12; /* bit 0-8: flags, bit 9,10: application.
@@ -838,6 +880,7 @@ typedef struct header
                              * option.
                              */
   bool xlabel_changed  : 1; /* editable - used for syncing */
+  bool pooled          : 1; /* allocated by mx_new_header() */
 
   /* timezone of the sender of this message */
   unsigned int zhours : 5;
@@ -854,49 +897,33 @@ typedef struct header
   /* the following are used to support collapsing threads  */
   bool collapsed : 1; /* is this message part of a collapsed thread? */
   bool limited : 1;   /* is this message in a limited view?  */
-  size_t num_hidden;  /* number of hidden messages in this view */
 
   short recipient;    /* user_is_recipient()'s return value, cached */
+  int num_hidden;     /* number of hidden messages in this view */
 
-  int pair;           /* color-pair to use when displaying in the index */
-
-  time_t date_sent;   /* time when the message was sent (UTC) */
-  time_t received;    /* time when the message was placed in the mailbox */
-  LOFF_T offset;      /* where in the stream does this message begin? */
-  int lines;          /* how many lines in the body of this message? */
   int index;          /* the absolute (unsorted) message number */
   int msgno;          /* number displayed to the user */
   int virtual;        /* virtual message number */
   int score;
+  time_t date_sent;   /* time when the message was sent (UTC) */
   ENVELOPE *env;      /* envelope information */
-  BODY *content;      /* list of MIME parts */
-  char *path;
-
-  char *tree; /* character string to print thread tree */
   THREAD *thread;
+  int pair;           /* color-pair to use when displaying in the index */
+  int lines;          /* how many lines in the body of this message? */
+  time_t received;    /* time when the message was placed in the mailbox */
+  LOFF_T offset;      /* where in the stream does this message begin? */
+  BODY *content;      /* list of MIME parts */
 
-  /* Number of qualifying attachments in message, if attach_valid */
-  short attach_total;
-
-#ifdef MIXMASTER
-  LIST *chain;
-#endif
-
-#ifdef USE_POP
-  int refno; /* message number on server */
-#endif
-
-#if defined(USE_POP) || defined(USE_IMAP) || defined(USE_NNTP) || defined(USE_NOTMUCH)
-  void *data;                       /* driver-specific data */
-  void (*free_cb)(struct header *); /* driver-specific data free function */
-#endif
-
-  char *maildir_flags; /* unknown maildir flags */
+  struct header_cold *cold; /* allocated with the header */
 } HEADER;
 
 static inline HEADER *mutt_new_header(void)
 {
-  return safe_calloc(1, sizeof(HEADER));
+  /* the cold part follows the header, see struct header_cold */
+  HEADER *h = safe_calloc(1, sizeof(HEADER) + sizeof(struct header_cold));
+
+  h->cold = (struct header_cold *) (h + 1);
+  return h;
 }
 
 struct mutt_thread
@@ -909,12 +936,18 @@ struct mutt_thread
   bool deep : 1;
   unsigned int subtree_visible : 2;
   bool next_subtree_visible : 1;
+  bool rethread : 1; /* see mutt_sort_new_threads() */
   THREAD *parent;
   THREAD *child;
   THREAD *next;
   THREAD *prev;
   HEADER *message;
   HEADER *sort_key;
+  /* messages of a top-level thread which match the limit, counted by
+   * mutt_count_threads() */
+  int hidden;
+  int unread_new;
+  int unread_old;
 };
 
 
@@ -1005,6 +1038,10 @@ struct _message;
  *
  * Optional operations
  *  - open_new_msg
+ *  - compact_hcache
+ *  - open_hcache
+ *  - hcache_key
+ *  - load
  */
 struct mx_ops
 {
@@ -1017,6 +1054,12 @@ struct mx_ops
   int (*close_msg)(struct _context *ctx, struct _message *msg);
   int (*commit_msg)(struct _context *ctx, struct _message *msg);
   int (*open_new_msg)(struct _message *msg, struct _context *ctx, HEADER *hdr);
+#ifdef USE_HCACHE
+  int (*compact_hcache)(struct _context *ctx, bool force, long *reclaimed);
+  struct header_cache *(*open_hcache)(struct _context *ctx);
+  int (*hcache_key)(struct _context *ctx, HEADER *h, char *buf, size_t buflen);
+#endif
+  int (*load)(struct _context *ctx);
 };
 
 #include "mutt_menu.h"
@@ -1056,20 +1099,27 @@ typedef struct _context
 
   unsigned char rights[(RIGHTSMAX + 7) / 8]; /* ACL bits */
 
-  bool locked : 1;    /* is the mailbox locked? */
-  bool changed : 1;   /* mailbox has been modified */
-  bool readonly : 1;  /* don't allow changes to the mailbox */
-  bool dontwrite : 1; /* don't write the mailbox on close */
-  bool append : 1;    /* mailbox is opened in append mode */
-  bool quiet : 1;     /* inhibit status messages? */
-  bool collapsed : 1; /* are all threads collapsed? */
-  bool closing : 1;   /* mailbox is being closed */
-  bool peekonly : 1;  /* just taking a glance, revert atime */
+  bool locked : 1;      /* is the mailbox locked? */
+  bool changed : 1;     /* mailbox has been modified */
+  bool readonly : 1;    /* don't allow changes to the mailbox */
+  bool dontwrite : 1;   /* don't write the mailbox on close */
+  bool append : 1;      /* mailbox is opened in append mode */
+  bool quiet : 1;       /* inhibit status messages? */
+  bool collapsed : 1;   /* are all threads collapsed? */
+  bool closing : 1;     /* mailbox is being closed */
+  bool opening : 1;     /* mailbox is being opened */
+  bool peekonly : 1;    /* just taking a glance, revert atime */
+  bool progressive : 1; /* opened with MUTT_PROGRESSIVE */
+  bool loading : 1;     /* more headers to read, see mx_load_mailbox() */
+  bool restored : 1;    /* the threads were restored from the header cache */
 
 #ifdef USE_COMPRESSED
   void *compress_info; /* compressed mbox module private data */
 #endif /* USE_COMPRESSED */
 
+  struct mx_pool *pool; /* message nodes, see mx_new_header() */
+  HASH *strings;        /* shared strings, see mx_intern() */
+
   /* driver hooks */
   void *data; /* driver specific data */
   struct mx_ops *mx_ops;
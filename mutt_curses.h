@@ -115,6 +115,7 @@ event_t mutt_getch(void);
 
 void mutt_endwin(const char *msg);
 void mutt_flushinp(void);
+bool mutt_key_pending(void);
 void mutt_refresh(void);
 void mutt_resize_screen(void);
 void mutt_unget_event(int ch, int op);
@@ -67,6 +67,7 @@ static int addr_is_intl(ADDRESS *a)
 
 static void set_local_mailbox(ADDRESS *a, char *local_mailbox)
 {
+  rfc822_unshare_address(a);
   FREE(&a->mailbox);
   a->mailbox = local_mailbox;
   a->intl_checked = true;
@@ -75,6 +76,7 @@ static void set_local_mailbox(ADDRESS *a, char *local_mailbox)
 
 static void set_intl_mailbox(ADDRESS *a, char *intl_mailbox)
 {
+  rfc822_unshare_address(a);
   FREE(&a->mailbox);
   a->mailbox = intl_mailbox;
   a->intl_checked = true;
@@ -302,6 +304,7 @@ const char *mutt_addr_for_display(ADDRESS *a)
 /* Convert an ENVELOPE structure */
 void mutt_env_to_local(ENVELOPE *e)
 {
+  mutt_env_restore_lazy(e);
   mutt_addrlist_to_local(e->return_path);
   mutt_addrlist_to_local(e->from);
   mutt_addrlist_to_local(e->to);
@@ -328,6 +331,7 @@ void mutt_env_to_local(ENVELOPE *e)
 int mutt_env_to_intl(ENVELOPE *env, char **tag, char **err)
 {
   int e = 0;
+  mutt_env_restore_lazy(env);
   H_TO_INTL(return_path);
   H_TO_INTL(from);
   H_TO_INTL(to);
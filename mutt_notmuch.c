@@ -389,12 +389,14 @@ static int init_context(CONTEXT *ctx)
 
 static char *header_get_id(HEADER *h)
 {
-  return (h && h->data) ? ((struct nm_hdrdata *) h->data)->virtual_id : NULL;
+  return (h && h->cold->data) ?
+             ((struct nm_hdrdata *) h->cold->data)->virtual_id :
+             NULL;
 }
 
 static char *header_get_fullpath(HEADER *h, char *buf, size_t bufsz)
 {
-  snprintf(buf, bufsz, "%s/%s", nm_header_get_folder(h), h->path);
+  snprintf(buf, bufsz, "%s/%s", nm_header_get_folder(h), h->cold->path);
   return buf;
 }
 
@@ -841,7 +843,7 @@ static void append_str_item(char **str, const char *item, int sep)
 
 static int update_header_tags(HEADER *h, notmuch_message_t *msg)
 {
-  struct nm_hdrdata *data = h->data;
+  struct nm_hdrdata *data = h->cold->data;
   notmuch_tags_t *tags = NULL;
   char *tstr = NULL, *ttstr = NULL;
   struct nm_hdrtag *tag_list = NULL, *tmp = NULL;
@@ -913,7 +915,7 @@ static int update_header_tags(HEADER *h, notmuch_message_t *msg)
 
 static int update_message_path(HEADER *h, const char *path)
 {
-  struct nm_hdrdata *data = h->data;
+  struct nm_hdrdata *data = h->cold->data;
   char *p = NULL;
 
   mutt_debug(2, "nm: path update requested path=%s, (%s)\n", path, data->virtual_id);
@@ -925,18 +927,18 @@ static int update_message_path(HEADER *h, const char *path)
   {
     data->magic = MUTT_MAILDIR;
 
-    FREE(&h->path);
+    FREE(&h->cold->path);
     FREE(&data->folder);
 
     p -= 3; /* skip subfolder (e.g. "new") */
-    h->path = safe_strdup(p);
+    h->cold->path = safe_strdup(p);
 
     for (; (p > path) && (*(p - 1) == '/'); p--)
       ;
 
     data->folder = mutt_substrdup(path, p);
 
-    mutt_debug(2, "nm: folder='%s', file='%s'\n", data->folder, h->path);
+    mutt_debug(2, "nm: folder='%s', file='%s'\n", data->folder, h->cold->path);
     return 0;
   }
 
@@ -965,8 +967,8 @@ static void deinit_header(HEADER *h)
 {
   if (h)
   {
-    free_hdrdata(h->data);
-    h->data = NULL;
+    free_hdrdata(h->cold->data);
+    h->cold->data = NULL;
   }
 }
 
@@ -988,22 +990,22 @@ static int init_header(HEADER *h, const char *path, notmuch_message_t *msg)
 {
   const char *id = NULL;
 
-  if (h->data)
+  if (h->cold->data)
     return 0;
 
   id = notmuch_message_get_message_id(msg);
 
-  h->data = safe_calloc(1, sizeof(struct nm_hdrdata));
-  h->free_cb = deinit_header;
+  h->cold->data = safe_calloc(1, sizeof(struct nm_hdrdata));
+  h->cold->free_cb = deinit_header;
 
   /*
    * Notmuch ensures that message Id exists (if not notmuch Notmuch will
    * generate an ID), so it's more safe than use mutt HEADER->env->id
    */
-  ((struct nm_hdrdata *) h->data)->virtual_id = safe_strdup(id);
+  ((struct nm_hdrdata *) h->cold->data)->virtual_id = safe_strdup(id);
 
   mutt_debug(2, "nm: initialize header data: [hdr=%p, data=%p] (%s)\n",
-             (void *) h, (void *) h->data, id);
+             (void *) h, (void *) h->cold->data, id);
 
   if (!h->env->message_id)
     h->env->message_id = nm2mutt_message_id(id);
@@ -1181,7 +1183,7 @@ static void append_message(CONTEXT *ctx, notmuch_query_t *q, notmuch_message_t *
   if (newpath)
   {
     /* remember that file has been moved -- nm_sync_mailbox() will update the DB */
-    struct nm_hdrdata *hd = (struct nm_hdrdata *) h->data;
+    struct nm_hdrdata *hd = (struct nm_hdrdata *) h->cold->data;
 
     if (hd)
     {
@@ -1632,27 +1634,31 @@ static unsigned count_query(notmuch_database_t *db, const char *qstr)
 
 char *nm_header_get_folder(HEADER *h)
 {
-  return (h && h->data) ? ((struct nm_hdrdata *) h->data)->folder : NULL;
+  return (h && h->cold->data) ?
+             ((struct nm_hdrdata *) h->cold->data)->folder :
+             NULL;
 }
 
 char *nm_header_get_tags(HEADER *h)
 {
-  return (h && h->data) ? ((struct nm_hdrdata *) h->data)->tags : NULL;
+  return (h && h->cold->data) ?
+             ((struct nm_hdrdata *) h->cold->data)->tags :
+             NULL;
 }
 
 char *nm_header_get_tags_transformed(HEADER *h)
 {
-  return (h && h->data) ? ((struct nm_hdrdata *) h->data)->tags_transformed : NULL;
+  return (h && h->cold->data) ? ((struct nm_hdrdata *) h->cold->data)->tags_transformed : NULL;
 }
 
 char *nm_header_get_tag_transformed(char *tag, HEADER *h)
 {
   struct nm_hdrtag *tmp = NULL;
 
-  if (!h || !h->data)
+  if (!h || !h->cold->data)
     return NULL;
 
-  for (tmp = ((struct nm_hdrdata *) h->data)->tag_list; tmp != NULL; tmp = tmp->next)
+  for (tmp = ((struct nm_hdrdata *) h->cold->data)->tag_list; tmp != NULL; tmp = tmp->next)
   {
     if (strcmp(tag, tmp->tag) == 0)
       return tmp->transformed;
@@ -1901,7 +1907,7 @@ int nm_update_filename(CONTEXT *ctx, const char *old, const char *new, HEADER *h
   if (!data || !new)
     return -1;
 
-  if (!old && h && h->data)
+  if (!old && h && h->cold->data)
   {
     header_get_fullpath(h, buf, sizeof(buf));
     old = buf;
@@ -2176,8 +2182,8 @@ static int nm_close_mailbox(CONTEXT *ctx)
 
     if (h)
     {
-      free_hdrdata(h->data);
-      h->data = NULL;
+      free_hdrdata(h->cold->data);
+      h->cold->data = NULL;
     }
   }
 
@@ -2261,9 +2267,13 @@ static int nm_check_mailbox(CONTEXT *ctx, int *index_hint)
        * detected.
        */
       HEADER tmp;
+      struct header_cold tmp_cold;
       memset(&tmp, 0, sizeof(tmp));
+      memset(&tmp_cold, 0, sizeof(tmp_cold));
+      tmp.cold = &tmp_cold;
       maildir_parse_flags(&tmp, new);
       maildir_update_flags(ctx, h, &tmp);
+      FREE(&tmp_cold.maildir_flags);
     }
 
     if (update_header_tags(h, m) == 0)
@@ -2325,7 +2335,7 @@ static int nm_sync_mailbox(CONTEXT *ctx, int *index_hint)
   {
     char old[_POSIX_PATH_MAX], new[_POSIX_PATH_MAX];
     HEADER *h = ctx->hdrs[i];
-    struct nm_hdrdata *hd = h->data;
+    struct nm_hdrdata *hd = h->cold->data;
 
     if (!ctx->quiet)
       mutt_progress_update(&progress, i, -1);
@@ -2389,12 +2399,12 @@ static int nm_open_message(CONTEXT *ctx, MESSAGE *msg, int msgno)
   char path[_POSIX_PATH_MAX];
   folder = nm_header_get_folder(cur);
 
-  snprintf(path, sizeof(path), "%s/%s", folder, cur->path);
+  snprintf(path, sizeof(path), "%s/%s", folder, cur->cold->path);
 
   msg->fp = fopen(path, "r");
   if ((msg->fp == NULL) && (errno == ENOENT) &&
       ((ctx->magic == MUTT_MAILDIR) || (ctx->magic == MUTT_NOTMUCH)))
-    msg->fp = maildir_open_find_message(folder, cur->path, NULL);
+    msg->fp = maildir_open_find_message(folder, cur->cold->path, NULL);
 
   mutt_debug(1, "%s\n", __func__);
   return !msg->fp;
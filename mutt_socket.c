@@ -31,6 +31,7 @@
 #include "mutt_socket.h"
 #include "mutt_idna.h"
 #include "mutt_tunnel.h"
+#include "stats.h"
 #ifdef HAVE_SYS_TIME_H
 #include <sys/time.h>
 #endif
@@ -173,6 +174,7 @@ int mutt_socket_readchar(CONNECTION *conn, char *c)
       mutt_socket_close(conn);
       return -1;
     }
+    mutt_stats_add(STATS_BYTES_READ, conn->available);
   }
   *c = conn->inbuf[conn->bufpos];
   conn->bufpos++;
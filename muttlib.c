@@ -37,6 +37,9 @@
 #include "mutt_curses.h"
 #include "mx.h"
 #include "url.h"
+#ifdef USE_HCACHE
+#include "hcache.h"
+#endif
 #ifdef USE_IMAP
 #include "imap/imap.h"
 #endif
@@ -133,6 +136,7 @@ int mutt_copy_body(FILE *fp, BODY **tgt, BODY *src)
   memcpy(b, src, sizeof(BODY));
   b->parts = NULL;
   b->next = NULL;
+  b->pooled = false;
 
   b->filename = safe_strdup(tmp);
   b->use_disp = use_disp;
@@ -211,7 +215,8 @@ void mutt_free_body(BODY **p)
     if (b->parts)
       mutt_free_body(&b->parts);
 
-    FREE(&b);
+    if (!b->pooled)
+      FREE(&b);
   }
 
   *p = 0;
@@ -376,22 +381,30 @@ LIST *mutt_copy_list(LIST *p)
 
 void mutt_free_header(HEADER **h)
 {
+  struct header_cold *cold = NULL;
+
   if (!h || !*h)
     return;
+  cold = (*h)->cold;
   mutt_free_envelope(&(*h)->env);
   mutt_free_body(&(*h)->content);
-  FREE(&(*h)->maildir_flags);
-  FREE(&(*h)->tree);
-  FREE(&(*h)->path);
+  FREE(&cold->maildir_flags);
+  FREE(&cold->tree);
+  FREE(&cold->path);
 #ifdef MIXMASTER
-  mutt_free_list(&(*h)->chain);
+  mutt_free_list(&cold->chain);
 #endif
 #if defined(USE_POP) || defined(USE_IMAP) || defined(USE_NNTP) || defined(USE_NOTMUCH)
-  if ((*h)->free_cb)
-    (*h)->free_cb(*h);
-  FREE(&(*h)->data);
+  if (cold->free_cb)
+    cold->free_cb(*h);
+  FREE(&cold->data);
 #endif
-  FREE(h); /* __FREE_CHECKED__ */
+  /* a message node is reclaimed with its mailbox, see mx_free_header();
+   * otherwise the cold part goes with the header, see mutt_new_header() */
+  if ((*h)->pooled)
+    *h = NULL;
+  else
+    FREE(h); /* __FREE_CHECKED__ */
 }
 
 /* returns true if the header contained in "s" is in list "t" */
@@ -736,10 +749,28 @@ bool mutt_is_text_part(BODY *b)
   return false;
 }
 
+/**
+ * mutt_env_restore_lazy - Restore the envelope fields not loaded from the cache
+ * @param e Envelope
+ *
+ * This must be called before accessing the fields of an envelope which are
+ * not needed by the index, see $header_cache_lazy.
+ */
+void mutt_env_restore_lazy(ENVELOPE *e)
+{
+#ifdef USE_HCACHE
+  if (e && e->lazy)
+    mutt_hcache_restore_lazy(e);
+#endif
+}
+
 void mutt_free_envelope(ENVELOPE **p)
 {
   if (!*p)
     return;
+#ifdef USE_HCACHE
+  FREE(&(*p)->lazy);
+#endif
   rfc822_free_address(&(*p)->return_path);
   rfc822_free_address(&(*p)->from);
   rfc822_free_address(&(*p)->to);
@@ -750,8 +781,12 @@ void mutt_free_envelope(ENVELOPE **p)
   rfc822_free_address(&(*p)->mail_followup_to);
 
   FREE(&(*p)->list_post);
-  FREE(&(*p)->subject);
-  /* real_subj is just an offset to subject and shouldn't be freed */
+  if ((*p)->interned)
+    (*p)->subject = NULL;
+  else
+    FREE(&(*p)->subject);
+  /* real_subj points into subject or into the strings of the mailbox, and
+   * shouldn't be freed */
   FREE(&(*p)->disp_subj);
   FREE(&(*p)->message_id);
   FREE(&(*p)->supersedes);
@@ -767,10 +802,38 @@ void mutt_free_envelope(ENVELOPE **p)
 
   mutt_buffer_free(&(*p)->spam);
 
-  mutt_free_list(&(*p)->references);
-  mutt_free_list(&(*p)->in_reply_to);
+  if ((*p)->refs_pooled)
+  {
+    (*p)->references = NULL;
+    (*p)->in_reply_to = NULL;
+  }
+  else
+  {
+    mutt_free_list(&(*p)->references);
+    mutt_free_list(&(*p)->in_reply_to);
+  }
   mutt_free_list(&(*p)->userhdrs);
-  FREE(p); /* __FREE_CHECKED__ */
+  if ((*p)->pooled)
+    *p = NULL;
+  else
+    FREE(p); /* __FREE_CHECKED__ */
+}
+
+/**
+ * mutt_env_unshare_refs - Give an envelope its own References and In-Reply-To
+ * @env: Envelope
+ *
+ * The lists of a message read into a pool belong to its mailbox, see
+ * mx_intern_envelope().  They are copied before they are mixed with others.
+ */
+void mutt_env_unshare_refs(ENVELOPE *env)
+{
+  if (!env->refs_pooled)
+    return;
+
+  env->references = mutt_copy_list(env->references);
+  env->in_reply_to = mutt_copy_list(env->in_reply_to);
+  env->refs_pooled = false;
 }
 
 /* move all the headers from extra not present in base into base */
@@ -785,6 +848,9 @@ void mutt_merge_envelopes(ENVELOPE *base, ENVELOPE **extra)
     base->h = (*extra)->h;                                                     \
     (*extra)->h = NULL;                                                        \
   }
+  mutt_env_restore_lazy(base);
+  mutt_env_unshare_refs(base);
+  mutt_env_unshare_refs(*extra);
   MOVE_ELEM(return_path);
   MOVE_ELEM(from);
   MOVE_ELEM(to);
@@ -814,6 +880,7 @@ void mutt_merge_envelopes(ENVELOPE *base, ENVELOPE **extra)
     base->subject = (*extra)->subject;
     base->real_subj = (*extra)->real_subj;
     base->disp_subj = (*extra)->disp_subj;
+    base->interned = (*extra)->interned;
     (*extra)->subject = NULL;
     (*extra)->real_subj = NULL;
     (*extra)->disp_subj = NULL;
@@ -2083,8 +2150,9 @@ bool mutt_match_rx_list(const char *s, RX_LIST *l)
  * false. */
 bool mutt_match_spam_list(const char *s, REPLACE_LIST *l, char *text, int textsize)
 {
-  static regmatch_t *pmatch = NULL;
-  static int nmatch = 0;
+  /* not static: headers may be parsed by several threads at once */
+  regmatch_t smatch[10];
+  regmatch_t *pmatch = NULL;
   int tlen = 0;
   char *p = NULL;
 
@@ -2093,12 +2161,11 @@ bool mutt_match_spam_list(const char *s, REPLACE_LIST *l, char *text, int textsi
 
   for (; l; l = l->next)
   {
-    /* If this pattern needs more matches, expand pmatch. */
-    if (l->nmatch > nmatch)
-    {
-      safe_realloc(&pmatch, l->nmatch * sizeof(regmatch_t));
-      nmatch = l->nmatch;
-    }
+    /* If this pattern needs more matches, use the heap. */
+    if (l->nmatch > (int) mutt_array_size(smatch))
+      pmatch = safe_malloc(l->nmatch * sizeof(regmatch_t));
+    else
+      pmatch = smatch;
 
     /* Does this pattern match? */
     if (regexec(l->rx->rx, s, (size_t) l->nmatch, (regmatch_t *) pmatch, (int) 0) == 0)
@@ -2146,8 +2213,12 @@ bool mutt_match_spam_list(const char *s, REPLACE_LIST *l, char *text, int textsi
         text[tlen] = '\0';
         mutt_debug(5, "mutt_match_spam_list: \"%s\"\n", text);
       }
+      if (pmatch != smatch)
+        FREE(&pmatch);
       return true;
     }
+    if (pmatch != smatch)
+      FREE(&pmatch);
   }
 
   return false;
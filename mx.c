@@ -21,6 +21,8 @@
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/file.h>
@@ -33,9 +35,11 @@
 #include "copy.h"
 #include "keymap.h"
 #include "mailbox.h"
+#include "mime.h"
 #include "mutt_crypt.h"
 #include "rfc2047.h"
 #include "sort.h"
+#include "stats.h"
 #include "url.h"
 #ifdef USE_SIDEBAR
 #include "sidebar.h"
@@ -594,11 +598,14 @@ static int mx_open_mailbox_append(CONTEXT *ctx, int flags)
  *              MUTT_READONLY   open mailbox in read-only mode
  *              MUTT_QUIET              only print error messages
  *              MUTT_PEEK               revert atime where applicable
+ *              MUTT_PROGRESSIVE        headers may be read later, see
+ *                                      mx_load_mailbox()
  *      ctx     if non-null, context struct to use
  */
 CONTEXT *mx_open_mailbox(const char *path, int flags, CONTEXT *pctx)
 {
   CONTEXT *ctx = pctx;
+  long long start;
   int rc;
 
   if (!path || !path[0])
@@ -623,6 +630,8 @@ CONTEXT *mx_open_mailbox(const char *path, int flags, CONTEXT *pctx)
     ctx->readonly = true;
   if (flags & MUTT_PEEK)
     ctx->peekonly = true;
+  if (flags & MUTT_PROGRESSIVE)
+    ctx->progressive = true;
 
   if (flags & (MUTT_APPEND | MUTT_NEWFOLDER))
   {
@@ -652,6 +661,7 @@ CONTEXT *mx_open_mailbox(const char *path, int flags, CONTEXT *pctx)
     return NULL;
   }
 
+  start = mutt_stats_start();
   mutt_make_label_hash(ctx);
 
   /* if the user has a `push' command in their .muttrc, or in a folder-hook,
@@ -674,12 +684,15 @@ CONTEXT *mx_open_mailbox(const char *path, int flags, CONTEXT *pctx)
          to begin with */
       unset_option(OPTSORTSUBTHREADS);
       unset_option(OPTNEEDRESCORE);
+      ctx->opening = true;
       mutt_sort_headers(ctx, 1);
+      ctx->opening = false;
     }
     if (!ctx->quiet)
       mutt_clear_error();
     if (rc == -2)
       mutt_error(_("Reading from %s interrupted..."), ctx->path);
+    mutt_stats_stop(STATS_OPEN, start, ctx);
   }
   else
   {
@@ -692,6 +705,501 @@ CONTEXT *mx_open_mailbox(const char *path, int flags, CONTEXT *pctx)
   return ctx;
 }
 
+#ifdef USE_HCACHE
+/**
+ * mx_compact_hcache - Drop the cached headers of messages no longer in a mailbox
+ * @ctx:       Mailbox
+ * @force:     Compact the database even if no record was dropped
+ * @reclaimed: Set to the number of bytes by which the database shrank
+ * @retval num Number of records dropped
+ * @retval -1  Error, or the mailbox type has no header cache
+ */
+int mx_compact_hcache(CONTEXT *ctx, bool force, long *reclaimed)
+{
+  if (!ctx || !ctx->mx_ops || !ctx->mx_ops->compact_hcache)
+    return -1;
+
+  return ctx->mx_ops->compact_hcache(ctx, force, reclaimed);
+}
+
+/**
+ * mx_open_hcache - Open the header cache of a mailbox
+ * @ctx:      Mailbox
+ * @retval ptr  Header cache, to be closed with mutt_hcache_close()
+ * @retval NULL The mailbox type has no header cache, or it can't be opened
+ */
+header_cache_t *mx_open_hcache(CONTEXT *ctx)
+{
+  if (!ctx || !ctx->mx_ops || !ctx->mx_ops->open_hcache)
+    return NULL;
+
+  return ctx->mx_ops->open_hcache(ctx);
+}
+
+/**
+ * mx_hcache_key - Identify a message of a mailbox in its header cache
+ * @ctx:    Mailbox
+ * @h:      Message
+ * @buf:    Buffer for the key
+ * @buflen: Length of the buffer
+ * @retval num Length of the key
+ * @retval -1  The message has no key
+ *
+ * The key is the one the message is cached under, followed by whatever tells
+ * it apart from the messages which were cached under the same key before.
+ */
+int mx_hcache_key(CONTEXT *ctx, HEADER *h, char *buf, size_t buflen)
+{
+  if (!ctx || !ctx->mx_ops || !ctx->mx_ops->hcache_key)
+    return -1;
+
+  return ctx->mx_ops->hcache_key(ctx, h, buf, buflen);
+}
+
+/* the automatic pass of $header_cache_compact */
+static void mx_close_hcache(CONTEXT *ctx)
+{
+  long reclaimed = 0;
+  int dropped;
+
+  if (!option(OPTHCACHECOMPACT))
+    return;
+
+  dropped = mx_compact_hcache(ctx, false, &reclaimed);
+  if (dropped > 0)
+    mutt_debug(1, "mx_close_mailbox: %s: dropped %d cached headers, reclaimed %ld bytes\n",
+               ctx->path, dropped, reclaimed);
+}
+#endif
+
+/* number of message nodes allocated at a time */
+#define MX_POOL_SLAB 1024
+
+/**
+ * struct mx_node - The objects of a message which are allocated together
+ *
+ * The HEADER itself is kept apart, in the array of its slab, so that the
+ * headers of a mailbox are dense in memory.
+ */
+struct mx_node
+{
+  struct header_cold cold; /* first, see mx_free_header() */
+  ENVELOPE env;
+  BODY body;
+  HEADER *h;             /* the header using this node */
+  struct mx_node *next;  /* next free node */
+};
+
+struct mx_slab
+{
+  struct mx_slab *next;
+  int used;
+  HEADER hdrs[MX_POOL_SLAB];
+  struct mx_node nodes[MX_POOL_SLAB];
+};
+
+/* storage of the strings of mx_intern(), and of the address and list nodes of
+ * mx_intern_envelope() */
+struct mx_chunk
+{
+  struct mx_chunk *next;
+  size_t used;
+  size_t size;
+  char data[];
+};
+
+/**
+ * struct mx_pool - The message nodes of a mailbox
+ */
+struct mx_pool
+{
+  struct mx_slab *slabs;
+  struct mx_node *free;     /* nodes given back by mx_free_header() */
+  ADDRESS *free_addrs;      /* ... and their addresses */
+  LIST *free_lists;         /* ... and their references */
+  struct mx_chunk *chunks;  /* the first one is being filled */
+  int lookups;              /* calls to mx_intern() */
+  int hits;                 /* ... which found the string */
+};
+
+/**
+ * mx_new_header - Allocate a header from the pool of a mailbox
+ * @ctx: Mailbox the message belongs to
+ * @retval ptr New header, with an empty envelope and body
+ *
+ * Parsing a folder makes a HEADER, an ENVELOPE and a BODY for every message.
+ * They are carved from large slabs instead, which are freed when the mailbox
+ * is closed.  mutt_read_rfc822_header() fills in the envelope and body, and
+ * must be used once on the header.
+ *
+ * The pooled objects are flagged, so that mutt_free_envelope() and friends
+ * only free their contents.  Objects which replace them later, e.g. an
+ * edited envelope, are allocated as usual.
+ */
+HEADER *mx_new_header(CONTEXT *ctx)
+{
+  struct mx_pool *pool = ctx->pool;
+  struct mx_slab *slab = NULL;
+  struct mx_node *node = NULL;
+  HEADER *h = NULL;
+
+  if (!pool)
+    pool = ctx->pool = safe_calloc(1, sizeof(struct mx_pool));
+
+  if (pool->free)
+  {
+    node = pool->free;
+    pool->free = node->next;
+    h = node->h;
+  }
+  else
+  {
+    slab = pool->slabs;
+    if (!slab || slab->used == MX_POOL_SLAB)
+    {
+      slab = safe_malloc(sizeof(struct mx_slab));
+      slab->next = pool->slabs;
+      slab->used = 0;
+      pool->slabs = slab;
+    }
+    h = &slab->hdrs[slab->used];
+    node = &slab->nodes[slab->used++];
+  }
+
+  memset(h, 0, sizeof(HEADER));
+  memset(node, 0, sizeof(struct mx_node));
+  node->h = h;
+  h->pooled = true;
+  h->cold = &node->cold;
+  h->env = &node->env;
+  node->env.pooled = true;
+  h->content = &node->body;
+  node->body.pooled = true;
+  node->body.disposition = DISPATTACH;
+  node->body.use_disp = true;
+
+  return h;
+}
+
+/**
+ * mx_free_header - Free a header of a mailbox
+ * @ctx: Mailbox the message belongs to
+ * @h:   Header to free
+ *
+ * The node of a pooled header can then be reused by mx_new_header(), and so
+ * can the nodes of its addresses and references, see mx_intern_envelope().
+ * Other headers are simply freed.
+ */
+void mx_free_header(CONTEXT *ctx, HEADER **h)
+{
+  struct mx_node *node = NULL;
+  ENVELOPE *env = NULL;
+  LIST *l = NULL;
+
+  if (!h || !*h)
+    return;
+
+  if ((*h)->pooled && ctx->pool)
+  {
+    node = (struct mx_node *) (*h)->cold;
+
+    env = (*h)->env;
+    rfc822_release_address(&env->return_path, &ctx->pool->free_addrs);
+    rfc822_release_address(&env->from, &ctx->pool->free_addrs);
+    rfc822_release_address(&env->to, &ctx->pool->free_addrs);
+    rfc822_release_address(&env->cc, &ctx->pool->free_addrs);
+    rfc822_release_address(&env->bcc, &ctx->pool->free_addrs);
+    rfc822_release_address(&env->sender, &ctx->pool->free_addrs);
+    rfc822_release_address(&env->reply_to, &ctx->pool->free_addrs);
+    rfc822_release_address(&env->mail_followup_to, &ctx->pool->free_addrs);
+    rfc822_release_address(&env->x_original_to, &ctx->pool->free_addrs);
+
+    /* the message ids are interned, only the nodes are reused */
+    if (env->refs_pooled)
+    {
+      while ((l = env->references) || (l = env->in_reply_to))
+      {
+        if (l == env->references)
+          env->references = l->next;
+        else
+          env->in_reply_to = l->next;
+        l->next = ctx->pool->free_lists;
+        ctx->pool->free_lists = l;
+      }
+      env->refs_pooled = false;
+    }
+  }
+  mutt_free_header(h);
+  if (node)
+  {
+    node->next = ctx->pool->free;
+    ctx->pool->free = node;
+  }
+}
+
+/**
+ * mx_free_pool - Free all the message nodes of a mailbox
+ * @ctx: Mailbox, whose headers have been freed
+ */
+static void mx_free_pool(CONTEXT *ctx)
+{
+  struct mx_slab *slab = NULL;
+  struct mx_chunk *chunk = NULL;
+
+  if (!ctx->pool)
+    return;
+
+  while ((slab = ctx->pool->slabs))
+  {
+    ctx->pool->slabs = slab->next;
+    FREE(&slab);
+  }
+  while ((chunk = ctx->pool->chunks))
+  {
+    ctx->pool->chunks = chunk->next;
+    FREE(&chunk);
+  }
+  FREE(&ctx->pool);
+}
+
+/* initial number of buckets of the shared strings of a mailbox; the sizes are
+ * kept odd, as the string hash doesn't spread well over a power of two */
+#define MX_STRINGS_HASH 1023
+
+/* size of the chunks the shared strings and nodes are carved from */
+#define MX_POOL_CHUNK 65536
+
+/* alignment of the objects carved from the chunks */
+#define MX_POOL_ALIGN (sizeof(void *) > 8 ? sizeof(void *) : 8)
+
+/* number of strings after which interning is given up, unless half of them
+ * were found in the table: a table of distinct strings only costs time and
+ * memory */
+#define MX_STRINGS_PROBE 4096
+
+/**
+ * mx_pool_alloc - Carve an object out of the chunks of a mailbox pool
+ * @ctx:  Mailbox
+ * @size: Size of the object
+ * @retval ptr Uninitialised memory, freed when the mailbox is closed
+ */
+static void *mx_pool_alloc(CONTEXT *ctx, size_t size)
+{
+  struct mx_pool *pool = NULL;
+  struct mx_chunk *chunk = NULL;
+  void *obj = NULL;
+
+  if (!ctx->pool)
+    ctx->pool = safe_calloc(1, sizeof(struct mx_pool));
+  pool = ctx->pool;
+  chunk = pool->chunks;
+
+  /* keep the next object aligned */
+  size = (size + MX_POOL_ALIGN - 1) & ~(MX_POOL_ALIGN - 1);
+
+  if (size > MX_POOL_CHUNK / 4)
+  {
+    /* a large object gets a chunk of its own, behind the one being filled */
+    chunk = safe_malloc(sizeof(struct mx_chunk) + size);
+    chunk->size = chunk->used = size;
+    if (pool->chunks)
+    {
+      chunk->next = pool->chunks->next;
+      pool->chunks->next = chunk;
+    }
+    else
+    {
+      chunk->next = NULL;
+      pool->chunks = chunk;
+    }
+    obj = chunk->data;
+  }
+  else
+  {
+    if (!chunk || (chunk->size - chunk->used < size))
+    {
+      chunk = safe_malloc(sizeof(struct mx_chunk) + MX_POOL_CHUNK);
+      chunk->size = MX_POOL_CHUNK;
+      chunk->used = 0;
+      chunk->next = pool->chunks;
+      pool->chunks = chunk;
+    }
+    obj = chunk->data + chunk->used;
+    chunk->used += size;
+  }
+
+  return obj;
+}
+
+static struct mx_string *mx_new_string(CONTEXT *ctx, size_t len)
+{
+  struct mx_string *str = mx_pool_alloc(ctx, sizeof(struct mx_string) + len);
+
+  str->lists_serial = 0;
+  str->lists = 0;
+  return str;
+}
+
+/**
+ * mx_intern - Share the storage of a string between the messages of a mailbox
+ * @ctx: Mailbox
+ * @s:   String
+ * @retval ptr Equal string, owned by the mailbox until it is closed
+ *
+ * Mailing list folders repeat the same addresses and subjects many times.
+ * Each distinct string is only kept once, in the chunks of the mailbox pool,
+ * so that equal interned strings are also equal pointers.
+ */
+char *mx_intern(CONTEXT *ctx, const char *s)
+{
+  struct mx_string *str = NULL;
+  char *text = NULL;
+  size_t len;
+
+  if (!ctx->pool)
+    ctx->pool = safe_calloc(1, sizeof(struct mx_pool));
+  ctx->pool->lookups++;
+
+  if (!ctx->strings)
+    ctx->strings = hash_create(MX_STRINGS_HASH, 0);
+  else if ((text = hash_find(ctx->strings, s)))
+  {
+    ctx->pool->hits++;
+    return text;
+  }
+
+  if (ctx->strings->nelem < ctx->strings->curnelem * 2)
+    ctx->strings = hash_resize(ctx->strings, ctx->strings->nelem * 2 + 1, 0);
+
+  len = strlen(s) + 1;
+  str = mx_new_string(ctx, len);
+  memcpy(str->text, s, len);
+  hash_insert(ctx->strings, str->text, str->text);
+  return str->text;
+}
+
+static void mx_intern_address(CONTEXT *ctx, ADDRESS **pa, bool strings, bool nodes)
+{
+  ADDRESS *a = NULL;
+  char *personal = NULL;
+  char *mailbox = NULL;
+
+  for (; (a = *pa); pa = &a->next)
+  {
+    if (strings && !a->interned)
+    {
+      personal = a->personal ? mx_intern(ctx, a->personal) : NULL;
+      mailbox = a->mailbox ? mx_intern(ctx, a->mailbox) : NULL;
+      FREE(&a->personal);
+      FREE(&a->mailbox);
+      a->personal = personal;
+      a->mailbox = mailbox;
+      a->interned = true;
+    }
+
+    if (nodes && !a->pooled)
+    {
+      if ((*pa = ctx->pool->free_addrs))
+        ctx->pool->free_addrs = (*pa)->next;
+      else
+        *pa = mx_pool_alloc(ctx, sizeof(ADDRESS));
+      memcpy(*pa, a, sizeof(ADDRESS));
+      FREE(&a);
+      a = *pa;
+      a->pooled = true;
+    }
+  }
+}
+
+static LIST *mx_pool_list(CONTEXT *ctx, LIST *l)
+{
+  LIST *top = NULL;
+  LIST **last = &top;
+
+  for (; l; l = l->next)
+  {
+    if ((*last = ctx->pool->free_lists))
+      ctx->pool->free_lists = (*last)->next;
+    else
+      *last = mx_pool_alloc(ctx, sizeof(LIST));
+    (*last)->data = l->data ? mx_intern(ctx, l->data) : NULL;
+    last = &(*last)->next;
+  }
+  *last = NULL;
+
+  return top;
+}
+
+/**
+ * mx_intern_envelope - Share the addresses and the subject of a message
+ * @ctx: Mailbox
+ * @env: Envelope of a new message of the mailbox
+ *
+ * The strings are flagged (see rfc822_unshare_address()), so that they are
+ * not freed with the envelope.  mx_update_context() does this for the new
+ * messages.  Parsers which read one message at a time call it as they go, so
+ * that the next message reuses the memory of the copies it frees.
+ *
+ * The envelope of a header from mx_new_header() also moves the nodes of its
+ * addresses, and its References and In-Reply-To, into the pool of the
+ * mailbox.  mx_free_header() reuses them, the others are released all at
+ * once when the mailbox is closed.  See mutt_env_unshare_refs().
+ *
+ * No string is shared in mailboxes whose strings hardly repeat, see
+ * MX_STRINGS_PROBE.  Their references are not pooled either.  The fields a
+ * header from the cache has not restored yet are left out:
+ * mutt_env_restore_lazy() gives them their own copies.
+ */
+void mx_intern_envelope(CONTEXT *ctx, ENVELOPE *env)
+{
+  char *subject = NULL;
+  bool strings = true;
+  LIST *refs = NULL;
+  LIST *irt = NULL;
+
+  if (ctx->pool && (ctx->pool->lookups > MX_STRINGS_PROBE) &&
+      (ctx->pool->hits < ctx->pool->lookups / 2))
+    strings = false;
+
+  if (!strings && !env->pooled)
+    return;
+
+  mx_intern_address(ctx, &env->return_path, strings, env->pooled);
+  mx_intern_address(ctx, &env->from, strings, env->pooled);
+  mx_intern_address(ctx, &env->to, strings, env->pooled);
+  mx_intern_address(ctx, &env->cc, strings, env->pooled);
+  mx_intern_address(ctx, &env->bcc, strings, env->pooled);
+  mx_intern_address(ctx, &env->sender, strings, env->pooled);
+  mx_intern_address(ctx, &env->reply_to, strings, env->pooled);
+  mx_intern_address(ctx, &env->mail_followup_to, strings, env->pooled);
+  mx_intern_address(ctx, &env->x_original_to, strings, env->pooled);
+
+  if (strings && env->subject && !env->interned)
+  {
+    /* real_subj is kept apart, so that replies share it with the original */
+    subject = mx_intern(ctx, env->subject);
+    if (env->real_subj == env->subject)
+      env->real_subj = subject;
+    else if (env->real_subj)
+      env->real_subj = mx_intern(ctx, env->real_subj);
+    FREE(&env->subject);
+    env->subject = subject;
+    env->interned = true;
+  }
+
+  if (strings && env->pooled && !env->refs_pooled)
+  {
+    /* a thread repeats the same message ids */
+    refs = mx_pool_list(ctx, env->references);
+    irt = mx_pool_list(ctx, env->in_reply_to);
+    mutt_free_list(&env->references);
+    mutt_free_list(&env->in_reply_to);
+    env->references = refs;
+    env->in_reply_to = irt;
+    env->refs_pooled = true;
+  }
+}
+
 /* free up memory associated with the mailbox context */
 void mx_fastclose_mailbox(CONTEXT *ctx)
 {
@@ -725,6 +1233,9 @@ void mx_fastclose_mailbox(CONTEXT *ctx)
   mutt_clear_threads(ctx);
   for (i = 0; i < ctx->msgcount; i++)
     mutt_free_header(&ctx->hdrs[i]);
+  if (ctx->strings)
+    hash_destroy(&ctx->strings, NULL);
+  mx_free_pool(ctx);
   FREE(&ctx->hdrs);
   FREE(&ctx->v2r);
   FREE(&ctx->path);
@@ -739,13 +1250,19 @@ void mx_fastclose_mailbox(CONTEXT *ctx)
 /* save changes to disk */
 static int sync_mailbox(CONTEXT *ctx, int *index_hint)
 {
+  long long start;
+  int rc;
+
   if (!ctx->mx_ops || !ctx->mx_ops->sync)
     return -1;
 
   if (!ctx->quiet)
     mutt_message(_("Writing %s..."), ctx->path);
 
-  return ctx->mx_ops->sync(ctx, index_hint);
+  start = mutt_stats_start();
+  rc = ctx->mx_ops->sync(ctx, index_hint);
+  mutt_stats_stop(STATS_SYNC, start, ctx);
+  return rc;
 }
 
 /* move deleted mails to the trash folder */
@@ -986,6 +1503,9 @@ int mx_close_mailbox(CONTEXT *ctx, int *index_hint)
       mutt_message(_("Mailbox is unchanged."));
     if (ctx->magic == MUTT_MBOX || ctx->magic == MUTT_MMDF)
       mbox_reset_atime(ctx, NULL);
+#ifdef USE_HCACHE
+    mx_close_hcache(ctx);
+#endif
     mx_fastclose_mailbox(ctx);
     return 0;
   }
@@ -1046,6 +1566,10 @@ int mx_close_mailbox(CONTEXT *ctx, int *index_hint)
       !mutt_is_spool(ctx->path) && !option(OPTSAVEEMPTY))
     mx_unlink_empty(ctx->path);
 
+#ifdef USE_HCACHE
+  mx_close_hcache(ctx);
+#endif
+
 #ifdef USE_SIDEBAR
   ctx->msgcount -= ctx->deleted;
   mutt_sb_set_buffystats(ctx);
@@ -1137,7 +1661,7 @@ void mx_update_tables(CONTEXT *ctx, int committing)
        */
       if (ctx->last_tag == ctx->hdrs[i])
         ctx->last_tag = NULL;
-      mutt_free_header(&ctx->hdrs[i]);
+      mx_free_header(ctx, &ctx->hdrs[i]);
     }
   }
 #undef this_body
@@ -1316,6 +1840,7 @@ MESSAGE *mx_open_new_message(CONTEXT *dest, HEADER *hdr, int flags)
     {
       if (hdr)
       {
+        mutt_env_restore_lazy(hdr->env);
         if (hdr->env->return_path)
           p = hdr->env->return_path;
         else if (hdr->env->sender)
@@ -1337,13 +1862,50 @@ MESSAGE *mx_open_new_message(CONTEXT *dest, HEADER *hdr, int flags)
 /* check for new mail */
 int mx_check_mailbox(CONTEXT *ctx, int *index_hint)
 {
+  long long start;
+  int rc;
+
   if (!ctx || !ctx->mx_ops)
   {
     mutt_debug(1, "mx_check_mailbox: null or invalid context.\n");
     return -1;
   }
 
-  return ctx->mx_ops->check(ctx, index_hint);
+  start = mutt_stats_start();
+  rc = ctx->mx_ops->check(ctx, index_hint);
+  mutt_stats_stop(STATS_CHECK, start, ctx);
+  return rc;
+}
+
+/**
+ * mx_load_mailbox - Read more headers of a mailbox which is still loading
+ * @ctx: Mailbox, opened with MUTT_PROGRESSIVE
+ * @retval  0 Success, or nothing left to read
+ * @retval -1 Error
+ *
+ * A backend may return from open() after reading the first headers and set
+ * ctx->loading.  The index then calls this while no key is pressed and
+ * treats the headers appended to ctx->hdrs like new mail (MUTT_LOADED).
+ * ctx->loading is cleared once every header has been read, or on error.
+ */
+int mx_load_mailbox(CONTEXT *ctx)
+{
+  long long start;
+  int rc;
+
+  if (!ctx || !ctx->loading)
+    return 0;
+
+  if (!ctx->mx_ops || !ctx->mx_ops->load)
+  {
+    ctx->loading = false;
+    return 0;
+  }
+
+  start = mutt_stats_start();
+  rc = ctx->mx_ops->load(ctx);
+  mutt_stats_stop(STATS_LOAD, start, ctx);
+  return rc;
 }
 
 /* return a stream pointer for a message */
@@ -1358,6 +1920,8 @@ MESSAGE *mx_open_message(CONTEXT *ctx, int msgno)
     return NULL;
   }
 
+  mutt_env_restore_lazy(ctx->hdrs[msgno]->env);
+
   msg = safe_calloc(1, sizeof(MESSAGE));
   if (ctx->mx_ops->open_msg(ctx, msg, msgno))
     FREE(&msg);
@@ -1403,28 +1967,28 @@ int mx_close_message(CONTEXT *ctx, MESSAGE **msg)
   return r;
 }
 
-void mx_alloc_memory(CONTEXT *ctx)
+/**
+ * mx_resize_memory - Resize the header arrays of a mailbox
+ * @ctx:    Mailbox
+ * @hdrmax: New number of slots
+ *
+ * The slots between ctx->msgcount and hdrmax are cleared.
+ */
+static void mx_resize_memory(CONTEXT *ctx, int hdrmax)
 {
   int i;
   size_t s = MAX(sizeof(HEADER *), sizeof(int));
 
-  if ((ctx->hdrmax + 25) * s < ctx->hdrmax * s)
+  if ((hdrmax < 0) || ((size_t) hdrmax > SIZE_MAX / s))
   {
     mutt_error(_("Integer overflow -- can't allocate memory."));
     sleep(1);
     mutt_exit(1);
   }
 
-  if (ctx->hdrs)
-  {
-    safe_realloc(&ctx->hdrs, sizeof(HEADER *) * (ctx->hdrmax += 25));
-    safe_realloc(&ctx->v2r, sizeof(int) * ctx->hdrmax);
-  }
-  else
-  {
-    ctx->hdrs = safe_calloc((ctx->hdrmax += 25), sizeof(HEADER *));
-    ctx->v2r = safe_calloc(ctx->hdrmax, sizeof(int));
-  }
+  safe_realloc(&ctx->hdrs, sizeof(HEADER *) * hdrmax);
+  safe_realloc(&ctx->v2r, sizeof(int) * hdrmax);
+  ctx->hdrmax = hdrmax;
   for (i = ctx->msgcount; i < ctx->hdrmax; i++)
   {
     ctx->hdrs[i] = NULL;
@@ -1432,6 +1996,43 @@ void mx_alloc_memory(CONTEXT *ctx)
   }
 }
 
+/**
+ * mx_alloc_memory - Grow the header arrays of a mailbox
+ * @ctx: Mailbox
+ *
+ * The capacity is doubled, so adding n messages one at a time costs
+ * O(n) copying in total rather than O(n^2).
+ */
+void mx_alloc_memory(CONTEXT *ctx)
+{
+  int hdrmax = 25;
+
+  if (ctx->hdrmax >= hdrmax)
+    hdrmax = (ctx->hdrmax > INT_MAX / 2) ? INT_MAX : ctx->hdrmax * 2;
+  if (hdrmax <= ctx->hdrmax)
+  {
+    mutt_error(_("Integer overflow -- can't allocate memory."));
+    sleep(1);
+    mutt_exit(1);
+  }
+
+  mx_resize_memory(ctx, hdrmax);
+}
+
+/**
+ * mx_reserve_memory - Make room for a known number of messages
+ * @ctx:   Mailbox
+ * @count: Total number of messages the mailbox will hold
+ *
+ * Backends that learn the size of a mailbox before reading it can call
+ * this once instead of growing the arrays message by message.
+ */
+void mx_reserve_memory(CONTEXT *ctx, int count)
+{
+  if (count > ctx->hdrmax)
+    mx_resize_memory(ctx, count);
+}
+
 /* this routine is called to update the counts in the context structure for
  * the last message header parsed.
  */
@@ -1440,10 +2041,13 @@ void mx_update_context(CONTEXT *ctx, int new_messages)
   HEADER *h = NULL;
   int msgno;
 
+  mutt_stats_add(STATS_MESSAGES, new_messages);
   for (msgno = ctx->msgcount - new_messages; msgno < ctx->msgcount; msgno++)
   {
     h = ctx->hdrs[msgno];
 
+    mx_intern_envelope(ctx, h->env);
+
     if (WithCrypto)
     {
       /* NOTE: this _must_ be done before the check for mailcap! */
@@ -24,6 +24,7 @@
 #ifndef _MUTT_MX_H
 #define _MUTT_MX_H 1
 
+#include <stddef.h>
 #include "buffy.h"
 #include "mailbox.h"
 
@@ -74,7 +75,30 @@ FILE *maildir_open_find_message(const char *folder, const char *msg, char **newn
 
 int mbox_strict_cmp_headers(const HEADER *h1, const HEADER *h2);
 
+HEADER *mx_new_header(CONTEXT *ctx);
+void mx_free_header(CONTEXT *ctx, HEADER **h);
+
+/**
+ * struct mx_string - A string shared by the messages of a mailbox
+ *
+ * The strings handed out by mx_intern() are the text of these.
+ */
+struct mx_string
+{
+  unsigned int lists_serial; /* MailListsSerial when lists was set */
+  unsigned char lists;       /* MX_STRING_MAIL_LIST, MX_STRING_SUBSCRIBED */
+  char text[];
+};
+
+#define MX_STRING_MAIL_LIST  (1 << 0) /* mutt_is_mail_list() */
+#define MX_STRING_SUBSCRIBED (1 << 1) /* mutt_is_subscribed_list() */
+
+#define mx_string(s) ((struct mx_string *) ((s) - offsetof(struct mx_string, text)))
+
+char *mx_intern(CONTEXT *ctx, const char *s);
+void mx_intern_envelope(CONTEXT *ctx, ENVELOPE *env);
 void mx_alloc_memory(CONTEXT *ctx);
+void mx_reserve_memory(CONTEXT *ctx, int count);
 void mx_update_context(CONTEXT *ctx, int new_messages);
 void mx_update_tables(CONTEXT *ctx, int committing);
 
@@ -83,6 +107,12 @@ int mx_lock_file(const char *path, int fd, int excl, int dot, int timeout);
 int mx_unlock_file(const char *path, int fd, int dot);
 
 struct mx_ops *mx_get_ops(int magic);
+
+#ifdef USE_HCACHE
+int mx_compact_hcache(CONTEXT *ctx, bool force, long *reclaimed);
+header_cache_t *mx_open_hcache(CONTEXT *ctx);
+int mx_hcache_key(CONTEXT *ctx, HEADER *h, char *buf, size_t buflen);
+#endif
 extern struct mx_ops mx_maildir_ops;
 extern struct mx_ops mx_mbox_ops;
 extern struct mx_ops mx_mh_ops;
@@ -0,0 +1,215 @@
+/**
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Mailbox open micro-benchmark.
+ *
+ * This program measures:
+ *
+ *  - the time needed to fill the header arrays of a mailbox (ctx->hdrs and
+ *    ctx->v2r) with a given number of messages, when the arrays grow by a
+ *    fixed 25 slots at a time, when they grow with mx_alloc_memory(), and
+ *    when they are sized once with mx_reserve_memory()
+ *  - the time needed by mx_open_mailbox() to read a whole mbox folder, which
+ *    is generated in a scratch directory unless one is given
+ *
+ * The program is linked with the same objects as mutt itself and is built
+ * with "make mx_bench".
+ */
+
+#include "config.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include "mutt.h"
+#include "bench.h"
+#include "mx.h"
+
+/* The growth policy of mx_alloc_memory() before it doubled the arrays */
+static void fixed_alloc_memory(CONTEXT *ctx)
+{
+  int i;
+
+  safe_realloc(&ctx->hdrs, sizeof(HEADER *) * (ctx->hdrmax += 25));
+  safe_realloc(&ctx->v2r, sizeof(int) * ctx->hdrmax);
+  for (i = ctx->msgcount; i < ctx->hdrmax; i++)
+  {
+    ctx->hdrs[i] = NULL;
+    ctx->v2r[i] = -1;
+  }
+}
+
+enum Growth
+{
+  GROW_FIXED,
+  GROW_DOUBLE,
+  GROW_RESERVE
+};
+
+/* Add n headers to an empty mailbox, allocating each one in between as a
+ * backend does, so that the arrays cannot simply be extended in place */
+static double fill_arrays(enum Growth growth, int n)
+{
+  CONTEXT ctx;
+  double t;
+  int reallocs = 0;
+  int i;
+
+  memset(&ctx, 0, sizeof(ctx));
+  t = bench_now();
+  if (growth == GROW_RESERVE)
+  {
+    mx_reserve_memory(&ctx, n);
+    reallocs++;
+  }
+  for (i = 0; i < n; i++)
+  {
+    if (ctx.msgcount == ctx.hdrmax)
+    {
+      if (growth == GROW_FIXED)
+        fixed_alloc_memory(&ctx);
+      else
+        mx_alloc_memory(&ctx);
+      reallocs++;
+    }
+    ctx.hdrs[ctx.msgcount++] = mutt_new_header();
+  }
+  t = bench_now() - t;
+
+  printf("  %-24s %9.1f ms  %7d reallocs  %9d slots\n",
+         (growth == GROW_FIXED) ? "fixed (25 slots)" :
+         (growth == GROW_DOUBLE) ? "mx_alloc_memory()" : "mx_reserve_memory()",
+         t * 1000, reallocs, ctx.hdrmax);
+
+  for (i = 0; i < ctx.msgcount; i++)
+    mutt_free_header(&ctx.hdrs[i]);
+  FREE(&ctx.hdrs);
+  FREE(&ctx.v2r);
+  return t;
+}
+
+static int write_folder(const char *path, int n)
+{
+  FILE *fp = NULL;
+  int i;
+
+  fp = safe_fopen(path, "w");
+  if (!fp)
+    return -1;
+  for (i = 0; i < n; i++)
+  {
+    fprintf(fp, "From bench@example.com Mon Jan  2 15:04:05 2017\n"
+                "From: Bench <bench%d@example.com>\n"
+                "Subject: message %d\n"
+                "Message-ID: <%d@example.com>\n"
+                "Date: Mon, 2 Jan 2017 15:04:05 +0000\n"
+                "\n"
+                "body %d\n"
+                "\n",
+            i % 97, i, i, i);
+  }
+  return safe_fclose(&fp);
+}
+
+static void usage(const char *progname)
+{
+  fprintf(stderr, "usage: %s [-n messages] [-d directory] [-f folder]\n"
+                  "  -n number of synthetic messages (default: 1000000)\n"
+                  "  -d scratch directory (default: $TMPDIR or /tmp)\n"
+                  "  -f open this folder instead of a synthetic one\n",
+          progname);
+  exit(1);
+}
+
+int main(int argc, char **argv)
+{
+  char path[_POSIX_PATH_MAX];
+  const char *tmpdir = getenv("TMPDIR");
+  const char *folder = NULL;
+  CONTEXT ctx;
+  struct rusage ru;
+  double fixed, doubled, reserved, t;
+  int n = 1000000;
+  int ch;
+
+  bench_init();
+  /* prefer the dotlock program of the build tree */
+  MuttDotlock = safe_strdup((access("mutt_dotlock", X_OK) == 0) ?
+                                "./mutt_dotlock" :
+                                BINDIR "/mutt_dotlock");
+
+  while ((ch = getopt(argc, argv, "n:d:f:")) != -1)
+  {
+    switch (ch)
+    {
+      case 'n':
+        if (mutt_atoi(optarg, &n) < 0 || n <= 0)
+          usage(argv[0]);
+        break;
+      case 'd':
+        tmpdir = optarg;
+        break;
+      case 'f':
+        folder = optarg;
+        break;
+      default:
+        usage(argv[0]);
+    }
+  }
+
+  printf("Header arrays, %d messages:\n", n);
+  fixed = fill_arrays(GROW_FIXED, n);
+  doubled = fill_arrays(GROW_DOUBLE, n);
+  reserved = fill_arrays(GROW_RESERVE, n);
+  printf("  saved by doubling: %.1f ms, by reserving: %.1f ms\n",
+         (fixed - doubled) * 1000, (fixed - reserved) * 1000);
+
+  if (!folder)
+  {
+    snprintf(path, sizeof(path), "%s/mx-bench-%d", tmpdir ? tmpdir : "/tmp",
+             (int) getpid());
+    printf("Generating %d messages...\n", n);
+    if (write_folder(path, n) != 0)
+    {
+      fprintf(stderr, "%s: %s: %s\n", argv[0], path, strerror(errno));
+      unlink(path);
+      exit(1);
+    }
+    folder = path;
+  }
+
+  memset(&ctx, 0, sizeof(ctx));
+  t = bench_now();
+  if (!mx_open_mailbox(folder, MUTT_READONLY | MUTT_QUIET, &ctx))
+  {
+    fprintf(stderr, "%s: can't open %s\n", argv[0], folder);
+    if (folder == path)
+      unlink(path);
+    exit(1);
+  }
+  t = bench_now() - t;
+  getrusage(RUSAGE_SELF, &ru);
+  printf("mx_open_mailbox(): %d messages in %.1f ms, max RSS %ld kB\n",
+         ctx.msgcount, t * 1000, ru.ru_maxrss);
+  mx_fastclose_mailbox(&ctx);
+
+  if (folder == path)
+    unlink(path);
+
+  return 0;
+}
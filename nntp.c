@@ -1105,7 +1105,7 @@ static int parse_overview_line(char *line, void *data)
       mutt_free_header(&hdr);
       ctx->hdrs[ctx->msgcount] = hdr = mutt_hcache_restore(hdata);
       mutt_hcache_free(fc->hc, &hdata);
-      hdr->data = 0;
+      hdr->cold->data = 0;
       hdr->read = false;
       hdr->old = false;
 
@@ -1136,7 +1136,7 @@ static int parse_overview_line(char *line, void *data)
     hdr->read = false;
     hdr->old = false;
     hdr->deleted = false;
-    hdr->data = safe_calloc(1, sizeof(NNTP_HEADER_DATA));
+    hdr->cold->data = safe_calloc(1, sizeof(NNTP_HEADER_DATA));
     NHDR(hdr)->article_num = anum;
     if (fc->restore)
       hdr->changed = true;
@@ -1167,6 +1167,7 @@ static int nntp_fetch_headers(CONTEXT *ctx, void *hc, anum_t first, anum_t last,
   char buf[HUGE_STRING];
   int rc = 0;
   int oldmsgcount = ctx->msgcount;
+  int count = 0;
   anum_t current;
   anum_t first_over = first;
 #ifdef USE_HCACHE
@@ -1185,6 +1186,7 @@ static int nntp_fetch_headers(CONTEXT *ctx, void *hc, anum_t first, anum_t last,
   fc.messages = safe_calloc(last - first + 1, sizeof(unsigned char));
 #ifdef USE_HCACHE
   fc.hc = hc;
+  mutt_hcache_begin(fc.hc);
 #endif
 
   /* fetch list of articles */
@@ -1230,6 +1232,12 @@ static int nntp_fetch_headers(CONTEXT *ctx, void *hc, anum_t first, anum_t last,
     for (current = first; current <= last; current++)
       fc.messages[current - first] = 1;
 
+  /* the articles known to exist give the size of the group up front */
+  for (current = first; current <= last; current++)
+    if (fc.messages[current - first])
+      count++;
+  mx_reserve_memory(ctx, ctx->msgcount + count);
+
   /* fetching header from cache or server, or fallback to fetch overview */
   if (!ctx->quiet)
     mutt_progress_init(&fc.progress, _("Fetching message headers..."),
@@ -1259,7 +1267,7 @@ static int nntp_fetch_headers(CONTEXT *ctx, void *hc, anum_t first, anum_t last,
       mutt_debug(2, "nntp_fetch_headers: mutt_hcache_fetch %s\n", buf);
       ctx->hdrs[ctx->msgcount] = hdr = mutt_hcache_restore(hdata);
       mutt_hcache_free(fc.hc, &hdata);
-      hdr->data = 0;
+      hdr->cold->data = 0;
 
       /* skip header marked as deleted in cache */
       if (hdr->deleted && !restore)
@@ -1348,7 +1356,7 @@ static int nntp_fetch_headers(CONTEXT *ctx, void *hc, anum_t first, anum_t last,
     hdr->read = false;
     hdr->old = false;
     hdr->deleted = false;
-    hdr->data = safe_calloc(1, sizeof(NNTP_HEADER_DATA));
+    hdr->cold->data = safe_calloc(1, sizeof(NNTP_HEADER_DATA));
     NHDR(hdr)->article_num = current;
     if (restore)
       hdr->changed = true;
@@ -1379,6 +1387,10 @@ static int nntp_fetch_headers(CONTEXT *ctx, void *hc, anum_t first, anum_t last,
     }
   }
 
+#ifdef USE_HCACHE
+  mutt_hcache_commit(fc.hc);
+#endif
+
   if (ctx->msgcount > oldmsgcount)
     mx_update_context(ctx, ctx->msgcount - oldmsgcount);
 
@@ -1819,6 +1831,7 @@ static int nntp_check_mailbox(CONTEXT *ctx, int *index_hint)
     char buf[16];
     void *hdata = NULL;
     HEADER *hdr = NULL;
+    hcache_flags_t hflags;
     anum_t first = nntp_data->firstMessage;
 
     if (NntpContext && nntp_data->lastMessage - first + 1 > NntpContext)
@@ -1842,21 +1855,13 @@ static int nntp_check_mailbox(CONTEXT *ctx, int *index_hint)
           messages[anum - first] = 1;
 
         snprintf(buf, sizeof(buf), "%d", anum);
-        hdata = mutt_hcache_fetch(hc, buf, strlen(buf));
-        if (hdata)
+        if (mutt_hcache_fetch_flags(hc, buf, strlen(buf), &hflags) == 0)
         {
-          bool deleted;
-
-          mutt_debug(2, "nntp_check_mailbox: mutt_hcache_fetch %s\n", buf);
-          hdr = mutt_hcache_restore(hdata);
-          mutt_hcache_free(hc, &hdata);
-          hdr->data = 0;
-          deleted = hdr->deleted;
-          flagged = hdr->flagged;
-          mutt_free_header(&hdr);
+          mutt_debug(2, "nntp_check_mailbox: mutt_hcache_fetch_flags %s\n", buf);
+          flagged = hflags.flags & HCACHE_FLAG_FLAGGED;
 
           /* header marked as deleted, removing from context */
-          if (deleted)
+          if (hflags.flags & HCACHE_FLAG_DELETED)
           {
             mutt_set_flag(ctx, ctx->hdrs[i], MUTT_TAG, 0);
             mutt_free_header(&ctx->hdrs[i]);
@@ -1897,7 +1902,7 @@ static int nntp_check_mailbox(CONTEXT *ctx, int *index_hint)
 
         ctx->hdrs[ctx->msgcount] = hdr = mutt_hcache_restore(hdata);
         mutt_hcache_free(hc, &hdata);
-        hdr->data = 0;
+        hdr->cold->data = 0;
         if (hdr->deleted)
         {
           mutt_free_header(&hdr);
@@ -1912,7 +1917,7 @@ static int nntp_check_mailbox(CONTEXT *ctx, int *index_hint)
         ctx->msgcount++;
         hdr->read = false;
         hdr->old = false;
-        hdr->data = safe_calloc(1, sizeof(NNTP_HEADER_DATA));
+        hdr->cold->data = safe_calloc(1, sizeof(NNTP_HEADER_DATA));
         NHDR(hdr)->article_num = anum;
         nntp_article_status(ctx, hdr, NULL, anum);
         if (!hdr->read)
@@ -2054,6 +2059,39 @@ static int nntp_fastclose_mailbox(CONTEXT *ctx)
   return 0;
 }
 
+#ifdef USE_HCACHE
+/* Keep the index and the articles still available on the server,
+ * including those not loaded because of $nntp_context */
+static int nntp_hcache_keep(const char *key, void *data)
+{
+  NNTP_DATA *nntp_data = data;
+  anum_t anum;
+  char c;
+
+  if (mutt_strcmp(key, "index") == 0)
+    return 1;
+
+  return sscanf(key, ANUM "%c", &anum, &c) == 1 &&
+         anum >= nntp_data->firstMessage && anum <= nntp_data->lastMessage;
+}
+
+/* Drop cached headers of expired articles */
+static int nntp_compact_hcache(CONTEXT *ctx, bool force, long *reclaimed)
+{
+  NNTP_DATA *nntp_data = ctx->data;
+  header_cache_t *hc = NULL;
+  int rc;
+
+  hc = nntp_hcache_open(nntp_data);
+  if (!hc)
+    return -1;
+
+  rc = mutt_hcache_compact(hc, nntp_hcache_keep, nntp_data, force, reclaimed);
+  mutt_hcache_close(hc);
+  return rc;
+}
+#endif
+
 /* Get date and time from server */
 static int nntp_date(NNTP_SERVER *nserv, time_t *now)
 {
@@ -2277,7 +2315,7 @@ int nntp_check_msgid(CONTEXT *ctx, const char *msgid)
   if (ctx->msgcount == ctx->hdrmax)
     mx_alloc_memory(ctx);
   hdr = ctx->hdrs[ctx->msgcount] = mutt_new_header();
-  hdr->data = safe_calloc(1, sizeof(NNTP_HEADER_DATA));
+  hdr->cold->data = safe_calloc(1, sizeof(NNTP_HEADER_DATA));
   hdr->env = mutt_read_rfc822_header(fp, hdr, 0, 0);
   safe_fclose(&fp);
   unlink(tempfile);
@@ -2405,4 +2443,7 @@ struct mx_ops mx_nntp_ops = {
     .close_msg = nntp_close_message,
     .commit_msg = NULL,
     .open_new_msg = NULL,
+#ifdef USE_HCACHE
+    .compact_hcache = nntp_compact_hcache,
+#endif
 };
@@ -115,7 +115,7 @@ typedef struct
   bool parsed : 1;
 } NNTP_HEADER_DATA;
 
-#define NHDR(hdr) ((NNTP_HEADER_DATA *) ((hdr)->data))
+#define NHDR(hdr) ((NNTP_HEADER_DATA *) ((hdr)->cold->data))
 
 /* internal functions */
 int nntp_add_group(char *line, void *data);
@@ -363,10 +363,12 @@ void mutt_parse_content_type(char *s, BODY *ct)
   /* Default character set for text types. */
   if (ct->type == TYPETEXT)
   {
+    char charset[SHORT_STRING];
     if (!(pc = mutt_get_parameter("charset", ct->parameter)))
-      mutt_set_parameter("charset", (AssumedCharset && *AssumedCharset) ?
-                                        (const char *) mutt_get_default_charset() :
-                                        "us-ascii",
+      mutt_set_parameter("charset",
+                         (AssumedCharset && *AssumedCharset) ?
+                             (const char *) mutt_get_default_charset(charset, sizeof(charset)) :
+                             "us-ascii",
                          &ct->parameter);
   }
 }
@@ -743,6 +745,7 @@ time_t mutt_parse_date(const char *s, HEADER *h)
 {
   int count = 0;
   char *t = NULL;
+  char *save = NULL;
   int hour, min, sec;
   struct tm tm;
   int i;
@@ -769,7 +772,7 @@ time_t mutt_parse_date(const char *s, HEADER *h)
 
   memset(&tm, 0, sizeof(tm));
 
-  while ((t = strtok(t, " \t")) != NULL)
+  while ((t = strtok_r(t, " \t", &save)) != NULL)
   {
     switch (count)
     {
@@ -848,7 +851,7 @@ time_t mutt_parse_date(const char *s, HEADER *h)
           /* ad hoc support for the European MET (now officially CET) TZ */
           if (ascii_strcasecmp(t, "MET") == 0)
           {
-            if ((t = strtok(NULL, " \t")) != NULL)
+            if ((t = strtok_r(NULL, " \t", &save)) != NULL)
             {
               if (ascii_strcasecmp(t, "DST") == 0)
                 zhours++;
@@ -1364,10 +1367,12 @@ done:
  *
  * Returns:     newly allocated envelope structure.  You should free it by
  *              mutt_free_envelope() when envelope stay unneeded.
+ *              The fresh envelope and body of a header from mx_new_header()
+ *              are filled in instead of allocating new ones.
  */
 ENVELOPE *mutt_read_rfc822_header(FILE *f, HEADER *hdr, short user_hdrs, short weed)
 {
-  ENVELOPE *e = mutt_new_envelope();
+  ENVELOPE *e = (hdr && hdr->env && hdr->env->pooled) ? hdr->env : mutt_new_envelope();
   LIST *last = NULL;
   char *line = safe_malloc(LONG_STRING);
   char *p = NULL;
@@ -1377,9 +1382,10 @@ ENVELOPE *mutt_read_rfc822_header(FILE *f, HEADER *hdr, short user_hdrs, short w
 
   if (hdr)
   {
-    if (hdr->content == NULL)
+    if (hdr->content == NULL || hdr->content->pooled)
     {
-      hdr->content = mutt_new_body();
+      if (hdr->content == NULL)
+        hdr->content = mutt_new_body();
 
       /* set the defaults from RFC1521 */
       hdr->content->type = TYPETEXT;
@@ -1522,10 +1528,11 @@ ADDRESS *mutt_parse_adrlist(ADDRESS *p, const char *s)
   {
     char tmp[HUGE_STRING];
     char *r = NULL;
+    char *save = NULL;
 
     strfcpy(tmp, s, sizeof(tmp));
     r = tmp;
-    while ((r = strtok(r, " \t")) != NULL)
+    while ((r = strtok_r(r, " \t", &save)) != NULL)
     {
       p = rfc822_parse_adrlist(p, r);
       r = NULL;
@@ -1677,7 +1684,7 @@ int mutt_count_body_parts(CONTEXT *ctx, HEADER *hdr)
   short keep_parts = 0;
 
   if (hdr->attach_valid)
-    return hdr->attach_total;
+    return hdr->cold->attach_total;
 
   if (hdr->content->parts)
     keep_parts = 1;
@@ -1685,14 +1692,15 @@ int mutt_count_body_parts(CONTEXT *ctx, HEADER *hdr)
     mutt_parse_mime_message(ctx, hdr);
 
   if (AttachAllow || AttachExclude || InlineAllow || InlineExclude)
-    hdr->attach_total = count_body_parts(hdr->content, MUTT_PARTS_TOPLEVEL);
+    hdr->cold->attach_total =
+        count_body_parts(hdr->content, MUTT_PARTS_TOPLEVEL);
   else
-    hdr->attach_total = 0;
+    hdr->cold->attach_total = 0;
 
   hdr->attach_valid = true;
 
   if (!keep_parts)
     mutt_free_body(&hdr->content->parts);
 
-  return hdr->attach_total;
+  return hdr->cold->attach_total;
 }
@@ -31,6 +31,7 @@
 #include "mutt_crypt.h"
 #include "mutt_curses.h"
 #include "mutt_menu.h"
+#include "stats.h"
 #ifdef USE_IMAP
 #include "imap/imap.h"
 #include "mx.h"
@@ -867,7 +868,10 @@ static int patmatch(const pattern_t *pat, const char *buf)
   else if (pat->groupmatch)
     return !mutt_group_match(pat->p.g, buf);
   else
+  {
+    mutt_stats_count(STATS_REGEXEC);
     return regexec(pat->p.rx, buf, 0, NULL, 0);
+  }
 }
 
 static int msg_search(CONTEXT *ctx, pattern_t *pat, int msgno)
@@ -1762,6 +1766,7 @@ bool mutt_limit_current_thread(HEADER *h)
       Context->vsize += (body->length + body->offset - body->hdr_offset);
     }
   }
+  mutt_count_threads(Context);
   return true;
 }
 
@@ -1771,6 +1776,7 @@ int mutt_pattern_func(int op, char *prompt)
   char buf[LONG_STRING] = "", *simple = NULL;
   BUFFER err;
   int i;
+  long long start;
   progress_t progress;
 
   strfcpy(buf, NONULL(Context->pattern), sizeof(buf));
@@ -1794,6 +1800,7 @@ int mutt_pattern_func(int op, char *prompt)
     return -1;
   }
 
+  start = mutt_stats_start();
 #ifdef USE_IMAP
   if (Context->magic == MUTT_IMAP && imap_search(Context, pat) < 0)
     return -1;
@@ -1828,6 +1835,7 @@ int mutt_pattern_func(int op, char *prompt)
         Context->vsize += THIS_BODY->length + THIS_BODY->offset - THIS_BODY->hdr_offset;
       }
     }
+    mutt_count_threads(Context);
   }
   else
   {
@@ -1857,6 +1865,7 @@ int mutt_pattern_func(int op, char *prompt)
 
 #undef THIS_BODY
 
+  mutt_stats_stop(STATS_PATTERN, start, Context);
   mutt_clear_error();
 
   if (op == MUTT_LIMIT)
@@ -268,11 +268,13 @@ void pgp_invoke_getkeys(ADDRESS *addr)
 
   memset(&cctx, 0, sizeof(cctx));
 
+  /* this may replace the strings of addr, see rfc822_unshare_address() */
+  mutt_addrlist_to_local(addr);
+
   personal = addr->personal;
   addr->personal = NULL;
 
   *tmp = '\0';
-  mutt_addrlist_to_local(addr);
   rfc822_write_address_single(tmp, sizeof(tmp), addr, 0);
   mutt_quote_filename(buff, sizeof(buff), tmp);
 
@@ -70,13 +70,13 @@ static int pop_read_header(POP_DATA *pop_data, HEADER *h)
     return -3;
   }
 
-  snprintf(buf, sizeof(buf), "LIST %d\r\n", h->refno);
+  snprintf(buf, sizeof(buf), "LIST %d\r\n", h->cold->refno);
   ret = pop_query(pop_data, buf, sizeof(buf));
   if (ret == 0)
   {
     sscanf(buf, "+OK %d %ld", &index, &length);
 
-    snprintf(buf, sizeof(buf), "TOP %d 0\r\n", h->refno);
+    snprintf(buf, sizeof(buf), "TOP %d 0\r\n", h->cold->refno);
     ret = pop_fetch_data(pop_data, buf, NULL, fetch_message, f);
 
     if (pop_data->cmd_top == 2)
@@ -148,7 +148,7 @@ static int fetch_uidl(char *line, void *data)
   memmove(line, endp, strlen(endp) + 1);
 
   for (i = 0; i < ctx->msgcount; i++)
-    if (mutt_strcmp(line, ctx->hdrs[i]->data) == 0)
+    if (mutt_strcmp(line, ctx->hdrs[i]->cold->data) == 0)
       break;
 
   if (i == ctx->msgcount)
@@ -160,12 +160,12 @@ static int fetch_uidl(char *line, void *data)
 
     ctx->msgcount++;
     ctx->hdrs[i] = mutt_new_header();
-    ctx->hdrs[i]->data = safe_strdup(line);
+    ctx->hdrs[i]->cold->data = safe_strdup(line);
   }
   else if (ctx->hdrs[i]->index != index - 1)
     pop_data->clear_cache = true;
 
-  ctx->hdrs[i]->refno = index;
+  ctx->hdrs[i]->cold->refno = index;
   ctx->hdrs[i]->index = index - 1;
 
   return 0;
@@ -190,7 +190,8 @@ static int msg_cache_check(const char *id, body_cache_t *bcache, void *data)
 
   for (i = 0; i < ctx->msgcount; i++)
     /* if the id we get is known for a header: done (i.e. keep in cache) */
-    if (ctx->hdrs[i]->data && (mutt_strcmp(ctx->hdrs[i]->data, id) == 0))
+    if (ctx->hdrs[i]->cold->data &&
+        (mutt_strcmp(ctx->hdrs[i]->cold->data, id) == 0))
       return 0;
 
   /* message not found in context -> remove it from cache
@@ -218,6 +219,29 @@ static header_cache_t *pop_hcache_open(POP_DATA *pop_data, const char *path)
   url_ciss_tostring(&url, p, sizeof(p), U_PATH);
   return mutt_hcache_open(HeaderCache, p, pop_hcache_namer);
 }
+
+static int pop_compact_hcache(CONTEXT *ctx, bool force, long *reclaimed)
+{
+  header_cache_t *hc = NULL;
+  HASH *keys = NULL;
+  int rc;
+
+  hc = pop_hcache_open((POP_DATA *) ctx->data, ctx->path);
+  if (!hc)
+    return -1;
+
+  /* messages are cached under their UIDL */
+  keys = hash_create(ctx->msgcount + 1, 0);
+  for (int i = 0; i < ctx->msgcount; i++)
+    if (ctx->hdrs[i]->cold->data)
+      hash_insert(keys, ctx->hdrs[i]->cold->data, ctx->hdrs[i]);
+
+  rc = mutt_hcache_compact(hc, mutt_hcache_keep_hash, keys, force, reclaimed);
+
+  hash_destroy(&keys, NULL);
+  mutt_hcache_close(hc);
+  return rc;
+}
 #endif
 
 /*
@@ -240,13 +264,14 @@ static int pop_fetch_headers(CONTEXT *ctx)
   void *data = NULL;
 
   hc = pop_hcache_open(pop_data, ctx->path);
+  mutt_hcache_begin(hc);
 #endif
 
   time(&pop_data->check_time);
   pop_data->clear_cache = false;
 
   for (i = 0; i < ctx->msgcount; i++)
-    ctx->hdrs[i]->refno = -1;
+    ctx->hdrs[i]->cold->refno = -1;
 
   old_count = ctx->msgcount;
   ret = pop_fetch_data(pop_data, "UIDL\r\n", NULL, fetch_uidl, ctx);
@@ -280,7 +305,7 @@ static int pop_fetch_headers(CONTEXT *ctx)
   {
     for (i = 0, deleted = 0; i < old_count; i++)
     {
-      if (ctx->hdrs[i]->refno == -1)
+      if (ctx->hdrs[i]->cold->refno == -1)
       {
         ctx->hdrs[i]->deleted = true;
         deleted++;
@@ -297,10 +322,10 @@ static int pop_fetch_headers(CONTEXT *ctx)
       if (!ctx->quiet)
         mutt_progress_update(&progress, i + 1 - old_count, -1);
 #ifdef USE_HCACHE
-      if ((data = mutt_hcache_fetch(hc, ctx->hdrs[i]->data, strlen(ctx->hdrs[i]->data))))
+      if ((data = mutt_hcache_fetch(hc, ctx->hdrs[i]->cold->data, strlen(ctx->hdrs[i]->cold->data))))
       {
-        char *uidl = safe_strdup(ctx->hdrs[i]->data);
-        int refno = ctx->hdrs[i]->refno;
+        char *uidl = safe_strdup(ctx->hdrs[i]->cold->data);
+        int refno = ctx->hdrs[i]->cold->refno;
         int index = ctx->hdrs[i]->index;
         /*
          * - POP dynamically numbers headers and relies on h->refno
@@ -315,9 +340,9 @@ static int pop_fetch_headers(CONTEXT *ctx)
         mutt_hcache_free(hc, &data);
         mutt_free_header(&ctx->hdrs[i]);
         ctx->hdrs[i] = h;
-        ctx->hdrs[i]->refno = refno;
+        ctx->hdrs[i]->cold->refno = refno;
         ctx->hdrs[i]->index = index;
-        ctx->hdrs[i]->data = uidl;
+        ctx->hdrs[i]->cold->data = uidl;
         ret = 0;
         hcached = 1;
       }
@@ -328,8 +353,8 @@ static int pop_fetch_headers(CONTEXT *ctx)
 #ifdef USE_HCACHE
       else
       {
-        mutt_hcache_store(hc, ctx->hdrs[i]->data, strlen(ctx->hdrs[i]->data),
-                          ctx->hdrs[i], 0);
+        mutt_hcache_store(hc, ctx->hdrs[i]->cold->data,
+                          strlen(ctx->hdrs[i]->cold->data), ctx->hdrs[i], 0);
       }
 #endif
 
@@ -345,7 +370,8 @@ static int pop_fetch_headers(CONTEXT *ctx)
        *        - if we also have a body: read
        *        - if we don't have a body: new
        */
-      bcached = mutt_bcache_exists(pop_data->bcache, ctx->hdrs[i]->data) == 0;
+      bcached =
+          mutt_bcache_exists(pop_data->bcache, ctx->hdrs[i]->cold->data) == 0;
       ctx->hdrs[i]->old = false;
       ctx->hdrs[i]->read = false;
       if (hcached)
@@ -369,6 +395,7 @@ static int pop_fetch_headers(CONTEXT *ctx)
   }
 
 #ifdef USE_HCACHE
+  mutt_hcache_commit(hc);
   mutt_hcache_close(hc);
 #endif
 
@@ -521,7 +548,7 @@ static int pop_fetch_message(CONTEXT *ctx, MESSAGE *msg, int msgno)
   unsigned short bcache = 1;
 
   /* see if we already have the message in body cache */
-  if ((msg->fp = mutt_bcache_get(pop_data->bcache, h->data)))
+  if ((msg->fp = mutt_bcache_get(pop_data->bcache, h->cold->data)))
     return 0;
 
   /*
@@ -557,7 +584,7 @@ static int pop_fetch_message(CONTEXT *ctx, MESSAGE *msg, int msgno)
       return -1;
 
     /* verify that massage index is correct */
-    if (h->refno < 0)
+    if (h->cold->refno < 0)
     {
       mutt_error(
           _("The message index is incorrect. Try reopening the mailbox."));
@@ -569,7 +596,7 @@ static int pop_fetch_message(CONTEXT *ctx, MESSAGE *msg, int msgno)
                        NetInc, h->content->length + h->content->offset - 1);
 
     /* see if we can put in body cache; use our cache as fallback */
-    if (!(msg->fp = mutt_bcache_put(pop_data->bcache, h->data, 1)))
+    if (!(msg->fp = mutt_bcache_put(pop_data->bcache, h->cold->data, 1)))
     {
       /* no */
       bcache = 0;
@@ -582,7 +609,7 @@ static int pop_fetch_message(CONTEXT *ctx, MESSAGE *msg, int msgno)
       }
     }
 
-    snprintf(buf, sizeof(buf), "RETR %d\r\n", h->refno);
+    snprintf(buf, sizeof(buf), "RETR %d\r\n", h->cold->refno);
 
     ret = pop_fetch_data(pop_data, buf, &progressbar, fetch_message, msg->fp);
     if (ret == 0)
@@ -615,14 +642,14 @@ static int pop_fetch_message(CONTEXT *ctx, MESSAGE *msg, int msgno)
    * portion of the headers, those required for the main display.
    */
   if (bcache)
-    mutt_bcache_commit(pop_data->bcache, h->data);
+    mutt_bcache_commit(pop_data->bcache, h->cold->data);
   else
   {
     cache->index = h->index;
     cache->path = safe_strdup(path);
   }
   rewind(msg->fp);
-  uidl = h->data;
+  uidl = h->cold->data;
 
   /* we replace envelop, key in subj_hash has to be updated as well */
   if (ctx->subj_hash && h->env->real_subj)
@@ -634,7 +661,7 @@ static int pop_fetch_message(CONTEXT *ctx, MESSAGE *msg, int msgno)
     hash_insert(ctx->subj_hash, h->env->real_subj, h);
   mutt_label_hash_add(ctx, h);
 
-  h->data = uidl;
+  h->cold->data = uidl;
   h->lines = 0;
   fgets(buf, sizeof(buf), msg->fp);
   while (!feof(msg->fp))
@@ -687,17 +714,17 @@ static int pop_sync_mailbox(CONTEXT *ctx, int *index_hint)
 
     for (i = 0, j = 0, ret = 0; ret == 0 && i < ctx->msgcount; i++)
     {
-      if (ctx->hdrs[i]->deleted && ctx->hdrs[i]->refno != -1)
+      if (ctx->hdrs[i]->deleted && ctx->hdrs[i]->cold->refno != -1)
       {
         j++;
         if (!ctx->quiet)
           mutt_progress_update(&progress, j, -1);
-        snprintf(buf, sizeof(buf), "DELE %d\r\n", ctx->hdrs[i]->refno);
+        snprintf(buf, sizeof(buf), "DELE %d\r\n", ctx->hdrs[i]->cold->refno);
         if ((ret = pop_query(pop_data, buf, sizeof(buf))) == 0)
         {
-          mutt_bcache_del(pop_data->bcache, ctx->hdrs[i]->data);
+          mutt_bcache_del(pop_data->bcache, ctx->hdrs[i]->cold->data);
 #ifdef USE_HCACHE
-          mutt_hcache_delete(hc, ctx->hdrs[i]->data, strlen(ctx->hdrs[i]->data));
+          mutt_hcache_delete(hc, ctx->hdrs[i]->cold->data, strlen(ctx->hdrs[i]->cold->data));
 #endif
         }
       }
@@ -705,8 +732,8 @@ static int pop_sync_mailbox(CONTEXT *ctx, int *index_hint)
 #ifdef USE_HCACHE
       if (ctx->hdrs[i]->changed)
       {
-        mutt_hcache_store(hc, ctx->hdrs[i]->data, strlen(ctx->hdrs[i]->data),
-                          ctx->hdrs[i], 0);
+        mutt_hcache_store(hc, ctx->hdrs[i]->cold->data,
+                          strlen(ctx->hdrs[i]->cold->data), ctx->hdrs[i], 0);
       }
 #endif
     }
@@ -943,4 +970,7 @@ struct mx_ops mx_pop_ops = {
     .commit_msg = NULL,
     .open_new_msg = NULL,
     .sync = pop_sync_mailbox,
+#ifdef USE_HCACHE
+    .compact_hcache = pop_compact_hcache,
+#endif
 };
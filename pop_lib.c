@@ -535,9 +535,9 @@ static int check_uidl(char *line, void *data)
 
   for (i = 0; i < ctx->msgcount; i++)
   {
-    if (mutt_strcmp(ctx->hdrs[i]->data, line) == 0)
+    if (mutt_strcmp(ctx->hdrs[i]->cold->data, line) == 0)
     {
-      ctx->hdrs[i]->refno = index;
+      ctx->hdrs[i]->cold->refno = index;
       break;
     }
   }
@@ -570,7 +570,7 @@ int pop_reconnect(CONTEXT *ctx)
                          MUTT_PROGRESS_SIZE, NetInc, 0);
 
       for (i = 0; i < ctx->msgcount; i++)
-        ctx->hdrs[i]->refno = -1;
+        ctx->hdrs[i]->cold->refno = -1;
 
       ret = pop_fetch_data(pop_data, "UIDL\r\n", &progressbar, check_uidl, ctx);
       if (ret == -2)
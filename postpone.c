@@ -385,12 +385,12 @@ int mutt_get_postponed(CONTEXT *ctx, HEADER *hdr, HEADER **cur, char *fcc, size_
     else if (mutt_strncmp("X-Mutt-Mix:", tmp->data, 11) == 0)
     {
       char *t = NULL;
-      mutt_free_list(&hdr->chain);
+      mutt_free_list(&hdr->cold->chain);
 
       t = strtok(tmp->data + 11, " \t\n");
       while (t)
       {
-        hdr->chain = mutt_add_list(hdr->chain, t);
+        hdr->cold->chain = mutt_add_list(hdr->cold->chain, t);
         t = strtok(NULL, " \t\n");
       }
 
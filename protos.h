@@ -213,6 +213,7 @@ void mutt_free_alias(ALIAS **p);
 void mutt_free_body(BODY **p);
 void mutt_free_color(int fg, int bg);
 void mutt_free_enter_state(ENTER_STATE **esp);
+void mutt_env_restore_lazy(ENVELOPE *e);
 void mutt_free_envelope(ENVELOPE **p);
 void mutt_free_header(HEADER **h);
 void mutt_free_parameter(PARAMETER **p);
@@ -226,6 +227,7 @@ void mutt_make_help(char *d, size_t dlen, const char *txt, int menu, int op);
 void mutt_make_misc_reply_headers(ENVELOPE *env, CONTEXT *ctx, HEADER *cur, ENVELOPE *curenv);
 void mutt_make_post_indent(CONTEXT *ctx, HEADER *cur, FILE *out);
 void mutt_merge_envelopes(ENVELOPE *base, ENVELOPE **extra);
+void mutt_env_unshare_refs(ENVELOPE *env);
 void mutt_message_to_7bit(BODY *a, FILE *fp);
 #define mutt_mktemp(a, b) mutt_mktemp_pfx_sfx(a, b, "mutt", NULL)
 #define mutt_mktemp_pfx_sfx(a, b, c, d) _mutt_mktemp(a, b, c, d, __FILE__, __LINE__)
@@ -267,6 +269,8 @@ void mutt_version(void);
 void mutt_view_attachments(HEADER *hdr);
 void mutt_write_address_list(ADDRESS *adr, FILE *fp, int linelen, int display);
 void mutt_set_virtual(CONTEXT *ctx);
+void mutt_count_threads(CONTEXT *ctx);
+void mutt_count_thread_message(CONTEXT *ctx, HEADER *cur, int n);
 int mutt_add_to_rx_list(RX_LIST **list, const char *s, int flags, BUFFER *err);
 bool mutt_addr_is_user(ADDRESS *addr);
 int mutt_addwch(wchar_t wc);
@@ -82,6 +82,7 @@ static size_t convert_string(ICONV_CONST char *f, size_t flen, const char *from,
 int convert_nonmime_string(char **ps)
 {
   const char *c = NULL, *c1 = NULL;
+  char buf[SHORT_STRING];
 
   for (c = AssumedCharset; c; c = c1 ? c1 + 1 : 0)
   {
@@ -110,8 +111,8 @@ int convert_nonmime_string(char **ps)
       return 0;
     }
   }
-  mutt_convert_string(ps, (const char *) mutt_get_default_charset(), Charset,
-                      MUTT_ICONV_HOOK_FROM);
+  mutt_convert_string(ps, (const char *) mutt_get_default_charset(buf, sizeof(buf)),
+                      Charset, MUTT_ICONV_HOOK_FROM);
   return -1;
 }
 
@@ -879,9 +880,15 @@ void rfc2047_decode_adrlist(ADDRESS *a)
   {
     if (a->personal &&
         ((strstr(a->personal, "=?") != NULL) || (AssumedCharset && *AssumedCharset)))
+    {
+      rfc822_unshare_address(a);
       rfc2047_decode(&a->personal);
+    }
     else if (a->group && a->mailbox && (strstr(a->mailbox, "=?") != NULL))
+    {
+      rfc822_unshare_address(a);
       rfc2047_decode(&a->mailbox);
+    }
 #ifdef EXACT_ADDRESS
     if (a->val && strstr(a->val, "=?") != NULL)
       rfc2047_decode(&a->val);
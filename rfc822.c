@@ -55,7 +55,11 @@
 const char RFC822Specials[] = "@.,:;<>[]\\\"()";
 #define is_special(x) strchr(RFC822Specials, x)
 
+#ifdef HAVE_PTHREAD
+__thread int RFC822Error = 0;
+#else
 int RFC822Error = 0;
+#endif
 
 /* these must defined in the same order as the numerated errors given in rfc822.h */
 const char *const RFC822Errors[] = {
@@ -86,12 +90,16 @@ void rfc822_dequote_comment(char *s)
 
 static void free_address(ADDRESS *a)
 {
-  FREE(&a->personal);
-  FREE(&a->mailbox);
+  if (!a->interned)
+  {
+    FREE(&a->personal);
+    FREE(&a->mailbox);
+  }
 #ifdef EXACT_ADDRESS
   FREE(&a->val);
 #endif
-  FREE(&a);
+  if (!a->pooled)
+    FREE(&a);
 }
 
 int rfc822_remove_from_adrlist(ADDRESS **a, const char *mailbox)
@@ -124,7 +132,9 @@ int rfc822_remove_from_adrlist(ADDRESS **a, const char *mailbox)
   return rv;
 }
 
-void rfc822_free_address(ADDRESS **p)
+/* free an address list, except for the nodes which belong to a mailbox (see
+ * mx_intern_envelope()): they are chained on freed, if it isn't NULL */
+void rfc822_release_address(ADDRESS **p, ADDRESS **freed)
 {
   ADDRESS *t = NULL;
 
@@ -135,12 +145,26 @@ void rfc822_free_address(ADDRESS **p)
 #ifdef EXACT_ADDRESS
     FREE(&t->val);
 #endif
-    FREE(&t->personal);
-    FREE(&t->mailbox);
-    FREE(&t);
+    if (!t->interned)
+    {
+      FREE(&t->personal);
+      FREE(&t->mailbox);
+    }
+    if (!t->pooled)
+      FREE(&t);
+    else if (freed)
+    {
+      t->next = *freed;
+      *freed = t;
+    }
   }
 }
 
+void rfc822_free_address(ADDRESS **p)
+{
+  rfc822_release_address(p, NULL);
+}
+
 static const char *parse_comment(const char *s, char *comment, size_t *commentlen, size_t commentmax)
 {
   int level = 1;
@@ -549,6 +573,18 @@ ADDRESS *rfc822_parse_adrlist(ADDRESS *top, const char *s)
   return top;
 }
 
+/* give an address its own copy of the strings it shares with the other
+ * messages of a mailbox, before they are changed */
+void rfc822_unshare_address(ADDRESS *a)
+{
+  if (!a->interned)
+    return;
+
+  a->personal = safe_strdup(a->personal);
+  a->mailbox = safe_strdup(a->mailbox);
+  a->interned = false;
+}
+
 void rfc822_qualify(ADDRESS *addr, const char *host)
 {
   char *p = NULL;
@@ -556,6 +592,7 @@ void rfc822_qualify(ADDRESS *addr, const char *host)
   for (; addr; addr = addr->next)
     if (!addr->group && addr->mailbox && strchr(addr->mailbox, '@') == NULL)
     {
+      rfc822_unshare_address(addr);
       p = safe_malloc(mutt_strlen(addr->mailbox) + mutt_strlen(host) + 2);
       sprintf(p, "%s@%s", addr->mailbox, host); /* __SPRINTF_CHECKED__ */
       FREE(&addr->mailbox);
@@ -43,11 +43,14 @@ typedef struct address_t
   struct address_t *next;
   bool is_intl : 1;
   bool intl_checked : 1;
+  bool interned : 1; /* personal and mailbox belong to a mailbox, see mx_intern() */
+  bool pooled : 1;   /* the node belongs to a mailbox, see mx_intern_envelope() */
 } ADDRESS;
 
 void rfc822_dequote_comment(char *s);
 void rfc822_free_address(ADDRESS **p);
 void rfc822_qualify(ADDRESS *addr, const char *host);
+void rfc822_unshare_address(ADDRESS *a);
 ADDRESS *rfc822_parse_adrlist(ADDRESS *top, const char *s);
 ADDRESS *rfc822_cpy_adr(ADDRESS *addr, int prune);
 ADDRESS *rfc822_cpy_adr_real(ADDRESS *addr);
@@ -55,11 +58,17 @@ ADDRESS *rfc822_append(ADDRESS **a, ADDRESS *b, int prune);
 int rfc822_write_address(char *buf, size_t buflen, ADDRESS *addr, int display);
 void rfc822_write_address_single(char *buf, size_t buflen, ADDRESS *addr, int display);
 void rfc822_free_address(ADDRESS **p);
+void rfc822_release_address(ADDRESS **p, ADDRESS **freed);
 void rfc822_cat(char *buf, size_t buflen, const char *value, const char *specials);
 bool rfc822_valid_msgid(const char *msgid);
 int rfc822_remove_from_adrlist(ADDRESS **a, const char *mailbox);
 
+#ifdef HAVE_PTHREAD
+/* the address parser may run on several threads, see mh.c and mbox.c */
+extern __thread int RFC822Error;
+#else
 extern int RFC822Error;
+#endif
 extern const char *const RFC822Errors[];
 
 #define rfc822_error(x) RFC822Errors[x]
@@ -575,6 +575,8 @@ int mutt_fetch_recips(ENVELOPE *out, ENVELOPE *in, int flags)
   ADDRESS *tmp = NULL;
   int hmfupto = -1;
 
+  mutt_env_restore_lazy(in);
+
   if ((flags & (SENDLISTREPLY | SENDGROUPREPLY)) && in->mail_followup_to)
   {
     snprintf(prompt, sizeof(prompt), _("Follow-up to %s%s?"),
@@ -1070,7 +1072,7 @@ static int send_message(HEADER *msg)
     unset_option(OPTWRITEBCC);
 #endif
 #ifdef MIXMASTER
-  mutt_write_rfc822_header(tempfp, msg->env, msg->content, 0, msg->chain ? 1 : 0);
+  mutt_write_rfc822_header(tempfp, msg->env, msg->content, 0, msg->cold->chain ? 1 : 0);
 #endif
 #ifndef MIXMASTER
   mutt_write_rfc822_header(tempfp, msg->env, msg->content, 0, 0);
@@ -1097,8 +1099,8 @@ static int send_message(HEADER *msg)
   }
 
 #ifdef MIXMASTER
-  if (msg->chain)
-    return mix_send_message(msg->chain, tempfile);
+  if (msg->cold->chain)
+    return mix_send_message(msg->cold->chain, tempfile);
 #endif
 
 #ifdef USE_SMTP
@@ -2910,12 +2910,12 @@ int mutt_write_fcc(const char *path, HEADER *hdr, const char *msgid, int post,
    * chain, save that information
    */
 
-  if (post && hdr->chain && hdr->chain)
+  if (post && hdr->cold->chain && hdr->cold->chain)
   {
     LIST *p = NULL;
 
     fputs("X-Mutt-Mix:", msg->fp);
-    for (p = hdr->chain; p; p = p->next)
+    for (p = hdr->cold->chain; p; p = p->next)
       fprintf(msg->fp, " %s", (char *) p->data);
 
     fputc('\n', msg->fp);
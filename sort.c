@@ -17,12 +17,18 @@
 
 #include "config.h"
 #include <ctype.h>
+#include <limits.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#include <signal.h>
+#endif
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include "mutt.h"
 #include "sort.h"
 #include "mutt_idna.h"
+#include "stats.h"
 #ifdef USE_NNTP
 #include "mx.h"
 #include "nntp.h"
@@ -108,6 +114,18 @@ const char *mutt_get_name(ADDRESS *a)
   return "";
 }
 
+/* Whether mutt_get_name() gives the same name for two addresses, judging by
+ * their interned strings alone.  False means that the names must be compared.
+ */
+static bool same_name(ADDRESS *a, ADDRESS *b)
+{
+  if (!a || !b || !a->interned || !b->interned || option(OPTREVALIAS))
+    return false;
+  if (a->personal || b->personal)
+    return a->personal == b->personal;
+  return a->mailbox == b->mailbox;
+}
+
 static int compare_to(const void *a, const void *b)
 {
   HEADER **ppa = (HEADER **) a;
@@ -116,9 +134,14 @@ static int compare_to(const void *a, const void *b)
   const char *fb = NULL;
   int result;
 
-  strfcpy(fa, mutt_get_name((*ppa)->env->to), SHORT_STRING);
-  fb = mutt_get_name((*ppb)->env->to);
-  result = mutt_strncasecmp(fa, fb, SHORT_STRING);
+  if (same_name((*ppa)->env->to, (*ppb)->env->to))
+    result = 0;
+  else
+  {
+    strfcpy(fa, mutt_get_name((*ppa)->env->to), SHORT_STRING);
+    fb = mutt_get_name((*ppb)->env->to);
+    result = mutt_strncasecmp(fa, fb, SHORT_STRING);
+  }
   AUXSORT(result, a, b);
   return (SORTCODE(result));
 }
@@ -131,9 +154,14 @@ static int compare_from(const void *a, const void *b)
   const char *fb = NULL;
   int result;
 
-  strfcpy(fa, mutt_get_name((*ppa)->env->from), SHORT_STRING);
-  fb = mutt_get_name((*ppb)->env->from);
-  result = mutt_strncasecmp(fa, fb, SHORT_STRING);
+  if (same_name((*ppa)->env->from, (*ppb)->env->from))
+    result = 0;
+  else
+  {
+    strfcpy(fa, mutt_get_name((*ppa)->env->from), SHORT_STRING);
+    fb = mutt_get_name((*ppb)->env->from);
+    result = mutt_strncasecmp(fa, fb, SHORT_STRING);
+  }
   AUXSORT(result, a, b);
   return (SORTCODE(result));
 }
@@ -284,12 +312,499 @@ sort_t *mutt_get_sort_func(int method)
   /* not reached */
 }
 
+/* The sort keys of a message: what the compare_*() functions look at for $sort
+ * and $sort_aux, looked up once per message.  Comparing them doesn't need
+ * mutt_get_name() or any case folding, and most comparisons of strings stop
+ * at their prefix.
+ */
+struct sort_key
+{
+  long long num;             /* date, size, score... or the class of a string */
+  unsigned long long prefix; /* first bytes of the (case folded) string */
+  size_t rest;               /* rest of the string, offset in SortKeys */
+};
+
+struct sort_entry
+{
+  struct sort_key key[2]; /* $sort, $sort_aux */
+  int index;              /* index of the message, the last resort */
+  int slot;               /* of the message in SortKeys */
+  bool flip;              /* $sort_aux and index go the other way */
+};
+
+/* what the entries refer to */
+static struct
+{
+  HEADER **hdrs;        /* the messages, by slot */
+  char *data;           /* the rest of the strings of the keys, 0 is "" */
+  size_t len;
+  size_t size;
+} SortKeys;
+
+static void sort_key_string(struct sort_key *k, const char *s, size_t max, int fold)
+{
+  size_t len = mutt_strlen(s), i;
+  unsigned char c;
+
+  if (len > max)
+    len = max;
+
+  /* zero padding keeps the order of strcmp() */
+  k->prefix = 0;
+  for (i = 0; i < sizeof(k->prefix); i++)
+  {
+    c = (i < len) ? (unsigned char) s[i] : 0;
+    k->prefix = (k->prefix << 8) | (fold ? tolower(c) : c);
+  }
+  if (len <= sizeof(k->prefix))
+    return;
+
+  len -= sizeof(k->prefix);
+  s += sizeof(k->prefix);
+  if (SortKeys.len + len + 1 > SortKeys.size)
+  {
+    SortKeys.size = MAX(2 * SortKeys.size, SortKeys.len + len + 1);
+    safe_realloc(&SortKeys.data, SortKeys.size);
+  }
+  k->rest = SortKeys.len;
+  for (i = 0; i < len; i++)
+    SortKeys.data[SortKeys.len++] = fold ? tolower((unsigned char) s[i]) : s[i];
+  SortKeys.data[SortKeys.len++] = '\0';
+}
+
+/* Set k to the key of h for a sort method, in the order of its compare_*()
+ * function before $sort's reverse is applied */
+static void sort_key_set(struct sort_key *k, int method, CONTEXT *ctx, HEADER *h)
+{
+  char *p = NULL;
+  double d;
+
+  memset(k, 0, sizeof(*k));
+  switch (method & SORT_MASK)
+  {
+    case SORT_RECEIVED:
+      k->num = h->received;
+      break;
+    case SORT_ORDER:
+#ifdef USE_NNTP
+      if (ctx->magic == MUTT_NNTP)
+      {
+        k->num = NHDR(h)->article_num;
+        break;
+      }
+#endif
+      k->num = h->index;
+      break;
+    case SORT_DATE:
+      k->num = h->date_sent;
+      break;
+    case SORT_SUBJECT:
+      /* messages without a subject come first, by date */
+      if (h->env->real_subj)
+      {
+        k->num = LLONG_MAX;
+        sort_key_string(k, h->env->real_subj, (size_t) -1, 1);
+      }
+      else
+        k->num = h->date_sent;
+      break;
+    case SORT_FROM:
+      sort_key_string(k, mutt_get_name(h->env->from), SHORT_STRING - 1, 1);
+      break;
+    case SORT_TO:
+      sort_key_string(k, mutt_get_name(h->env->to), SHORT_STRING - 1, 1);
+      break;
+    case SORT_SIZE:
+      k->num = h->content->length;
+      break;
+    case SORT_SCORE:
+      k->num = -h->score; /* note that this is reverse */
+      break;
+    case SORT_SPAM:
+      /* messages without a spam tag come first, then by the value of the tag
+       * and its text.  A double is ordered as an integer once its sign bit is
+       * moved to the top, see IEEE 754. */
+      if (h->env->spam)
+      {
+        d = strtod(h->env->spam->data, &p);
+        memcpy(&k->num, &d, sizeof(k->num));
+        if (k->num < 0)
+          k->num = LLONG_MIN - k->num;
+        sort_key_string(k, p, (size_t) -1, 0);
+      }
+      else
+        k->num = LLONG_MIN;
+      break;
+    case SORT_LABEL:
+      /* messages with a label come first */
+      if (h->env->x_label && *h->env->x_label)
+        sort_key_string(k, h->env->x_label, (size_t) -1, 1);
+      else
+        k->num = 1;
+      break;
+  }
+}
+
+static int compare_key(const struct sort_key *a, const struct sort_key *b)
+{
+  if (a->num != b->num)
+    return (a->num < b->num) ? -1 : 1;
+  if (a->prefix != b->prefix)
+    return (a->prefix < b->prefix) ? -1 : 1;
+  if (a->rest != b->rest)
+    return strcmp(SortKeys.data + a->rest, SortKeys.data + b->rest);
+  return 0;
+}
+
+/* like AUXSORT(), $sort's reverse doesn't apply to $sort_aux nor to the order
+ * of the messages, unless they are flipped.  Entries with the same $sort key
+ * are all flipped or none is. */
+static int compare_entries(const void *a, const void *b)
+{
+  const struct sort_entry *ea = (const struct sort_entry *) a;
+  const struct sort_entry *eb = (const struct sort_entry *) b;
+  int rc;
+
+  if ((rc = compare_key(&ea->key[0], &eb->key[0])))
+    return (SORTCODE(rc));
+  if (!(rc = compare_key(&ea->key[1], &eb->key[1])))
+    rc = ea->index - eb->index;
+  return ea->flip ? -rc : rc;
+}
+
+#define RADIX_WORDS 5
+
+/* Word of the order of e, for sort_entries().  From the least significant: its
+ * index, the prefix and the number of its $sort_aux key, then those of its
+ * $sort key, which go down when $sort is reversed.  Those below the $sort key
+ * go down when e is flipped. */
+static unsigned long long radix_word(const struct sort_entry *e, int word, int reverse)
+{
+  const struct sort_key *k = &e->key[word < 3];
+  unsigned long long v;
+
+  if (word == 0)
+    v = (unsigned int) e->index;
+  else if (word % 2)
+    v = k->prefix;
+  else
+    v = (unsigned long long) k->num ^ (1ULL << 63);
+  if ((reverse && (word > 2)) || (e->flip && (word <= 2)))
+    v = ~v;
+  return v;
+}
+
+/* Sort entries as compare_entries() does.  A radix sort orders them by the
+ * numbers and the prefixes of their keys, then by index.  Only the messages
+ * that the rest of their strings could reorder are then compared. */
+static void sort_entries(struct sort_entry *entries, int n)
+{
+  int(*count)[256] = NULL;
+  struct sort_entry *tmp = NULL, *src = entries, *dst = NULL, *swap = NULL;
+  unsigned long long v;
+  int reverse = Sort & SORT_REVERSE;
+  int pass, word, i, j, c, sum, more, first, lo, hi;
+
+  if (n < 2)
+    return;
+
+  /* the indices of the messages of a mailbox go from 0 to msgcount - 1: put
+   * the entries in their order at once rather than sort them by index, unless
+   * some are ordered by decreasing index */
+  dst = tmp = safe_malloc(n * sizeof(struct sort_entry));
+  lo = hi = entries[0].index;
+  for (i = 1; i < n; i++)
+  {
+    lo = MIN(lo, entries[i].index);
+    hi = MAX(hi, entries[i].index);
+  }
+  first = 0;
+  if (hi - lo == n - 1)
+  {
+    for (i = 0; i < n; i++)
+      tmp[i].index = -1;
+    for (i = 0; (i < n) && !entries[i].flip && (tmp[entries[i].index - lo].index == -1); i++)
+      tmp[entries[i].index - lo] = entries[i];
+    if (i == n)
+    {
+      src = tmp;
+      dst = entries;
+      first = 8;
+    }
+  }
+
+  count = safe_calloc(8 * RADIX_WORDS, sizeof(*count));
+  for (i = 0; i < n; i++)
+  {
+    for (word = first / 8; word < RADIX_WORDS; word++)
+    {
+      v = radix_word(&src[i], word, reverse);
+      for (pass = 8 * word; pass < 8 * (word + 1); pass++, v >>= 8)
+        count[pass][v & 0xff]++;
+    }
+  }
+
+  for (pass = first; pass < 8 * RADIX_WORDS; pass++)
+  {
+    word = pass / 8;
+    c = 8 * (pass % 8);
+    /* skip the bytes that are the same in all the entries */
+    if (count[pass][(radix_word(&src[0], word, reverse) >> c) & 0xff] == n)
+      continue;
+    for (sum = 0, j = 0; j < 256; j++)
+    {
+      i = count[pass][j];
+      count[pass][j] = sum;
+      sum += i;
+    }
+    for (i = 0; i < n; i++)
+      dst[count[pass][(radix_word(&src[i], word, reverse) >> c) & 0xff]++] = src[i];
+    swap = src;
+    src = dst;
+    dst = swap;
+  }
+  if (src != entries)
+    memcpy(entries, src, n * sizeof(struct sort_entry));
+  FREE(&tmp);
+  FREE(&count);
+
+  for (i = 0; i < n; i = j)
+  {
+    more = entries[i].key[0].rest || entries[i].key[1].rest;
+    for (j = i + 1; (j < n) && (entries[j].key[0].num == entries[i].key[0].num) &&
+                    (entries[j].key[0].prefix == entries[i].key[0].prefix);
+         j++)
+      more |= entries[j].key[0].rest || entries[j].key[1].rest;
+    if (more && (j - i > 1))
+      qsort(entries + i, j - i, sizeof(struct sort_entry), compare_entries);
+  }
+}
+
+#ifdef HAVE_PTHREAD
+/* Upper bound for $index_sort_threads */
+#define SORT_MAX_THREADS 16
+/* Fewest messages worth a thread of their own */
+#define SORT_MIN_CHUNK 25000
+
+/* A share of the work of sort_entries_threads(): sort entries, or if out is
+ * set, merge the sorted halves entries[0, mid) and entries[mid, n) into it.
+ * Each job only touches its own entries. */
+struct sort_job
+{
+  struct sort_entry *entries;
+  int n;
+  int mid;
+  struct sort_entry *out;
+};
+
+static void merge_entries(struct sort_job *job)
+{
+  struct sort_entry *a = job->entries, *b = job->entries + job->mid;
+  struct sort_entry *a_end = b, *b_end = job->entries + job->n;
+  struct sort_entry *out = job->out;
+
+  /* the first half wins a tie, but there are none: the indices differ */
+  while ((a < a_end) && (b < b_end))
+  {
+    if (compare_entries(a, b) <= 0)
+      *out++ = *a++;
+    else
+      *out++ = *b++;
+  }
+  memcpy(out, a, (a_end - a) * sizeof(struct sort_entry));
+  out += a_end - a;
+  memcpy(out, b, (b_end - b) * sizeof(struct sort_entry));
+}
+
+static void *sort_worker(void *data)
+{
+  struct sort_job *job = data;
+
+  if (job->out)
+    merge_entries(job);
+  else
+    sort_entries(job->entries, job->n);
+  return NULL;
+}
+
+/* Run count jobs, one on the calling thread and the others on workers */
+static void sort_run_jobs(struct sort_job *jobs, int count)
+{
+  pthread_t threads[SORT_MAX_THREADS - 1];
+  bool started[SORT_MAX_THREADS - 1];
+  sigset_t all, old;
+  int i;
+
+  /* leave the signals to the main thread */
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &old);
+  for (i = 0; i < count - 1; i++)
+    started[i] = (pthread_create(&threads[i], NULL, sort_worker, &jobs[i]) == 0);
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+  /* this thread takes the last job, and those no worker could take */
+  sort_worker(&jobs[count - 1]);
+  for (i = 0; i < count - 1; i++)
+  {
+    if (started[i])
+      pthread_join(threads[i], NULL);
+    else
+      sort_worker(&jobs[i]);
+  }
+}
+#endif
+
+/**
+ * sort_entries_threads - Sort entries, on several threads if there are many
+ * @entries: Entries to sort
+ * @n:       Number of entries
+ *
+ * The entries are cut in up to $index_sort_threads chunks, which are sorted
+ * concurrently by sort_entries().  The chunks are then merged in pairs, also
+ * concurrently, until one is left.  As compare_entries() is a total order,
+ * the result is the one sort_entries() would give.
+ */
+static void sort_entries_threads(struct sort_entry *entries, int n)
+{
+#ifdef HAVE_PTHREAD
+  struct sort_job jobs[SORT_MAX_THREADS];
+  int bounds[SORT_MAX_THREADS + 1];
+  struct sort_entry *tmp = NULL, *src = entries, *dst = NULL, *swap = NULL;
+  int nthreads = IndexSortThreads;
+  int chunks, i, k;
+
+  if (nthreads <= 0)
+    nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+  nthreads = MIN(MIN(nthreads, n / SORT_MIN_CHUNK), SORT_MAX_THREADS);
+  if (nthreads < 2)
+  {
+    sort_entries(entries, n);
+    return;
+  }
+  mutt_debug(2, "sort_entries_threads: sorting %d messages with %d threads\n", n, nthreads);
+
+  for (i = 0; i <= nthreads; i++)
+    bounds[i] = (int) ((long long) n * i / nthreads);
+  for (i = 0; i < nthreads; i++)
+  {
+    jobs[i].entries = entries + bounds[i];
+    jobs[i].n = bounds[i + 1] - bounds[i];
+    jobs[i].mid = 0;
+    jobs[i].out = NULL;
+  }
+  sort_run_jobs(jobs, nthreads);
+
+  dst = tmp = safe_malloc(n * sizeof(struct sort_entry));
+  for (chunks = nthreads; chunks > 1; chunks = (chunks + 1) / 2)
+  {
+    /* a chunk without a pair is merged with nothing, i.e. copied */
+    for (i = 0, k = 0; i < chunks; i += 2, k++)
+    {
+      jobs[k].entries = src + bounds[i];
+      jobs[k].n = bounds[MIN(i + 2, chunks)] - bounds[i];
+      jobs[k].mid = bounds[i + 1] - bounds[i];
+      jobs[k].out = dst + bounds[i];
+      bounds[k] = bounds[i];
+    }
+    bounds[k] = n;
+    sort_run_jobs(jobs, k);
+    swap = src;
+    src = dst;
+    dst = swap;
+  }
+  if (src != entries)
+    memcpy(entries, src, n * sizeof(struct sort_entry));
+  FREE(&tmp);
+#else
+  sort_entries(entries, n);
+#endif
+}
+
+/* Look up the sort keys of the messages of ctx, for $sort and $sort_aux */
+static struct sort_entry *sort_entries_new(CONTEXT *ctx)
+{
+  struct sort_entry *entries = NULL;
+  int i, aux;
+
+  SortKeys.hdrs = safe_malloc(ctx->msgcount * sizeof(HEADER *));
+  memcpy(SortKeys.hdrs, ctx->hdrs, ctx->msgcount * sizeof(HEADER *));
+  SortKeys.size = 1024;
+  SortKeys.data = safe_malloc(SortKeys.size);
+  SortKeys.data[0] = '\0';
+  SortKeys.len = 1;
+
+  /* $sort_aux only matters when $sort can't tell messages apart */
+  aux = ((SortAux & SORT_MASK) != (Sort & SORT_MASK)) && ((Sort & SORT_MASK) != SORT_ORDER);
+
+  entries = safe_malloc(ctx->msgcount * sizeof(struct sort_entry));
+  for (i = 0; i < ctx->msgcount; i++)
+  {
+    sort_key_set(&entries[i].key[0], Sort, ctx, ctx->hdrs[i]);
+    if (aux)
+      sort_key_set(&entries[i].key[1], SortAux, ctx, ctx->hdrs[i]);
+    else
+      memset(&entries[i].key[1], 0, sizeof(struct sort_key));
+    entries[i].index = ctx->hdrs[i]->index;
+    entries[i].slot = i;
+    entries[i].flip = false;
+
+    /* compare_subject() orders the messages without a subject with
+     * compare_date_sent(), which applies $sort's reverse once more */
+    if ((Sort & SORT_REVERSE) && !ctx->hdrs[i]->env->real_subj)
+    {
+      if ((Sort & SORT_MASK) == SORT_SUBJECT)
+      {
+        /* by date, then by $sort_aux and index reversed unless $sort_aux is
+         * $sort as well */
+        entries[i].key[0].num = -ctx->hdrs[i]->date_sent;
+        entries[i].flip = aux;
+      }
+      else if (aux && ((SortAux & SORT_MASK) == SORT_SUBJECT))
+      {
+        /* by date and index, both reversed */
+        entries[i].key[1].num = -ctx->hdrs[i]->date_sent;
+        entries[i].key[1].prefix = ~(unsigned long long) ctx->hdrs[i]->index;
+      }
+    }
+  }
+  return entries;
+}
+
+static void sort_entries_free(struct sort_entry **entries)
+{
+  FREE(entries);
+  FREE(&SortKeys.hdrs);
+  FREE(&SortKeys.data);
+  SortKeys.len = SortKeys.size = 0;
+}
+
+/* adjust the virtual message numbers */
+static void renumber_headers(CONTEXT *ctx)
+{
+  int i;
+
+  ctx->vcount = 0;
+  for (i = 0; i < ctx->msgcount; i++)
+  {
+    HEADER *cur = ctx->hdrs[i];
+    if (cur->virtual != -1 || (cur->collapsed && (!ctx->pattern || cur->limited)))
+    {
+      cur->virtual = ctx->vcount;
+      ctx->v2r[ctx->vcount] = i;
+      ctx->vcount++;
+    }
+    cur->msgno = i;
+  }
+}
+
 void mutt_sort_headers(CONTEXT *ctx, int init)
 {
   int i;
   HEADER *h = NULL;
   THREAD *thread = NULL, *top = NULL;
   sort_t *sortfunc = NULL;
+  struct sort_entry *entries = NULL;
+  long long start, threads;
 
   unset_option(OPTNEEDRESORT);
 
@@ -310,6 +825,7 @@ void mutt_sort_headers(CONTEXT *ctx, int init)
   if (!ctx->quiet)
     mutt_message(_("Sorting mailbox..."));
 
+  start = mutt_stats_start();
   if (option(OPTNEEDRESCORE) && option(OPTSCORE))
   {
     for (i = 0; i < ctx->msgcount; i++)
@@ -340,7 +856,9 @@ void mutt_sort_headers(CONTEXT *ctx, int init)
       Sort = i;
       unset_option(OPTSORTSUBTHREADS);
     }
+    threads = mutt_stats_start();
     mutt_sort_threads(ctx, init);
+    mutt_stats_stop(STATS_THREADS, threads, ctx);
   }
   else if ((sortfunc = mutt_get_sort_func(Sort)) == NULL ||
            (AuxSort = mutt_get_sort_func(SortAux)) == NULL)
@@ -350,22 +868,16 @@ void mutt_sort_headers(CONTEXT *ctx, int init)
     return;
   }
   else
-    qsort((void *) ctx->hdrs, ctx->msgcount, sizeof(HEADER *), sortfunc);
-
-  /* adjust the virtual message numbers */
-  ctx->vcount = 0;
-  for (i = 0; i < ctx->msgcount; i++)
   {
-    HEADER *cur = ctx->hdrs[i];
-    if (cur->virtual != -1 || (cur->collapsed && (!ctx->pattern || cur->limited)))
-    {
-      cur->virtual = ctx->vcount;
-      ctx->v2r[ctx->vcount] = i;
-      ctx->vcount++;
-    }
-    cur->msgno = i;
+    entries = sort_entries_new(ctx);
+    sort_entries_threads(entries, ctx->msgcount);
+    for (i = 0; i < ctx->msgcount; i++)
+      ctx->hdrs[i] = SortKeys.hdrs[entries[i].slot];
+    sort_entries_free(&entries);
   }
 
+  renumber_headers(ctx);
+
   /* re-collapse threads marked as collapsed */
   if ((Sort & SORT_MASK) == SORT_THREADS)
   {
@@ -383,6 +895,87 @@ void mutt_sort_headers(CONTEXT *ctx, int init)
     mutt_set_virtual(ctx);
   }
 
+  mutt_stats_stop(STATS_SORT, start, ctx);
   if (!ctx->quiet)
     mutt_clear_error();
 }
+
+/* Sort the messages appended to a sorted mailbox: only the new headers,
+ * from oldcount on, are sorted and they are then merged with the others.
+ * Threads are extended with mutt_sort_new_threads() when it can, else they
+ * are sorted again with mutt_sort_headers().  If uncollapse is set, the
+ * threads with new messages are uncollapsed, as $uncollapse_new does. */
+void mutt_sort_new_headers(CONTEXT *ctx, int oldcount, int uncollapse)
+{
+  HEADER **new = NULL;
+  struct sort_entry *entries = NULL;
+  sort_t *sortfunc = NULL;
+  long long start;
+  int i, j, k, n;
+
+  if (!ctx)
+    return;
+
+  if ((oldcount <= 0) || (oldcount > ctx->msgcount) || option(OPTNEEDRESORT) ||
+      (option(OPTNEEDRESCORE) && option(OPTSCORE)) || option(OPTRESORTINIT))
+  {
+    mutt_sort_headers(ctx, 0);
+    return;
+  }
+
+  if ((Sort & SORT_MASK) == SORT_THREADS)
+  {
+    AuxSort = NULL;
+    start = mutt_stats_start();
+    i = mutt_sort_new_threads(ctx, oldcount, uncollapse);
+    mutt_stats_stop(STATS_THREADS, start, ctx);
+    if (i == 0)
+      return;
+
+    n = ctx->msgcount - oldcount;
+    if (uncollapse && (n > 0))
+    {
+      new = safe_malloc(n * sizeof(HEADER *));
+      memcpy(new, ctx->hdrs + oldcount, n * sizeof(HEADER *));
+    }
+    mutt_sort_headers(ctx, 0);
+    if (new)
+    {
+      for (i = 0; i < n; i++)
+        if (!ctx->pattern || new[i]->limited)
+          mutt_uncollapse_thread(ctx, new[i]);
+      FREE(&new);
+      mutt_set_virtual(ctx);
+    }
+    return;
+  }
+
+  if (!(sortfunc = mutt_get_sort_func(Sort)) || !(AuxSort = mutt_get_sort_func(SortAux)))
+  {
+    mutt_sort_headers(ctx, 0);
+    return;
+  }
+
+  start = mutt_stats_start();
+  n = ctx->msgcount - oldcount;
+  if (n > 0)
+  {
+    entries = sort_entries_new(ctx);
+    sort_entries_threads(entries + oldcount, n);
+
+    /* merge from the end, the old headers only move towards it */
+    i = oldcount - 1;
+    j = ctx->msgcount - 1;
+    for (k = ctx->msgcount - 1; j >= oldcount; k--)
+    {
+      if (i >= 0 && compare_entries(&entries[i], &entries[j]) > 0)
+        ctx->hdrs[k] = SortKeys.hdrs[entries[i--].slot];
+      else
+        ctx->hdrs[k] = SortKeys.hdrs[entries[j--].slot];
+    }
+    sort_entries_free(&entries);
+  }
+
+  renumber_headers(ctx);
+  mutt_stats_stop(STATS_SORT, start, ctx);
+}
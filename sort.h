@@ -61,6 +61,8 @@ sort_t *mutt_get_sort_func(int method);
 
 void mutt_clear_threads(CONTEXT *ctx);
 void mutt_sort_headers(CONTEXT *ctx, int init);
+void mutt_sort_new_headers(CONTEXT *ctx, int oldcount, int uncollapse);
+int mutt_sort_new_threads(CONTEXT *ctx, int oldcount, int uncollapse);
 void mutt_sort_threads(CONTEXT *ctx, int init);
 int mutt_select_sort(int reverse);
 THREAD *mutt_sort_subthreads(THREAD *thread, int init);
@@ -0,0 +1,248 @@
+/**
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Timing and counters of the mailbox operations.
+ *
+ * The operations are timed with mutt_stats_start() and mutt_stats_stop(),
+ * which also write a Chrome trace event ("ph":"X") to $stats_trace_file when
+ * it is set.  The file can be loaded in chrome://tracing or Perfetto.
+ *
+ * The report is shown by the "stats" command, and written to $stats_file
+ * when mutt exits.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+#include "mutt.h"
+#include "stats.h"
+#include "globals.h"
+#include "lib.h"
+
+struct stats_total
+{
+  unsigned long calls;
+  long long total; /* microseconds */
+  long long max;
+};
+
+long long StatsCounters[STATS_COUNTER_MAX];
+
+static struct stats_total Spans[STATS_SPAN_MAX];
+static long Peaks[STATS_PEAK_MAX];
+
+static const char *const SpanNames[STATS_SPAN_MAX] = {
+  "open", "load", "check", "sync", "sort", "threads", "pattern",
+};
+
+static const char *const CounterNames[STATS_COUNTER_MAX] = {
+  "header cache hits", "header cache misses", "bytes read",
+  "regexec calls",     "messages read",
+};
+
+static const char *const PeakNames[STATS_PEAK_MAX] = {
+  "messages in a mailbox", "header array slots",
+};
+
+static FILE *TraceFp = NULL;
+static char *TracePath = NULL; /* $stats_trace_file when TraceFp was opened */
+static bool TraceFirst;
+
+/* microseconds on the monotonic clock */
+static long long stats_now(void)
+{
+  struct timespec ts;
+
+  if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0)
+    return 0;
+  return (long long) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void trace_close(void)
+{
+  if (TraceFp)
+  {
+    fputs("\n]\n", TraceFp);
+    safe_fclose(&TraceFp);
+  }
+  FREE(&TracePath);
+}
+
+/* Open $stats_trace_file if it was set or changed.  A file which can't be
+ * opened is not retried until the variable changes. */
+static FILE *trace_open(void)
+{
+  if (!StatsTraceFile)
+  {
+    trace_close();
+    return NULL;
+  }
+
+  if (TracePath && (mutt_strcmp(TracePath, StatsTraceFile) == 0))
+    return TraceFp;
+
+  trace_close();
+  TracePath = safe_strdup(StatsTraceFile);
+  TraceFp = safe_fopen(StatsTraceFile, "w");
+  if (!TraceFp)
+  {
+    mutt_debug(1, "trace_open: can't open %s\n", StatsTraceFile);
+    return NULL;
+  }
+
+  fputs("[\n", TraceFp);
+  TraceFirst = true;
+  return TraceFp;
+}
+
+static void json_puts(const char *s, FILE *fp)
+{
+  for (; s && *s; s++)
+  {
+    if ((*s == '"') || (*s == '\\'))
+      fprintf(fp, "\\%c", *s);
+    else if ((unsigned char) *s < 0x20)
+      fprintf(fp, "\\u%04x", (unsigned char) *s);
+    else
+      fputc(*s, fp);
+  }
+}
+
+/**
+ * mutt_stats_start - Start timing an operation
+ * @retval num Start time, to be passed to mutt_stats_stop()
+ */
+long long mutt_stats_start(void)
+{
+  return stats_now();
+}
+
+/**
+ * mutt_stats_stop - Record the duration of an operation
+ * @span:  Operation
+ * @start: Value returned by mutt_stats_start()
+ * @ctx:   Mailbox the operation worked on, may be NULL
+ */
+void mutt_stats_stop(enum stats_span span, long long start, const CONTEXT *ctx)
+{
+  long long dur = stats_now() - start;
+  FILE *fp = NULL;
+
+  Spans[span].calls++;
+  Spans[span].total += dur;
+  if (dur > Spans[span].max)
+    Spans[span].max = dur;
+
+  if (ctx)
+  {
+    mutt_stats_peak(STATS_PEAK_MSGCOUNT, ctx->msgcount);
+    mutt_stats_peak(STATS_PEAK_HDRMAX, ctx->hdrmax);
+  }
+
+  if (!(fp = trace_open()))
+    return;
+
+  fprintf(fp,
+          "%s{\"name\":\"%s\",\"cat\":\"mailbox\",\"ph\":\"X\",\"ts\":%lld,"
+          "\"dur\":%lld,\"pid\":%d,\"tid\":1,\"args\":{",
+          TraceFirst ? "" : ",\n", SpanNames[span], start, dur, (int) getpid());
+  if (ctx)
+  {
+    fprintf(fp, "\"messages\":%d,\"mailbox\":\"", ctx->msgcount);
+    json_puts(ctx->path, fp);
+    fputc('"', fp);
+  }
+  fputs("}}", fp);
+  fflush(fp);
+  TraceFirst = false;
+}
+
+/**
+ * mutt_stats_peak - Record a size, keeping the largest one
+ * @peak: What is measured
+ * @n:    Current size
+ */
+void mutt_stats_peak(enum stats_peak peak, long n)
+{
+  if (n > Peaks[peak])
+    Peaks[peak] = n;
+}
+
+/**
+ * mutt_stats_report - Write the statistics of the session
+ * @fp: File to write to
+ */
+void mutt_stats_report(FILE *fp)
+{
+  struct rusage ru;
+  int i;
+
+  fprintf(fp, "%-10s %8s %12s %12s %12s\n", "Operation", "Calls",
+          "Total ms", "Mean ms", "Max ms");
+  for (i = 0; i < STATS_SPAN_MAX; i++)
+  {
+    fprintf(fp, "%-10s %8lu %12.1f %12.1f %12.1f\n", SpanNames[i],
+            Spans[i].calls, Spans[i].total / 1000.0,
+            Spans[i].calls ? Spans[i].total / 1000.0 / Spans[i].calls : 0.0,
+            Spans[i].max / 1000.0);
+  }
+
+  fprintf(fp, "\n%-30s %14s\n", "Counter", "Value");
+  for (i = 0; i < STATS_COUNTER_MAX; i++)
+    fprintf(fp, "%-30s %14lld\n", CounterNames[i], StatsCounters[i]);
+
+  fprintf(fp, "\n%-30s %14s\n", "Peak", "Value");
+  for (i = 0; i < STATS_PEAK_MAX; i++)
+    fprintf(fp, "%-30s %14ld\n", PeakNames[i], Peaks[i]);
+  if (getrusage(RUSAGE_SELF, &ru) == 0)
+    fprintf(fp, "%-30s %14ld\n", "max resident set size (kB)", ru.ru_maxrss);
+}
+
+/**
+ * mutt_stats_reset - Forget the statistics gathered so far
+ */
+void mutt_stats_reset(void)
+{
+  memset(Spans, 0, sizeof(Spans));
+  memset(StatsCounters, 0, sizeof(StatsCounters));
+  memset(Peaks, 0, sizeof(Peaks));
+}
+
+/**
+ * mutt_stats_finish - Write $stats_file and close $stats_trace_file
+ *
+ * Called when mutt exits.
+ */
+void mutt_stats_finish(void)
+{
+  FILE *fp = NULL;
+
+  if (StatsFile)
+  {
+    if ((fp = safe_fopen(StatsFile, "w")))
+    {
+      mutt_stats_report(fp);
+      safe_fclose(&fp);
+    }
+    else
+      mutt_debug(1, "mutt_stats_finish: can't open %s\n", StatsFile);
+  }
+
+  trace_close();
+}
@@ -0,0 +1,67 @@
+/**
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MUTT_STATS_H
+#define _MUTT_STATS_H 1
+
+#include <stdio.h>
+
+/* timed operations, see mutt_stats_stop() */
+enum stats_span
+{
+  STATS_OPEN,    /* mx_open_mailbox() */
+  STATS_LOAD,    /* mx_load_mailbox() */
+  STATS_CHECK,   /* mx_check_mailbox() */
+  STATS_SYNC,    /* writing a mailbox back */
+  STATS_SORT,    /* mutt_sort_headers() */
+  STATS_THREADS, /* mutt_sort_threads() */
+  STATS_PATTERN, /* mutt_pattern_func() */
+  STATS_SPAN_MAX
+};
+
+/* event counters, see mutt_stats_add() */
+enum stats_counter
+{
+  STATS_HCACHE_HIT,  /* headers found in the header cache */
+  STATS_HCACHE_MISS, /* headers not found, or not valid any more */
+  STATS_BYTES_READ,  /* read from servers and scanned in mbox folders */
+  STATS_REGEXEC,     /* regular expressions run by patterns */
+  STATS_MESSAGES,    /* messages added to mailboxes */
+  STATS_COUNTER_MAX
+};
+
+/* largest sizes seen, see mutt_stats_peak() */
+enum stats_peak
+{
+  STATS_PEAK_MSGCOUNT, /* messages in a mailbox */
+  STATS_PEAK_HDRMAX,   /* slots in the header arrays of a mailbox */
+  STATS_PEAK_MAX
+};
+
+extern long long StatsCounters[STATS_COUNTER_MAX];
+
+/* the counters are bumped on hot paths, so they are plain increments: only
+ * the main thread may use them */
+#define mutt_stats_add(c, n) (StatsCounters[(c)] += (n))
+#define mutt_stats_count(c) (StatsCounters[(c)]++)
+
+long long mutt_stats_start(void);
+void mutt_stats_stop(enum stats_span span, long long start, const CONTEXT *ctx);
+void mutt_stats_peak(enum stats_peak peak, long n);
+void mutt_stats_report(FILE *fp);
+void mutt_stats_reset(void);
+void mutt_stats_finish(void);
+
+#endif /* _MUTT_STATS_H */
@@ -17,9 +17,15 @@
 
 #include "config.h"
 #include <ctype.h>
+#include <stdint.h>
 #include <string.h>
 #include "mutt.h"
 #include "sort.h"
+#ifdef USE_HCACHE
+#include "hcache.h"
+#include "md5.h"
+#include "mx.h"
+#endif
 
 #define VISIBLE(hdr, ctx)                                                      \
   (hdr->virtual >= 0 || (hdr->collapsed && (!ctx->pattern || hdr->limited)))
@@ -112,6 +118,36 @@ static void linearize_tree(CONTEXT *ctx)
   }
 }
 
+/* copy the messages of the thread under top to array, in the order used by
+ * linearize_tree(), and return their number.  array may be NULL to just count
+ * them. */
+static int linearize_thread(THREAD *top, HEADER **array)
+{
+  THREAD *tree = top;
+  int n = 0;
+
+  while (tree)
+  {
+    while (!tree->message)
+      tree = tree->child;
+
+    if (array)
+      array[n] = tree->message;
+    n++;
+
+    if (tree->child)
+      tree = tree->child;
+    else
+    {
+      while (tree != top && !tree->next)
+        tree = tree->parent;
+      tree = (tree == top) ? NULL : tree->next;
+    }
+  }
+
+  return n;
+}
+
 /* this calculates whether a node is the root of a subtree that has visible
  * nodes, whether a node itself is visible, whether, if invisible, it has
  * depth anyway, and whether any of its later siblings are roots of visible
@@ -119,9 +155,9 @@ static void linearize_tree(CONTEXT *ctx)
  * skip parts of the tree in mutt_draw_tree() if we've decided here that we
  * don't care about them any more.
  */
-static void calculate_visibility(CONTEXT *ctx, int *max_depth)
+static void calculate_visibility(CONTEXT *ctx, THREAD *top, int *max_depth)
 {
-  THREAD *tmp = NULL, *tree = ctx->tree;
+  THREAD *tmp = NULL, *tree = top;
   int hide_top_missing = option(OPTHIDETOPMISSING) && !option(OPTHIDEMISSING);
   int hide_top_limited = option(OPTHIDETOPLIMITED) && !option(OPTHIDELIMITED);
   int depth = 0;
@@ -139,7 +175,7 @@ static void calculate_visibility(CONTEXT *ctx, int *max_depth)
     tree->subtree_visible = 0;
     if (tree->message)
     {
-      FREE(&tree->message->tree);
+      FREE(&tree->message->cold->tree);
       if (VISIBLE(tree->message, ctx))
       {
         tree->deep = true;
@@ -196,7 +232,7 @@ static void calculate_visibility(CONTEXT *ctx, int *max_depth)
   /* now fix up for the OPTHIDETOP* options if necessary */
   if (hide_top_limited || hide_top_missing)
   {
-    tree = ctx->tree;
+    tree = top;
     while (true)
     {
       if (!tree->visible && tree->deep && tree->subtree_visible < 2 &&
@@ -226,19 +262,22 @@ static void calculate_visibility(CONTEXT *ctx, int *max_depth)
  * ncurses should automatically use the default ASCII characters instead of
  * graphics chars on terminals which don't support them (see the man page
  * for curs_addch).
+ *
+ * The threads are drawn independently of each other, so this may be given
+ * only some of them, linked as siblings starting at top.
  */
-void mutt_draw_tree(CONTEXT *ctx)
+static void draw_threads(CONTEXT *ctx, THREAD *top)
 {
   char *pfx = NULL, *mypfx = NULL, *arrow = NULL, *myarrow = NULL, *new_tree = NULL;
   char corner = (Sort & SORT_REVERSE) ? MUTT_TREE_ULCORNER : MUTT_TREE_LLCORNER;
   char vtee = (Sort & SORT_REVERSE) ? MUTT_TREE_BTEE : MUTT_TREE_TTEE;
   int depth = 0, start_depth = 0, max_depth = 0, width = option(OPTNARROWTREE) ? 1 : 2;
-  THREAD *nextdisp = NULL, *pseudo = NULL, *parent = NULL, *tree = ctx->tree;
+  THREAD *nextdisp = NULL, *pseudo = NULL, *parent = NULL, *tree = top;
 
   /* Do the visibility calculations and free the old thread chars.
    * From now on we can simply ignore invisible subtrees
    */
-  calculate_visibility(ctx, &max_depth);
+  calculate_visibility(ctx, top, &max_depth);
   pfx = safe_malloc(width * max_depth + 2);
   arrow = safe_malloc(width * max_depth + 2);
   while (tree)
@@ -270,7 +309,7 @@ void mutt_draw_tree(CONTEXT *ctx)
         }
         else
           strfcpy(new_tree, arrow, 2 + depth * width);
-        tree->message->tree = new_tree;
+        tree->message->cold->tree = new_tree;
       }
     }
     if (tree->child && depth)
@@ -338,6 +377,11 @@ void mutt_draw_tree(CONTEXT *ctx)
   FREE(&arrow);
 }
 
+void mutt_draw_tree(CONTEXT *ctx)
+{
+  draw_threads(ctx, ctx->tree);
+}
+
 /* since we may be trying to attach as a pseudo-thread a THREAD that
  * has no message, we have to make a list of all the subjects of its
  * most immediate existing descendants.  we also note the earliest
@@ -480,25 +524,44 @@ static void insert_message(THREAD **new, THREAD *newparent, THREAD *cur)
 static HASH *make_subj_hash(CONTEXT *ctx)
 {
   int i;
-  HEADER *hdr = NULL;
+  HEADER *hdr = NULL, **read = NULL;
   HASH *hash = NULL;
 
   hash = hash_create(ctx->msgcount * 2, MUTT_HASH_ALLOW_DUPS);
 
+  /* the messages of a tree restored from the header cache have been sorted
+   * since it was built: add them in the order they were read, as it was */
+  if (ctx->restored)
+  {
+    read = safe_calloc(ctx->msgcount, sizeof(HEADER *));
+    for (i = 0; i < ctx->msgcount; i++)
+    {
+      hdr = ctx->hdrs[i];
+      if ((hdr->index < 0) || (hdr->index >= ctx->msgcount) || read[hdr->index])
+      {
+        FREE(&read);
+        break;
+      }
+      read[hdr->index] = hdr;
+    }
+  }
+
   for (i = 0; i < ctx->msgcount; i++)
   {
-    hdr = ctx->hdrs[i];
+    hdr = read ? read[i] : ctx->hdrs[i];
     if (hdr->env->real_subj)
       hash_insert(hash, hdr->env->real_subj, hdr);
   }
 
+  FREE(&read);
   return hash;
 }
 
-/* thread by subject things that didn't get threaded by message-id */
-static void pseudo_threads(CONTEXT *ctx)
+/* thread by subject things that didn't get threaded by message-id.
+ * tree is a list of top-level threads, the new head of which is returned. */
+static THREAD *pseudo_threads(CONTEXT *ctx, THREAD *tree)
 {
-  THREAD *tree = ctx->tree, *top = tree;
+  THREAD *top = tree;
   THREAD *tmp = NULL, *cur = NULL, *parent = NULL, *curchild = NULL, *nextchild = NULL;
 
   if (!ctx->subj_hash)
@@ -552,7 +615,7 @@ static void pseudo_threads(CONTEXT *ctx)
       }
     }
   }
-  ctx->tree = top;
+  return top;
 }
 
 
@@ -573,6 +636,7 @@ void mutt_clear_threads(CONTEXT *ctx)
 
   if (ctx->thread_hash)
     hash_destroy(&ctx->thread_hash, *free);
+  ctx->restored = false;
 }
 
 static int compare_threads(const void *a, const void *b)
@@ -719,10 +783,29 @@ THREAD *mutt_sort_subthreads(THREAD *thread, int init)
   }
 }
 
+/* figure out whether a message has a subject different than its parent's */
+static void check_subject(HEADER *cur)
+{
+  THREAD *tmp = cur->thread->parent;
+
+  while (tmp && !tmp->message)
+  {
+    tmp = tmp->parent;
+  }
+
+  if (!tmp)
+    cur->subject_changed = true;
+  else if (cur->env->real_subj && tmp->message->env->real_subj)
+    cur->subject_changed =
+        (mutt_strcmp(cur->env->real_subj, tmp->message->env->real_subj) != 0) ? true : false;
+  else
+    cur->subject_changed =
+        (cur->env->real_subj || tmp->message->env->real_subj) ? true : false;
+}
+
 static void check_subjects(CONTEXT *ctx, int init)
 {
   HEADER *cur = NULL;
-  THREAD *tmp = NULL;
   int i;
 
   for (i = 0; i < ctx->msgcount; i++)
@@ -733,41 +816,189 @@ static void check_subjects(CONTEXT *ctx, int init)
     else if (!init)
       continue;
 
-    /* figure out which messages have subjects different than their parents' */
-    tmp = cur->thread->parent;
-    while (tmp && !tmp->message)
+    check_subject(cur);
+  }
+}
+
+/* put a new message together with the matching messageless THREAD if it
+ * exists.  otherwise, if there is a THREAD that already has a message, thread
+ * the new message as an identical child.  if we didn't attach the message to a
+ * THREAD, make a new one for it.  top is the temporary top node of the tree. */
+static void add_message(CONTEXT *ctx, THREAD *top, HEADER *cur, int init)
+{
+  THREAD *thread = NULL, *new = NULL, *tmp = NULL;
+
+  if ((!init || option(OPTDUPTHREADS)) && cur->env->message_id)
+    thread = hash_find(ctx->thread_hash, cur->env->message_id);
+  else
+    thread = NULL;
+
+  if (thread && !thread->message)
+  {
+    /* this is a message which was missing before */
+    thread->message = cur;
+    cur->thread = thread;
+    thread->check_subject = true;
+
+    /* mark descendants as needing subject_changed checked */
+    for (tmp = (thread->child ? thread->child : thread); tmp != thread;)
     {
-      tmp = tmp->parent;
+      while (!tmp->message)
+        tmp = tmp->child;
+      tmp->check_subject = true;
+      while (!tmp->next && tmp != thread)
+        tmp = tmp->parent;
+      if (tmp != thread)
+        tmp = tmp->next;
     }
 
-    if (!tmp)
-      cur->subject_changed = true;
-    else if (cur->env->real_subj && tmp->message->env->real_subj)
-      cur->subject_changed =
-          (mutt_strcmp(cur->env->real_subj, tmp->message->env->real_subj) != 0) ? true : false;
-    else
-      cur->subject_changed =
-          (cur->env->real_subj || tmp->message->env->real_subj) ? true : false;
+    if (thread->parent)
+    {
+      /* remove threading info above it based on its children, which we'll
+       * recalculate based on its headers.  make sure not to leave
+       * dangling missing messages.  note that we haven't kept track
+       * of what info came from its children and what from its siblings'
+       * children, so we just remove the stuff that's definitely from it */
+      do
+      {
+        tmp = thread->parent;
+        unlink_message(&tmp->child, thread);
+        thread->parent = NULL;
+        thread->sort_key = NULL;
+        thread->fake_thread = false;
+        thread = tmp;
+      } while (thread != top && !thread->child && !thread->message);
+    }
+  }
+  else
+  {
+    new = (option(OPTDUPTHREADS) ? thread : NULL);
+
+    thread = safe_calloc(1, sizeof(THREAD));
+    thread->message = cur;
+    thread->check_subject = true;
+    cur->thread = thread;
+    hash_insert(ctx->thread_hash,
+                cur->env->message_id ? cur->env->message_id : "", thread);
+
+    if (new)
+    {
+      if (new->duplicate_thread)
+        new = new->parent;
+
+      thread = cur->thread;
+
+      insert_message(&new->child, new, thread);
+      thread->duplicate_thread = true;
+      thread->message->threaded = true;
+    }
   }
 }
 
-void mutt_sort_threads(CONTEXT *ctx, int init)
+/* unlink the pseudo-threads of a message because they might be children of
+ * newly arrived messages */
+static void unlink_pseudo_threads(THREAD *top, THREAD *thread)
 {
-  HEADER *cur = NULL;
-  int i, oldsort, using_refs = 0;
-  THREAD *thread = NULL, *new = NULL, *tmp = NULL, top;
-  memset(&top, 0, sizeof(top));
+  THREAD *new = NULL, *tmp = NULL;
+
+  for (new = thread->child; new;)
+  {
+    tmp = new->next;
+    if (new->fake_thread)
+    {
+      unlink_message(&thread->child, new);
+      insert_message(&top->child, top, new);
+      new->fake_thread = false;
+    }
+    new = tmp;
+  }
+}
+
+/* thread a message by its In-Reply-To: and References: */
+static void thread_by_references(CONTEXT *ctx, THREAD *top, HEADER *cur)
+{
+  THREAD *thread = NULL, *new = NULL;
   LIST *ref = NULL;
+  int using_refs = 0;
 
-  /* set Sort to the secondary method to support the set sort_aux=reverse-*
-   * settings.  The sorting functions just look at the value of
-   * SORT_REVERSE
-   */
-  oldsort = Sort;
-  Sort = SortAux;
+  if (cur->threaded)
+    return;
+  cur->threaded = true;
 
-  if (!ctx->thread_hash)
-    init = 1;
+  thread = cur->thread;
+
+  while (1)
+  {
+    if (using_refs == 0)
+    {
+      /* look at the beginning of in-reply-to: */
+      if ((ref = cur->env->in_reply_to) != NULL)
+        using_refs = 1;
+      else
+      {
+        ref = cur->env->references;
+        using_refs = 2;
+      }
+    }
+    else if (using_refs == 1)
+    {
+      /* if there's no references header, use all the in-reply-to:
+       * data that we have.  otherwise, use the first reference
+       * if it's different than the first in-reply-to, otherwise use
+       * the second reference (since at least eudora puts the most
+       * recent reference in in-reply-to and the rest in references)
+       */
+      if (!cur->env->references)
+        ref = ref->next;
+      else
+      {
+        if (mutt_strcmp(ref->data, cur->env->references->data) != 0)
+          ref = cur->env->references;
+        else
+          ref = cur->env->references->next;
+
+        using_refs = 2;
+      }
+    }
+    else
+      ref = ref->next; /* go on with references */
+
+    if (!ref)
+      break;
+
+    if ((new = hash_find(ctx->thread_hash, ref->data)) == NULL)
+    {
+      new = safe_calloc(1, sizeof(THREAD));
+      hash_insert(ctx->thread_hash, ref->data, new);
+    }
+    else
+    {
+      if (new->duplicate_thread)
+        new = new->parent;
+      if (is_descendant(new, thread)) /* no loops! */
+        continue;
+    }
+
+    if (thread->parent)
+      unlink_message(&top->child, thread);
+    insert_message(&new->child, new, thread);
+    thread = new;
+    if (thread->message || (thread->parent && thread->parent != top))
+      break;
+  }
+
+  if (!thread->parent)
+    insert_message(&top->child, top, thread);
+}
+
+/* build the tree of the messages which aren't threaded yet, but don't sort it.
+ * when init is set, the tree is built from scratch. */
+static void thread_messages(CONTEXT *ctx, int init)
+{
+  HEADER *cur = NULL;
+  int i;
+  THREAD *thread = NULL, top;
+  memset(&top, 0, sizeof(top));
 
   if (init)
     ctx->thread_hash = hash_create(ctx->msgcount * 2, MUTT_HASH_ALLOW_DUPS);
@@ -780,201 +1011,990 @@ void mutt_sort_threads(CONTEXT *ctx, int init)
   for (thread = ctx->tree; thread; thread = thread->next)
     thread->parent = &top;
 
-  /* put each new message together with the matching messageless THREAD if it
-   * exists.  otherwise, if there is a THREAD that already has a message, thread
-   * new message as an identical child.  if we didn't attach the message to a
-   * THREAD, make a new one for it. */
   for (i = 0; i < ctx->msgcount; i++)
   {
     cur = ctx->hdrs[i];
 
     if (!cur->thread)
+      add_message(ctx, &top, cur, init);
+    else
+      unlink_pseudo_threads(&top, cur->thread);
+  }
+
+  /* thread by references */
+  for (i = 0; i < ctx->msgcount; i++)
+    thread_by_references(ctx, &top, ctx->hdrs[i]);
+
+  /* detach everything from the temporary top node */
+  for (thread = top.child; thread; thread = thread->next)
+  {
+    thread->parent = NULL;
+  }
+  ctx->tree = top.child;
+
+  check_subjects(ctx, init);
+
+  if (!option(OPTSTRICTTHREADS))
+    ctx->tree = pseudo_threads(ctx, ctx->tree);
+}
+
+#ifdef USE_HCACHE
+/**
+ * struct thread_cache - The tree of a folder, stored in its header cache
+ *
+ * It is stored under HCACHE_THREADS_KEY as built by thread_messages() from
+ * scratch, before its threads are sorted, followed by its nodes in the order
+ * of a depth-first walk.  It is only used for the same messages, in the same
+ * order, threaded with the same options.
+ */
+struct thread_cache
+{
+  int msgcount;
+  int nodes;                /* messages, and the missing messages they refer to */
+  unsigned char digest[16]; /* md5 of the keys of the messages and the options */
+};
+
+#define THREAD_CACHE_FAKE      (1 << 0) /* fake_thread */
+#define THREAD_CACHE_DUPLICATE (1 << 1) /* duplicate_thread */
+#define THREAD_CACHE_CHANGED   (1 << 2) /* subject_changed of the message */
+#define THREAD_CACHE_MISSING   (1 << 3) /* a missing message, only referred to */
+
+struct thread_cache_node
+{
+  int message; /* index of the message, or of one referring to it if missing */
+  int ref;     /* if missing, which reference of that message names it */
+  int parent;  /* position of the parent node, or -1 */
+  int flags;   /* THREAD_CACHE_* */
+};
+
+/* a missing message in ctx->thread_hash, and a reference naming it */
+struct thread_cache_ref
+{
+  THREAD *thread;
+  int message;
+  int ref;
+};
+
+static int compare_cache_refs(const void *a, const void *b)
+{
+  uintptr_t ta = (uintptr_t)((const struct thread_cache_ref *) a)->thread;
+  uintptr_t tb = (uintptr_t)((const struct thread_cache_ref *) b)->thread;
+
+  return (ta > tb) - (ta < tb);
+}
+
+/**
+ * thread_cache_ref - Get a reference of a message
+ * @hdr: Message
+ * @ref: Position of the reference, counting its In-Reply-To: ids first
+ * @retval ptr Message-id of the reference
+ * @retval NULL The message has fewer references
+ */
+static const char *thread_cache_ref(HEADER *hdr, int ref)
+{
+  LIST *l = NULL;
+  int i = 0;
+
+  for (l = hdr->env->in_reply_to; l; l = l->next, i++)
+    if (i == ref)
+      return l->data;
+  for (l = hdr->env->references; l; l = l->next, i++)
+    if (i == ref)
+      return l->data;
+  return NULL;
+}
+
+/**
+ * thread_cache_digest - Checksum what the tree of a folder is built from
+ * @ctx:    Mailbox, whose messages are in the order they were read
+ * @digest: Buffer for the md5 (16 bytes)
+ * @retval  0 Success
+ * @retval -1 A message has no header cache key
+ */
+static int thread_cache_digest(CONTEXT *ctx, unsigned char *digest)
+{
+  struct md5_ctx md5;
+  char key[LONG_STRING];
+  unsigned char opts[4];
+  int i, len;
+
+  opts[0] = option(OPTSTRICTTHREADS);
+  opts[1] = option(OPTDUPTHREADS);
+  opts[2] = option(OPTSORTRE);
+  opts[3] = option(OPTTHREADRECEIVED);
+
+  md5_init_ctx(&md5);
+  md5_process_bytes(opts, sizeof(opts), &md5);
+  if (ReplyRegexp.pattern)
+    md5_process_bytes(ReplyRegexp.pattern, strlen(ReplyRegexp.pattern) + 1, &md5);
+
+  for (i = 0; i < ctx->msgcount; i++)
+  {
+    if (ctx->hdrs[i]->index != i)
+      return -1;
+    len = mx_hcache_key(ctx, ctx->hdrs[i], key, sizeof(key));
+    if ((len < 0) || (len >= (int) sizeof(key)))
+      return -1;
+    md5_process_bytes(key, len + 1, &md5);
+  }
+
+  md5_finish_ctx(&md5, digest);
+  return 0;
+}
+
+/**
+ * thread_cache_restore - Restore the tree of a folder from its header cache
+ * @ctx: Mailbox, whose messages aren't threaded
+ * @hc:  Header cache
+ * @retval  0 Success, ctx->thread_hash holds the nodes of the tree
+ * @retval -1 There is no tree for these messages, nothing was restored
+ *
+ * The hash of the message-ids is rebuilt as thread_messages() fills it, so
+ * that new mail can be threaded into the restored tree.
+ */
+static int thread_cache_restore(CONTEXT *ctx, header_cache_t *hc)
+{
+  struct thread_cache tc;
+  struct thread_cache_node *node = NULL;
+  unsigned char digest[16];
+  THREAD **threads = NULL, *parent = NULL;
+  HEADER *cur = NULL;
+  HASH *hash = NULL;
+  const char *id = NULL;
+  void *data = NULL;
+  size_t dlen = 0;
+  int i, count = 0, rc = -1;
+
+  data = mutt_hcache_fetch_raw_size(hc, HCACHE_THREADS_KEY,
+                                    strlen(HCACHE_THREADS_KEY), &dlen);
+  if (!data)
+    return -1;
+  if (dlen < sizeof(tc))
+    goto cleanup;
+  memcpy(&tc, data, sizeof(tc));
+
+  /* the nodes must fill the rest of the record exactly */
+  if ((tc.msgcount != ctx->msgcount) || (tc.nodes < tc.msgcount) ||
+      ((dlen - sizeof(tc)) % sizeof(*node) != 0) ||
+      ((dlen - sizeof(tc)) / sizeof(*node) != (size_t) tc.nodes) ||
+      (thread_cache_digest(ctx, digest) != 0) ||
+      (memcmp(digest, tc.digest, sizeof(digest)) != 0))
+    goto cleanup;
+
+  node = (struct thread_cache_node *) ((char *) data + sizeof(tc));
+  threads = safe_calloc(tc.nodes, sizeof(THREAD *));
+
+  for (i = 0; i < tc.nodes; i++)
+  {
+    /* each message once, and the parents before their children */
+    if ((node[i].message < 0) || (node[i].message >= ctx->msgcount) ||
+        (node[i].parent < -1) || (node[i].parent >= i))
+      goto cleanup;
+
+    threads[i] = safe_calloc(1, sizeof(THREAD));
+    threads[i]->fake_thread = (node[i].flags & THREAD_CACHE_FAKE) ? true : false;
+    threads[i]->duplicate_thread = (node[i].flags & THREAD_CACHE_DUPLICATE) ? true : false;
+    if (node[i].flags & THREAD_CACHE_MISSING)
+      continue;
+
+    cur = ctx->hdrs[node[i].message];
+    if (cur->thread)
+      goto cleanup;
+    cur->thread = threads[i];
+    cur->threaded = true;
+    cur->subject_changed = (node[i].flags & THREAD_CACHE_CHANGED) ? true : false;
+    threads[i]->message = cur;
+    count++;
+  }
+  if (count != ctx->msgcount)
+    goto cleanup;
+
+  /* add_message() hashes the messages in order, then thread_by_references()
+   * the ids of the missing ones, which are unique */
+  hash = hash_create(ctx->msgcount * 2, MUTT_HASH_ALLOW_DUPS);
+  for (i = 0; i < ctx->msgcount; i++)
+  {
+    cur = ctx->hdrs[i];
+    hash_insert(hash, cur->env->message_id ? cur->env->message_id : "", cur->thread);
+  }
+  for (i = 0; i < tc.nodes; i++)
+  {
+    if (!(node[i].flags & THREAD_CACHE_MISSING))
+      continue;
+    id = thread_cache_ref(ctx->hdrs[node[i].message], node[i].ref);
+    if (!id || hash_find(hash, id))
+      goto cleanup;
+    hash_insert(hash, id, threads[i]);
+  }
+
+  /* insert_message() adds a node before its siblings */
+  for (i = tc.nodes - 1; i >= 0; i--)
+  {
+    if (node[i].parent < 0)
+      insert_message(&ctx->tree, NULL, threads[i]);
+    else
     {
-      if ((!init || option(OPTDUPTHREADS)) && cur->env->message_id)
-        thread = hash_find(ctx->thread_hash, cur->env->message_id);
-      else
-        thread = NULL;
+      parent = threads[node[i].parent];
+      insert_message(&parent->child, parent, threads[i]);
+    }
+  }
 
-      if (thread && !thread->message)
-      {
-        /* this is a message which was missing before */
-        thread->message = cur;
-        cur->thread = thread;
-        thread->check_subject = true;
+  /* a missing message is only in the tree for its children */
+  for (i = 0; i < tc.nodes; i++)
+    if (!threads[i]->message && !threads[i]->child)
+      goto cleanup;
 
-        /* mark descendants as needing subject_changed checked */
-        for (tmp = (thread->child ? thread->child : thread); tmp != thread;)
-        {
-          while (!tmp->message)
-            tmp = tmp->child;
-          tmp->check_subject = true;
-          while (!tmp->next && tmp != thread)
-            tmp = tmp->parent;
-          if (tmp != thread)
-            tmp = tmp->next;
-        }
+  ctx->thread_hash = hash;
+  ctx->restored = true;
+  rc = 0;
 
-        if (thread->parent)
-        {
-          /* remove threading info above it based on its children, which we'll
-           * recalculate based on its headers.  make sure not to leave
-           * dangling missing messages.  note that we haven't kept track
-           * of what info came from its children and what from its siblings'
-           * children, so we just remove the stuff that's definitely from it */
-          do
-          {
-            tmp = thread->parent;
-            unlink_message(&tmp->child, thread);
-            thread->parent = NULL;
-            thread->sort_key = NULL;
-            thread->fake_thread = false;
-            thread = tmp;
-          } while (thread != &top && !thread->child && !thread->message);
-        }
-      }
-      else
-      {
-        new = (option(OPTDUPTHREADS) ? thread : NULL);
+cleanup:
+  if (rc != 0)
+  {
+    for (i = 0; i < ctx->msgcount; i++)
+    {
+      ctx->hdrs[i]->thread = NULL;
+      ctx->hdrs[i]->threaded = false;
+    }
+    ctx->tree = NULL;
+    if (hash)
+      hash_destroy(&hash, NULL);
+    for (i = 0; threads && (i < tc.nodes); i++)
+      FREE(&threads[i]);
+  }
+  FREE(&threads);
+  mutt_hcache_free(hc, &data);
+  return rc;
+}
 
-        thread = safe_calloc(1, sizeof(THREAD));
-        thread->message = cur;
-        thread->check_subject = true;
-        cur->thread = thread;
-        hash_insert(ctx->thread_hash,
-                    cur->env->message_id ? cur->env->message_id : "", thread);
+/**
+ * thread_cache_save - Store the tree of a folder in its header cache
+ * @ctx: Mailbox, just threaded from scratch by thread_messages()
+ * @hc:  Header cache
+ */
+static void thread_cache_save(CONTEXT *ctx, header_cache_t *hc)
+{
+  struct thread_cache *tc = NULL;
+  struct thread_cache_node *node = NULL;
+  struct thread_cache_ref *refs = NULL, *found = NULL, key;
+  THREAD *thread = NULL;
+  const char *id = NULL;
+  size_t size;
+  int *stack = NULL; /* positions of the ancestors of thread */
+  int nodes = 0, depth = 0, maxdepth = 0, nrefs = 0, maxrefs = 0;
+  int i, j, rc = -1;
+
+  size = sizeof(struct thread_cache) + ctx->msgcount * sizeof(struct thread_cache_node);
+  tc = safe_malloc(size);
+  if (thread_cache_digest(ctx, tc->digest) != 0)
+    goto cleanup;
+
+  /* the ids of the missing messages are only keys of ctx->thread_hash */
+  for (i = 0; i < ctx->msgcount; i++)
+  {
+    for (j = 0; (id = thread_cache_ref(ctx->hdrs[i], j)); j++)
+    {
+      thread = hash_find(ctx->thread_hash, id);
+      if (!thread || thread->message)
+        continue;
+      if (nrefs == maxrefs)
+        safe_realloc(&refs, (maxrefs += 256) * sizeof(struct thread_cache_ref));
+      refs[nrefs].thread = thread;
+      refs[nrefs].message = ctx->hdrs[i]->index;
+      refs[nrefs].ref = j;
+      nrefs++;
+    }
+  }
+  if (refs)
+    qsort(refs, nrefs, sizeof(struct thread_cache_ref), compare_cache_refs);
 
-        if (new)
-        {
-          if (new->duplicate_thread)
-            new = new->parent;
+  for (thread = ctx->tree; thread;)
+  {
+    if (sizeof(struct thread_cache) + (nodes + 1) * sizeof(struct thread_cache_node) > size)
+    {
+      size *= 2;
+      safe_realloc(&tc, size);
+    }
+    node = (struct thread_cache_node *) (tc + 1) + nodes;
+    node->parent = depth ? stack[depth - 1] : -1;
+    node->flags = (thread->fake_thread ? THREAD_CACHE_FAKE : 0) |
+                  (thread->duplicate_thread ? THREAD_CACHE_DUPLICATE : 0) |
+                  ((thread->message && thread->message->subject_changed) ? THREAD_CACHE_CHANGED : 0);
+    if (thread->message)
+    {
+      node->message = thread->message->index;
+      node->ref = -1;
+    }
+    else
+    {
+      key.thread = thread;
+      found = refs ? bsearch(&key, refs, nrefs, sizeof(struct thread_cache_ref),
+                             compare_cache_refs) :
+                     NULL;
+      if (!found)
+        goto cleanup;
+      node->message = found->message;
+      node->ref = found->ref;
+      node->flags |= THREAD_CACHE_MISSING;
+    }
 
-          thread = cur->thread;
+    if (thread->child)
+    {
+      if (depth == maxdepth)
+        safe_realloc(&stack, (maxdepth += 64) * sizeof(int));
+      stack[depth++] = nodes++;
+      thread = thread->child;
+      continue;
+    }
 
-          insert_message(&new->child, new, thread);
-          thread->duplicate_thread = true;
-          thread->message->threaded = true;
-        }
-      }
+    nodes++;
+    while (!thread->next && depth)
+    {
+      thread = thread->parent;
+      depth--;
     }
+    thread = thread->next;
+  }
+
+  tc->msgcount = ctx->msgcount;
+  tc->nodes = nodes;
+  mutt_hcache_store_raw(hc, HCACHE_THREADS_KEY, strlen(HCACHE_THREADS_KEY), tc,
+                        sizeof(struct thread_cache) + nodes * sizeof(struct thread_cache_node));
+  rc = 0;
+
+cleanup:
+  if (rc != 0)
+    mutt_hcache_delete(hc, HCACHE_THREADS_KEY, strlen(HCACHE_THREADS_KEY));
+  FREE(&refs);
+  FREE(&stack);
+  FREE(&tc);
+}
+#endif /* USE_HCACHE */
+
+void mutt_sort_threads(CONTEXT *ctx, int init)
+{
+  int oldsort;
+#ifdef USE_HCACHE
+  header_cache_t *hc = NULL;
+#endif
+
+  /* set Sort to the secondary method to support the set sort_aux=reverse-*
+   * settings.  The sorting functions just look at the value of
+   * SORT_REVERSE
+   */
+  oldsort = Sort;
+  Sort = SortAux;
+
+  if (!ctx->thread_hash)
+    init = 1;
+
+#ifdef USE_HCACHE
+  /* when the mailbox is opened, reuse the tree of its last opening */
+  if (init && ctx->opening && !ctx->loading)
+    hc = mx_open_hcache(ctx);
+  if (hc && (thread_cache_restore(ctx, hc) == 0))
+    mutt_debug(2, "mutt_sort_threads: restored the threads of %s\n", ctx->path);
+  else
+  {
+    thread_messages(ctx, init);
+    if (hc)
+      thread_cache_save(ctx, hc);
+  }
+  mutt_hcache_close(hc);
+#else
+  thread_messages(ctx, init);
+#endif
+
+  if (ctx->tree)
+  {
+    ctx->tree = mutt_sort_subthreads(ctx->tree, init);
+
+    /* restore the oldsort order. */
+    Sort = oldsort;
+
+    /* Put the list into an array. */
+    linearize_tree(ctx);
+
+    /* Draw the thread tree. */
+    mutt_draw_tree(ctx);
+  }
+}
+
+/* a top-level thread moved by mutt_sort_new_threads(), and the positions of
+ * its messages in the display order */
+struct thread_block
+{
+  THREAD *top;
+  int pos;
+  int len;
+};
+
+static int compare_blocks(const void *a, const void *b)
+{
+  return ((const struct thread_block *) a)->pos - ((const struct thread_block *) b)->pos;
+}
+
+static off_t message_size(HEADER *h)
+{
+  return h->content->length + h->content->offset - h->content->hdr_offset;
+}
+
+/* the message at position pos of the display order of the n first messages */
+static HEADER *display_message(CONTEXT *ctx, int n, int pos, int reverse)
+{
+  return ctx->hdrs[reverse ? n - 1 - pos : pos];
+}
+
+static THREAD *top_of(THREAD *thread)
+{
+  while (thread->parent)
+    thread = thread->parent;
+  return thread;
+}
+
+/* add n times the message cur to the counts of its top-level thread top */
+static void count_message(CONTEXT *ctx, THREAD *top, HEADER *cur, int n)
+{
+  if (ctx->pattern && !cur->limited)
+    return;
+
+  if (cur->virtual == -1)
+    top->hidden += n;
+  if (!cur->read)
+  {
+    if (cur->old)
+      top->unread_old += n;
+    else
+      top->unread_new += n;
+  }
+}
+
+/* count the messages of the top-level thread top */
+static void count_thread(CONTEXT *ctx, THREAD *top)
+{
+  THREAD *tree = top;
+
+  top->hidden = top->unread_new = top->unread_old = 0;
+  while (tree)
+  {
+    if (tree->message)
+      count_message(ctx, top, tree->message, 1);
+
+    if (tree->child)
+      tree = tree->child;
     else
     {
-      /* unlink pseudo-threads because they might be children of newly
-       * arrived messages */
-      thread = cur->thread;
-      for (new = thread->child; new;)
-      {
-        tmp = new->next;
-        if (new->fake_thread)
-        {
-          unlink_message(&thread->child, new);
-          insert_message(&top.child, &top, new);
-          new->fake_thread = false;
-        }
-        new = tmp;
-      }
+      while (tree != top && !tree->next)
+        tree = tree->parent;
+      tree = (tree == top) ? NULL : tree->next;
     }
   }
+}
 
-  /* thread by references */
-  for (i = 0; i < ctx->msgcount; i++)
+/**
+ * mutt_count_threads - Count the messages of every thread
+ * @ctx: Mailbox
+ *
+ * The counts are kept on the top-level THREADs, so that the number of hidden
+ * messages of a thread and whether it has unread ones are known without
+ * walking it.  They must be counted again when the threads or the limit
+ * change.
+ */
+void mutt_count_threads(CONTEXT *ctx)
+{
+  THREAD *top = NULL;
+
+  if ((Sort & SORT_MASK) != SORT_THREADS)
+    return;
+
+  for (top = ctx->tree; top; top = top->next)
+    count_thread(ctx, top);
+}
+
+/**
+ * mutt_count_thread_message - Update the counts of the thread of a message
+ * @ctx: Mailbox
+ * @cur: Message
+ * @n:   1 to add the message, -1 to remove it
+ *
+ * The message is removed before its flags are changed, and added back after.
+ */
+void mutt_count_thread_message(CONTEXT *ctx, HEADER *cur, int n)
+{
+  if (((Sort & SORT_MASK) == SORT_THREADS) && cur->thread)
+    count_message(ctx, top_of(cur->thread), cur, n);
+}
+
+/* the threads collected by mutt_sort_new_threads() */
+struct rethread
+{
+  CONTEXT *ctx;
+  int oldcount;
+  struct thread_block *blocks;
+  int nblocks;
+  int maxblocks;
+  HASH *subjects; /* subjects looked up in all the messages */
+  HASH *tops;     /* subjects looked up in the top messages */
+};
+
+/* add the top-level thread of thread to the blocks being rethreaded, and
+ * return the number of messages it has */
+static int add_block(struct rethread *r, THREAD *thread)
+{
+  struct thread_block *b = NULL;
+  THREAD *tmp = NULL;
+
+  if (!thread)
+    return 0;
+
+  thread = top_of(thread);
+  /* skip the messageless THREADs which were dropped from the tree */
+  if (thread->rethread || (!thread->message && !thread->child))
+    return 0;
+  thread->rethread = true;
+
+  if (r->nblocks == r->maxblocks)
+    safe_realloc(&r->blocks, (r->maxblocks += 16) * sizeof(struct thread_block));
+  b = &r->blocks[r->nblocks++];
+
+  for (tmp = thread; !tmp->message; tmp = tmp->child)
+    ;
+  b->top = thread;
+  b->pos = (Sort & SORT_REVERSE) ? r->oldcount - 1 - tmp->message->msgno :
+                                   tmp->message->msgno;
+  b->len = linearize_thread(thread, NULL);
+  return b->len;
+}
+
+/* whether pseudo_threads() looks at the subject of cur: the message is at
+ * the top of a thread or of a pseudo-thread, see make_subject_list() */
+static bool is_subject_top(HEADER *cur)
+{
+  THREAD *thread = cur->thread;
+
+  if (!cur->env->real_subj ||
+      ((cur->env->real_subj == cur->env->subject) && option(OPTSORTRE)))
+    return false;
+
+  while (!thread->fake_thread && thread->parent)
+  {
+    thread = thread->parent;
+    if (thread->message)
+      return false;
+  }
+  return true;
+}
+
+/* add the threads whose pseudo-threads may change because of cur, and
+ * return the work done.  If cur may become a pseudo-thread, that is any
+ * thread with its subject, else the ones which may become its pseudo-thread. */
+static int add_subject_blocks(struct rethread *r, HEADER *cur, bool top)
+{
+  struct hash_elem *ptr = NULL;
+  const char *subj = cur->env->real_subj;
+  HASH *done = top ? r->subjects : r->tops;
+  int work = 0;
+
+  if (!subj || hash_find(r->subjects, subj) || hash_find(done, subj))
+    return 0;
+  hash_insert(done, subj, cur);
+
+  for (ptr = hash_find_bucket(r->ctx->subj_hash, subj); ptr; ptr = ptr->next, work++)
+  {
+    cur = ptr->data;
+    if (cur->thread && (mutt_strcmp(ptr->key.strkey, subj) == 0) &&
+        (top || is_subject_top(cur)))
+      work += add_block(r, cur->thread);
+  }
+
+  return work;
+}
+
+/* the first position of the blocks around pos, or -1 if pos isn't in one */
+static int block_start(struct thread_block *blocks, int nblocks, int pos, int *end)
+{
+  int lo = 0, hi = nblocks, mid, start;
+
+  while (lo < hi)
+  {
+    mid = lo + (hi - lo) / 2;
+    if (blocks[mid].pos + blocks[mid].len <= pos)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if ((lo == nblocks) || (blocks[lo].pos > pos))
+    return -1;
+
+  for (mid = lo, *end = blocks[mid].pos + blocks[mid].len;
+       (mid + 1 < nblocks) && (blocks[mid + 1].pos == *end); mid++)
+    *end += blocks[mid + 1].len;
+  for (start = blocks[lo].pos; (lo > 0) && (blocks[lo - 1].pos + blocks[lo - 1].len == start); lo--)
+    start = blocks[lo - 1].pos;
+  return start;
+}
+
+/* Thread the messages appended to a threaded mailbox, ctx->hdrs[oldcount] on.
+ *
+ * Only the threads which the new messages join are rethreaded, together with
+ * the ones sharing a subject with them unless $strict_threads is set, since
+ * the pseudo-threads may change.  They are sorted and drawn again and merged
+ * with the other threads, and ctx->hdrs and ctx->v2r are rebuilt from the
+ * first position where they were or go to.  As mutt_sort_headers() does,
+ * collapsed threads stay collapsed, unless uncollapse is set and they get a
+ * new message.
+ *
+ * Returns -1, without changing anything, if the mailbox has to be threaded
+ * by mutt_sort_headers() instead: when the threads weren't built yet, or
+ * when too many messages would have to be rethreaded anyway.
+ */
+int mutt_sort_new_threads(CONTEXT *ctx, int oldcount, int uncollapse)
+{
+  struct rethread rt;
+  struct thread_block *blocks = NULL;
+  int nblocks = 0;
+  THREAD top, *thread = NULL, *tail = NULL, **roots = NULL;
+  HEADER **new = NULL, **array = NULL, *cur = NULL;
+  LIST *ref = NULL;
+  int reverse = (Sort & SORT_REVERSE);
+  int count = ctx->msgcount - oldcount;
+  int nroots = 0, work = 0, rc = -1;
+  int i, j, k, b, r, lo, hi, mid, end, first, oldsort, vcount, *at = NULL;
+  off_t vsize;
+
+  if (!ctx->tree || !ctx->thread_hash || (oldcount <= 0) || (count <= 0) ||
+      option(OPTSORTSUBTHREADS))
+    return -1;
+
+  for (i = oldcount; i < ctx->msgcount; i++)
+    if (ctx->hdrs[i]->thread)
+      return -1;
+
+  /* find the threads the new messages join */
+  memset(&rt, 0, sizeof(rt));
+  rt.ctx = ctx;
+  rt.oldcount = oldcount;
+  if (!option(OPTSTRICTTHREADS))
+  {
+    if (!ctx->subj_hash)
+      ctx->subj_hash = make_subj_hash(ctx);
+    rt.subjects = hash_create(count * 2, 0);
+    rt.tops = hash_create(count * 2, 0);
+  }
+
+  for (i = oldcount; i < ctx->msgcount; i++)
   {
     cur = ctx->hdrs[i];
-    if (cur->threaded)
-      continue;
-    cur->threaded = true;
+    if (cur->env->message_id)
+      add_block(&rt, hash_find(ctx->thread_hash, cur->env->message_id));
+    for (ref = cur->env->in_reply_to; ref; ref = ref->next)
+      add_block(&rt, hash_find(ctx->thread_hash, ref->data));
+    for (ref = cur->env->references; ref; ref = ref->next)
+      add_block(&rt, hash_find(ctx->thread_hash, ref->data));
+    if (rt.subjects)
+      work += add_subject_blocks(&rt, cur, true);
+  }
+
+  /* and the threads whose pseudo-threads may change with those */
+  for (b = 0; b < rt.nblocks; b++)
+  {
+    work += rt.blocks[b].len;
+    for (j = 0; rt.subjects && (j < rt.blocks[b].len); j++)
+    {
+      cur = display_message(ctx, oldcount, rt.blocks[b].pos + j, reverse);
+      work += add_subject_blocks(&rt, cur, is_subject_top(cur));
+    }
+    if (work > ctx->msgcount / 4)
+      goto cleanup;
+  }
+  blocks = rt.blocks;
+  nblocks = rt.nblocks;
+
+  rc = 0;
+  qsort(blocks, nblocks, sizeof(struct thread_block), compare_blocks);
+
+  /* move the threads to a temporary top node, as mutt_sort_threads() does */
+  memset(&top, 0, sizeof(top));
+  for (b = nblocks - 1; b >= 0; b--)
+  {
+    unlink_message(&ctx->tree, blocks[b].top);
+    insert_message(&top.child, &top, blocks[b].top);
+  }
+
+  /* unlink their pseudo-threads, in the order of ctx->hdrs */
+  for (b = 0; b < nblocks; b++)
+  {
+    k = reverse ? nblocks - 1 - b : b;
+    for (j = 0; j < blocks[k].len; j++)
+    {
+      cur = display_message(ctx, oldcount,
+                            blocks[k].pos + (reverse ? blocks[k].len - 1 - j : j), reverse);
+      unlink_pseudo_threads(&top, cur->thread);
+    }
+  }
 
-    thread = cur->thread;
-    using_refs = 0;
+  new = safe_malloc(count * sizeof(HEADER *));
+  memcpy(new, ctx->hdrs + oldcount, count * sizeof(HEADER *));
+  for (i = 0; i < count; i++)
+    add_message(ctx, &top, new[i], 0);
+  for (i = 0; i < count; i++)
+    thread_by_references(ctx, &top, new[i]);
+
+  for (thread = top.child; thread; thread = thread->next)
+    thread->parent = NULL;
 
-    while (1)
+  for (b = 0; b < nblocks; b++)
+  {
+    for (j = 0; j < blocks[b].len; j++)
     {
-      if (using_refs == 0)
+      cur = display_message(ctx, oldcount, blocks[b].pos + j, reverse);
+      if (cur->thread->check_subject)
       {
-        /* look at the beginning of in-reply-to: */
-        if ((ref = cur->env->in_reply_to) != NULL)
-          using_refs = 1;
-        else
-        {
-          ref = cur->env->references;
-          using_refs = 2;
-        }
+        cur->thread->check_subject = false;
+        check_subject(cur);
       }
-      else if (using_refs == 1)
+    }
+  }
+  for (i = 0; i < count; i++)
+  {
+    if (new[i]->thread->check_subject)
+    {
+      new[i]->thread->check_subject = false;
+      check_subject(new[i]);
+    }
+  }
+
+  if (rt.subjects)
+    top.child = pseudo_threads(ctx, top.child);
+
+  oldsort = Sort;
+  Sort = SortAux;
+  top.child = mutt_sort_subthreads(top.child, 0);
+  Sort = oldsort;
+
+  draw_threads(ctx, top.child);
+
+  /* merge the threads with the others, keeping their order */
+  for (thread = top.child; thread; thread = thread->next)
+    nroots++;
+  roots = safe_malloc(nroots * sizeof(THREAD *));
+  at = safe_malloc(nroots * sizeof(int));
+  for (thread = top.child, r = 0; thread; thread = thread->next)
+    roots[r++] = thread;
+
+  Sort = SortAux;
+  compare_threads(NULL, NULL);
+  qsort(roots, nroots, sizeof(THREAD *), compare_threads);
+
+  for (r = 0; r < nroots; r++)
+  {
+    /* the first thread which goes after this one, or oldcount */
+    lo = 0;
+    hi = oldcount;
+    while (lo < hi)
+    {
+      mid = lo + (hi - lo) / 2;
+      if ((first = block_start(blocks, nblocks, mid, &end)) >= 0)
       {
-        /* if there's no references header, use all the in-reply-to:
-         * data that we have.  otherwise, use the first reference
-         * if it's different than the first in-reply-to, otherwise use
-         * the second reference (since at least eudora puts the most
-         * recent reference in in-reply-to and the rest in references)
-         */
-        if (!cur->env->references)
-          ref = ref->next;
+        if (end < hi)
+          mid = end;
+        else if (first > lo)
+          mid = first - 1;
         else
         {
-          if (mutt_strcmp(ref->data, cur->env->references->data) != 0)
-            ref = cur->env->references;
-          else
-            ref = cur->env->references->next;
-
-          using_refs = 2;
+          lo = hi;
+          break;
         }
       }
+      thread = top_of(display_message(ctx, oldcount, mid, reverse)->thread);
+      if (compare_threads(&thread, &roots[r]) > 0)
+        hi = mid;
       else
-        ref = ref->next; /* go on with references */
-
-      if (!ref)
-        break;
+        lo = mid + 1;
+    }
+    at[r] = lo;
 
-      if ((new = hash_find(ctx->thread_hash, ref->data)) == NULL)
+    roots[r]->prev = roots[r]->next = NULL;
+    if (lo < oldcount)
+    {
+      thread = top_of(display_message(ctx, oldcount, lo, reverse)->thread);
+      roots[r]->next = thread;
+      roots[r]->prev = thread->prev;
+      if (thread->prev)
+        thread->prev->next = roots[r];
+      else
+        ctx->tree = roots[r];
+      thread->prev = roots[r];
+    }
+    else
+    {
+      if (!tail)
       {
-        new = safe_calloc(1, sizeof(THREAD));
-        hash_insert(ctx->thread_hash, ref->data, new);
+        /* the last thread which stays where it is */
+        for (mid = oldcount - 1; mid >= 0; mid = first - 1)
+          if ((first = block_start(blocks, nblocks, mid, &end)) < 0)
+            break;
+        if (mid >= 0)
+          tail = top_of(display_message(ctx, oldcount, mid, reverse)->thread);
       }
-      else
+      if (tail)
       {
-        if (new->duplicate_thread)
-          new = new->parent;
-        if (is_descendant(new, thread)) /* no loops! */
-          continue;
+        tail->next = roots[r];
+        roots[r]->prev = tail;
       }
-
-      if (thread->parent)
-        unlink_message(&top.child, thread);
-      insert_message(&new->child, new, thread);
-      thread = new;
-      if (thread->message || (thread->parent && thread->parent != &top))
-        break;
+      else
+        ctx->tree = roots[r];
+      tail = roots[r];
     }
-
-    if (!thread->parent)
-      insert_message(&top.child, &top, thread);
+  }
+  Sort = oldsort;
+
+  /* the virtual messages before the first change, and their size */
+  lo = at[0];
+  if (nblocks && (blocks[0].pos < lo))
+    lo = blocks[0].pos;
+
+  /* every message must have stayed in the threads which were moved */
+  for (r = 0, k = count; r < nroots; r++)
+    k -= linearize_thread(roots[r], NULL);
+  for (b = 0; b < nblocks; b++)
+    k += blocks[b].len;
+  if (k != 0)
+  {
+    mutt_debug(1, "mutt_sort_new_threads: %d messages moved to other threads\n", k);
+    lo = 0;
   }
 
-  /* detach everything from the temporary top node */
-  for (thread = top.child; thread; thread = thread->next)
+  vcount = 0;
+  if (!reverse)
   {
-    thread->parent = NULL;
+    hi = ctx->vcount;
+    while (vcount < hi)
+    {
+      mid = vcount + (hi - vcount) / 2;
+      if (ctx->v2r[mid] < lo)
+        vcount = mid + 1;
+      else
+        hi = mid;
+    }
+  }
+  vsize = lo ? ctx->vsize : 0;
+  for (i = lo; lo && (i < oldcount); i++)
+  {
+    cur = display_message(ctx, oldcount, i, reverse);
+    if (cur->virtual >= 0)
+      vsize -= message_size(cur);
+  }
+  /* update_index() counted the new messages which match the limit */
+  for (i = 0; lo && ctx->pattern && (i < count); i++)
+    if (new[i]->virtual >= 0)
+      vsize -= message_size(new[i]);
+
+  /* put the messages from lo on in their new order */
+  array = safe_malloc((ctx->msgcount - lo) * sizeof(HEADER *));
+  for (i = lo, j = 0, b = 0, r = 0; k == 0;)
+  {
+    while ((r < nroots) && (at[r] == i))
+      j += linearize_thread(roots[r++], array + j);
+    if (i >= oldcount)
+      break;
+    if ((b < nblocks) && (blocks[b].pos == i))
+    {
+      i += blocks[b++].len;
+      continue;
+    }
+    end = oldcount;
+    if ((b < nblocks) && (blocks[b].pos < end))
+      end = blocks[b].pos;
+    if ((r < nroots) && (at[r] < end))
+      end = at[r];
+    for (; i < end; i++)
+      array[j++] = display_message(ctx, oldcount, i, reverse);
   }
-  ctx->tree = top.child;
 
-  check_subjects(ctx, init);
+  if (k != 0)
+  {
+    linearize_tree(ctx);
+    first = 0;
+    end = ctx->msgcount;
+  }
+  else if (reverse)
+  {
+    memmove(ctx->hdrs + ctx->msgcount - lo, ctx->hdrs + oldcount - lo, lo * sizeof(HEADER *));
+    for (i = 0; i < j; i++)
+      ctx->hdrs[ctx->msgcount - 1 - lo - i] = array[i];
+    first = 0;
+    end = ctx->msgcount - lo;
+  }
+  else
+  {
+    memcpy(ctx->hdrs + lo, array, j * sizeof(HEADER *));
+    first = lo;
+    end = ctx->msgcount;
+  }
 
-  if (!option(OPTSTRICTTHREADS))
-    pseudo_threads(ctx);
+  for (i = first; i < ctx->msgcount; i++)
+    ctx->hdrs[i]->msgno = i;
 
-  if (ctx->tree)
+  /* make the collapsed threads visible and collapse them again, as
+   * mutt_sort_headers() does, but only the ones which were rethreaded */
+  for (r = 0; r < nroots; r++)
   {
-    ctx->tree = mutt_sort_subthreads(ctx->tree, init);
+    j = linearize_thread(roots[r], array);
+    for (i = 0; i < j; i++)
+    {
+      cur = array[i];
+      if (cur->virtual != -1 || (cur->collapsed && (!ctx->pattern || cur->limited)))
+        cur->virtual = cur->msgno;
+    }
+    for (thread = roots[r]; !thread->message; thread = thread->child)
+      ;
+    if (thread->message->collapsed)
+      mutt_collapse_thread(ctx, thread->message);
+  }
 
-    /* restore the oldsort order. */
-    Sort = oldsort;
+  for (i = 0; uncollapse && (i < count); i++)
+    if (!ctx->pattern || new[i]->limited)
+      mutt_uncollapse_thread(ctx, new[i]);
 
-    /* Put the list into an array. */
-    linearize_tree(ctx);
+  /* and set the virtual numbers as mutt_set_virtual() does */
+  for (i = first; i < ctx->msgcount; i++)
+  {
+    cur = ctx->hdrs[i];
+    if (cur->virtual >= 0)
+    {
+      cur->virtual = vcount;
+      ctx->v2r[vcount++] = i;
+      if (i < end)
+        vsize += message_size(cur);
+    }
+  }
+  ctx->vcount = vcount;
+  ctx->vsize = vsize;
 
-    /* Draw the thread tree. */
-    mutt_draw_tree(ctx);
+  for (r = 0; r < nroots; r++)
+  {
+    count_thread(ctx, roots[r]);
+    j = linearize_thread(roots[r], array);
+    for (i = 0; i < j; i++)
+      if (array[i]->virtual >= 0)
+        array[i]->num_hidden = mutt_get_hidden(ctx, array[i]);
+  }
+
+cleanup:
+  for (b = 0; b < rt.nblocks; b++)
+    rt.blocks[b].top->rethread = false;
+  FREE(&rt.blocks);
+  FREE(&roots);
+  FREE(&at);
+  FREE(&new);
+  FREE(&array);
+  if (rt.subjects)
+  {
+    hash_destroy(&rt.subjects, NULL);
+    hash_destroy(&rt.tops, NULL);
   }
+  return rc;
 }
 
 static HEADER *find_virtual(THREAD *cur, int reverse)
@@ -1126,6 +2146,7 @@ void mutt_set_virtual(CONTEXT *ctx)
 
   ctx->vcount = 0;
   ctx->vsize = 0;
+  mutt_count_threads(ctx);
 
   for (i = 0; i < ctx->msgcount; i++)
   {
@@ -1161,6 +2182,16 @@ int _mutt_traverse_thread(CONTEXT *ctx, HEADER *cur, int flag)
   while (thread->parent)
     thread = thread->parent;
   top = thread;
+
+  /* these are known from the counts of the thread */
+  if ((Sort & SORT_MASK) == SORT_THREADS)
+  {
+    if (flag & MUTT_THREAD_UNREAD)
+      return top->unread_new ? 1 : (top->unread_old ? 2 : 0);
+    if (flag & MUTT_THREAD_GET_HIDDEN)
+      return top->hidden + ((top->message && !top->child) ? 0 : 1);
+  }
+
   while (!thread->message)
     thread = thread->child;
   cur = thread->message;
@@ -1284,7 +2315,10 @@ int _mutt_traverse_thread(CONTEXT *ctx, HEADER *cur, int flag)
 
   /* return value depends on action requested */
   if (flag & (MUTT_THREAD_COLLAPSE | MUTT_THREAD_UNCOLLAPSE))
+  {
+    count_thread(ctx, top);
     return final;
+  }
   else if (flag & MUTT_THREAD_UNREAD)
     return ((old && new) ? new : (old ? old : new));
   else if (flag & MUTT_THREAD_GET_HIDDEN)
@@ -1380,8 +2414,12 @@ static void clean_references(THREAD *brk, THREAD *cur)
     {
       HEADER *h = cur->message;
 
-      /* clearing the References: header from obsolete Message-ID(s) */
-      mutt_free_list(&ref->next);
+      /* clearing the References: header from obsolete Message-ID(s), the
+       * pool of the mailbox keeps them if the list is in it */
+      if (h->env->refs_pooled)
+        ref->next = NULL;
+      else
+        mutt_free_list(&ref->next);
 
       h->env->refs_changed = h->changed = true;
     }
@@ -1390,6 +2428,12 @@ static void clean_references(THREAD *brk, THREAD *cur)
 
 void mutt_break_thread(HEADER *hdr)
 {
+  if (hdr->env->refs_pooled)
+  {
+    hdr->env->in_reply_to = NULL;
+    hdr->env->references = NULL;
+    hdr->env->refs_pooled = false;
+  }
   mutt_free_list(&hdr->env->in_reply_to);
   mutt_free_list(&hdr->env->references);
   hdr->env->irt_changed = hdr->env->refs_changed = hdr->changed = true;